@@ -198,6 +198,7 @@ enum dhd_bus_devreset_type {
 #define DHD_BUS_BUSY_IN_PM_CALLBACK		0x100000
 #define DHD_BUS_BUSY_IN_BT_FW_DWNLD		0x200000
 #define DHD_BUS_BUSY_IN_SSSR			0x400000
+#define DHD_BUS_BUSY_IN_BUSY_POLL		0x800000
 
 #define DHD_BUS_BUSY_SET_IN_TX(dhdp) \
 	(dhdp)->dhd_bus_busy_state |= DHD_BUS_BUSY_IN_TX
@@ -245,6 +246,8 @@ enum dhd_bus_devreset_type {
 	(dhdp)->dhd_bus_busy_state |= DHD_BUS_BUSY_IN_BT_FW_DWNLD
 #define DHD_BUS_BUSY_SET_IN_SSSR(dhdp) \
 	(dhdp)->dhd_bus_busy_state |= DHD_BUS_BUSY_IN_SSSR
+#define DHD_BUS_BUSY_SET_IN_BUSY_POLL(dhdp) \
+	(dhdp)->dhd_bus_busy_state |= DHD_BUS_BUSY_IN_BUSY_POLL
 
 #define DHD_BUS_BUSY_CLEAR_IN_TX(dhdp) \
 	(dhdp)->dhd_bus_busy_state &= ~DHD_BUS_BUSY_IN_TX
@@ -292,6 +295,8 @@ enum dhd_bus_devreset_type {
 	(dhdp)->dhd_bus_busy_state &= ~DHD_BUS_BUSY_IN_BT_FW_DWNLD
 #define DHD_BUS_BUSY_CLEAR_IN_SSSR(dhdp) \
 	(dhdp)->dhd_bus_busy_state &= ~DHD_BUS_BUSY_IN_SSSR
+#define DHD_BUS_BUSY_CLEAR_IN_BUSY_POLL(dhdp) \
+	(dhdp)->dhd_bus_busy_state &= ~DHD_BUS_BUSY_IN_BUSY_POLL
 
 #define DHD_BUS_BUSY_CHECK_IN_TX(dhdp) \
 	((dhdp)->dhd_bus_busy_state & DHD_BUS_BUSY_IN_TX)
@@ -335,6 +340,8 @@ enum dhd_bus_devreset_type {
 	((dhdp)->dhd_bus_busy_state & DHD_BUS_BUSY_IN_SYSFS_DUMP)
 #define DHD_BUS_BUSY_CHECK_IN_SSSR(dhdp) \
 	((dhdp)->dhd_bus_busy_state & DHD_BUS_BUSY_IN_SSSR)
+#define DHD_BUS_BUSY_CHECK_IN_BUSY_POLL(dhdp) \
+	((dhdp)->dhd_bus_busy_state & DHD_BUS_BUSY_IN_BUSY_POLL)
 
 #define DHD_BUS_BUSY_CHECK_IDLE(dhdp) \
 	((dhdp)->dhd_bus_busy_state == 0)
@@ -1091,6 +1098,24 @@ typedef struct dhd_if_tx_status_latency {
 } dhd_if_tx_status_latency_t;
 #endif /* TX_STATUS_LATENCY_STATS */
 
+#ifdef DHD_TXCPL_LAT_HIST
+/*
+ * Log-linear histogram of txpost to txcpl latency in usec. Values below
+ * DHD_TXCPL_LAT_SUB land in their own bin; above that each power of two is
+ * split in DHD_TXCPL_LAT_SUB bins, so a percentile read back is within 25%.
+ * The last bin collects everything from 2^(DHD_TXCPL_LAT_MSB_MAX + 1) us on.
+ * Only the txcpl path writes it, readers take an unlocked snapshot.
+ */
+#define DHD_TXCPL_LAT_SUB		4u
+#define DHD_TXCPL_LAT_MSB_MAX		20u
+#define DHD_TXCPL_LAT_BINS		(DHD_TXCPL_LAT_MSB_MAX * DHD_TXCPL_LAT_SUB + 1u)
+
+typedef struct dhd_txcpl_lat_hist {
+	uint32 bin[DHD_TXCPL_LAT_BINS];
+	uint32 max_us;
+} dhd_txcpl_lat_hist_t;
+#endif /* DHD_TXCPL_LAT_HIST */
+
 
 
 /* Bit in dhd_pub_t::gdb_proxy_stop_count set when firmware is stopped by GDB */
@@ -1585,6 +1610,15 @@ typedef struct dhd_pub {
 	uint32  max_tx_flowid;		/* used to validate flowid */
 	cumm_ctr_t cumm_ctr;        /* cumm queue length placeholder  */
 	cumm_ctr_t l2cumm_ctr;      /* level 2 cumm queue length placeholder */
+#ifdef DHD_FLOWRING_BQL
+	/* flowrings over their byte limit, per interface */
+	osl_atomic_t flow_bql_stopped[DHD_MAX_IFS];
+	/* flowrings holding queued or inflight bytes, per interface */
+	osl_atomic_t flow_bql_busy[DHD_MAX_IFS];
+#endif /* DHD_FLOWRING_BQL */
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_hist_t txcpl_lat_ac[AC_COUNT];	/* all flowrings, per AC */
+#endif /* DHD_TXCPL_LAT_HIST */
 	uint32 d2h_sync_mode;       /* D2H DMA completion sync mode */
 	uint8  flow_prio_map[NUMPRIO];
 	uint8	flow_prio_map_type;
@@ -2010,6 +2044,9 @@ typedef struct dhd_pub {
 	uint64 lb_rxp_strt_thr_hitcnt;
 	uint64 lb_rxp_napi_sched_cnt;
 	uint64 lb_rxp_napi_complete_cnt;
+#ifdef DHD_NAPI_BUSY_POLL
+	uint64 lb_rxp_busy_poll_cnt;	/* napi polls driven by a busy polling socket */
+#endif /* DHD_NAPI_BUSY_POLL */
 	uint64 rx_dma_stall_hc_ignore_cnt;
 #endif /* DHD_LB_STATS */
 #ifdef TX_CSO
@@ -2152,9 +2189,12 @@ typedef struct dhd_pkttag_fd {
 	void      *dmah;    /* dma mapper handle */
 	void      *secdma; /* secure dma sec_cma_info handle */
 #endif /* !DHD_PCIE_PKTID */
-#if defined(TX_STATUS_LATENCY_STATS) || defined(DHD_PKTTS)
+#if defined(TX_STATUS_LATENCY_STATS) || defined(DHD_PKTTS) || defined(DHD_TXCPL_LAT_HIST)
 	uint64	   q_time_us; /* time when tx pkt queued to flowring */
-#endif /* TX_STATUS_LATENCY_STATS || DHD_PKTTS */
+#endif /* TX_STATUS_LATENCY_STATS || DHD_PKTTS || DHD_TXCPL_LAT_HIST */
+#ifdef DHD_FLOWRING_SCHED
+	uint32	   enq_time_us; /* time when tx pkt queued to flow queue */
+#endif /* DHD_FLOWRING_SCHED */
 } dhd_pkttag_fd_t;
 
 /* Packet Tag for DHD PCIE Full Dongle */
@@ -2184,11 +2224,17 @@ typedef struct dhd_pkttag_fd {
 #define DHD_PKT_SET_SECDMA(pkt, pkt_secdma) \
 	DHD_PKTTAG_FD(pkt)->secdma = (void *)(pkt_secdma)
 
-#if defined(TX_STATUS_LATENCY_STATS) || defined(DHD_PKTTS)
+#if defined(TX_STATUS_LATENCY_STATS) || defined(DHD_PKTTS) || defined(DHD_TXCPL_LAT_HIST)
 #define DHD_PKT_GET_QTIME(pkt)    ((DHD_PKTTAG_FD(pkt))->q_time_us)
 #define DHD_PKT_SET_QTIME(pkt, pkt_q_time_us) \
 	DHD_PKTTAG_FD(pkt)->q_time_us = (uint64)(pkt_q_time_us)
-#endif /* TX_STATUS_LATENCY_STATS || DHD_PKTTS */
+#endif /* TX_STATUS_LATENCY_STATS || DHD_PKTTS || DHD_TXCPL_LAT_HIST */
+
+#ifdef DHD_FLOWRING_SCHED
+#define DHD_PKT_GET_ENQ_TIME(pkt)    ((DHD_PKTTAG_FD(pkt))->enq_time_us)
+#define DHD_PKT_SET_ENQ_TIME(pkt, pkt_enq_time_us) \
+	DHD_PKTTAG_FD(pkt)->enq_time_us = (uint32)(pkt_enq_time_us)
+#endif /* DHD_FLOWRING_SCHED */
 #endif /* PCIE_FULL_DONGLE */
 
 #if defined(BCMWDF)
@@ -4184,6 +4230,7 @@ extern void dhd_lb_stats_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
 extern void dhd_lb_stats_update_napi_histo(dhd_pub_t *dhdp, uint32 count);
 extern void dhd_lb_stats_update_txc_histo(dhd_pub_t *dhdp, uint32 count);
 extern void dhd_lb_stats_update_rxc_histo(dhd_pub_t *dhdp, uint32 count);
+extern void dhd_lb_stats_update_rx_list_histo(dhd_pub_t *dhdp, uint32 count);
 extern void dhd_lb_stats_txc_percpu_cnt_incr(dhd_pub_t *dhdp);
 extern void dhd_lb_stats_rxc_percpu_cnt_incr(dhd_pub_t *dhdp);
 #define DHD_LB_STATS_INIT(dhdp)	dhd_lb_stats_init(dhdp)
@@ -4199,6 +4246,7 @@ extern void dhd_lb_stats_rxc_percpu_cnt_incr(dhd_pub_t *dhdp);
 		DHD_LB_STATS_INCR(x[cpu]); \
 	}
 #define DHD_LB_STATS_UPDATE_NAPI_HISTO(dhdp, x)	dhd_lb_stats_update_napi_histo(dhdp, x)
+#define DHD_LB_STATS_UPDATE_RX_LIST_HISTO(dhdp, x)	dhd_lb_stats_update_rx_list_histo(dhdp, x)
 #else /* !DHD_LB_STATS */
 #define DHD_LB_STATS_INIT(dhdp)	 DHD_LB_STATS_NOOP
 #define DHD_LB_STATS_DEINIT(dhdp) DHD_LB_STATS_NOOP
@@ -4208,6 +4256,7 @@ extern void dhd_lb_stats_rxc_percpu_cnt_incr(dhd_pub_t *dhdp);
 #define DHD_LB_STATS_ADD(x, c)	 DHD_LB_STATS_NOOP
 #define DHD_LB_STATS_PERCPU_ARR_INCR(x)	 DHD_LB_STATS_NOOP
 #define DHD_LB_STATS_UPDATE_NAPI_HISTO(dhd, x) DHD_LB_STATS_NOOP
+#define DHD_LB_STATS_UPDATE_RX_LIST_HISTO(dhd, x) DHD_LB_STATS_NOOP
 #endif /* !DHD_LB_STATS */
 
 #ifdef BCMDBG
@@ -96,6 +96,10 @@ extern int dhd_bus_console_in(dhd_pub_t *dhd, uchar *msg, uint msglen);
 
 /* Deferred processing for the bus, return TRUE requests reschedule */
 extern bool dhd_bus_dpc(struct dhd_bus *bus);
+#ifdef DHD_NAPI_BUSY_POLL
+/* Drain rx completions for a busy polling socket, return TRUE if more are pending */
+extern bool dhd_bus_rx_busy_poll(struct dhd_bus *bus);
+#endif /* DHD_NAPI_BUSY_POLL */
 extern void dhd_bus_isr(bool * InterruptRecognized, bool * QueueMiniportHandleInterrupt, void *arg);
 
 
@@ -150,6 +154,12 @@ extern int dhd_bus_get_mem_dump(dhd_pub_t *dhdp);
 #define dhd_bus_get_mem_dump(x)
 #endif /* DHD_FW_COREDUMP && (BCMPCIE || BCMSDIO) */
 
+#if defined(DHD_FW_COREDUMP) && defined(BCMPCIE) && defined(DHD_MEMDUMP_STREAM)
+/* Consumer of a streamed SoC RAM dump, called for every piece of output in order */
+typedef int (*dhd_memdump_sink_t)(void *ctx, uint8 *buf, uint32 len);
+extern int dhd_bus_mem_dump_stream(dhd_pub_t *dhdp, dhd_memdump_sink_t sink, void *ctx);
+#endif /* DHD_FW_COREDUMP && BCMPCIE && DHD_MEMDUMP_STREAM */
+
 #ifdef BCMPCIE
 enum {
 	/* Scratch buffer confiuguration update */
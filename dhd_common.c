@@ -2410,6 +2410,9 @@ dhd_dump(dhd_pub_t *dhdp, char *buf, int buflen)
 
 	/* Add any bus info */
 	dhd_bus_dump(dhdp, strbuf);
+#ifdef DHDTCPACK_SUPPRESS
+	dhd_tcpack_suppress_dump(dhdp, strbuf);
+#endif /* DHDTCPACK_SUPPRESS */
 #if defined(BCM_ROUTER_DHD) && defined(HNDCTF)
 	/* Add ctf info */
 	dhd_ctf_dump(dhdp, strbuf);
@@ -30,6 +30,29 @@
 #include <dhd_dbg.h>
 #include <dhd_dbg_ring.h>
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+/*
+ * Per CPU staging buffer in front of the ring. Producers append complete
+ * records (header + payload) here under a lock that is only shared with the
+ * merger, and the staged records are moved into the ring under ring->lock
+ * when the stage fills up or before the ring is read. Records staged on
+ * different CPUs may reach the ring out of timestamp order. ring->stage is
+ * sampled once under rcu_read_lock() by its users, and freed only after a
+ * grace period once cleared.
+ */
+#ifndef DHD_DBG_RING_STAGE_SZ
+#define DHD_DBG_RING_STAGE_SZ	1024u
+#endif /* DHD_DBG_RING_STAGE_SZ */
+
+struct dhd_dbg_ring_stage {
+	spinlock_t lock;
+	uint32 len;
+	uint8 buf[DHD_DBG_RING_STAGE_SZ];
+};
+
+static void dhd_dbg_ring_stage_deinit(dhd_dbg_ring_t *ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 dhd_dbg_ring_t *
 dhd_dbg_ring_alloc_init(dhd_pub_t *dhd, uint16 ring_id,
 	char *ring_name, uint32 ring_sz, void *allocd_buf,
@@ -123,6 +146,31 @@ dhd_dbg_ring_init(dhd_pub_t *dhdp, dhd_dbg_ring_t *ring, uint16 id, uint8 *name,
 	ring->pull_inactive = pull_inactive;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	/* packet log ring is written in place and delayed rings have no buffer yet */
+	ring->stage = NULL;
+	atomic_set(&ring->staged_bytes, 0);
+	if (buf && id != PACKET_LOG_RING_ID) {
+		struct dhd_dbg_ring_stage *stages;
+		int cpu;
+
+		stages = alloc_percpu(struct dhd_dbg_ring_stage);
+		if (stages) {
+			for_each_possible_cpu(cpu) {
+				struct dhd_dbg_ring_stage *stage = per_cpu_ptr(stages, cpu);
+
+				spin_lock_init(&stage->lock);
+				stage->len = 0;
+			}
+			rcu_assign_pointer(ring->stage, stages);
+		} else {
+			/* not fatal, ring falls back to locked push */
+			DHD_ERROR(("%s: RING%d[%s] stage alloc failed\n",
+				__FUNCTION__, id, name));
+		}
+	}
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 	return BCME_OK;
 }
 
@@ -151,6 +199,10 @@ dhd_dbg_ring_deinit(dhd_pub_t *dhdp, dhd_dbg_ring_t *ring)
 	ring->state = RING_STOP;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_stage_deinit(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 	DHD_DBG_RING_LOCK_DEINIT(dhdp->osh, ring->lock);
 }
 
@@ -160,6 +212,11 @@ dhd_dbg_ring_sched_pull(dhd_dbg_ring_t *ring, uint32 pending_len,
 {
 	unsigned long flags = 0;
 
+	/* called after every push, skip the lock when there is nothing to do */
+	if (!ring->sched_pull || ring->threshold == 0 || pending_len < ring->threshold) {
+		return;
+	}
+
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 	/* if the current pending size is bigger than threshold and
 	 * threshold is set
@@ -184,17 +241,33 @@ uint32
 dhd_dbg_ring_get_pending_len(dhd_dbg_ring_t *ring)
 {
 	uint32 pending_len = 0;
+	uint32 written_bytes, read_bytes;
 	unsigned long flags = 0;
 
-	DHD_DBG_RING_LOCK(ring->lock, flags);
-	if (ring->stat.written_bytes > ring->stat.read_bytes) {
-		pending_len = ring->stat.written_bytes - ring->stat.read_bytes;
-	} else if (ring->stat.written_bytes < ring->stat.read_bytes) {
-		pending_len = PENDING_LEN_MAX - ring->stat.read_bytes + ring->stat.written_bytes;
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	if (READ_ONCE(ring->stage)) {
+		/* Only used to decide on scheduling the reader after a push,
+		 * so an unlocked snapshot including the staged bytes will do.
+		 */
+		written_bytes = READ_ONCE(ring->stat.written_bytes) +
+			dhd_dbg_ring_staged_len(ring);
+		read_bytes = READ_ONCE(ring->stat.read_bytes);
+	} else
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+	{
+		DHD_DBG_RING_LOCK(ring->lock, flags);
+		written_bytes = ring->stat.written_bytes;
+		read_bytes = ring->stat.read_bytes;
+		DHD_DBG_RING_UNLOCK(ring->lock, flags);
+	}
+
+	if (written_bytes > read_bytes) {
+		pending_len = written_bytes - read_bytes;
+	} else if (written_bytes < read_bytes) {
+		pending_len = PENDING_LEN_MAX - read_bytes + written_bytes;
 	} else {
 		pending_len = 0;
 	}
-	DHD_DBG_RING_UNLOCK(ring->lock, flags);
 
 	return pending_len;
 }
@@ -231,33 +304,16 @@ dhd_dbg_ring_update(void *dbg_ring, uint32 w_len)
 }
 #endif /* DHD_PKT_LOGGING_DBGRING */
 
-int
-dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
+/* Copy one record into the ring, called with ring->lock held */
+static int
+__dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
 {
-	unsigned long flags;
 	uint32 w_len;
 	uint32 avail_size;
 	dhd_dbg_ring_entry_t *w_entry, *r_entry;
 	int ret;
 
-	if (!ring || !hdr || !data) {
-		return BCME_BADARG;
-	}
-
-#if defined(__linux__)
-	/* Prevents the case of accessing the ring buffer in the HardIRQ context.
-	 * If an interrupt arise after holding ring lock, It could try the same lock.
-	 * This is to use the ring lock as spin_lock_bh instead of spin_lock_irqsave.
-	 */
-	if (in_irq()) {
-		return BCME_BUSY;
-	}
-#endif /* defined(__linux__) */
-
-	DHD_DBG_RING_LOCK(ring->lock, flags);
-
 	if (ring->state != RING_ACTIVE) {
-		DHD_DBG_RING_UNLOCK(ring->lock, flags);
 		return BCME_OK;
 	}
 
@@ -269,7 +325,6 @@ dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
 		ring->ring_buf, ring->ring_size));
 
 	if (w_len > ring->ring_size) {
-		DHD_DBG_RING_UNLOCK(ring->lock, flags);
 		DHD_ERROR(("%s: RING%d[%s] w_len=%u, ring_size=%u,"
 			" write size exceeds ring size !\n",
 			__FUNCTION__, ring->id, ring->name, w_len, ring->ring_size));
@@ -319,7 +374,6 @@ dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
 						__FUNCTION__, ring->id, ring->name, ring->wp,
 						ring->rp, ring->ring_size));
 					ASSERT(0);
-					DHD_DBG_RING_UNLOCK(ring->lock, flags);
 					return BCME_BUFTOOSHORT;
 				}
 				ring->rp += ENTRY_LENGTH(r_entry);
@@ -350,7 +404,6 @@ dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
 			"wp=%d, ring_size=%d, w_len=%u\n", __FUNCTION__, ring->id,
 			ring->name, ring->wp, ring->ring_size, w_len));
 		ASSERT(0);
-		DHD_DBG_RING_UNLOCK(ring->lock, flags);
 		return BCME_BUFTOOLONG;
 	}
 
@@ -383,10 +436,211 @@ dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
 		ring->stat.written_records, ring->stat.written_bytes, ring->stat.read_bytes,
 		ring->threshold, ring->wp, ring->rp));
 
-	DHD_DBG_RING_UNLOCK(ring->lock, flags);
 	return BCME_OK;
 }
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+/* Move the staged records into the ring, called with stage->lock held.
+ * While the ring is suspended the records stay staged for the merge on resume.
+ */
+static void
+dhd_dbg_ring_stage_flush(dhd_dbg_ring_t *ring, struct dhd_dbg_ring_stage *stage)
+{
+	dhd_dbg_ring_entry_t *hdr;
+	unsigned long flags;
+	uint32 off = 0;
+
+	if (!stage->len) {
+		return;
+	}
+
+	DHD_DBG_RING_LOCK(ring->lock, flags);
+	if (ring->state == RING_SUSPEND) {
+		DHD_DBG_RING_UNLOCK(ring->lock, flags);
+		return;
+	}
+	if (ring->ring_buf) {
+		while (off < stage->len) {
+			hdr = (dhd_dbg_ring_entry_t *)(stage->buf + off);
+			(void)__dhd_dbg_ring_push(ring, hdr, (uint8 *)hdr + DBG_RING_ENTRY_SIZE);
+			off += ENTRY_LENGTH(hdr);
+		}
+	}
+	DHD_DBG_RING_UNLOCK(ring->lock, flags);
+
+	atomic_sub(stage->len, &ring->staged_bytes);
+	stage->len = 0;
+}
+
+/* called under rcu_read_lock() with the sampled ring->stage in 'stages' */
+static int
+dhd_dbg_ring_stage_push(dhd_dbg_ring_t *ring, struct dhd_dbg_ring_stage *stages,
+	dhd_dbg_ring_entry_t *hdr, void *data)
+{
+	struct dhd_dbg_ring_stage *stage;
+	unsigned long flags, ring_flags;
+	uint32 w_len;
+	int ret = BCME_OK;
+
+	/* unlocked check, the state is rechecked when the stage is merged */
+	if (READ_ONCE(ring->state) != RING_ACTIVE) {
+		return BCME_OK;
+	}
+
+	w_len = ENTRY_LENGTH(hdr);
+
+	/* A migration after picking the stage only costs locality, stage->lock
+	 * still serialises producers on the same stage.
+	 */
+	stage = raw_cpu_ptr(stages);
+	flags = osl_spin_lock(&stage->lock);
+
+	if (w_len > sizeof(stage->buf)) {
+		/* too big to stage, keep the order of this CPU's records */
+		dhd_dbg_ring_stage_flush(ring, stage);
+		DHD_DBG_RING_LOCK(ring->lock, ring_flags);
+		ret = __dhd_dbg_ring_push(ring, hdr, data);
+		DHD_DBG_RING_UNLOCK(ring->lock, ring_flags);
+		goto exit;
+	}
+
+	if (stage->len + w_len > sizeof(stage->buf)) {
+		dhd_dbg_ring_stage_flush(ring, stage);
+		if (stage->len + w_len > sizeof(stage->buf)) {
+			/* suspended meanwhile with a full stage, drop it like the ring does */
+			goto exit;
+		}
+	}
+
+	memcpy(stage->buf + stage->len, hdr, DBG_RING_ENTRY_SIZE);
+	memcpy(stage->buf + stage->len + DBG_RING_ENTRY_SIZE, data, hdr->len);
+	stage->len += w_len;
+	atomic_add(w_len, &ring->staged_bytes);
+
+exit:
+	osl_spin_unlock(&stage->lock, flags);
+	return ret;
+}
+
+/*
+ * Merge the records staged on all CPUs into the ring. Must be called
+ * before reading ring->wp/rp directly, callers should not hold ring->lock.
+ */
+void
+dhd_dbg_ring_merge(dhd_dbg_ring_t *ring)
+{
+	struct dhd_dbg_ring_stage *stages, *stage;
+	unsigned long flags;
+	int cpu;
+
+	if (!ring) {
+		return;
+	}
+
+	rcu_read_lock();
+	stages = rcu_dereference(ring->stage);
+	if (stages) {
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(stages, cpu);
+			/* racy peek, a record staged meanwhile goes with the next merge */
+			if (!READ_ONCE(stage->len)) {
+				continue;
+			}
+			flags = osl_spin_lock(&stage->lock);
+			dhd_dbg_ring_stage_flush(ring, stage);
+			osl_spin_unlock(&stage->lock, flags);
+		}
+	}
+	rcu_read_unlock();
+}
+
+uint32
+dhd_dbg_ring_staged_len(dhd_dbg_ring_t *ring)
+{
+	if (!ring || !READ_ONCE(ring->stage)) {
+		return 0;
+	}
+
+	return (uint32)atomic_read(&ring->staged_bytes);
+}
+
+static void
+dhd_dbg_ring_stage_reset(dhd_dbg_ring_t *ring)
+{
+	struct dhd_dbg_ring_stage *stages, *stage;
+	unsigned long flags;
+	int cpu;
+
+	rcu_read_lock();
+	stages = rcu_dereference(ring->stage);
+	if (stages) {
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(stages, cpu);
+			flags = osl_spin_lock(&stage->lock);
+			atomic_sub(stage->len, &ring->staged_bytes);
+			stage->len = 0;
+			osl_spin_unlock(&stage->lock, flags);
+		}
+	}
+	rcu_read_unlock();
+}
+
+/* Called from process context once the ring is stopped */
+static void
+dhd_dbg_ring_stage_deinit(dhd_dbg_ring_t *ring)
+{
+	struct dhd_dbg_ring_stage *stages = ring->stage;
+
+	if (stages) {
+		RCU_INIT_POINTER(ring->stage, NULL);
+		/* producers and mergers that sampled the old pointer are done after this */
+		synchronize_rcu();
+		free_percpu(stages);
+	}
+}
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
+int
+dhd_dbg_ring_push(dhd_dbg_ring_t *ring, dhd_dbg_ring_entry_t *hdr, void *data)
+{
+	unsigned long flags;
+	int ret;
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	struct dhd_dbg_ring_stage *stages;
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
+	if (!ring || !hdr || !data) {
+		return BCME_BADARG;
+	}
+
+#if defined(__linux__)
+	/* Prevents the case of accessing the ring buffer in the HardIRQ context.
+	 * If an interrupt arise after holding ring lock, It could try the same lock.
+	 * This is to use the ring lock as spin_lock_bh instead of spin_lock_irqsave.
+	 */
+	if (in_irq()) {
+		return BCME_BUSY;
+	}
+#endif /* defined(__linux__) */
+
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	rcu_read_lock();
+	stages = rcu_dereference(ring->stage);
+	if (stages) {
+		ret = dhd_dbg_ring_stage_push(ring, stages, hdr, data);
+		rcu_read_unlock();
+		return ret;
+	}
+	rcu_read_unlock();
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
+	DHD_DBG_RING_LOCK(ring->lock, flags);
+	ret = __dhd_dbg_ring_push(ring, hdr, data);
+	DHD_DBG_RING_UNLOCK(ring->lock, flags);
+
+	return ret;
+}
+
 /*
  * This function folds ring->lock, so callers of this function
  * should not hold ring->lock.
@@ -403,6 +657,10 @@ dhd_dbg_ring_pull_single(dhd_dbg_ring_t *ring, void *data, uint32 buf_len, bool
 		return 0;
 	}
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 	/* pull from ring is allowed for inactive (suspended) ring
 	 * in case of ecounters only, this is because, for ecounters
@@ -528,6 +786,11 @@ dhd_dbg_ring_config(dhd_dbg_ring_t *ring, int log_level, uint32 threshold)
 	if (ring->state == RING_STOP)
 		return BCME_UNSUPPORTED;
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	/* staged records of an active ring go in before it is suspended */
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 
 	if (log_level == 0)
@@ -540,6 +803,11 @@ dhd_dbg_ring_config(dhd_dbg_ring_t *ring, int log_level, uint32 threshold)
 
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
 
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	/* and the ones kept while it was suspended go in on resume */
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
+
 	return BCME_OK;
 }
 
@@ -556,4 +824,7 @@ dhd_dbg_ring_start(dhd_dbg_ring_t *ring)
 	ring->threshold = 0;
 	bzero(&ring->stat, sizeof(struct ring_statistics));
 	bzero(ring->ring_buf, ring->ring_size);
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_stage_reset(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 }
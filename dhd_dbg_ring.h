@@ -96,6 +96,10 @@ typedef struct dhd_dbg_ring {
 	uint32 rem_len;		/* number of bytes from wp_pad to end */
 	bool sched_pull;	/* schedule reader immediately */
 	bool pull_inactive;	/* pull contents from ring even if it is inactive */
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	struct dhd_dbg_ring_stage *stage;	/* per CPU staging buffers */
+	atomic_t staged_bytes;	/* bytes held in all the stages */
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 } dhd_dbg_ring_t;
 
 #define DBGRING_FLUSH_THRESHOLD(ring)		\
@@ -151,4 +155,8 @@ void dhd_dbg_ring_sched_pull(dhd_dbg_ring_t *ring, uint32 pending_len,
 		os_pullreq_t pull_fn, void *os_pvt, const int id);
 int dhd_dbg_ring_config(dhd_dbg_ring_t *ring, int log_level, uint32 threshold);
 void dhd_dbg_ring_start(dhd_dbg_ring_t *ring);
+#ifdef DHD_DBG_RING_PCPU_STAGE
+void dhd_dbg_ring_merge(dhd_dbg_ring_t *ring);
+uint32 dhd_dbg_ring_staged_len(dhd_dbg_ring_t *ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 #endif /* __DHD_DBG_RING_H__ */
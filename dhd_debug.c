@@ -1721,6 +1721,10 @@ dhd_dbg_get_ring_status(dhd_pub_t *dhdp, int ring_id, dhd_dbg_ring_status_t *dbg
 	for (id = DEBUG_RING_ID_INVALID + 1; id < DEBUG_RING_ID_MAX; id++) {
 		dbg_ring = &dbg->dbg_rings[id];
 		if (VALID_RING(dbg_ring->id) && (dbg_ring->id == ring_id)) {
+#ifdef DHD_DBG_RING_PCPU_STAGE
+			/* staged records count in written_bytes */
+			dhd_dbg_ring_merge(dbg_ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 			__dhd_dbg_get_ring_status(dbg_ring, dbg_ring_status);
 			break;
 		}
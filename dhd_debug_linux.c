@@ -126,6 +126,10 @@ dbg_ring_poll_worker(struct work_struct *work)
 	ringid = ring_info->ring_id;
 
 	ring = &dhdp->dbg->dbg_rings[ringid];
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	/* wp/rp below must account for the records still staged per CPU */
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 	dhd_dbg_get_ring_status(dhdp, ringid, &ring_status);
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
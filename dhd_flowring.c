@@ -48,6 +48,46 @@
 #include <dhd_mesh_route.h>
 #endif /* defined(DHD_MESH) */
 
+/*
+ * DHD_FLOWID_RCU: the per interface flow hash table is read under RCU in the
+ * TX fast path (dhd_flowid_find), and updated under flowid_lock. Removed hash
+ * nodes are freed after a grace period.
+ */
+#ifdef DHD_FLOWID_RCU
+#include <linux/rcupdate.h>
+
+#define DHD_FLOWID_READ_LOCK(lock, flags) \
+	do { \
+		BCM_REFERENCE(lock); \
+		BCM_REFERENCE(flags); \
+		rcu_read_lock(); \
+	} while (0)
+#define DHD_FLOWID_READ_UNLOCK(lock, flags)	rcu_read_unlock()
+#define DHD_FLOW_HASH_DEREF(p)			rcu_dereference(p)
+#define DHD_FLOW_HASH_ASSIGN(p, v)		rcu_assign_pointer((p), (v))
+
+static void
+dhd_flow_hash_node_free_rcu(struct rcu_head *head)
+{
+	flow_hash_info_t *node = container_of(head, flow_hash_info_t, rcu);
+
+	MFREE(node->osh, node, sizeof(flow_hash_info_t));
+}
+
+#define DHD_FLOW_HASH_NODE_FREE(dhdp, node) \
+	do { \
+		(node)->osh = (dhdp)->osh; \
+		call_rcu(&(node)->rcu, dhd_flow_hash_node_free_rcu); \
+	} while (0)
+#else
+#define DHD_FLOWID_READ_LOCK(lock, flags)	DHD_FLOWID_LOCK(lock, flags)
+#define DHD_FLOWID_READ_UNLOCK(lock, flags)	DHD_FLOWID_UNLOCK(lock, flags)
+#define DHD_FLOW_HASH_DEREF(p)			(p)
+#define DHD_FLOW_HASH_ASSIGN(p, v)		((p) = (v))
+#define DHD_FLOW_HASH_NODE_FREE(dhdp, node) \
+	MFREE((dhdp)->osh, (node), sizeof(flow_hash_info_t))
+#endif /* DHD_FLOWID_RCU */
+
 static INLINE int dhd_flow_queue_throttle(flow_queue_t *queue);
 
 static INLINE uint16 dhd_flowid_find(dhd_pub_t *dhdp, uint8 ifindex,
@@ -138,6 +178,9 @@ dhd_flow_queue_reinit(dhd_pub_t *dhdp, flow_queue_t *queue, int max)
 
 	queue->head = queue->tail = NULL;
 	queue->len = 0;
+#ifdef DHD_FLOWRING_BQL
+	queue->bytes = 0;
+#endif /* DHD_FLOWRING_BQL */
 
 	/* Set queue's threshold and queue's parent cummulative length counter */
 	ASSERT(max > 1);
@@ -194,8 +237,15 @@ BCMFASTPATH(dhd_flow_queue_enqueue)(dhd_pub_t *dhdp, flow_queue_t *queue, void *
 	FLOW_QUEUE_PKT_SETNEXT(pkt, NULL);
 
 	queue->tail = pkt; /* at tail */
+#ifdef DHD_FLOWRING_SCHED
+	/* for queueing delay accounting when the pkt moves to the flowring */
+	DHD_PKT_SET_ENQ_TIME(pkt, OSL_SYSUPTIME_US());
+#endif /* DHD_FLOWRING_SCHED */
 
 	queue->len++;
+#ifdef DHD_FLOWRING_BQL
+	queue->bytes += PKTLEN(dhdp->osh, pkt);
+#endif /* DHD_FLOWRING_BQL */
 	/* increment parent's cummulative length */
 	DHD_CUMM_CTR_INCR(DHD_FLOW_QUEUE_CLEN_PTR(queue));
 	/* increment grandparent's cummulative length */
@@ -224,6 +274,9 @@ BCMFASTPATH(dhd_flow_queue_dequeue)(dhd_pub_t *dhdp, flow_queue_t *queue)
 		queue->tail = NULL;
 
 	queue->len--;
+#ifdef DHD_FLOWRING_BQL
+	queue->bytes -= PKTLEN(dhdp->osh, pkt);
+#endif /* DHD_FLOWRING_BQL */
 	/* decrement parent's cummulative length */
 	DHD_CUMM_CTR_DECR(DHD_FLOW_QUEUE_CLEN_PTR(queue));
 	/* decrement grandparent's cummulative length */
@@ -246,12 +299,336 @@ BCMFASTPATH(dhd_flow_queue_reinsert)(dhd_pub_t *dhdp, flow_queue_t *queue, void
 	FLOW_QUEUE_PKT_SETNEXT(pkt, queue->head);
 	queue->head = pkt;
 	queue->len++;
+#ifdef DHD_FLOWRING_BQL
+	queue->bytes += PKTLEN(dhdp->osh, pkt);
+#endif /* DHD_FLOWRING_BQL */
 	/* increment parent's cummulative length */
 	DHD_CUMM_CTR_INCR(DHD_FLOW_QUEUE_CLEN_PTR(queue));
 	/* increment grandparent's cummulative length */
 	DHD_CUMM_CTR_INCR(DHD_FLOW_QUEUE_L2CLEN_PTR(queue));
 }
 
+#ifdef DHD_FLOWRING_BQL
+uint flow_bql_target_ms = FLOW_BQL_TARGET_MS;
+
+/** TRUE if every flow of the interface that holds bytes is over its limit */
+static bool
+BCMFASTPATH(dhd_flow_bql_if_over)(dhd_pub_t *dhdp, uint8 ifidx)
+{
+	int stopped = OSL_ATOMIC_READ(dhdp->osh, &dhdp->flow_bql_stopped[ifidx]);
+
+	return (stopped > 0) &&
+		(stopped >= OSL_ATOMIC_READ(dhdp->osh, &dhdp->flow_bql_busy[ifidx]));
+}
+
+/** Reset a flow's byte limit state, releasing its hold on the netif queues if any */
+void
+dhd_flow_bql_init(dhd_pub_t *dhdp, flow_ring_node_t *node)
+{
+	flow_bql_t *bql = &node->bql;
+	uint8 ifidx = node->flow_info.ifindex;
+
+	if (ifidx < DHD_MAX_IFS) {
+		if (bql->busy) {
+			OSL_ATOMIC_DEC(dhdp->osh, &dhdp->flow_bql_busy[ifidx]);
+		}
+		if (bql->stopped) {
+			OSL_ATOMIC_DEC(dhdp->osh, &dhdp->flow_bql_stopped[ifidx]);
+			if (!dhd_flow_bql_if_over(dhdp, ifidx) && !dhdp->txoff) {
+				dhd_txflowcontrol(dhdp, ifidx, OFF);
+			}
+		}
+	}
+
+	bzero(bql, sizeof(*bql));
+	bql->limit = FLOW_BQL_INIT_BYTES;
+	bql->epoch_start_us = (uint32)OSL_SYSUPTIME_US();
+}
+
+/**
+ * Called after an enqueue with the flowring lock held. Marks the flow over its limit,
+ * and stops the interface's netif queues once all its flows holding bytes are over.
+ * Stopping is repeated on every enqueue over the limit, so a bus level restart of all
+ * interfaces is undone.
+ */
+void
+BCMFASTPATH(dhd_flow_bql_check_stop)(dhd_pub_t *dhdp, flow_ring_node_t *node)
+{
+	flow_bql_t *bql = &node->bql;
+	uint8 ifidx = node->flow_info.ifindex;
+
+	if (!bql->busy) {
+		bql->busy = TRUE;
+		OSL_ATOMIC_INC(dhdp->osh, &dhdp->flow_bql_busy[ifidx]);
+	}
+
+	if ((node->queue.bytes + FLOW_BQL_INFLIGHT(bql)) < bql->limit) {
+		return;
+	}
+
+	if (!bql->stopped) {
+		bql->stopped = TRUE;
+		bql->stops++;
+		OSL_ATOMIC_INC(dhdp->osh, &dhdp->flow_bql_stopped[ifidx]);
+	}
+	if (dhd_flow_bql_if_over(dhdp, ifidx)) {
+		dhd_txflowcontrol(dhdp, ifidx, ON);
+	}
+}
+
+/**
+ * Account a txcpl of len bytes, from DPC. Once per FLOW_BQL_EPOCH_US the drain rate is
+ * sampled and the limit resized to flow_bql_target_ms worth of data. A stopped flow is
+ * released once it is back under 3/4 of its limit; if it ran dry while stopped, the
+ * limit was starving the dongle and is doubled right away. A flow that ran dry no
+ * longer counts as busy.
+ */
+void
+BCMFASTPATH(dhd_flow_bql_complete)(dhd_pub_t *dhdp, flow_ring_node_t *node, uint32 len)
+{
+	flow_bql_t *bql = &node->bql;
+	uint8 ifidx = node->flow_info.ifindex;
+	uint32 now_us, elapsed_us, rate, owned;
+	unsigned long flags;
+	bool wake = FALSE;
+
+	/* completions of a ring that was reset in between are not ours */
+	bql->cpl_bytes += MIN(len, FLOW_BQL_INFLIGHT(bql));
+
+	now_us = (uint32)OSL_SYSUPTIME_US();
+	elapsed_us = now_us - bql->epoch_start_us;
+	if (elapsed_us >= FLOW_BQL_EPOCH_US) {
+		/* a sample spanning an idle period says nothing about the link */
+		if (elapsed_us < (FLOW_BQL_EPOCH_US << 2)) {
+			rate = (uint32)DIV_U64_BY_U32((uint64)(bql->cpl_bytes -
+				bql->epoch_cpl_bytes) * 1000u, elapsed_us);
+			bql->rate = bql->rate ? ((bql->rate * 3u) + rate) >> 2 : rate;
+			bql->limit = bql->rate * MAX(flow_bql_target_ms, 1u);
+			bql->limit = MAX(bql->limit, FLOW_BQL_MIN_BYTES);
+			bql->limit = MIN(bql->limit, FLOW_BQL_MAX_BYTES);
+		}
+		bql->epoch_start_us = now_us;
+		bql->epoch_cpl_bytes = bql->cpl_bytes;
+	}
+
+	/* unlocked peek, only a stopped or drained flow needs the lock */
+	if (!bql->stopped && (node->queue.bytes || FLOW_BQL_INFLIGHT(bql))) {
+		return;
+	}
+
+	DHD_FLOWRING_LOCK(node->lock, flags);
+	owned = node->queue.bytes + FLOW_BQL_INFLIGHT(bql);
+	if (bql->stopped && (owned <= (bql->limit - (bql->limit >> 2)))) {
+		if (owned == 0) {
+			bql->starved++;
+			bql->limit = MIN(bql->limit << 1, FLOW_BQL_MAX_BYTES);
+		}
+		bql->stopped = FALSE;
+		OSL_ATOMIC_DEC(dhdp->osh, &dhdp->flow_bql_stopped[ifidx]);
+		wake = TRUE;
+	}
+	if ((owned == 0) && bql->busy) {
+		bql->busy = FALSE;
+		OSL_ATOMIC_DEC(dhdp->osh, &dhdp->flow_bql_busy[ifidx]);
+	}
+	DHD_FLOWRING_UNLOCK(node->lock, flags);
+
+	/* a bus level stop of all interfaces stays in force */
+	if (wake && !dhd_flow_bql_if_over(dhdp, ifidx) && !dhdp->txoff) {
+		dhd_txflowcontrol(dhdp, ifidx, OFF);
+	}
+}
+
+void
+dhd_flow_bql_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
+{
+	flow_ring_node_t *flow_ring_node;
+	flow_bql_t *bql;
+	unsigned long flags;
+	uint16 flowid;
+
+	bcm_bprintf(strbuf, "\nFlowring byte queue limit: target %u ms\n", flow_bql_target_ms);
+	bcm_bprintf(strbuf, "%4s %5s %10s %10s %10s %12s %5s %8s %10s %10s\n",
+		"Flow", "IfIdx", "Limit", "Queued", "Inflight", "Rate_B/ms", "Busy", "Stopped",
+		"Stops", "Starved");
+	for (flowid = 0; flowid < dhdp->num_h2d_rings; flowid++) {
+		flow_ring_node = DHD_FLOW_RING(dhdp, flowid);
+		DHD_FLOWRING_LOCK(flow_ring_node->lock, flags);
+		if (flow_ring_node->status != FLOW_RING_STATUS_OPEN) {
+			DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
+			continue;
+		}
+		bql = &flow_ring_node->bql;
+		bcm_bprintf(strbuf, "%4d %5u %10u %10u %10u %12u %5u %8u %10u %10u\n",
+			flowid, flow_ring_node->flow_info.ifindex, bql->limit,
+			flow_ring_node->queue.bytes, FLOW_BQL_INFLIGHT(bql), bql->rate,
+			bql->busy, bql->stopped, bql->stops, bql->starved);
+		DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
+	}
+}
+#endif /* DHD_FLOWRING_BQL */
+
+#ifdef DHD_TXCPL_LAT_HIST
+static const char *dhd_txcpl_lat_ac_str[AC_COUNT] = { "BE", "BK", "VI", "VO" };
+
+static uint32
+dhd_txcpl_lat_bin(uint32 us)
+{
+	uint32 msb;
+
+	if (us < DHD_TXCPL_LAT_SUB) {
+		return us;
+	}
+	msb = 31u - bcm_count_leading_zeros(us);
+	if (msb > DHD_TXCPL_LAT_MSB_MAX) {
+		return DHD_TXCPL_LAT_BINS - 1u;
+	}
+	/* DHD_TXCPL_LAT_SUB == 4: the two bits below the msb pick the sub bin */
+	return (msb - 1u) * DHD_TXCPL_LAT_SUB + ((us >> (msb - 2u)) & (DHD_TXCPL_LAT_SUB - 1u));
+}
+
+/* Largest latency that falls in a bin */
+static uint32
+dhd_txcpl_lat_bin_hi(uint32 idx)
+{
+	uint32 msb, sub;
+
+	if (idx < DHD_TXCPL_LAT_SUB) {
+		return idx;
+	}
+	msb = idx / DHD_TXCPL_LAT_SUB + 1u;
+	sub = idx % DHD_TXCPL_LAT_SUB;
+	return ((DHD_TXCPL_LAT_SUB + sub + 1u) << (msb - 2u)) - 1u;
+}
+
+static uint8
+dhd_txcpl_lat_ac(dhd_pub_t *dhdp, flow_ring_node_t *node)
+{
+	uint8 tid = node->flow_info.tid;
+
+	/* with the AC map flow_info.tid already holds the AC */
+	if (dhdp->flow_prio_map_type == DHD_FLOW_PRIO_AC_MAP) {
+		return (tid < AC_COUNT) ? tid : AC_BE;
+	}
+	return prio2ac[tid & (NUMPRIO - 1)];
+}
+
+static INLINE void
+dhd_txcpl_lat_add(dhd_txcpl_lat_hist_t *hist, uint32 idx, uint32 us)
+{
+	hist->bin[idx]++;
+	if (us > hist->max_us) {
+		hist->max_us = us;
+	}
+}
+
+/**
+ * Account one txpost to txcpl latency. Called from the txcpl path, which is the
+ * only writer of both the flowring and the AC histogram, so no locks are taken.
+ */
+void
+dhd_txcpl_lat_update(dhd_pub_t *dhdp, flow_ring_node_t *node, uint64 lat_us)
+{
+	uint32 us = (uint32)MIN(lat_us, (uint64)0xFFFFFFFFu);
+	uint32 idx = dhd_txcpl_lat_bin(us);
+
+	dhd_txcpl_lat_add(&node->txcpl_lat, idx, us);
+	dhd_txcpl_lat_add(&dhdp->txcpl_lat_ac[dhd_txcpl_lat_ac(dhdp, node)], idx, us);
+}
+
+void
+dhd_txcpl_lat_clear(dhd_pub_t *dhdp)
+{
+	flow_ring_node_t *flow_ring_node;
+	uint16 flowid;
+
+	bzero(dhdp->txcpl_lat_ac, sizeof(dhdp->txcpl_lat_ac));
+	if (!dhdp->flow_ring_table) {
+		return;
+	}
+	for (flowid = 0; flowid < dhdp->num_h2d_rings; flowid++) {
+		flow_ring_node = DHD_FLOW_RING(dhdp, flowid);
+		bzero(&flow_ring_node->txcpl_lat, sizeof(flow_ring_node->txcpl_lat));
+	}
+}
+
+/* Print count, p50/p99/p99.9 and max from a snapshot of the histogram */
+static void
+dhd_txcpl_lat_print(struct bcmstrbuf *strbuf, const dhd_txcpl_lat_hist_t *live, bool bins)
+{
+	static const uint32 pctl_ppt[] = { 500u, 990u, 999u };
+	dhd_txcpl_lat_hist_t hist;
+	uint32 pctl[ARRAYSIZE(pctl_ppt)];
+	uint64 total = 0, acc = 0;
+	uint32 i, p = 0;
+
+	memcpy(&hist, live, sizeof(hist));
+	for (i = 0; i < DHD_TXCPL_LAT_BINS; i++) {
+		total += hist.bin[i];
+	}
+	bzero(pctl, sizeof(pctl));
+	for (i = 0; i < DHD_TXCPL_LAT_BINS && p < ARRAYSIZE(pctl_ppt); i++) {
+		acc += hist.bin[i];
+		while (p < ARRAYSIZE(pctl_ppt) && acc * 1000u >= total * pctl_ppt[p] && total) {
+			pctl[p++] = (i == DHD_TXCPL_LAT_BINS - 1u) ?
+				hist.max_us : MIN(dhd_txcpl_lat_bin_hi(i), hist.max_us);
+		}
+	}
+	bcm_bprintf(strbuf, "%12llu %10u %10u %10u %10u\n", total,
+		pctl[0], pctl[1], pctl[2], hist.max_us);
+
+	if (!bins || !total) {
+		return;
+	}
+	for (i = 0; i < DHD_TXCPL_LAT_BINS; i++) {
+		if (!hist.bin[i]) {
+			continue;
+		}
+		if (i == DHD_TXCPL_LAT_BINS - 1u) {
+			bcm_bprintf(strbuf, "\t%8u+         : %u\n",
+				dhd_txcpl_lat_bin_hi(i - 1u) + 1u, hist.bin[i]);
+		} else {
+			bcm_bprintf(strbuf, "\t%8u - %-8u: %u\n",
+				(i ? dhd_txcpl_lat_bin_hi(i - 1u) + 1u : 0u),
+				dhd_txcpl_lat_bin_hi(i), hist.bin[i]);
+		}
+	}
+}
+
+void
+dhd_txcpl_lat_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf, bool bins)
+{
+	flow_ring_node_t *flow_ring_node;
+	uint16 flowid;
+	uint8 ac;
+
+	bcm_bprintf(strbuf, "\nTX completion latency (usec, txpost to txcpl):\n");
+	bcm_bprintf(strbuf, "%-14s %12s %10s %10s %10s %10s\n",
+		"AC", "Count", "p50", "p99", "p99.9", "Max");
+	for (ac = 0; ac < AC_COUNT; ac++) {
+		bcm_bprintf(strbuf, "%-14s ", dhd_txcpl_lat_ac_str[ac]);
+		dhd_txcpl_lat_print(strbuf, &dhdp->txcpl_lat_ac[ac], bins);
+	}
+
+	if (!dhdp->flow_ring_table) {
+		return;
+	}
+
+	bcm_bprintf(strbuf, "%4s %5s %4s   ", "Flow", "IfIdx", "Prio");
+	bcm_bprintf(strbuf, "%12s %10s %10s %10s %10s\n",
+		"Count", "p50", "p99", "p99.9", "Max");
+	for (flowid = 0; flowid < dhdp->num_h2d_rings; flowid++) {
+		flow_ring_node = DHD_FLOW_RING(dhdp, flowid);
+		if (flow_ring_node->status != FLOW_RING_STATUS_OPEN) {
+			continue;
+		}
+		bcm_bprintf(strbuf, "%4d %5u %4u   ", flowid,
+			flow_ring_node->flow_info.ifindex, flow_ring_node->flow_info.tid);
+		dhd_txcpl_lat_print(strbuf, &flow_ring_node->txcpl_lat, FALSE);
+	}
+}
+#endif /* DHD_TXCPL_LAT_HIST */
+
 /** Fetch the backup queue for a flowring, and assign flow control thresholds */
 void
 dhd_flow_ring_config_thresholds(dhd_pub_t *dhdp, uint16 flowid,
@@ -524,6 +901,7 @@ void dhd_flow_rings_deinit(dhd_pub_t *dhdp)
 	uint16 idx;
 	uint32 flow_ring_table_sz;
 	uint32 if_flow_lkup_sz;
+	void *if_flow_lkup;
 	flow_ring_table_t *flow_ring_table;
 	unsigned long flags;
 	void *lock;
@@ -565,11 +943,19 @@ void dhd_flow_rings_deinit(dhd_pub_t *dhdp)
 	DHD_FLOWID_LOCK(dhdp->flowid_lock, flags);
 
 	/* Destruct the per interface flow lkup table */
-	if (dhdp->if_flow_lkup != NULL) {
+	if_flow_lkup = dhdp->if_flow_lkup;
+	if (if_flow_lkup != NULL) {
+		/* Unpublish first, lockless dhd_flowid_find() readers see NULL */
+		DHD_FLOW_HASH_ASSIGN(dhdp->if_flow_lkup, NULL);
+#ifdef DHD_FLOWID_RCU
+		/* and those already holding the old pointer drain before the free */
+		DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+		synchronize_rcu();
+		DHD_FLOWID_LOCK(dhdp->flowid_lock, flags);
+#endif /* DHD_FLOWID_RCU */
 		if_flow_lkup_sz = sizeof(if_flow_lkup_t) * DHD_MAX_IFS;
-		bzero((uchar *)dhdp->if_flow_lkup, if_flow_lkup_sz);
-		DHD_OS_PREFREE(dhdp, dhdp->if_flow_lkup, if_flow_lkup_sz);
-		dhdp->if_flow_lkup = NULL;
+		bzero((uchar *)if_flow_lkup, if_flow_lkup_sz);
+		DHD_OS_PREFREE(dhdp, if_flow_lkup, if_flow_lkup_sz);
 	}
 
 	/* Destruct the flowid allocator */
@@ -593,6 +979,11 @@ void dhd_flow_rings_deinit(dhd_pub_t *dhdp)
 	osl_spin_lock_deinit(dhdp->osh, dhdp->flowring_list_lock);
 	dhdp->flowring_list_lock = NULL;
 
+#ifdef DHD_FLOWID_RCU
+	/* Wait for hash nodes freed by dhd_flowid_free() */
+	rcu_barrier();
+#endif /* DHD_FLOWID_RCU */
+
 	ASSERT(dhdp->if_flow_lkup == NULL);
 	ASSERT(dhdp->flow_ring_table == NULL);
 	dhdp->flow_rings_inited = FALSE;
@@ -639,37 +1030,40 @@ dhd_flowid_find(dhd_pub_t *dhdp, uint8 ifindex, uint8 prio, char *sa, char *da)
 	bool ismcast = FALSE;
 	flow_hash_info_t *cur;
 	if_flow_lkup_t *if_flow_lkup;
-	unsigned long flags;
+	unsigned long flags = 0;
 
 	ASSERT(ifindex < DHD_MAX_IFS);
 	if (ifindex >= DHD_MAX_IFS)
 		return FLOWID_INVALID;
 
-	DHD_FLOWID_LOCK(dhdp->flowid_lock, flags);
-	if_flow_lkup = (if_flow_lkup_t *)dhdp->if_flow_lkup;
-
-	ASSERT(if_flow_lkup);
+	DHD_FLOWID_READ_LOCK(dhdp->flowid_lock, flags);
+	if_flow_lkup = (if_flow_lkup_t *)DHD_FLOW_HASH_DEREF(dhdp->if_flow_lkup);
+	if (if_flow_lkup == NULL) {
+		/* flow rings are being torn down */
+		DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
+		return FLOWID_INVALID;
+	}
 
 	if (DHD_IF_ROLE_GENERIC_STA(dhdp, ifindex)) {
 #ifdef WLTDLS
 		if (is_tdls_destination(dhdp, da)) {
 			hash = DHD_FLOWRING_HASHINDEX(da, prio);
-			cur = if_flow_lkup[ifindex].fl_hash[hash];
+			cur = DHD_FLOW_HASH_DEREF(if_flow_lkup[ifindex].fl_hash[hash]);
 			while (cur != NULL) {
 				if (!memcmp(cur->flow_info.da, da, ETHER_ADDR_LEN)) {
-					DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+					DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
 					return cur->flowid;
 				}
-				cur = cur->next;
+				cur = DHD_FLOW_HASH_DEREF(cur->next);
 			}
-			DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+			DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
 			return FLOWID_INVALID;
 		}
 #endif /* WLTDLS */
 		/* For STA non TDLS dest and WDS dest flow ring id is mapped based on prio only */
-		cur = if_flow_lkup[ifindex].fl_hash[prio];
+		cur = DHD_FLOW_HASH_DEREF(if_flow_lkup[ifindex].fl_hash[prio]);
 		if (cur) {
-			DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+			DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
 			return cur->flowid;
 		}
 	} else {
@@ -682,19 +1076,19 @@ dhd_flowid_find(dhd_pub_t *dhdp, uint8 ifindex, uint8 prio, char *sa, char *da)
 			hash = DHD_FLOWRING_HASHINDEX(da, prio);
 		}
 
-		cur = if_flow_lkup[ifindex].fl_hash[hash];
+		cur = DHD_FLOW_HASH_DEREF(if_flow_lkup[ifindex].fl_hash[hash]);
 
 		while (cur) {
 			if ((ismcast && ETHER_ISMULTI(cur->flow_info.da)) ||
 				(!memcmp(cur->flow_info.da, da, ETHER_ADDR_LEN) &&
 				(cur->flow_info.tid == prio))) {
-				DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+				DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
 				return cur->flowid;
 			}
-			cur = cur->next;
+			cur = DHD_FLOW_HASH_DEREF(cur->next);
 		}
 	}
-	DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
+	DHD_FLOWID_READ_UNLOCK(dhdp->flowid_lock, flags);
 
 #ifdef DHD_EFI
 	DHD_TRACE(("%s: cannot find flowid\n", __FUNCTION__));
@@ -799,13 +1193,13 @@ dhd_flowid_alloc(dhd_pub_t *dhdp, uint8 ifindex, uint8 prio, char *sa, char *da)
 				while (cur->next) {
 					cur = cur->next;
 				}
-				cur->next = fl_hash_node;
+				DHD_FLOW_HASH_ASSIGN(cur->next, fl_hash_node);
 			} else {
-				if_flow_lkup[ifindex].fl_hash[hash] = fl_hash_node;
+				DHD_FLOW_HASH_ASSIGN(if_flow_lkup[ifindex].fl_hash[hash], fl_hash_node);
 			}
 		} else
 #endif /* WLTDLS */
-			if_flow_lkup[ifindex].fl_hash[prio] = fl_hash_node;
+			DHD_FLOW_HASH_ASSIGN(if_flow_lkup[ifindex].fl_hash[prio], fl_hash_node);
 	} else {
 
 		/* For bcast/mcast assign first slot in in interface */
@@ -817,9 +1211,9 @@ dhd_flowid_alloc(dhd_pub_t *dhdp, uint8 ifindex, uint8 prio, char *sa, char *da)
 			while (cur->next) {
 				cur = cur->next;
 			}
-			cur->next = fl_hash_node;
+			DHD_FLOW_HASH_ASSIGN(cur->next, fl_hash_node);
 		} else
-			if_flow_lkup[ifindex].fl_hash[hash] = fl_hash_node;
+			DHD_FLOW_HASH_ASSIGN(if_flow_lkup[ifindex].fl_hash[hash], fl_hash_node);
 	}
 	DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
 
@@ -933,9 +1327,18 @@ dhd_flowid_lookup(dhd_pub_t *dhdp, uint8 ifindex,
 #ifdef TX_STATUS_LATENCY_STATS
 		flow_ring_node->flow_info.cum_tx_status_latency = 0;
 #endif /* TX_STATUS_LATENCY_STATS */
+#ifdef DHD_TXCPL_LAT_HIST
+		bzero(&flow_ring_node->txcpl_lat, sizeof(flow_ring_node->txcpl_lat));
+#endif /* DHD_TXCPL_LAT_HIST */
 		flow_ring_node->flow_info.num_tx_status = 0;
 		flow_ring_node->flow_info.num_tx_pkts = 0;
 		flow_ring_node->flow_info.num_tx_dropped = 0;
+#ifdef DHD_FLOWRING_SCHED
+		bzero(&flow_ring_node->sched, sizeof(flow_ring_node->sched));
+#endif /* DHD_FLOWRING_SCHED */
+#ifdef DHD_FLOWRING_BQL
+		dhd_flow_bql_init(dhdp, flow_ring_node);
+#endif /* DHD_FLOWRING_BQL */
 #ifdef BCMDBG
 		bzero(&flow_ring_node->flow_info.tx_status[0],
 			sizeof(uint32) * DHD_MAX_TX_STATUS_MSGS);
@@ -1228,9 +1631,10 @@ dhd_flowid_free(dhd_pub_t *dhdp, uint8 ifindex, uint16 flowid)
 			}
 			if (found) {
 				if (!prev) {
-					if_flow_lkup[ifindex].fl_hash[hashix] = cur->next;
+					DHD_FLOW_HASH_ASSIGN(if_flow_lkup[ifindex].fl_hash[hashix],
+						cur->next);
 				} else {
-					prev->next = cur->next;
+					DHD_FLOW_HASH_ASSIGN(prev->next, cur->next);
 				}
 
 				/* Decrement multi_client_flow_rings */
@@ -1246,7 +1650,7 @@ dhd_flowid_free(dhd_pub_t *dhdp, uint8 ifindex, uint16 flowid)
 				dhd_del_flowid(dhdp, ifindex, flowid);
 
 				dhd_flowid_map_free(dhdp, ifindex, flowid);
-				MFREE(dhdp->osh, cur, sizeof(flow_hash_info_t));
+				DHD_FLOW_HASH_NODE_FREE(dhdp, cur);
 				DHD_FLOWID_UNLOCK(dhdp->flowid_lock, flags);
 
 				return;
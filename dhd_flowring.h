@@ -164,6 +164,9 @@ typedef struct flow_queue {
 	flow_queue_cb_t cb;         /* callback invoked on threshold crossing */
 	uint32 l2threshold;         /* grandparent's (level 2) cummulative length threshold */
 	void * l2clen_ptr;          /* grandparent's (level 2) cummulative length counter */
+#ifdef DHD_FLOWRING_BQL
+	uint32 bytes;               /* number of bytes in the queue */
+#endif /* DHD_FLOWRING_BQL */
 } flow_queue_t;
 
 #define DHD_FLOW_QUEUE_LEN(queue)       ((int)(queue)->len)
@@ -252,6 +255,83 @@ typedef struct flow_info {
 
 } flow_info_t;
 
+#ifdef DHD_FLOWRING_SCHED
+/*
+ * Flowring scheduler modes. With a scheduler, each visit of a backlogged flowring from
+ * dhd_update_txflowrings grants it a quantum of credit, and packets move from its queue
+ * to the flowring only while the credit lasts (deficit round robin).
+ */
+#define FLOW_SCHED_NONE		0u	/* drain each queue as far as ring space allows */
+#define FLOW_SCHED_DRR		1u	/* deficit round robin, cost is bytes */
+#define FLOW_SCHED_AIRTIME	2u	/* deficit round robin, cost is txcpl latency in usec */
+#define FLOW_SCHED_MAX		FLOW_SCHED_AIRTIME
+#ifndef FLOW_SCHED_DEFAULT
+#define FLOW_SCHED_DEFAULT	FLOW_SCHED_NONE	/* select with the flow_sched iovar */
+#endif /* FLOW_SCHED_DEFAULT */
+
+#ifndef FLOW_SCHED_QUANTUM_BYTES
+#define FLOW_SCHED_QUANTUM_BYTES	(8u * 1514u)	/* credit per round, DRR */
+#endif /* FLOW_SCHED_QUANTUM_BYTES */
+#ifndef FLOW_SCHED_QUANTUM_US
+#define FLOW_SCHED_QUANTUM_US		2000u	/* credit per round, airtime */
+#endif /* FLOW_SCHED_QUANTUM_US */
+/* Airtime cost of a packet until the flow has txcpl latency samples */
+#define FLOW_SCHED_AIRTIME_DEF_US	100u
+/* Unused credit carried over is capped at this many quanta */
+#define FLOW_SCHED_MAX_QUANTA		2
+
+/** per flowring scheduler state, and fairness and queueing delay counters */
+typedef struct flow_sched {
+	int32	deficit;	/* credit left in the current round */
+	uint32	airtime_us;	/* estimated airtime cost of one packet */
+	uint64	lat_cum_prev;	/* cum_tx_status_latency at the last airtime estimate */
+	uint64	lat_num_prev;	/* num_tx_status at the last airtime estimate */
+	uint32	rounds;		/* rounds in which the flow was granted a quantum */
+	uint32	stalls;		/* rounds that ended on credit with packets still queued */
+	uint64	tx_bytes;	/* bytes moved from queue to flowring */
+	uint64	tx_cost;	/* cost charged against the credit */
+	uint64	num_qdelay;	/* packets accounted in cum_qdelay_us */
+	uint64	cum_qdelay_us;	/* cumulative time packets waited in the queue */
+	uint32	max_qdelay_us;	/* max time a packet waited in the queue */
+	bool	backlogged;	/* held back on credit, refilled by the rounds only */
+} flow_sched_t;
+#endif /* DHD_FLOWRING_SCHED */
+
+#ifdef DHD_FLOWRING_BQL
+/*
+ * Byte queue limit per flowring. The bytes a flow holds below the netif queue, in its
+ * backup queue plus posted to the flowring and not yet completed, are bounded by a
+ * limit sized from the measured txcpl drain rate times flow_bql_target_ms. The
+ * interface's netif queues are stopped once every flow of the interface that holds bytes
+ * is over its limit, so one bulk flow does not stall the others. A flow over its limit
+ * meanwhile keeps the excess in its backup queue. Completions restart the queues.
+ */
+#define FLOW_BQL_EPOCH_US		10000u		/* drain rate sampling period */
+#define FLOW_BQL_MIN_BYTES		(16u * 1514u)
+#define FLOW_BQL_MAX_BYTES		(4u * 1024u * 1024u)
+#define FLOW_BQL_INIT_BYTES		(64u * 1514u)
+#ifndef FLOW_BQL_TARGET_MS
+#define FLOW_BQL_TARGET_MS		4u	/* msec of data at the drain rate */
+#endif /* FLOW_BQL_TARGET_MS */
+
+/** per flowring byte queue limit state */
+typedef struct flow_bql {
+	uint32	limit;		/* bound on queued plus inflight bytes */
+	uint32	posted_bytes;	/* bytes posted to the flowring, under the flowring lock */
+	uint32	cpl_bytes;	/* bytes completed by txstatus, from DPC only */
+	uint32	epoch_start_us;	/* start of the current drain rate sample */
+	uint32	epoch_cpl_bytes; /* cpl_bytes at epoch_start_us */
+	uint32	rate;		/* EWMA of the drain rate in bytes per msec */
+	bool	stopped;	/* over its limit, counted in flow_bql_stopped */
+	bool	busy;		/* holds queued or inflight bytes, counted in flow_bql_busy */
+	uint32	stops;		/* times the flow crossed its limit */
+	uint32	starved;	/* restarts with nothing left queued or inflight */
+} flow_bql_t;
+
+/* posted and not yet completed bytes, both counters only move forward */
+#define FLOW_BQL_INFLIGHT(bql)	((bql)->posted_bytes - (bql)->cpl_bytes)
+#endif /* DHD_FLOWRING_BQL */
+
 /** a flow ring is used for outbound (towards antenna) 802.3 packets */
 typedef struct flow_ring_node {
 	dll_t		list;  /* manage a constructed flowring in a dll, must be at first place */
@@ -284,6 +364,15 @@ typedef struct flow_ring_node {
 #ifdef DHD_HP2P
 	bool	hp2p_ring;
 #endif /* DHD_HP2P */
+#ifdef DHD_FLOWRING_SCHED
+	flow_sched_t	sched;
+#endif /* DHD_FLOWRING_SCHED */
+#ifdef DHD_FLOWRING_BQL
+	flow_bql_t	bql;
+#endif /* DHD_FLOWRING_BQL */
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_hist_t	txcpl_lat;
+#endif /* DHD_TXCPL_LAT_HIST */
 } flow_ring_node_t;
 
 typedef flow_ring_node_t flow_ring_table_t;
@@ -292,6 +381,10 @@ typedef struct flow_hash_info {
 	uint16			flowid;
 	flow_info_t		flow_info;
 	struct flow_hash_info	*next;
+#ifdef DHD_FLOWID_RCU
+	struct rcu_head		rcu;	/* deferred free after lockless readers */
+	osl_t			*osh;
+#endif /* DHD_FLOWID_RCU */
 } flow_hash_info_t;
 
 typedef struct if_flow_lkup {
@@ -325,6 +418,20 @@ extern int  dhd_flow_queue_enqueue(dhd_pub_t *dhdp, flow_queue_t *queue, void *p
 extern void * dhd_flow_queue_dequeue(dhd_pub_t *dhdp, flow_queue_t *queue);
 extern void dhd_flow_queue_reinsert(dhd_pub_t *dhdp, flow_queue_t *queue, void *pkt);
 
+#ifdef DHD_FLOWRING_BQL
+extern uint flow_bql_target_ms;
+extern void dhd_flow_bql_init(dhd_pub_t *dhdp, flow_ring_node_t *node);
+extern void dhd_flow_bql_check_stop(dhd_pub_t *dhdp, flow_ring_node_t *node);
+extern void dhd_flow_bql_complete(dhd_pub_t *dhdp, flow_ring_node_t *node, uint32 len);
+extern void dhd_flow_bql_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
+#endif /* DHD_FLOWRING_BQL */
+
+#ifdef DHD_TXCPL_LAT_HIST
+extern void dhd_txcpl_lat_update(dhd_pub_t *dhdp, flow_ring_node_t *node, uint64 lat_us);
+extern void dhd_txcpl_lat_clear(dhd_pub_t *dhdp);
+extern void dhd_txcpl_lat_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf, bool bins);
+#endif /* DHD_TXCPL_LAT_HIST */
+
 extern void dhd_flow_ring_config_thresholds(dhd_pub_t *dhdp, uint16 flowid,
                           int queue_budget, int cumm_threshold, void *cumm_ctr,
                           int l2cumm_threshold, void *l2cumm_ctr);
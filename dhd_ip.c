@@ -116,11 +116,41 @@ pkt_frag_t pkt_frag_info(osl_t *osh, void *p)
 
 #ifdef DHDTCPACK_SUPPRESS
 
+/* TCP stream identity, as laid out in the IP and TCP headers */
 typedef struct {
+	uint8 ip_addr[IPV4_ADDR_LEN * 2];	/* SRC and DST ip addrs of the TCP stream */
+	uint8 tcp_port[TCP_PORT_LEN * 2];	/* SRC and DST tcp ports of the TCP stream */
+} tcpack_flow_key_t;
+
+/* Hash table linkage shared by tcpack_info_t and tcpdata_info_t, must be first member */
+typedef struct tcpack_flow {
+	dll_t lru;			/* link in the LRU list of the table or its free list */
+	struct tcpack_flow *hnext;	/* next flow in the same hash bucket */
+	tcpack_flow_key_t key;
+	uint16 hidx;			/* hash bucket of this flow */
+} tcpack_flow_t;
+
+#define TCPACK_HASH_SZ	(1u << TCPACK_HASH_BITS)
+
+/* 4-tuple hash table of flows, evicting the least recently used flow when full */
+typedef struct {
+	tcpack_flow_t *bucket[TCPACK_HASH_SZ];
+	dll_t lru;		/* flows in use, least recently used first */
+	dll_t free;		/* flows not in use */
+	int cnt;		/* number of flows in use */
+	uint32 lookups;
+	uint32 hits;
+	uint32 evicts;
+} tcpack_flow_tbl_t;
+
+typedef struct {
+	tcpack_flow_t flow;	/* must be first */
 	void *pkt_in_q;		/* TCP ACK packet that is already in txq or DelayQ */
 	void *pkt_ether_hdr;	/* Ethernet header pointer of pkt_in_q */
 	int ifidx;
 	uint8 supp_cnt;
+	bool timer_armed;	/* timer started and its callback not yet run */
+	bool in_flight;		/* given up while its callback was running, not reusable yet */
 	dhd_pub_t *dhdp;
 #ifndef TCPACK_SUPPRESS_HOLD_HRT
 	timer_list_compat_t timer;
@@ -135,14 +165,7 @@ typedef struct _tdata_psh_info_t {
 } tdata_psh_info_t;
 
 typedef struct {
-	struct {
-		uint8 src[IPV4_ADDR_LEN];	/* SRC ip addrs of this TCP stream */
-		uint8 dst[IPV4_ADDR_LEN];	/* DST ip addrs of this TCP stream */
-	} ip_addr;
-	struct {
-		uint8 src[TCP_PORT_LEN];	/* SRC tcp ports of this TCP stream */
-		uint8 dst[TCP_PORT_LEN];	/* DST tcp ports of this TCP stream */
-	} tcp_port;
+	tcpack_flow_t flow;	/* must be first, key is the src/dst of the DATA stream */
 	tdata_psh_info_t *tdata_psh_info_head;	/* Head of received TCP PSH DATA chain */
 	tdata_psh_info_t *tdata_psh_info_tail;	/* Tail of received TCP PSH DATA chain */
 	uint32 last_used_time;	/* The last time this tcpdata_info was used(in ms) */
@@ -150,9 +173,9 @@ typedef struct {
 
 /* TCPACK SUPPRESS module */
 typedef struct {
-	int tcpack_info_cnt;
+	tcpack_flow_tbl_t tcpack_flows;	/* Flows of tcpack_info_tbl in use */
 	tcpack_info_t tcpack_info_tbl[TCPACK_INFO_MAXNUM];	/* Info of TCP ACK to send */
-	int tcpdata_info_cnt;
+	tcpack_flow_tbl_t tcpdata_flows;	/* Flows of tcpdata_info_tbl in use */
 	tcpdata_info_t tcpdata_info_tbl[TCPDATA_INFO_MAXNUM];	/* Info of received TCP DATA */
 	tdata_psh_info_t *tdata_psh_info_pool;	/* Pointer to tdata_psh_info elements pool */
 	tdata_psh_info_t *tdata_psh_info_free;	/* free tdata_psh_info elements chain in pool */
@@ -165,6 +188,166 @@ typedef struct {
 counter_tbl_t tack_tbl = {"tcpACK", 0, 1000, 10, {0, }, 1};
 #endif /* DEBUG_COUNTER && DHDTCPACK_SUP_DBG */
 
+#ifndef TCPACK_SUPPRESS_HOLD_HRT
+#define TCPACK_TIMER_CANCEL(tcpack_info)	del_timer(&(tcpack_info)->timer)
+#else
+#define TCPACK_TIMER_CANCEL(tcpack_info)	hrtimer_try_to_cancel(&(tcpack_info)->timer.timer)
+#endif /* TCPACK_SUPPRESS_HOLD_HRT */
+
+static INLINE void
+tcpack_flow_key_get(tcpack_flow_key_t *key, uint8 *ip_hdr, uint8 *tcp_hdr)
+{
+	/* Note that src/dst addr fields in ip header are contiguous being 8 bytes in total.
+	 * Also, src/dst port fields in TCP header are contiguous being 4 bytes in total.
+	 */
+	bcopy(&ip_hdr[IPV4_SRC_IP_OFFSET], key->ip_addr, IPV4_ADDR_LEN * 2);
+	bcopy(&tcp_hdr[TCP_SRC_PORT_OFFSET], key->tcp_port, TCP_PORT_LEN * 2);
+}
+
+/* Key of the opposite direction, i.e. the DATA stream a TCP ACK acknowledges */
+static INLINE void
+tcpack_flow_key_get_rev(tcpack_flow_key_t *key, uint8 *ip_hdr, uint8 *tcp_hdr)
+{
+	bcopy(&ip_hdr[IPV4_DEST_IP_OFFSET], key->ip_addr, IPV4_ADDR_LEN);
+	bcopy(&ip_hdr[IPV4_SRC_IP_OFFSET], &key->ip_addr[IPV4_ADDR_LEN], IPV4_ADDR_LEN);
+	bcopy(&tcp_hdr[TCP_DEST_PORT_OFFSET], key->tcp_port, TCP_PORT_LEN);
+	bcopy(&tcp_hdr[TCP_SRC_PORT_OFFSET], &key->tcp_port[TCP_PORT_LEN], TCP_PORT_LEN);
+}
+
+static INLINE uint16
+tcpack_flow_hash(tcpack_flow_key_t *key)
+{
+	uint32 hash;
+
+	hash = ntoh32_ua(key->ip_addr) ^ ntoh32_ua(&key->ip_addr[IPV4_ADDR_LEN]) ^
+		ntoh32_ua(key->tcp_port);
+	/* multiplicative hashing, the upper bits are the well mixed ones */
+	hash *= 0x9E3779B1u;
+
+	return (uint16)(hash >> (32 - TCPACK_HASH_BITS));
+}
+
+static void
+tcpack_flow_tbl_init(tcpack_flow_tbl_t *tbl, void *flows, uint flow_sz, uint num)
+{
+	uint i;
+
+	bzero(tbl->bucket, sizeof(tbl->bucket));
+	dll_init(&tbl->lru);
+	dll_init(&tbl->free);
+	tbl->cnt = 0;
+
+	for (i = 0; i < num; i++) {
+		tcpack_flow_t *flow = (tcpack_flow_t *)((uint8 *)flows + (i * flow_sz));
+		flow->hnext = NULL;
+		dll_append(&tbl->free, &flow->lru);
+	}
+}
+
+static tcpack_flow_t *
+tcpack_flow_find(tcpack_flow_tbl_t *tbl, tcpack_flow_key_t *key, uint16 hidx)
+{
+	tcpack_flow_t *flow;
+
+	tbl->lookups++;
+	for (flow = tbl->bucket[hidx]; flow; flow = flow->hnext) {
+		if (memcmp(&flow->key, key, sizeof(*key)) == 0) {
+			tbl->hits++;
+			break;
+		}
+	}
+
+	return flow;
+}
+
+/* Mark a flow as the most recently used one */
+static INLINE void
+tcpack_flow_touch(tcpack_flow_tbl_t *tbl, tcpack_flow_t *flow)
+{
+	dll_delete(&flow->lru);
+	dll_append(&tbl->lru, &flow->lru);
+}
+
+/* Least recently used flow, the one to evict when the table is full */
+static INLINE tcpack_flow_t *
+tcpack_flow_lru(tcpack_flow_tbl_t *tbl)
+{
+	return dll_empty(&tbl->lru) ? NULL : (tcpack_flow_t *)dll_head_p(&tbl->lru);
+}
+
+static tcpack_flow_t *
+tcpack_flow_alloc(tcpack_flow_tbl_t *tbl, tcpack_flow_key_t *key, uint16 hidx)
+{
+	tcpack_flow_t *flow;
+
+	if (dll_empty(&tbl->free)) {
+		return NULL;
+	}
+
+	flow = (tcpack_flow_t *)dll_head_p(&tbl->free);
+	dll_delete(&flow->lru);
+	dll_append(&tbl->lru, &flow->lru);
+	bcopy(key, &flow->key, sizeof(*key));
+	flow->hidx = hidx;
+	flow->hnext = tbl->bucket[hidx];
+	tbl->bucket[hidx] = flow;
+	tbl->cnt++;
+
+	return flow;
+}
+
+/* Take a flow out of the hash table and the LRU list, without freeing it */
+static bool
+tcpack_flow_unlink(tcpack_flow_tbl_t *tbl, tcpack_flow_t *flow)
+{
+	tcpack_flow_t **prev = &tbl->bucket[flow->hidx];
+
+	while (*prev && *prev != flow) {
+		prev = &(*prev)->hnext;
+	}
+	if (*prev == NULL) {
+		DHD_ERROR(("%s %d: flow %p not in bucket %d\n",
+			__FUNCTION__, __LINE__, flow, flow->hidx));
+		return FALSE;
+	}
+
+	*prev = flow->hnext;
+	flow->hnext = NULL;
+	dll_delete(&flow->lru);
+	tbl->cnt--;
+
+	return TRUE;
+}
+
+static void
+tcpack_flow_free(tcpack_flow_tbl_t *tbl, tcpack_flow_t *flow)
+{
+	if (tcpack_flow_unlink(tbl, flow)) {
+		dll_append(&tbl->free, &flow->lru);
+	}
+}
+
+/* Give up a HOLD entry. If its timer already fired the callback is still on its
+ * way, so the entry is only put back on the free list once that callback ran.
+ */
+static void
+tcpack_info_release(tcpack_sup_module_t *tcpack_sup_mod, tcpack_info_t *tcpack_info)
+{
+	tcpack_info->pkt_in_q = NULL;
+	tcpack_info->pkt_ether_hdr = NULL;
+	tcpack_info->ifidx = 0;
+	tcpack_info->supp_cnt = 0;
+
+	if ((TCPACK_TIMER_CANCEL(tcpack_info) <= 0) && tcpack_info->timer_armed) {
+		if (tcpack_flow_unlink(&tcpack_sup_mod->tcpack_flows, &tcpack_info->flow)) {
+			tcpack_info->in_flight = TRUE;
+		}
+	} else {
+		tcpack_flow_free(&tcpack_sup_mod->tcpack_flows, &tcpack_info->flow);
+	}
+	tcpack_info->timer_armed = FALSE;
+}
+
 static void
 _tdata_psh_info_pool_enq(tcpack_sup_module_t *tcpack_sup_mod,
 	tdata_psh_info_t *tdata_psh_info)
@@ -208,6 +391,31 @@ _tdata_psh_info_pool_deq(tcpack_sup_module_t *tcpack_sup_mod)
 	return tdata_psh_info;
 }
 
+/* Return the TCP PSH DATA info elements of a tcpdata_info to the pool */
+static void
+_tcpdata_info_psh_flush(tcpack_sup_module_t *tcpack_sup_mod, tcpdata_info_t *tcpdata_info)
+{
+	tdata_psh_info_t *tdata_psh_info;
+
+	while ((tdata_psh_info = tcpdata_info->tdata_psh_info_head)) {
+		tcpdata_info->tdata_psh_info_head = tdata_psh_info->next;
+		tdata_psh_info->next = NULL;
+		DHD_TRACE(("%s %d: Clean tdata_psh_info(end_seq %u)!\n",
+			__FUNCTION__, __LINE__, tdata_psh_info->end_seq));
+		_tdata_psh_info_pool_enq(tcpack_sup_mod, tdata_psh_info);
+	}
+	tcpdata_info->tdata_psh_info_tail = NULL;
+}
+
+static void
+_tcpack_sup_tbl_init(tcpack_sup_module_t *tcpack_sup_mod)
+{
+	tcpack_flow_tbl_init(&tcpack_sup_mod->tcpack_flows, tcpack_sup_mod->tcpack_info_tbl,
+		sizeof(tcpack_info_t), TCPACK_INFO_MAXNUM);
+	tcpack_flow_tbl_init(&tcpack_sup_mod->tcpdata_flows, tcpack_sup_mod->tcpdata_info_tbl,
+		sizeof(tcpdata_info_t), TCPDATA_INFO_MAXNUM);
+}
+
 #ifdef BCMSDIO
 static int _tdata_psh_info_pool_init(dhd_pub_t *dhdp,
 	tcpack_sup_module_t *tcpack_sup_mod)
@@ -248,6 +456,7 @@ static void _tdata_psh_info_pool_deinit(dhd_pub_t *dhdp,
 {
 	uint i;
 	tdata_psh_info_t *tdata_psh_info;
+	dll_t *item;
 
 	DHD_TRACE(("%s %d: Enter\n", __FUNCTION__, __LINE__));
 
@@ -257,15 +466,11 @@ static void _tdata_psh_info_pool_deinit(dhd_pub_t *dhdp,
 		return;
 	}
 
-	for (i = 0; i < tcpack_sup_mod->tcpdata_info_cnt; i++) {
-		tcpdata_info_t *tcpdata_info = &tcpack_sup_mod->tcpdata_info_tbl[i];
-		/* Return tdata_psh_info elements allocated to each tcpdata_info to the pool */
-		while ((tdata_psh_info = tcpdata_info->tdata_psh_info_head)) {
-			tcpdata_info->tdata_psh_info_head = tdata_psh_info->next;
-			tdata_psh_info->next = NULL;
-			_tdata_psh_info_pool_enq(tcpack_sup_mod, tdata_psh_info);
-		}
-		tcpdata_info->tdata_psh_info_tail = NULL;
+	/* Return tdata_psh_info elements allocated to each tcpdata_info to the pool */
+	for (item = dll_head_p(&tcpack_sup_mod->tcpdata_flows.lru);
+		!dll_end(&tcpack_sup_mod->tcpdata_flows.lru, item);
+		item = dll_next_p(item)) {
+		_tcpdata_info_psh_flush(tcpack_sup_mod, (tcpdata_info_t *)item);
 	}
 #ifdef DHDTCPACK_SUP_DBG
 	DHD_PRINT(("%s %d: PSH INFO ENQ %d\n",
@@ -330,6 +535,14 @@ static enum hrtimer_restart dhd_tcpack_send(struct hrtimer *timer)
 		dhd_os_tcpackunlock(dhdp, flags);
 		goto done;
 	}
+	cur_tbl->timer_armed = FALSE;
+	if (cur_tbl->in_flight) {
+		/* The entry was given up while this callback was pending */
+		cur_tbl->in_flight = FALSE;
+		dll_append(&tcpack_sup_mod->tcpack_flows.free, &cur_tbl->flow.lru);
+		dhd_os_tcpackunlock(dhdp, flags);
+		goto done;
+	}
 	pkt = cur_tbl->pkt_in_q;
 	ifidx = cur_tbl->ifidx;
 	if (!pkt) {
@@ -340,10 +553,7 @@ static enum hrtimer_restart dhd_tcpack_send(struct hrtimer *timer)
 	cur_tbl->pkt_ether_hdr = NULL;
 	cur_tbl->ifidx = 0;
 	cur_tbl->supp_cnt = 0;
-	if (--tcpack_sup_mod->tcpack_info_cnt < 0) {
-		DHD_ERROR(("%s %d: ERROR!!! tcp_ack_info_cnt %d\n",
-			__FUNCTION__, __LINE__, tcpack_sup_mod->tcpack_info_cnt));
-	}
+	tcpack_flow_free(&tcpack_sup_mod->tcpack_flows, &cur_tbl->flow);
 
 	dhd_os_tcpackunlock(dhdp, flags);
 
@@ -366,6 +576,12 @@ int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 mode)
 	uint8 invalid_mode = FALSE;
 	int prev_mode;
 	int i = 0;
+	tcpack_sup_module_t *new_module = NULL;
+
+	/* The module is large and TX may call in atomic context, so allocate it up front */
+	if ((mode != TCPACK_SUP_OFF) && (dhdp->tcpack_sup_module == NULL)) {
+		new_module = MALLOC(dhdp->osh, sizeof(tcpack_sup_module_t));
+	}
 
 	flags = dhd_os_tcpacklock(dhdp);
 	tcpack_sup_module = dhdp->tcpack_sup_module;
@@ -398,7 +614,8 @@ int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 mode)
 	switch (prev_mode) {
 		case TCPACK_SUP_OFF:
 			if (tcpack_sup_module == NULL) {
-				tcpack_sup_module = MALLOC(dhdp->osh, sizeof(tcpack_sup_module_t));
+				tcpack_sup_module = new_module;
+				new_module = NULL;
 				if (tcpack_sup_module == NULL) {
 					DHD_ERROR(("%s[%d]: Failed to allocate the new memory for "
 						"tcpack_sup_module\n", __FUNCTION__, __LINE__));
@@ -409,6 +626,7 @@ int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 mode)
 				dhdp->tcpack_sup_module = tcpack_sup_module;
 			}
 			bzero(tcpack_sup_module, sizeof(tcpack_sup_module_t));
+			_tcpack_sup_tbl_init(tcpack_sup_module);
 			break;
 #ifdef BCMSDIO
 		case TCPACK_SUP_DELAYTX:
@@ -417,9 +635,11 @@ int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 mode)
 				 * tcpddata_info_tbl anymore
 				 */
 				_tdata_psh_info_pool_deinit(dhdp, tcpack_sup_module);
-				tcpack_sup_module->tcpdata_info_cnt = 0;
 				bzero(tcpack_sup_module->tcpdata_info_tbl,
 					sizeof(tcpdata_info_t) * TCPDATA_INFO_MAXNUM);
+				tcpack_flow_tbl_init(&tcpack_sup_module->tcpdata_flows,
+					tcpack_sup_module->tcpdata_info_tbl,
+					sizeof(tcpdata_info_t), TCPDATA_INFO_MAXNUM);
 			}
 
 			/* For half duplex bus interface, tx precedes rx by default */
@@ -510,6 +730,9 @@ int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 mode)
 
 exit:
 	dhd_os_tcpackunlock(dhdp, flags);
+	if (new_module) {
+		MFREE(dhdp->osh, new_module, sizeof(tcpack_sup_module_t));
+	}
 	return ret;
 }
 
@@ -542,11 +765,14 @@ dhd_tcpack_info_tbl_clean(dhd_pub_t *dhdp)
 				tcpack_sup_mod->tcpack_info_tbl[i].ifidx = 0;
 				tcpack_sup_mod->tcpack_info_tbl[i].supp_cnt = 0;
 			}
+			tcpack_sup_mod->tcpack_info_tbl[i].timer_armed = FALSE;
+			tcpack_sup_mod->tcpack_info_tbl[i].in_flight = FALSE;
 		}
 	} else {
-		tcpack_sup_mod->tcpack_info_cnt = 0;
 		bzero(tcpack_sup_mod->tcpack_info_tbl, sizeof(tcpack_info_t) * TCPACK_INFO_MAXNUM);
 	}
+	tcpack_flow_tbl_init(&tcpack_sup_mod->tcpack_flows, tcpack_sup_mod->tcpack_info_tbl,
+		sizeof(tcpack_info_t), TCPACK_INFO_MAXNUM);
 
 	dhd_os_tcpackunlock(dhdp, flags);
 
@@ -564,14 +790,36 @@ exit:
 	return;
 }
 
+void
+dhd_tcpack_suppress_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
+{
+	tcpack_sup_module_t *tcpack_sup_mod;
+	tcpack_flow_tbl_t *tbl;
+	unsigned long flags;
+
+	flags = dhd_os_tcpacklock(dhdp);
+	bcm_bprintf(strbuf, "tcpack_sup_mode %d\n", dhdp->tcpack_sup_mode);
+	tcpack_sup_mod = dhdp->tcpack_sup_module;
+	if (tcpack_sup_mod) {
+		tbl = &tcpack_sup_mod->tcpack_flows;
+		bcm_bprintf(strbuf, "tcpack flows %d/%d lookups %u hits %u evicts %u\n",
+			tbl->cnt, TCPACK_INFO_MAXNUM, tbl->lookups, tbl->hits, tbl->evicts);
+		tbl = &tcpack_sup_mod->tcpdata_flows;
+		bcm_bprintf(strbuf, "tcpdata flows %d/%d lookups %u hits %u evicts %u\n",
+			tbl->cnt, TCPDATA_INFO_MAXNUM, tbl->lookups, tbl->hits, tbl->evicts);
+	}
+	dhd_os_tcpackunlock(dhdp, flags);
+}
+
 inline int dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt)
 {
-	uint8 i;
 	tcpack_sup_module_t *tcpack_sup_mod;
-	tcpack_info_t *tcpack_info_tbl;
-	int tbl_cnt;
+	tcpack_info_t *tcpack_info;
+	tcpack_flow_t *flow;
+	tcpack_flow_key_t key;
 	int ret = BCME_OK;
-	void *pdata;
+	uint8 *pdata;
+	uint8 *ether_hdr, *ip_hdr;
 	uint32 pktlen;
 	unsigned long flags;
 
@@ -587,6 +835,16 @@ inline int dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt)
 		goto exit;
 	}
 
+	/* Only a TCP/IPv4 pkt can be in tcpack_info_tbl, find its stream by the headers */
+	ether_hdr = pdata + dhd_prot_hdrlen(dhdp, pdata);
+	ip_hdr = ether_hdr + ETHER_HDR_LEN;
+	if (((ether_hdr[12] << 8) | ether_hdr[13]) != ETHER_TYPE_IP ||
+		IP_VER(ip_hdr) != IP_VER_4 || IPV4_PROT(ip_hdr) != IP_PROT_TCP ||
+		IPV4_HLEN(ip_hdr) + ETHER_HDR_LEN + TCP_MIN_HEADER_LEN > pktlen) {
+		goto exit;
+	}
+	tcpack_flow_key_get(&key, ip_hdr, ip_hdr + IPV4_HLEN(ip_hdr));
+
 	flags = dhd_os_tcpacklock(dhdp);
 	tcpack_sup_mod = dhdp->tcpack_sup_module;
 
@@ -596,26 +854,19 @@ inline int dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt)
 		dhd_os_tcpackunlock(dhdp, flags);
 		goto exit;
 	}
-	tbl_cnt = tcpack_sup_mod->tcpack_info_cnt;
-	tcpack_info_tbl = tcpack_sup_mod->tcpack_info_tbl;
-
-	ASSERT(tbl_cnt <= TCPACK_INFO_MAXNUM);
 
-	for (i = 0; i < tbl_cnt; i++) {
-		if (tcpack_info_tbl[i].pkt_in_q == pkt) {
-			DHD_TRACE(("%s %d: pkt %p sent out. idx %d, tbl_cnt %d\n",
-				__FUNCTION__, __LINE__, pkt, i, tbl_cnt));
+	for (flow = tcpack_sup_mod->tcpack_flows.bucket[tcpack_flow_hash(&key)]; flow;
+		flow = flow->hnext) {
+		tcpack_info = (tcpack_info_t *)flow;
+		if (tcpack_info->pkt_in_q == pkt) {
+			DHD_TRACE(("%s %d: pkt %p sent out. tbl_cnt %d\n",
+				__FUNCTION__, __LINE__, pkt, tcpack_sup_mod->tcpack_flows.cnt));
 			/* This pkt is being transmitted so remove the tcp_ack_info of it. */
-			if (i < tbl_cnt - 1) {
-				bcopy(&tcpack_info_tbl[tbl_cnt - 1],
-					&tcpack_info_tbl[i], sizeof(tcpack_info_t));
-			}
-			bzero(&tcpack_info_tbl[tbl_cnt - 1], sizeof(tcpack_info_t));
-			if (--tcpack_sup_mod->tcpack_info_cnt < 0) {
-				DHD_ERROR(("%s %d: ERROR!!! tcp_ack_info_cnt %d\n",
-					__FUNCTION__, __LINE__, tcpack_sup_mod->tcpack_info_cnt));
-				ret = BCME_ERROR;
-			}
+			tcpack_info->pkt_in_q = NULL;
+			tcpack_info->pkt_ether_hdr = NULL;
+			tcpack_info->ifidx = 0;
+			tcpack_info->supp_cnt = 0;
+			tcpack_flow_free(&tcpack_sup_mod->tcpack_flows, flow);
 			break;
 		}
 	}
@@ -629,9 +880,9 @@ static INLINE bool dhd_tcpdata_psh_acked(dhd_pub_t *dhdp, uint8 *ip_hdr,
 	uint8 *tcp_hdr, uint32 tcp_ack_num)
 {
 	tcpack_sup_module_t *tcpack_sup_mod;
-	int i;
 	tcpdata_info_t *tcpdata_info = NULL;
 	tdata_psh_info_t *tdata_psh_info = NULL;
+	tcpack_flow_key_t key;
 	bool ret = FALSE;
 
 	if (dhdp->tcpack_sup_mode != TCPACK_SUP_DELAYTX)
@@ -652,28 +903,10 @@ static INLINE bool dhd_tcpdata_psh_acked(dhd_pub_t *dhdp, uint8 *ip_hdr,
 		ntoh16_ua(&tcp_hdr[TCP_DEST_PORT_OFFSET]),
 		tcp_ack_num));
 
-	for (i = 0; i < tcpack_sup_mod->tcpdata_info_cnt; i++) {
-		tcpdata_info_t *tcpdata_info_tmp = &tcpack_sup_mod->tcpdata_info_tbl[i];
-		DHD_TRACE(("%s %d: data info[%d], IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
-			" TCP port %d %d\n", __FUNCTION__, __LINE__, i,
-			IPV4_ADDR_TO_STR(ntoh32_ua(tcpdata_info_tmp->ip_addr.src)),
-			IPV4_ADDR_TO_STR(ntoh32_ua(tcpdata_info_tmp->ip_addr.dst)),
-			ntoh16_ua(tcpdata_info_tmp->tcp_port.src),
-			ntoh16_ua(tcpdata_info_tmp->tcp_port.dst)));
-
-		/* If either IP address or TCP port number does not match, skip. */
-		if (memcmp(&ip_hdr[IPV4_SRC_IP_OFFSET],
-			tcpdata_info_tmp->ip_addr.dst, IPV4_ADDR_LEN) == 0 &&
-			memcmp(&ip_hdr[IPV4_DEST_IP_OFFSET],
-			tcpdata_info_tmp->ip_addr.src, IPV4_ADDR_LEN) == 0 &&
-			memcmp(&tcp_hdr[TCP_SRC_PORT_OFFSET],
-			tcpdata_info_tmp->tcp_port.dst, TCP_PORT_LEN) == 0 &&
-			memcmp(&tcp_hdr[TCP_DEST_PORT_OFFSET],
-			tcpdata_info_tmp->tcp_port.src, TCP_PORT_LEN) == 0) {
-			tcpdata_info = tcpdata_info_tmp;
-			break;
-		}
-	}
+	/* The DATA stream acked by this pkt has the IP addrs and TCP ports swapped */
+	tcpack_flow_key_get_rev(&key, ip_hdr, tcp_hdr);
+	tcpdata_info = (tcpdata_info_t *)tcpack_flow_find(&tcpack_sup_mod->tcpdata_flows,
+		&key, tcpack_flow_hash(&key));
 
 	if (tcpdata_info == NULL) {
 		DHD_TRACE(("%s %d: no tcpdata_info!\n", __FUNCTION__, __LINE__));
@@ -720,8 +953,10 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 	uint16 new_ip_total_len;	/* Total length of IP packet for the new packet */
 	uint32 new_tcp_hdr_len;		/* TCP header length of the new packet */
 	tcpack_sup_module_t *tcpack_sup_mod;
-	tcpack_info_t *tcpack_info_tbl;
-	int i;
+	tcpack_info_t *tcpack_info;
+	tcpack_flow_t *flow;
+	tcpack_flow_key_t key;
+	uint16 hidx;
 	bool ret = FALSE;
 	bool set_dotxinrx = TRUE;
 	unsigned long flags;
@@ -796,6 +1031,9 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 		ntoh16_ua(&new_tcp_hdr[TCP_SRC_PORT_OFFSET]),
 		ntoh16_ua(&new_tcp_hdr[TCP_DEST_PORT_OFFSET])));
 
+	tcpack_flow_key_get(&key, new_ip_hdr, new_tcp_hdr);
+	hidx = tcpack_flow_hash(&key);
+
 	/* Look for tcp_ack_info that has the same ip src/dst addrs and tcp src/dst ports */
 	flags = dhd_os_tcpacklock(dhdp);
 #if defined(DEBUG_COUNTER) && defined(DHDTCPACK_SUP_DBG)
@@ -804,7 +1042,6 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 #endif /* DEBUG_COUNTER && DHDTCPACK_SUP_DBG */
 
 	tcpack_sup_mod = dhdp->tcpack_sup_module;
-	tcpack_info_tbl = tcpack_sup_mod->tcpack_info_tbl;
 
 	if (!tcpack_sup_mod) {
 		DHD_ERROR(("%s %d: tcpack suppress module NULL!!\n", __FUNCTION__, __LINE__));
@@ -821,47 +1058,42 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 	} else
 		set_dotxinrx = FALSE;
 
-	for (i = 0; i < tcpack_sup_mod->tcpack_info_cnt; i++) {
+	flow = tcpack_flow_find(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+	if (flow) {
 		void *oldpkt;	/* TCPACK packet that is already in txq or DelayQ */
 		uint8 *old_ether_hdr, *old_ip_hdr, *old_tcp_hdr;
 		uint32 old_ip_hdr_len, old_tcp_hdr_len;
 		uint32 old_tcpack_num;	/* TCP ACK number of old TCPACK packet in Q */
 
-		if ((oldpkt = tcpack_info_tbl[i].pkt_in_q) == NULL) {
-			DHD_ERROR(("%s %d: Unexpected error!! cur idx %d, ttl cnt %d\n",
-				__FUNCTION__, __LINE__, i, tcpack_sup_mod->tcpack_info_cnt));
-			break;
+		tcpack_info = (tcpack_info_t *)flow;
+		if ((oldpkt = tcpack_info->pkt_in_q) == NULL) {
+			DHD_ERROR(("%s %d: Unexpected error!! ttl cnt %d\n",
+				__FUNCTION__, __LINE__, tcpack_sup_mod->tcpack_flows.cnt));
+			dhd_os_tcpackunlock(dhdp, flags);
+			goto exit;
 		}
 
 		if (PKTDATA(dhdp->osh, oldpkt) == NULL) {
-			DHD_ERROR(("%s %d: oldpkt data NULL!! cur idx %d, ttl cnt %d\n",
-				__FUNCTION__, __LINE__, i, tcpack_sup_mod->tcpack_info_cnt));
-			break;
+			DHD_ERROR(("%s %d: oldpkt data NULL!! ttl cnt %d\n",
+				__FUNCTION__, __LINE__, tcpack_sup_mod->tcpack_flows.cnt));
+			dhd_os_tcpackunlock(dhdp, flags);
+			goto exit;
 		}
+		tcpack_flow_touch(&tcpack_sup_mod->tcpack_flows, flow);
 
-		old_ether_hdr = tcpack_info_tbl[i].pkt_ether_hdr;
+		old_ether_hdr = tcpack_info->pkt_ether_hdr;
 		old_ip_hdr = old_ether_hdr + ETHER_HDR_LEN;
 		old_ip_hdr_len = IPV4_HLEN(old_ip_hdr);
 		old_tcp_hdr = old_ip_hdr + old_ip_hdr_len;
 		old_tcp_hdr_len = 4 * TCP_HDRLEN(old_tcp_hdr[TCP_HLEN_OFFSET]);
 
-		DHD_TRACE(("%s %d: oldpkt %p[%d], IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
-			" TCP port %d %d\n", __FUNCTION__, __LINE__, oldpkt, i,
+		DHD_TRACE(("%s %d: oldpkt %p, IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
+			" TCP port %d %d\n", __FUNCTION__, __LINE__, oldpkt,
 			IPV4_ADDR_TO_STR(ntoh32_ua(&old_ip_hdr[IPV4_SRC_IP_OFFSET])),
 			IPV4_ADDR_TO_STR(ntoh32_ua(&old_ip_hdr[IPV4_DEST_IP_OFFSET])),
 			ntoh16_ua(&old_tcp_hdr[TCP_SRC_PORT_OFFSET]),
 			ntoh16_ua(&old_tcp_hdr[TCP_DEST_PORT_OFFSET])));
 
-		/* If either of IP address or TCP port number does not match, skip.
-		 * Note that src/dst addr fields in ip header are contiguous being 8 bytes in total.
-		 * Also, src/dst port fields in TCP header are contiguous being 4 bytes in total.
-		 */
-		if (memcmp(&new_ip_hdr[IPV4_SRC_IP_OFFSET],
-			&old_ip_hdr[IPV4_SRC_IP_OFFSET], IPV4_ADDR_LEN * 2) ||
-			memcmp(&new_tcp_hdr[TCP_SRC_PORT_OFFSET],
-			&old_tcp_hdr[TCP_SRC_PORT_OFFSET], TCP_PORT_LEN * 2))
-			continue;
-
 		old_tcpack_num = ntoh32_ua(&old_tcp_hdr[TCP_ACK_NUM_OFFSET]);
 
 		if (IS_TCPSEQ_GT(new_tcp_ack_num, old_tcpack_num)) {
@@ -902,25 +1134,32 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 		goto exit;
 	}
 
-	if (i == tcpack_sup_mod->tcpack_info_cnt && i < TCPACK_INFO_MAXNUM) {
-		/* No TCPACK packet with the same IP addr and TCP port is found
-		 * in tcp_ack_info_tbl. So add this packet to the table.
-		 */
-		DHD_TRACE(("%s %d: Add pkt 0x%p(ether_hdr 0x%p) to tbl[%d]\n",
-			__FUNCTION__, __LINE__, pkt, new_ether_hdr,
-			tcpack_sup_mod->tcpack_info_cnt));
+	/* No TCPACK packet with the same IP addr and TCP port is found
+	 * in tcp_ack_info_tbl. So add this packet to the table, giving up
+	 * on the least recently used stream if the table is full. The pkt
+	 * of that stream stays in txq, it just can not be replaced anymore.
+	 */
+	flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+	if (flow == NULL) {
+		flow = tcpack_flow_lru(&tcpack_sup_mod->tcpack_flows);
+		ASSERT(flow != NULL);
+		((tcpack_info_t *)flow)->pkt_in_q = NULL;
+		((tcpack_info_t *)flow)->pkt_ether_hdr = NULL;
+		tcpack_flow_free(&tcpack_sup_mod->tcpack_flows, flow);
+		tcpack_sup_mod->tcpack_flows.evicts++;
+		flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+	}
+	tcpack_info = (tcpack_info_t *)flow;
+
+	DHD_TRACE(("%s %d: Add pkt 0x%p(ether_hdr 0x%p) to tbl, ttl cnt %d\n",
+		__FUNCTION__, __LINE__, pkt, new_ether_hdr,
+		tcpack_sup_mod->tcpack_flows.cnt));
 
-		tcpack_info_tbl[tcpack_sup_mod->tcpack_info_cnt].pkt_in_q = pkt;
-		tcpack_info_tbl[tcpack_sup_mod->tcpack_info_cnt].pkt_ether_hdr = new_ether_hdr;
-		tcpack_sup_mod->tcpack_info_cnt++;
+	tcpack_info->pkt_in_q = pkt;
+	tcpack_info->pkt_ether_hdr = new_ether_hdr;
 #if defined(DEBUG_COUNTER) && defined(DHDTCPACK_SUP_DBG)
-		tack_tbl.cnt[1]++;
+	tack_tbl.cnt[1]++;
 #endif /* DEBUG_COUNTER && DHDTCPACK_SUP_DBG */
-	} else {
-		ASSERT(i == tcpack_sup_mod->tcpack_info_cnt);
-		DHD_TRACE(("%s %d: No empty tcp ack info tbl\n",
-			__FUNCTION__, __LINE__));
-	}
 	dhd_os_tcpackunlock(dhdp, flags);
 
 exit:
@@ -948,8 +1187,10 @@ dhd_tcpdata_info_get(dhd_pub_t *dhdp, void *pkt)
 	tcpack_sup_module_t *tcpack_sup_mod;
 	tcpdata_info_t *tcpdata_info = NULL;
 	tdata_psh_info_t *tdata_psh_info;
-
-	int i;
+	tcpack_flow_t *flow;
+	tcpack_flow_key_t key;
+	uint16 hidx;
+	uint32 now_in_ms;
 	bool ret = FALSE;
 	unsigned long flags;
 
@@ -1013,6 +1254,9 @@ dhd_tcpdata_info_get(dhd_pub_t *dhdp, void *pkt)
 		ntoh16_ua(&tcp_hdr[TCP_DEST_PORT_OFFSET]),
 		tcp_hdr[TCP_FLAGS_OFFSET]));
 
+	tcpack_flow_key_get(&key, ip_hdr, tcp_hdr);
+	hidx = tcpack_flow_hash(&key);
+
 	flags = dhd_os_tcpacklock(dhdp);
 	tcpack_sup_mod = dhdp->tcpack_sup_module;
 
@@ -1023,103 +1267,64 @@ dhd_tcpdata_info_get(dhd_pub_t *dhdp, void *pkt)
 		goto exit;
 	}
 
-	/* Look for tcpdata_info that has the same ip src/dst addrs and tcp src/dst ports */
-	i = 0;
-	while (i < tcpack_sup_mod->tcpdata_info_cnt) {
-		tcpdata_info_t *tdata_info_tmp = &tcpack_sup_mod->tcpdata_info_tbl[i];
-		uint32 now_in_ms = OSL_SYSUPTIME();
-		DHD_TRACE(("%s %d: data info[%d], IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
-			" TCP port %d %d\n", __FUNCTION__, __LINE__, i,
-			IPV4_ADDR_TO_STR(ntoh32_ua(tdata_info_tmp->ip_addr.src)),
-			IPV4_ADDR_TO_STR(ntoh32_ua(tdata_info_tmp->ip_addr.dst)),
-			ntoh16_ua(tdata_info_tmp->tcp_port.src),
-			ntoh16_ua(tdata_info_tmp->tcp_port.dst)));
-
-		/* If both IP address and TCP port number match, we found it so break.
-		 * Note that src/dst addr fields in ip header are contiguous being 8 bytes in total.
-		 * Also, src/dst port fields in TCP header are contiguous being 4 bytes in total.
-		 */
-		if (memcmp(&ip_hdr[IPV4_SRC_IP_OFFSET],
-			(void *)&tdata_info_tmp->ip_addr, IPV4_ADDR_LEN * 2) == 0 &&
-			memcmp(&tcp_hdr[TCP_SRC_PORT_OFFSET],
-			(void *)&tdata_info_tmp->tcp_port, TCP_PORT_LEN * 2) == 0) {
-			tcpdata_info = tdata_info_tmp;
-			tcpdata_info->last_used_time = now_in_ms;
+	/* Age out idle streams, the LRU list is in the order of last_used_time */
+	now_in_ms = OSL_SYSUPTIME();
+	while ((flow = tcpack_flow_lru(&tcpack_sup_mod->tcpdata_flows)) != NULL) {
+		tcpdata_info_t *tdata_info_tmp = (tcpdata_info_t *)flow;
+
+		if (now_in_ms - tdata_info_tmp->last_used_time <= TCPDATA_INFO_TIMEOUT) {
 			break;
 		}
-
-		if (now_in_ms - tdata_info_tmp->last_used_time > TCPDATA_INFO_TIMEOUT) {
-			tdata_psh_info_t *tdata_psh_info_tmp;
-			tcpdata_info_t *last_tdata_info;
-
-			while ((tdata_psh_info_tmp = tdata_info_tmp->tdata_psh_info_head)) {
-				tdata_info_tmp->tdata_psh_info_head = tdata_psh_info_tmp->next;
-				tdata_psh_info_tmp->next = NULL;
-				DHD_TRACE(("%s %d: Clean tdata_psh_info(end_seq %u)!\n",
-					__FUNCTION__, __LINE__, tdata_psh_info_tmp->end_seq));
-				_tdata_psh_info_pool_enq(tcpack_sup_mod, tdata_psh_info_tmp);
-			}
+		_tcpdata_info_psh_flush(tcpack_sup_mod, tdata_info_tmp);
 #ifdef DHDTCPACK_SUP_DBG
-			DHD_PRINT(("%s %d: PSH INFO ENQ %d\n",
-				__FUNCTION__, __LINE__, tcpack_sup_mod->psh_info_enq_num));
+		DHD_PRINT(("%s %d: PSH INFO ENQ %d\n",
+			__FUNCTION__, __LINE__, tcpack_sup_mod->psh_info_enq_num));
 #endif /* DHDTCPACK_SUP_DBG */
-			tcpack_sup_mod->tcpdata_info_cnt--;
-			ASSERT(tcpack_sup_mod->tcpdata_info_cnt >= 0);
-
-			last_tdata_info =
-				&tcpack_sup_mod->tcpdata_info_tbl[tcpack_sup_mod->tcpdata_info_cnt];
-			if (i < tcpack_sup_mod->tcpdata_info_cnt) {
-				ASSERT(last_tdata_info != tdata_info_tmp);
-				bcopy(last_tdata_info, tdata_info_tmp, sizeof(tcpdata_info_t));
-			}
-			bzero(last_tdata_info, sizeof(tcpdata_info_t));
-			DHD_INFO(("%s %d: tcpdata_info(idx %d) is aged out. ttl cnt is now %d\n",
-				__FUNCTION__, __LINE__, i, tcpack_sup_mod->tcpdata_info_cnt));
-			/* Don't increase "i" here, so that the prev last tcpdata_info is checked */
-		} else
-			 i++;
+		tcpack_flow_free(&tcpack_sup_mod->tcpdata_flows, flow);
+		DHD_INFO(("%s %d: tcpdata_info is aged out. ttl cnt is now %d\n",
+			__FUNCTION__, __LINE__, tcpack_sup_mod->tcpdata_flows.cnt));
 	}
 
-	tcp_seq_num = ntoh32_ua(&tcp_hdr[TCP_SEQ_NUM_OFFSET]);
-	tcp_data_len = ip_total_len - ip_hdr_len - tcp_hdr_len;
-	end_tcp_seq_num = tcp_seq_num + tcp_data_len;
-
-	if (tcpdata_info == NULL) {
-		ASSERT(i == tcpack_sup_mod->tcpdata_info_cnt);
-		if (i >= TCPDATA_INFO_MAXNUM) {
-			DHD_TRACE(("%s %d: tcp_data_info_tbl FULL! %d %d"
-				" IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR" TCP port %d %d\n",
-				__FUNCTION__, __LINE__, i, tcpack_sup_mod->tcpdata_info_cnt,
-				IPV4_ADDR_TO_STR(ntoh32_ua(&ip_hdr[IPV4_SRC_IP_OFFSET])),
-				IPV4_ADDR_TO_STR(ntoh32_ua(&ip_hdr[IPV4_DEST_IP_OFFSET])),
-				ntoh16_ua(&tcp_hdr[TCP_SRC_PORT_OFFSET]),
-				ntoh16_ua(&tcp_hdr[TCP_DEST_PORT_OFFSET])));
-			dhd_os_tcpackunlock(dhdp, flags);
-			goto exit;
+	/* Look for tcpdata_info that has the same ip src/dst addrs and tcp src/dst ports */
+	flow = tcpack_flow_find(&tcpack_sup_mod->tcpdata_flows, &key, hidx);
+	if (flow == NULL) {
+		flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpdata_flows, &key, hidx);
+		if (flow == NULL) {
+			/* Table is full, reuse the entry of the least recently used stream */
+			flow = tcpack_flow_lru(&tcpack_sup_mod->tcpdata_flows);
+			ASSERT(flow != NULL);
+			DHD_TRACE(("%s %d: tcp_data_info_tbl FULL! evict "
+				IPV4_ADDR_STR" "IPV4_ADDR_STR" TCP port %d %d\n",
+				__FUNCTION__, __LINE__,
+				IPV4_ADDR_TO_STR(ntoh32_ua(flow->key.ip_addr)),
+				IPV4_ADDR_TO_STR(ntoh32_ua(&flow->key.ip_addr[IPV4_ADDR_LEN])),
+				ntoh16_ua(flow->key.tcp_port),
+				ntoh16_ua(&flow->key.tcp_port[TCP_PORT_LEN])));
+			_tcpdata_info_psh_flush(tcpack_sup_mod, (tcpdata_info_t *)flow);
+			tcpack_flow_free(&tcpack_sup_mod->tcpdata_flows, flow);
+			tcpack_sup_mod->tcpdata_flows.evicts++;
+			flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpdata_flows, &key, hidx);
 		}
-		tcpdata_info = &tcpack_sup_mod->tcpdata_info_tbl[i];
 
 		/* No TCP flow with the same IP addr and TCP port is found
 		 * in tcp_data_info_tbl. So add this flow to the table.
 		 */
-		DHD_INFO(("%s %d: Add data info to tbl[%d]: IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
-			" TCP port %d %d\n",
-			__FUNCTION__, __LINE__, tcpack_sup_mod->tcpdata_info_cnt,
+		DHD_INFO(("%s %d: Add data info to tbl (cnt %d): IP addr "IPV4_ADDR_STR" "
+			IPV4_ADDR_STR" TCP port %d %d\n",
+			__FUNCTION__, __LINE__, tcpack_sup_mod->tcpdata_flows.cnt,
 			IPV4_ADDR_TO_STR(ntoh32_ua(&ip_hdr[IPV4_SRC_IP_OFFSET])),
 			IPV4_ADDR_TO_STR(ntoh32_ua(&ip_hdr[IPV4_DEST_IP_OFFSET])),
 			ntoh16_ua(&tcp_hdr[TCP_SRC_PORT_OFFSET]),
 			ntoh16_ua(&tcp_hdr[TCP_DEST_PORT_OFFSET])));
-		/* Note that src/dst addr fields in ip header are contiguous being 8 bytes in total.
-		 * Also, src/dst port fields in TCP header are contiguous being 4 bytes in total.
-		 */
-		bcopy(&ip_hdr[IPV4_SRC_IP_OFFSET], (void *)&tcpdata_info->ip_addr,
-			IPV4_ADDR_LEN * 2);
-		bcopy(&tcp_hdr[TCP_SRC_PORT_OFFSET], (void *)&tcpdata_info->tcp_port,
-			TCP_PORT_LEN * 2);
-
-		tcpdata_info->last_used_time = OSL_SYSUPTIME();
-		tcpack_sup_mod->tcpdata_info_cnt++;
+	} else {
+		tcpack_flow_touch(&tcpack_sup_mod->tcpdata_flows, flow);
 	}
+	tcpdata_info = (tcpdata_info_t *)flow;
+	tcpdata_info->last_used_time = now_in_ms;
+
+	tcp_seq_num = ntoh32_ua(&tcp_hdr[TCP_SEQ_NUM_OFFSET]);
+	tcp_data_len = ip_total_len - ip_hdr_len - tcp_hdr_len;
+	end_tcp_seq_num = tcp_seq_num + tcp_data_len;
 
 	ASSERT(tcpdata_info != NULL);
 
@@ -1173,8 +1378,12 @@ dhd_tcpack_hold(dhd_pub_t *dhdp, void *pkt, int ifidx)
 	uint16 new_ip_total_len;	/* Total length of IP packet for the new packet */
 	uint32 new_tcp_hdr_len;		/* TCP header length of the new packet */
 	tcpack_sup_module_t *tcpack_sup_mod;
-	tcpack_info_t *tcpack_info_tbl;
-	int i, free_slot = TCPACK_INFO_MAXNUM;
+	tcpack_info_t *tcpack_info;
+	tcpack_flow_t *flow;
+	tcpack_flow_key_t key;
+	uint16 hidx;
+	void *evict_pkt = NULL;	/* held pkt of the stream evicted to make room */
+	int evict_ifidx = 0;
 	bool hold = FALSE;
 	unsigned long flags;
 
@@ -1252,11 +1461,13 @@ dhd_tcpack_hold(dhd_pub_t *dhdp, void *pkt, int ifidx)
 		ntoh16_ua(&new_tcp_hdr[TCP_SRC_PORT_OFFSET]),
 		ntoh16_ua(&new_tcp_hdr[TCP_DEST_PORT_OFFSET])));
 
+	tcpack_flow_key_get(&key, new_ip_hdr, new_tcp_hdr);
+	hidx = tcpack_flow_hash(&key);
+
 	/* Look for tcp_ack_info that has the same ip src/dst addrs and tcp src/dst ports */
 	flags = dhd_os_tcpacklock(dhdp);
 
 	tcpack_sup_mod = dhdp->tcpack_sup_module;
-	tcpack_info_tbl = tcpack_sup_mod->tcpack_info_tbl;
 
 	if (!tcpack_sup_mod) {
 		DHD_ERROR(("%s %d: tcpack suppress module NULL!!\n", __FUNCTION__, __LINE__));
@@ -1266,105 +1477,105 @@ dhd_tcpack_hold(dhd_pub_t *dhdp, void *pkt, int ifidx)
 
 	hold = TRUE;
 
-	for (i = 0; i < TCPACK_INFO_MAXNUM; i++) {
+	flow = tcpack_flow_find(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+	if (flow) {
 		void *oldpkt;	/* TCPACK packet that is already in txq or DelayQ */
 		uint8 *old_ether_hdr, *old_ip_hdr, *old_tcp_hdr;
 		uint32 old_ip_hdr_len;
 		uint32 old_tcpack_num;	/* TCP ACK number of old TCPACK packet in Q */
 
-		if ((oldpkt = tcpack_info_tbl[i].pkt_in_q) == NULL) {
-			if (free_slot == TCPACK_INFO_MAXNUM) {
-				free_slot = i;
-			}
-			continue;
-		}
-
-		if (PKTDATA(dhdp->osh, oldpkt) == NULL) {
-			DHD_ERROR(("%s %d: oldpkt data NULL!! cur idx %d\n",
-				__FUNCTION__, __LINE__, i));
+		tcpack_info = (tcpack_info_t *)flow;
+		oldpkt = tcpack_info->pkt_in_q;
+		if (oldpkt == NULL || PKTDATA(dhdp->osh, oldpkt) == NULL) {
+			DHD_ERROR(("%s %d: oldpkt %p data NULL!!\n",
+				__FUNCTION__, __LINE__, oldpkt));
 			hold = FALSE;
 			dhd_os_tcpackunlock(dhdp, flags);
 			goto exit;
 		}
 
-		old_ether_hdr = tcpack_info_tbl[i].pkt_ether_hdr;
+		old_ether_hdr = tcpack_info->pkt_ether_hdr;
 		old_ip_hdr = old_ether_hdr + ETHER_HDR_LEN;
 		old_ip_hdr_len = IPV4_HLEN(old_ip_hdr);
 		old_tcp_hdr = old_ip_hdr + old_ip_hdr_len;
 
-		DHD_TRACE(("%s %d: oldpkt %p[%d], IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
-			" TCP port %d %d\n", __FUNCTION__, __LINE__, oldpkt, i,
+		DHD_TRACE(("%s %d: oldpkt %p, IP addr "IPV4_ADDR_STR" "IPV4_ADDR_STR
+			" TCP port %d %d\n", __FUNCTION__, __LINE__, oldpkt,
 			IPV4_ADDR_TO_STR(ntoh32_ua(&old_ip_hdr[IPV4_SRC_IP_OFFSET])),
 			IPV4_ADDR_TO_STR(ntoh32_ua(&old_ip_hdr[IPV4_DEST_IP_OFFSET])),
 			ntoh16_ua(&old_tcp_hdr[TCP_SRC_PORT_OFFSET]),
 			ntoh16_ua(&old_tcp_hdr[TCP_DEST_PORT_OFFSET])));
 
-		/* If either of IP address or TCP port number does not match, skip. */
-		if (memcmp(&new_ip_hdr[IPV4_SRC_IP_OFFSET],
-			&old_ip_hdr[IPV4_SRC_IP_OFFSET], IPV4_ADDR_LEN * 2) ||
-			memcmp(&new_tcp_hdr[TCP_SRC_PORT_OFFSET],
-			&old_tcp_hdr[TCP_SRC_PORT_OFFSET], TCP_PORT_LEN * 2)) {
-			continue;
-		}
-
 		old_tcpack_num = ntoh32_ua(&old_tcp_hdr[TCP_ACK_NUM_OFFSET]);
 
 		if (IS_TCPSEQ_GE(new_tcp_ack_num, old_tcpack_num)) {
-			tcpack_info_tbl[i].supp_cnt++;
-			if (tcpack_info_tbl[i].supp_cnt >= dhdp->tcpack_sup_ratio) {
-				tcpack_info_tbl[i].pkt_in_q = NULL;
-				tcpack_info_tbl[i].pkt_ether_hdr = NULL;
-				tcpack_info_tbl[i].ifidx = 0;
-				tcpack_info_tbl[i].supp_cnt = 0;
+			tcpack_info->supp_cnt++;
+			if (tcpack_info->supp_cnt >= dhdp->tcpack_sup_ratio) {
+				tcpack_info_release(tcpack_sup_mod, tcpack_info);
 				hold = FALSE;
 			} else {
-				tcpack_info_tbl[i].pkt_in_q = pkt;
-				tcpack_info_tbl[i].pkt_ether_hdr = new_ether_hdr;
-				tcpack_info_tbl[i].ifidx = ifidx;
+				tcpack_info->pkt_in_q = pkt;
+				tcpack_info->pkt_ether_hdr = new_ether_hdr;
+				tcpack_info->ifidx = ifidx;
+				tcpack_flow_touch(&tcpack_sup_mod->tcpack_flows, flow);
 			}
 			PKTFREE(dhdp->osh, oldpkt, TRUE);
 		} else {
 			PKTFREE(dhdp->osh, pkt, TRUE);
 		}
 		dhd_os_tcpackunlock(dhdp, flags);
+		goto exit;
+	}
 
-		if (!hold) {
-#ifndef TCPACK_SUPPRESS_HOLD_HRT
-			del_timer_sync(&tcpack_info_tbl[i].timer);
-#else
-			hrtimer_cancel(&tcpack_sup_mod->tcpack_info_tbl[i].timer.timer);
-#endif /* TCPACK_SUPPRESS_HOLD_HRT */
+	/* No TCPACK packet with the same IP addr and TCP port is found
+	 * in tcp_ack_info_tbl. So add this packet to the table. If the table
+	 * is full the least recently used stream gives up its entry and its
+	 * held pkt is sent right away. If that entry is still in use by its timer
+	 * callback, the new pkt is not held.
+	 */
+	flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+	if (flow == NULL) {
+		flow = tcpack_flow_lru(&tcpack_sup_mod->tcpack_flows);
+		if (flow) {
+			tcpack_info = (tcpack_info_t *)flow;
+			evict_pkt = tcpack_info->pkt_in_q;
+			evict_ifidx = tcpack_info->ifidx;
+			tcpack_info_release(tcpack_sup_mod, tcpack_info);
+			tcpack_sup_mod->tcpack_flows.evicts++;
+			flow = tcpack_flow_alloc(&tcpack_sup_mod->tcpack_flows, &key, hidx);
+		}
+		if (flow == NULL) {
+			hold = FALSE;
+			dhd_os_tcpackunlock(dhdp, flags);
+			goto send_evicted;
 		}
-		goto exit;
 	}
+	tcpack_info = (tcpack_info_t *)flow;
 
-	if (free_slot < TCPACK_INFO_MAXNUM) {
-		/* No TCPACK packet with the same IP addr and TCP port is found
-		 * in tcp_ack_info_tbl. So add this packet to the table.
-		 */
-		DHD_TRACE(("%s %d: Add pkt 0x%p(ether_hdr 0x%p) to tbl[%d]\n",
-			__FUNCTION__, __LINE__, pkt, new_ether_hdr,
-			free_slot));
-
-		tcpack_info_tbl[free_slot].pkt_in_q = pkt;
-		tcpack_info_tbl[free_slot].pkt_ether_hdr = new_ether_hdr;
-		tcpack_info_tbl[free_slot].ifidx = ifidx;
-		tcpack_info_tbl[free_slot].supp_cnt = 1;
+	DHD_TRACE(("%s %d: Add pkt 0x%p(ether_hdr 0x%p) to tbl, ttl cnt %d\n",
+		__FUNCTION__, __LINE__, pkt, new_ether_hdr,
+		tcpack_sup_mod->tcpack_flows.cnt));
+
+	tcpack_info->pkt_in_q = pkt;
+	tcpack_info->pkt_ether_hdr = new_ether_hdr;
+	tcpack_info->ifidx = ifidx;
+	tcpack_info->supp_cnt = 1;
+	tcpack_info->timer_armed = TRUE;
 #ifndef TCPACK_SUPPRESS_HOLD_HRT
-		mod_timer(&tcpack_sup_mod->tcpack_info_tbl[free_slot].timer,
-			jiffies + msecs_to_jiffies(dhdp->tcpack_sup_delay));
+	mod_timer(&tcpack_info->timer,
+		jiffies + msecs_to_jiffies(dhdp->tcpack_sup_delay));
 #else
-		tasklet_hrtimer_start(&tcpack_sup_mod->tcpack_info_tbl[free_slot].timer,
-			ktime_set(0, dhdp->tcpack_sup_delay*1000000),
-			HRTIMER_MODE_REL);
+	tasklet_hrtimer_start(&tcpack_info->timer,
+		ktime_set(0, dhdp->tcpack_sup_delay*1000000),
+		HRTIMER_MODE_REL);
 #endif /* TCPACK_SUPPRESS_HOLD_HRT */
-		tcpack_sup_mod->tcpack_info_cnt++;
-	} else {
-		DHD_TRACE(("%s %d: No empty tcp ack info tbl\n",
-			__FUNCTION__, __LINE__));
-	}
 	dhd_os_tcpackunlock(dhdp, flags);
 
+send_evicted:
+	if (evict_pkt) {
+		dhd_sendpkt(dhdp, evict_ifidx, evict_pkt);
+	}
+
 exit:
 	return hold;
 }
@@ -59,8 +59,14 @@ extern tcp_hdr_flag_t dhd_tcpdata_get_flag(dhd_pub_t *dhdp, void *pkt);
 #define	TCPACKSZMAX	(TCPACKSZMIN + 100)
 
 /* Max number of TCP streams that have own src/dst IP addrs and TCP ports */
-#define TCPACK_INFO_MAXNUM 4
-#define TCPDATA_INFO_MAXNUM 4
+#ifndef TCPACK_INFO_MAXNUM
+#define TCPACK_INFO_MAXNUM 128
+#endif /* TCPACK_INFO_MAXNUM */
+#ifndef TCPDATA_INFO_MAXNUM
+#define TCPDATA_INFO_MAXNUM 128
+#endif /* TCPDATA_INFO_MAXNUM */
+/* log2 of the number of hash buckets the TCP streams are looked up with */
+#define TCPACK_HASH_BITS 7
 #define TCPDATA_PSH_INFO_MAXNUM (8 * TCPDATA_INFO_MAXNUM)
 
 #define TCPDATA_INFO_TIMEOUT 5000	/* Remove tcpdata_info if inactive for this time (in ms) */
@@ -78,6 +84,7 @@ extern tcp_hdr_flag_t dhd_tcpdata_get_flag(dhd_pub_t *dhdp, void *pkt);
 extern int dhd_tcpack_suppress_set(dhd_pub_t *dhdp, uint8 on);
 extern void dhd_tcpack_info_tbl_clean(dhd_pub_t *dhdp);
 extern int dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt);
+extern void dhd_tcpack_suppress_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
 extern bool dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt);
 extern bool dhd_tcpdata_info_get(dhd_pub_t *dhdp, void *pkt);
 extern bool dhd_tcpack_hold(dhd_pub_t *dhdp, void *pkt, int ifidx);
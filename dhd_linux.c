@@ -747,6 +747,17 @@ extern uint rx_bufpost_threshold;
 module_param(rx_bufpost_threshold, uint, 0644);
 
 module_param(flowring_bkp_qsize, uint, 0644);
+#ifdef DHD_FLOWRING_BQL
+module_param(flow_bql_target_ms, uint, 0644);
+#endif /* DHD_FLOWRING_BQL */
+
+#ifdef DHD_LB_REBAL_SUPPORT
+module_param(dhd_lb_rebal_enable, uint, 0644);
+module_param(dhd_lb_rebal_period_ms, uint, 0644);
+module_param(dhd_lb_rebal_hyst_pct, uint, 0644);
+module_param(dhd_lb_rebal_busy_pct, uint, 0644);
+module_param(dhd_lb_rebal_lat_pct, uint, 0644);
+#endif /* DHD_LB_REBAL_SUPPORT */
 
 #ifdef AGG_H2D_DB
 extern bool agg_h2d_db_enab;
@@ -755,6 +766,10 @@ extern uint agg_h2d_db_timeout;
 module_param(agg_h2d_db_timeout, uint, 0644);
 extern uint agg_h2d_db_inflight_thresh;
 module_param(agg_h2d_db_inflight_thresh, uint, 0644);
+#ifdef AGG_H2D_DB_ADAPTIVE
+extern bool agg_h2d_db_adaptive;
+module_param(agg_h2d_db_adaptive, bool, 0644);
+#endif /* AGG_H2D_DB_ADAPTIVE */
 #endif /* AGG_H2D_DB */
 
 #ifdef DHD_AGGR_WI
@@ -762,9 +777,36 @@ extern uint aggr_wi_enab;
 module_param(aggr_wi_enab, uint, 0644);
 #endif /* DHD_AGGR_WI */
 
+#ifdef DHD_MSGBUF_EMU
+extern uint msgbuf_emu;
+module_param(msgbuf_emu, uint, 0644);
+extern uint msgbuf_emu_rx_pps;
+module_param(msgbuf_emu_rx_pps, uint, 0644);
+extern uint msgbuf_emu_rx_len;
+module_param(msgbuf_emu_rx_len, uint, 0644);
+#endif /* DHD_MSGBUF_EMU */
+
 extern uint dma_ring_indices;
 module_param(dma_ring_indices, uint, 0644);
 
+#if defined(DHD_FW_COREDUMP) && defined(DHD_MEMDUMP_STREAM)
+/* Stream the SoC RAM dump to the dump file in compressed chunks */
+extern uint memdump_stream;
+module_param(memdump_stream, uint, 0644);
+#endif /* DHD_FW_COREDUMP && DHD_MEMDUMP_STREAM */
+
+#ifdef DHD_FW_DNLD_FAST
+/* Read back and compare every firmware download block */
+extern uint fw_dnld_verify;
+module_param(fw_dnld_verify, uint, 0644);
+#endif /* DHD_FW_DNLD_FAST */
+
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+/* Bytes kept per logged packet, 0 keeps full packets */
+extern uint pktlog_snaplen;
+module_param(pktlog_snaplen, uint, 0644);
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
+
 extern bool h2d_phase;
 module_param(h2d_phase, bool, 0644);
 extern bool force_trap_bad_h2d_phase;
@@ -1561,6 +1603,12 @@ dhd_sta_free(dhd_pub_t * dhdp, dhd_sta_t * sta)
 		sta->peer_info = NULL;
 	}
 #endif /* WL_MLO */
+#ifdef DHD_STA_HASH
+	/* Readers may still walk through the node, only the chain pointer is kept */
+	if (!hlist_nulls_unhashed(&sta->hnode)) {
+		hlist_nulls_del_init_rcu(&sta->hnode);
+	}
+#endif /* DHD_STA_HASH */
 	id16_map_free(dhdp->staid_allocator, sta->idx);
 	DHD_CUMM_CTR_INIT(&sta->cumm_ctr);
 	sta->ifp = DHD_IF_NULL; /* dummy dhd_if object */
@@ -1746,6 +1794,40 @@ dhd_sta_pool_clear(dhd_pub_t *dhdp, int max_sta)
 	}
 }
 
+#ifdef DHD_STA_HASH
+/*
+ * Find STA with MAC address ea in an interface's STA hash index.
+ * Safe without sta_list_lock. dhd_sta_t objects live in the sta_pool and are
+ * never freed while the pool exists, but may be recycled to another bucket or
+ * interface under a reader. The nulls marker at the end of each chain detects
+ * this, in which case the lookup is restarted.
+ */
+static dhd_sta_t *
+BCMFASTPATH(dhd_sta_hash_find)(dhd_if_t *ifp, int ifidx, void *ea)
+{
+	dhd_sta_t *sta;
+	struct hlist_nulls_node *node;
+	uint32 bucket = DHD_STA_HASH(ea);
+
+	rcu_read_lock();
+begin:
+	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
+	hlist_nulls_for_each_entry_rcu(sta, node, &ifp->sta_hash[bucket], hnode) {
+		GCC_DIAGNOSTIC_POP();
+		if ((sta->ifp == ifp) && !memcmp(sta->ea.octet, ea, ETHER_ADDR_LEN)) {
+			rcu_read_unlock();
+			return sta;
+		}
+	}
+	if (get_nulls_value(node) != DHD_STA_HASH_NULLS(ifidx, bucket)) {
+		goto begin;
+	}
+	rcu_read_unlock();
+
+	return DHD_STA_NULL;
+}
+#endif /* DHD_STA_HASH */
+
 /*
  * Lockless variant of dhd_find_sta()
  * Find STA with MAC address ea in an interface's STA list.
@@ -1755,6 +1837,15 @@ __dhd_find_sta(dhd_if_t *ifp, void *pub, int ifidx, void *ea)
 {
 	dhd_sta_t *sta;
 
+#ifdef DHD_STA_HASH
+	sta = dhd_sta_hash_find(ifp, ifidx, ea);
+	if (sta != DHD_STA_NULL) {
+		DHD_INFO(("%s: Found STA " MACDBG "\n",
+			__FUNCTION__, MAC2STRDBG((char *)ea)));
+	}
+
+	return sta;
+#else
 	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
 	list_for_each_entry(sta, &ifp->sta_list, list) {
 		GCC_DIAGNOSTIC_POP();
@@ -1766,6 +1857,7 @@ __dhd_find_sta(dhd_if_t *ifp, void *pub, int ifidx, void *ea)
 	}
 
 	return DHD_STA_NULL;
+#endif /* DHD_STA_HASH */
 }
 
 /** Find STA with MAC address ea in an interface's STA list. */
@@ -1774,17 +1866,24 @@ dhd_find_sta(void *pub, int ifidx, void *ea)
 {
 	dhd_sta_t *sta;
 	dhd_if_t *ifp;
+#ifndef DHD_STA_HASH
 	unsigned long flags;
+#endif /* !DHD_STA_HASH */
 
 	ifp = dhd_get_ifp((dhd_pub_t *)pub, ifidx);
 	if (ifp == NULL)
 		return DHD_STA_NULL;
 
+#ifdef DHD_STA_HASH
+	/* Read side of the hash index is lockless */
+	sta = __dhd_find_sta(ifp, pub, ifidx, ea);
+#else
 	DHD_IF_STA_LIST_LOCK(&ifp->sta_list_lock, flags);
 
 	sta = __dhd_find_sta(ifp, pub, ifidx, ea);
 
 	DHD_IF_STA_LIST_UNLOCK(&ifp->sta_list_lock, flags);
+#endif /* DHD_STA_HASH */
 
 	return sta;
 }
@@ -1820,6 +1919,10 @@ __dhd_add_sta(dhd_if_t *ifp, void *pub, int ifidx, void *ea)
 	INIT_LIST_HEAD(&sta->list);
 
 	list_add_tail(&sta->list, &ifp->sta_list);
+#ifdef DHD_STA_HASH
+	/* Publish only after ea/ifp are set, for lockless readers */
+	hlist_nulls_add_head_rcu(&sta->hnode, &ifp->sta_hash[DHD_STA_HASH(ea)]);
+#endif /* DHD_STA_HASH */
 
 	DHD_PRINT(("%s: Adding  STA " MACDBG "\n",
 		__FUNCTION__, MAC2STRDBG((char *)ea)));
@@ -1930,6 +2033,14 @@ dhd_findadd_sta(void *pub, int ifidx, void *ea)
 	if (ifp == NULL)
 		return DHD_STA_NULL;
 
+#ifdef DHD_STA_HASH
+	/* Common case, STA already exists: no lock needed */
+	sta = __dhd_find_sta(ifp, pub, ifidx, ea);
+	if (sta) {
+		return sta;
+	}
+#endif /* DHD_STA_HASH */
+
 	DHD_IF_STA_LIST_LOCK(&ifp->sta_list_lock, flags);
 	sta = __dhd_find_sta(ifp, pub, ifidx, ea);
 
@@ -8006,6 +8117,16 @@ dhd_allocate_if(dhd_pub_t *dhdpub, int ifidx, const char *name,
 	/* Initialize STA info list */
 	INIT_LIST_HEAD(&ifp->sta_list);
 	DHD_IF_STA_LIST_LOCK_INIT(&ifp->sta_list_lock);
+#ifdef DHD_STA_HASH
+	{
+		uint32 bucket;
+
+		for (bucket = 0; bucket < DHD_STA_HASH_SZ; bucket++) {
+			INIT_HLIST_NULLS_HEAD(&ifp->sta_hash[bucket],
+				DHD_STA_HASH_NULLS(ifidx, bucket));
+		}
+	}
+#endif /* DHD_STA_HASH */
 #endif /* PCIE_FULL_DONGLE */
 
 #ifdef DHD_L2_FILTER
@@ -8231,6 +8352,9 @@ dhd_remove_if(dhd_pub_t *dhdpub, int ifidx, bool need_rtnl_lock)
 #ifdef DHD_WMF
 		dhd_wmf_cleanup(dhdpub, ifidx);
 #endif /* DHD_WMF */
+#ifdef DHD_XDP_SUPPORT
+		dhd_xdp_if_deinit(ifp);
+#endif /* DHD_XDP_SUPPORT */
 		DHD_CUMM_CTR_INIT(&ifp->cumm_ctr);
 
 		MFREE(dhdinfo->pub.osh, ifp, sizeof(*ifp));
@@ -8286,8 +8410,11 @@ static struct net_device_ops dhd_ops_pri = {
 	.ndo_set_multicast_list = dhd_set_multicast_list,
 #endif
 #ifdef DHD_MQ
-	.ndo_select_queue = dhd_select_queue
+	.ndo_select_queue = dhd_select_queue,
 #endif
+#ifdef DHD_XDP_SUPPORT
+	.ndo_bpf = dhd_xdp_bpf,
+#endif /* DHD_XDP_SUPPORT */
 };
 
 static struct net_device_ops dhd_ops_virt = {
@@ -8317,6 +8444,9 @@ static struct net_device_ops dhd_ops_virt = {
 #else
 	.ndo_set_multicast_list = dhd_set_multicast_list,
 #endif
+#ifdef DHD_XDP_SUPPORT
+	.ndo_bpf = dhd_xdp_bpf,
+#endif /* DHD_XDP_SUPPORT */
 };
 
 #if (defined(BCM_ROUTER_DHD) && defined(HNDCTF))
@@ -8344,6 +8474,15 @@ dhd_os_write_file_posn(void *fp, unsigned long *posn, void *buf,
 	if (!fp || !buf || buflen == 0)
 		return -1;
 
+#ifdef DHD_LOG_DUMP_ASYNC
+	if (dhd_log_dump_is_arena(fp)) {
+		if (dhd_log_dump_arena_write(fp, (uint32)wr_posn, buf, (uint32)buflen) != BCME_OK)
+			return -1;
+		*posn = wr_posn + buflen;
+		return 0;
+	}
+#endif /* DHD_LOG_DUMP_ASYNC */
+
 	if (dhd_vfs_write((struct file *)fp, buf, buflen, &wr_posn) < 0)
 		return -1;
 
@@ -9714,6 +9853,9 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 #endif /* DHD_LB_HOST_CTRL */
 	dhd_lb_set_default_cpus(dhd);
 	DHD_LB_STATS_INIT(&dhd->pub);
+#ifdef DHD_LB_REBAL_SUPPORT
+	spin_lock_init(&dhd->lb_cpu_lock);
+#endif /* DHD_LB_REBAL_SUPPORT */
 
 	/* Initialize the CPU Masks */
 	if (dhd_cpumasks_init(dhd) == 0) {
@@ -9723,6 +9865,11 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 		/* Register the call backs to CPU Hotplug sub-system */
 		dhd_register_cpuhp_callback(dhd);
 
+#ifdef DHD_LB_REBAL_SUPPORT
+		/* Re-select napi/tx cpus periodically from measured cpu load */
+		dhd_lb_rebal_init(dhd);
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 	} else {
 		/*
 		* We are unable to initialize CPU masks, so candidacy algorithm
@@ -9749,6 +9896,10 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	atomic_set(&dhd->lb_rxp_active, 1);
 #endif /* DHD_LB_RXP */
 
+#ifdef DHD_LB_REBAL_SUPPORT
+	dhd_lb_rebal_kick(dhd);
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 	/* Initialize the Load Balancing Tasklets and Napi object */
 #if defined(DHD_LB_RXP)
 	__skb_queue_head_init(&dhd->rx_pend_queue);
@@ -15043,6 +15194,10 @@ void dhd_detach(dhd_pub_t *dhdp)
 		__skb_queue_purge(&dhd->tx_pend_queue);
 #endif /* DHD_LB_TXP */
 
+#ifdef DHD_LB_REBAL_SUPPORT
+		dhd_lb_rebal_deinit(dhd);
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 		/* Unregister from CPU Hotplug framework */
 		dhd_unregister_cpuhp_callback(dhd);
 
@@ -18574,16 +18729,15 @@ dhd_get_memdump_filename(struct net_device *ndev, char *memdump_path, int len, c
 	}
 }
 
-int
-write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
+/* Compose the dump file path for 'fname' and return the mode to open it with */
+static uint32
+dhd_get_dump_file_path(dhd_pub_t *dhd, char *fname, char *memdump_path, int len)
 {
-	int ret = 0;
-	char memdump_path[DHD_MEMDUMP_PATH_STR_LEN];
 	char memdump_type[DHD_MEMDUMP_TYPE_STR_LEN];
 	uint32 file_mode;
 
 	/* Init file name */
-	bzero(memdump_path, DHD_MEMDUMP_PATH_STR_LEN);
+	bzero(memdump_path, len);
 	bzero(memdump_type, DHD_MEMDUMP_TYPE_STR_LEN);
 	dhd_convert_memdump_type_to_str(dhd->memdump_type, memdump_type,
 			DHD_MEMDUMP_TYPE_STR_LEN,
@@ -18593,7 +18747,7 @@ write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
 	get_debug_dump_time(dhd->debug_dump_time_str);
 #endif /* DHD_LOG_DUMP */
 
-	snprintf(memdump_path, sizeof(memdump_path), "%s%s_%s_" "%s",
+	snprintf(memdump_path, len, "%s%s_%s_" "%s",
 		DHD_COMMON_DUMP_PATH, fname, memdump_type,
 		dhd->debug_dump_time_str);
 
@@ -18616,7 +18770,7 @@ write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
 		/* Check if it is live Brix image having /installmedia, else use /data */
 		if (IS_ERR(fp) || (fp == NULL)) {
 			DHD_ERROR(("open file %s, try /data/\n", memdump_path));
-			snprintf(memdump_path, sizeof(memdump_path), "%s%s_%s_" "%s",
+			snprintf(memdump_path, len, "%s%s_%s_" "%s",
 				"/data/", fname, memdump_type,  dhd->debug_dump_time_str);
 		} else {
 			dhd_filp_close(fp, NULL);
@@ -18626,6 +18780,18 @@ write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
 	file_mode = O_CREAT | O_WRONLY;
 #endif /* CUSTOMER_HW4_DEBUG */
 
+	return file_mode;
+}
+
+int
+write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
+{
+	int ret = 0;
+	char memdump_path[DHD_MEMDUMP_PATH_STR_LEN];
+	uint32 file_mode;
+
+	file_mode = dhd_get_dump_file_path(dhd, fname, memdump_path, sizeof(memdump_path));
+
 	/* print SOCRAM dump file path */
 	DHD_PRINT(("%s: file_path = %s\n", __FUNCTION__, memdump_path));
 
@@ -18644,6 +18810,69 @@ write_dump_to_file(dhd_pub_t *dhd, uint8 *buf, int size, char *fname)
 
 	return ret;
 }
+
+#if defined(DHD_FW_COREDUMP) && defined(BCMPCIE) && defined(DHD_MEMDUMP_STREAM)
+typedef struct dhd_dump_file_sink {
+	struct file *fp;
+	loff_t pos;
+} dhd_dump_file_sink_t;
+
+static int
+dhd_dump_file_sink(void *ctx, uint8 *buf, uint32 len)
+{
+	dhd_dump_file_sink_t *sink = (dhd_dump_file_sink_t *)ctx;
+	int ret;
+
+	ret = dhd_vfs_write(sink->fp, buf, len, &sink->pos);
+	if (ret != (int)len) {
+		DHD_ERROR(("write file error, err = %d\n", ret));
+		return BCME_ERROR;
+	}
+
+	return BCME_OK;
+}
+
+/* Write the SoC RAM dump as it is read out of the dongle, see dhd_bus_mem_dump_stream */
+static int
+write_dump_stream_to_file(dhd_pub_t *dhd, char *fname)
+{
+	int ret = BCME_ERROR;
+	char memdump_path[DHD_MEMDUMP_PATH_STR_LEN];
+	uint32 file_mode;
+	dhd_dump_file_sink_t sink;
+	MM_SEGMENT_T fs;
+
+	file_mode = dhd_get_dump_file_path(dhd, fname, memdump_path, sizeof(memdump_path));
+	DHD_PRINT(("%s: file_path = %s\n", __FUNCTION__, memdump_path));
+
+	GETFS_AND_SETFS_TO_KERNEL_DS(fs);
+
+	sink.pos = 0;
+	sink.fp = dhd_filp_open(memdump_path, file_mode, 0664);
+	if (IS_ERR(sink.fp) || (sink.fp == NULL)) {
+		DHD_ERROR(("open file error, err = %ld\n", PTR_ERR(sink.fp)));
+		goto exit;
+	}
+
+	ret = dhd_bus_mem_dump_stream(dhd, dhd_dump_file_sink, &sink);
+	if (ret == BCME_OK && dhd_vfs_fsync(sink.fp, 0) < 0) {
+		DHD_ERROR(("sync file error\n"));
+		ret = BCME_ERROR;
+	}
+	dhd_filp_close(sink.fp, current->files);
+
+exit:
+	SETFS(fs);
+	DHD_LOG_ERROR(dhd->logger, memdump_path, sizeof(memdump_path));
+#ifdef DHD_DUMP_MNGR
+	if (ret == BCME_OK) {
+		dhd_dump_file_manage_enqueue(dhd, memdump_path, fname);
+	}
+#endif /* DHD_DUMP_MNGR */
+
+	return ret;
+}
+#endif /* DHD_FW_COREDUMP && BCMPCIE && DHD_MEMDUMP_STREAM */
 #endif /* DHD_DEBUG */
 
 int dhd_os_wake_lock_timeout(dhd_pub_t *pub)
@@ -20308,6 +20537,23 @@ dhd_mem_dump(void *handle, void *event_info, u8 event)
 		goto exit;
 	}
 
+#if defined(DHD_DUMP_FILE_WRITE_FROM_KERNEL) && defined(BCMPCIE) && \
+	defined(DHD_MEMDUMP_STREAM) && !defined(BCMQT_HW)
+	/* No buffered copy was taken, stream RAM to the file compressed. This has
+	 * to be done first, SSSR/FIS collection, a CTO link down and the minidump
+	 * below change or cut off the dongle RAM.
+	 */
+	if (dump->buf == NULL) {
+		if (write_dump_stream_to_file(&dhd->pub, "mem_dump_lz4")) {
+			DHD_ERROR(("%s: streaming SoC_RAM dump to the file failed\n",
+				__FUNCTION__));
+#ifdef DHD_DEBUG_UART
+			dhd->pub.memdump_success = FALSE;
+#endif	/* DHD_DEBUG_UART */
+		}
+	}
+#endif /* DHD_DUMP_FILE_WRITE_FROM_KERNEL && BCMPCIE && DHD_MEMDUMP_STREAM && !BCMQT_HW */
+
 #ifdef DHD_SSSR_DUMP
 	DHD_PRINT(("%s: sssr_enab=%d dhdp->sssr_inited=%d dhdp->collect_sssr=%d\n",
 		__FUNCTION__, sssr_enab, dhdp->sssr_inited, dhdp->collect_sssr));
@@ -20410,6 +20656,9 @@ dhd_mem_dump(void *handle, void *event_info, u8 event)
 	if (dhdp->memdump_enabled == DUMP_MEMONLY) {
 		DHD_ERROR(("%s: Force BUG_ON for memdump_enabled:%d\n",
 			__FUNCTION__, dhdp->memdump_enabled));
+#ifdef DHD_LOG_DUMP_ASYNC
+		dhd_log_dump_async_flush();
+#endif /* DHD_LOG_DUMP_ASYNC */
 		BUG_ON(1);
 	}
 
@@ -20551,6 +20800,10 @@ dhd_mem_dump(void *handle, void *event_info, u8 event)
 
 #ifndef BCMQT_HW
 	/* skip memdump for QT in dhd. user will collect through upload in chunks */
+#if defined(BCMPCIE) && defined(DHD_MEMDUMP_STREAM)
+	/* a streamed dump was already written on entry */
+	if (dump->buf != NULL)
+#endif /* BCMPCIE && DHD_MEMDUMP_STREAM */
 	if (write_dump_to_file(&dhd->pub, dump->buf, dump->bufsize, "mem_dump")) {
 		DHD_ERROR(("%s: writing SoC_RAM dump to the file failed\n", __FUNCTION__));
 #ifdef DHD_DEBUG_UART
@@ -20650,6 +20903,10 @@ dhd_mem_dump(void *handle, void *event_info, u8 event)
 #ifdef EWP_EDL
 		dhd_cancel_delayed_work_sync(&dhd->edl_dispatcher_work);
 #endif
+#ifdef DHD_LOG_DUMP_ASYNC
+		/* Wait till a debug_dump snapshot is written to the file */
+		dhd_log_dump_async_flush();
+#endif /* DHD_LOG_DUMP_ASYNC */
 		BUG_ON(1);
 	}
 
@@ -21500,6 +21757,16 @@ dhd_export_debug_data(void *mem_buf, void *fp, const void *user_buf, uint32 buf_
 	struct dhd_dbg_ring_buf *ring_buf;
 #endif /* DHD_DEBUGABILITY_DEBUG_DUMP */
 
+#ifdef DHD_LOG_DUMP_ASYNC
+	if (dhd_log_dump_is_arena(fp)) {
+		ret = dhd_log_dump_arena_write(fp, (uint32)(*(loff_t *)pos), mem_buf, buf_len);
+		if (ret == BCME_OK) {
+			(*(loff_t *)pos) += buf_len;
+		}
+		goto exit;
+	}
+#endif /* DHD_LOG_DUMP_ASYNC */
+
 	if (fp) {
 		ret = dhd_vfs_write(fp, mem_buf, buf_len, (loff_t *)pos);
 		if (ret < 0) {
@@ -22499,6 +22766,9 @@ dhd_debug_uart_exec(dhd_pub_t *dhdp, char *cmd)
 			if (dhdp->memdump_type != DUMP_TYPE_BY_SYSDUMP)
 #endif
 			{
+#ifdef DHD_LOG_DUMP_ASYNC
+				dhd_log_dump_async_flush();
+#endif /* DHD_LOG_DUMP_ASYNC */
 				BUG_ON(1);
 			}
 		}
@@ -55,8 +55,32 @@
 
 #ifdef PCIE_FULL_DONGLE
 #include <etd.h>
+#ifdef DHD_STA_HASH
+#include <linux/rculist_nulls.h>
+#endif /* DHD_STA_HASH */
 #endif /* PCIE_FULL_DONGLE */
 
+#if defined(DHD_RX_XDP) && (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0))
+/* Native XDP on the RX completion path, run before skb metadata is built */
+#define DHD_XDP_SUPPORT
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <net/xdp.h>
+#endif /* DHD_RX_XDP && LINUX_VERSION >= 5.11 */
+
+#if defined(DHD_LB) && defined(DHD_LB_REBALANCE) && \
+	(LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0))
+/* Load driven LB rebalancer, needs kcpustat accounted in ns */
+#define DHD_LB_REBAL_SUPPORT
+#endif /* DHD_LB && DHD_LB_REBALANCE && LINUX_VERSION >= 4.11 */
+
+#if defined(DHD_LB_RXP) && defined(DHD_NAPI_BUSY_POLL) && \
+	defined(CONFIG_NET_RX_BUSY_POLL) && (LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0))
+/* Sockets busy polling on the rx napi drain the rxcpl rings directly */
+#define DHD_BUSY_POLL_SUPPORT
+#include <net/busy_poll.h>
+#endif /* DHD_LB_RXP && DHD_NAPI_BUSY_POLL && CONFIG_NET_RX_BUSY_POLL */
+
 #ifdef WL_MONITOR
 #ifdef HOST_RADIOTAP_CONV
 #include <bcmwifi_monitor.h>
@@ -153,6 +177,21 @@ typedef struct bcmdhd_wifi_platdata {
 	wifi_adapter_info_t	*adapters;
 } bcmdhd_wifi_platdata_t;
 
+#ifdef DHD_STA_HASH
+/* Number of buckets in the per interface STA MAC hash, power of 2 */
+#ifndef DHD_STA_HASH_SZ
+#define DHD_STA_HASH_SZ		64u
+#endif /* DHD_STA_HASH_SZ */
+#define DHD_STA_HASH_SHIFT	8u
+/* Hash on the low octets of the MAC, the OUI octets carry little entropy */
+#define DHD_STA_HASH(ea) \
+	((((const uint8 *)(ea))[3] ^ ((const uint8 *)(ea))[4] ^ \
+	((const uint8 *)(ea))[5]) & (DHD_STA_HASH_SZ - 1u))
+/* Unique nulls marker per <ifidx, bucket> to detect a STA moved under a reader */
+#define DHD_STA_HASH_NULLS(ifidx, bucket) \
+	(((uint32)(ifidx) << DHD_STA_HASH_SHIFT) | (uint32)(bucket))
+#endif /* DHD_STA_HASH */
+
 /** Per STA params. A list of dhd_sta objects are managed in dhd_if */
 typedef struct dhd_sta {
 	cumm_ctr_t cumm_ctr;    /* cummulative queue length of child flowrings */
@@ -160,6 +199,9 @@ typedef struct dhd_sta {
 	void * ifp;             /* associated dhd_if */
 	struct ether_addr ea;   /* stations ethernet mac address */
 	struct list_head list;  /* link into dhd_if::sta_list */
+#ifdef DHD_STA_HASH
+	struct hlist_nulls_node hnode; /* link into dhd_if::sta_hash[] */
+#endif /* DHD_STA_HASH */
 	int idx;                /* index of self in dhd_pub::sta_pool[] */
 	int ifidx;              /* index of interface in dhd */
 #ifdef DHD_WMF
@@ -299,6 +341,18 @@ typedef struct dhd_if_event {
 } dhd_if_event_t;
 
 /* Interface control information */
+#ifdef DHD_XDP_SUPPORT
+typedef struct dhd_xdp_stats {
+	uint64 aborted;		/* XDP_ABORTED and unknown verdicts, dropped */
+	uint64 drop;		/* XDP_DROP */
+	uint64 pass;		/* XDP_PASS */
+	uint64 tx;		/* XDP_TX, sent back out on the same interface */
+	uint64 redirect;	/* XDP_REDIRECT */
+	uint64 redirect_err;	/* XDP_REDIRECT the kernel failed to deliver, dropped */
+	uint64 bypass;		/* non linear frames handed to the stack without a run */
+} dhd_xdp_stats_t;
+#endif /* DHD_XDP_SUPPORT */
+
 typedef struct dhd_if {
 	struct dhd_info *info;			/* back pointer to dhd_info */
 	/* OS/stack specifics */
@@ -323,6 +377,10 @@ typedef struct dhd_if {
 #ifdef PCIE_FULL_DONGLE
 	struct list_head sta_list;		/* sll of associated stations */
 	spinlock_t	sta_list_lock;		/* lock for manipulating sll */
+#ifdef DHD_STA_HASH
+	/* RCU index of sta_list keyed by MAC, updated under sta_list_lock */
+	struct hlist_nulls_head sta_hash[DHD_STA_HASH_SZ];
+#endif /* DHD_STA_HASH */
 #endif /* PCIE_FULL_DONGLE */
 	uint32  ap_isolate;			/* ap-isolation settings */
 #ifdef DHD_L2_FILTER
@@ -369,6 +427,11 @@ typedef struct dhd_if {
 #endif /* DHD_POST_EAPOL_M1_AFTER_ROAM_EVT */
 	uint64 rx_pkts;		/* per interface total rx pkts, can be cleared with iovar */
 	uint64 tx_pkts;		/* per interface total tx pkts, can be cleared with iovar */
+#ifdef DHD_XDP_SUPPORT
+	struct bpf_prog __rcu *xdp_prog;	/* attached through ndo_bpf, RCU read in DPC */
+	struct xdp_rxq_info xdp_rxq;		/* registered on first attach */
+	dhd_xdp_stats_t xdp_stats;
+#endif /* DHD_XDP_SUPPORT */
 } dhd_if_t;
 
 struct ipv6_work_info_t {
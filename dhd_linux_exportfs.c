@@ -29,6 +29,9 @@
 #include <dhd_dbg.h>
 #include <dhd_linux_priv.h>
 #include <dhd_proto.h>
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+#include <dhd_pktlog.h>
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
 #if defined(WL_BAM)
 #include <wl_bam.h>
 #endif	/* WL_BAM */
@@ -94,6 +97,26 @@ static const struct proc_ops dhd_buffer_proc_ops = {
 #endif /* LINUX_VERSION_CODE < KERNEL_VERSION(5, 6, 0) */
 #endif /* DHD_PCIE_WRAPPER_DUMP */
 
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+static int dhd_pktlog_proc_open(struct inode *inode, struct file *file);
+ssize_t dhd_pktlog_proc_read(struct file *file, char __user *usrbuf, size_t usrsz, loff_t *loff);
+static int dhd_pktlog_proc_release(struct inode *inode, struct file *file);
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 6, 0))
+static const struct file_operations dhd_pktlog_proc_ops = {
+	.open = dhd_pktlog_proc_open,
+	.read = dhd_pktlog_proc_read,
+	.release = dhd_pktlog_proc_release,
+};
+#else
+static const struct proc_ops dhd_pktlog_proc_ops = {
+	.proc_open = dhd_pktlog_proc_open,
+	.proc_read = dhd_pktlog_proc_read,
+	.proc_release = dhd_pktlog_proc_release,
+};
+#endif /* LINUX_VERSION_CODE < KERNEL_VERSION(5, 6, 0) */
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
+
 static int
 dhd_proc_open(struct inode *inode, struct file *file)
 {
@@ -236,6 +259,51 @@ dhd_buffer_proc_read(struct file *file, char __user *usrbuf, size_t usrsz, loff_
 }
 #endif /* DHD_PCIE_WRAPPER_DUMP */
 
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+/* The packet log is read once as a pcapng stream, logging resumes on close */
+static int
+dhd_pktlog_proc_open(struct inode *inode, struct file *file)
+{
+	dhd_pub_t *dhdp = NULL;
+
+	if (!inode) {
+		DHD_ERROR(("%s: inode is NULL\n", __FUNCTION__));
+		return -EINVAL;
+	}
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0))
+	dhdp = (dhd_pub_t *)pde_data(inode);
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0))
+	dhdp = (dhd_pub_t *)PDE_DATA(inode);
+#endif
+
+	file->private_data = dhd_pktlog_pcapng_open(dhdp);
+	return file->private_data ? 0 : -EBUSY;
+}
+
+ssize_t
+dhd_pktlog_proc_read(struct file *file, char __user *usrbuf, size_t usrsz, loff_t *loff)
+{
+	int ret;
+
+	ret = dhd_pktlog_pcapng_read(file->private_data, usrbuf,
+		(uint32)MIN(usrsz, (size_t)PKTLOG_DUMP_BUF_SIZE));
+	if (ret < 0) {
+		return -EFAULT;
+	}
+
+	*loff += ret;
+	return ret;
+}
+
+static int
+dhd_pktlog_proc_release(struct inode *inode, struct file *file)
+{
+	dhd_pktlog_pcapng_close(file->private_data);
+	file->private_data = NULL;
+	return 0;
+}
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
+
 void
 dhd_dbg_ring_proc_create(dhd_pub_t *dhdp)
 {
@@ -298,6 +366,16 @@ dhd_dbg_ring_proc_create(dhd_pub_t *dhdp)
 		DHD_INFO(("%s: Created /proc/dhd_wrapper_dump interface\n", __FUNCTION__));
 	}
 #endif /* DHD_PCIE_WRAPPER_DUMP */
+
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+	dhd->dhd_pktlog_proc = proc_create_data("dhd_pktlog", S_IRUSR, NULL,
+		&dhd_pktlog_proc_ops, dhdp);
+	if (!dhd->dhd_pktlog_proc) {
+		DHD_ERROR(("%s: Failed to create /proc/dhd_pktlog interface\n", __FUNCTION__));
+	} else {
+		DHD_INFO(("%s: Created /proc/dhd_pktlog interface\n", __FUNCTION__));
+	}
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
 	BCM_REFERENCE(dhd);
 }
 
@@ -334,6 +412,12 @@ dhd_dbg_ring_proc_destroy(dhd_pub_t *dhdp)
 		remove_proc_entry("dhd_wrapper_dump", NULL);
 	}
 #endif /* DHD_PCIE_WRAPPER_DUMP */
+
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+	if (dhd->dhd_pktlog_proc) {
+		remove_proc_entry("dhd_pktlog", NULL);
+	}
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
 	BCM_REFERENCE(dhd);
 }
 #endif /* SHOW_LOGTRACE */
@@ -1286,6 +1370,64 @@ set_tcm_test_mode(struct dhd_info *dev, const char *buf, size_t count)
 	return count;
 }
 
+#ifdef DHD_XDP_SUPPORT
+static ssize_t
+show_xdp_stats(struct dhd_info *dev, char *buf)
+{
+	dhd_info_t *dhd = (dhd_info_t *)dev;
+
+	return dhd_xdp_show_stats(dhd, buf, PAGE_SIZE);
+}
+
+static ssize_t
+clear_xdp_stats(struct dhd_info *dev, const char *buf, size_t count)
+{
+	unsigned long clear;
+	dhd_info_t *dhd = (dhd_info_t *)dev;
+
+	clear = bcm_strtoul(buf, NULL, 10);
+	if (clear != 0) {
+		return -EINVAL;
+	}
+
+	dhd_xdp_clear_stats(dhd);
+
+	return count;
+}
+#endif /* DHD_XDP_SUPPORT */
+
+#ifdef DHD_TXCPL_LAT_HIST
+static ssize_t
+show_txcpl_lat(struct dhd_info *dev, char *buf)
+{
+	struct bcmstrbuf strbuf;
+
+	if (!dev) {
+		DHD_ERROR(("%s: dhd is NULL\n", __FUNCTION__));
+		return 0;
+	}
+
+	bcm_binit(&strbuf, buf, PAGE_SIZE - 1);
+	dhd_txcpl_lat_dump(&dev->pub, &strbuf, FALSE);
+	return (ssize_t)strnlen(buf, PAGE_SIZE - 1);
+}
+
+static ssize_t
+clear_txcpl_lat(struct dhd_info *dev, const char *buf, size_t count)
+{
+	unsigned long clear;
+
+	clear = bcm_strtoul(buf, NULL, 10);
+	if (clear != 0) {
+		return -EINVAL;
+	}
+
+	dhd_txcpl_lat_clear(&dev->pub);
+
+	return count;
+}
+#endif /* DHD_TXCPL_LAT_HIST */
+
 /*
  * Generic Attribute Structure for DHD.
  * If we have to add a new sysfs entry under /sys/bcm-dhd/, we have
@@ -1315,6 +1457,16 @@ static struct dhd_attr dhd_attr_logdump_ecntr =
 static struct dhd_attr dhd_attr_ecounters =
 	__ATTR(ecounters, 0660, show_enable_ecounter, ecounter_onoff);
 
+#ifdef DHD_XDP_SUPPORT
+static struct dhd_attr dhd_attr_xdp_stats =
+	__ATTR(xdp_stats, 0660, show_xdp_stats, clear_xdp_stats);
+#endif /* DHD_XDP_SUPPORT */
+
+#ifdef DHD_TXCPL_LAT_HIST
+static struct dhd_attr dhd_attr_txcpl_lat =
+	__ATTR(txcpl_lat, 0660, show_txcpl_lat, clear_txcpl_lat);
+#endif /* DHD_TXCPL_LAT_HIST */
+
 #if defined(DHD_QOS_ON_SOCK_FLOW)
 static struct dhd_attr dhd_attr_sock_qos_onoff =
 	__ATTR(sock_qos_onoff, 0660, show_sock_qos_onoff, update_sock_qos_onoff);
@@ -2246,6 +2398,24 @@ set_max_rx_pkt_pool(struct dhd_info *dhd, const char *buf, size_t count)
 
 static struct dhd_attr dhd_attr_max_rx_pkt_pool=
 __ATTR(dhd_max_rx_pkt_pool, 0660, show_max_rx_pkt_pool, set_max_rx_pkt_pool);
+
+static ssize_t
+show_rx_pkt_pool_stats(struct dhd_info *dhd, char *buf)
+{
+	struct bcmstrbuf strbuf;
+
+	if (!dhd) {
+		DHD_ERROR(("%s: dhd is NULL\n", __FUNCTION__));
+		return 0;
+	}
+
+	bcm_binit(&strbuf, buf, PAGE_SIZE - 1);
+	dhd_rx_pktpool_dump(dhd, &strbuf);
+	return (ssize_t)strnlen(buf, PAGE_SIZE - 1);
+}
+
+static struct dhd_attr dhd_attr_rx_pkt_pool_stats =
+__ATTR(dhd_rx_pkt_pool_stats, 0440, show_rx_pkt_pool_stats, NULL);
 #endif /* RX_PKT_POOL */
 
 #ifdef PCIE_FULL_DONGLE
@@ -2910,6 +3080,12 @@ static struct attribute *default_file_attrs[] = {
 	&dhd_attr_logdump_ecntr.attr,
 #endif
 	&dhd_attr_ecounters.attr,
+#ifdef DHD_XDP_SUPPORT
+	&dhd_attr_xdp_stats.attr,
+#endif /* DHD_XDP_SUPPORT */
+#ifdef DHD_TXCPL_LAT_HIST
+	&dhd_attr_txcpl_lat.attr,
+#endif /* DHD_TXCPL_LAT_HIST */
 #ifdef DHD_QOS_ON_SOCK_FLOW
 	&dhd_attr_sock_qos_onoff.attr,
 	&dhd_attr_sock_qos_stats.attr,
@@ -2956,6 +3132,7 @@ static struct attribute *default_file_attrs[] = {
 #endif /* AGG_H2D_DB */
 #if defined(RX_PKT_POOL)
 	&dhd_attr_max_rx_pkt_pool.attr,
+	&dhd_attr_rx_pkt_pool_stats.attr,
 #endif /* RX_PKT_POOL */
 #ifdef DHD_AGGR_WI
 	&dhd_attr_wl_aggr_wi_enab.attr,
@@ -3073,6 +3250,11 @@ lbtxp_onoff(struct dhd_info *dev, const char *buf, size_t count)
 		return -EINVAL;
 	}
 	atomic_set(&dhd->lb_txp_active, onoff);
+#ifdef DHD_LB_REBAL_SUPPORT
+	if (onoff) {
+		dhd_lb_rebal_kick(dhd);
+	}
+#endif /* DHD_LB_REBAL_SUPPORT */
 
 	/* Since the scheme is changed clear the counters */
 	for (i = 0; i < NR_CPUS; i++) {
@@ -3114,6 +3296,11 @@ lbrxp_onoff(struct dhd_info *dev, const char *buf, size_t count)
 		return -EINVAL;
 	}
 	atomic_set(&dhd->lb_rxp_active, onoff);
+#ifdef DHD_LB_REBAL_SUPPORT
+	if (onoff) {
+		dhd_lb_rebal_kick(dhd);
+	}
+#endif /* DHD_LB_REBAL_SUPPORT */
 
 	return count;
 }
@@ -3443,6 +3630,44 @@ set_tx_cpu(struct dhd_info *dev, const char *buf, size_t count)
 static struct dhd_attr dhd_tx_cpu =
 __ATTR(tx_cpu, 0660, show_tx_cpu, set_tx_cpu);
 
+#ifdef DHD_LB_REBAL_SUPPORT
+static ssize_t
+show_lb_rebal(struct dhd_info *dev, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE - 1, "%u\n", dhd_lb_rebal_enable);
+}
+
+static ssize_t
+set_lb_rebal(struct dhd_info *dev, const char *buf, size_t count)
+{
+	dhd_lb_rebal_enable = (bcm_atoi(buf) > 0) ? TRUE : FALSE;
+	DHD_PRINT(("%s: dhd_lb_rebal_enable %u\n", __FUNCTION__, dhd_lb_rebal_enable));
+	return count;
+}
+
+static struct dhd_attr dhd_lb_rebal =
+__ATTR(lb_rebal, 0660, show_lb_rebal, set_lb_rebal);
+
+static ssize_t
+show_lb_rebal_log(struct dhd_info *dev, char *buf)
+{
+	return dhd_lb_rebal_log_show(dev, buf, PAGE_SIZE - 1);
+}
+
+/* Writing 0 clears the decision log and move counters */
+static ssize_t
+set_lb_rebal_log(struct dhd_info *dev, const char *buf, size_t count)
+{
+	if (bcm_atoi(buf) == 0) {
+		dhd_lb_rebal_log_clear(dev);
+	}
+	return count;
+}
+
+static struct dhd_attr dhd_lb_rebal_log =
+__ATTR(lb_rebal_log, 0660, show_lb_rebal_log, set_lb_rebal_log);
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 static struct attribute *debug_lb_attrs[] = {
 #if defined(DHD_LB_TXP)
 	&dhd_attr_lbtxp.attr,
@@ -3458,6 +3683,10 @@ static struct attribute *debug_lb_attrs[] = {
 	&dhd_cpumask_set0.attr,
 	&dhd_rx_cpu.attr,
 	&dhd_tx_cpu.attr,
+#ifdef DHD_LB_REBAL_SUPPORT
+	&dhd_lb_rebal.attr,
+	&dhd_lb_rebal_log.attr,
+#endif /* DHD_LB_REBAL_SUPPORT */
 	NULL
 };
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0))
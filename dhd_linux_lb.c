@@ -24,6 +24,10 @@
 
 #include <dhd_linux_priv.h>
 #include <dhd_plat.h>
+#ifdef DHD_LB_REBAL_SUPPORT
+#include <linux/kernel_stat.h>
+#include <linux/cpufreq.h>
+#endif /* DHD_LB_REBAL_SUPPORT */
 
 extern dhd_pub_t* g_dhd_pub;
 
@@ -186,7 +190,7 @@ dhd_select_napi_tx_cpus(cpumask_var_t cpumask_curr_avail, cpumask_var_t cpumask_
  * algo tries to pickup the first available non boot CPU (CPU0) for napi_cpu.
  *
  */
-void dhd_select_cpu_candidacy(dhd_info_t *dhd)
+static void __dhd_select_cpu_candidacy(dhd_info_t *dhd)
 {
 	uint32 set8_available_cpus; /* count of available cpus in 'bigger' set */
 	uint32 set4_available_cpus; /* count of available cpus in 'big' set */
@@ -304,12 +308,30 @@ void dhd_select_cpu_candidacy(dhd_info_t *dhd)
 		tx_cpu = 0;
 	}
 
+#ifdef DHD_LB_REBAL_SUPPORT
+	dhd_lb_rebal_keep_cpus(dhd, &napi_cpu, &tx_cpu);
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 	atomic_set(&dhd->rx_napi_cpu, napi_cpu);
 	atomic_set(&dhd->tx_cpu, tx_cpu);
 
 	return;
 }
 
+void dhd_select_cpu_candidacy(dhd_info_t *dhd)
+{
+#ifdef DHD_LB_REBAL_SUPPORT
+	unsigned long flags;
+
+	/* the rebalancer moves napi/tx cpus from its work */
+	spin_lock_irqsave(&dhd->lb_cpu_lock, flags);
+	__dhd_select_cpu_candidacy(dhd);
+	spin_unlock_irqrestore(&dhd->lb_cpu_lock, flags);
+#else
+	__dhd_select_cpu_candidacy(dhd);
+#endif /* DHD_LB_REBAL_SUPPORT */
+}
+
 /*
  * Function to handle CPU Hotplug notifications.
  * One of the task it does is to trigger the CPU Candidacy algorithm
@@ -432,6 +454,548 @@ int dhd_unregister_cpuhp_callback(dhd_info_t *dhd)
 	return ret;
 }
 
+#ifdef DHD_LB_REBAL_SUPPORT
+/*
+ * Load driven rebalancer.
+ *
+ * The candidacy algorithm above only looks at which CPUs are online. Every
+ * dhd_lb_rebal_period_ms the rebalancer samples the busy time of each CPU from
+ * kcpustat, scales the idle share by the CPU's max frequency, and moves the
+ * napi/tx job to the CPU with the most headroom when that beats the current
+ * CPU by dhd_lb_rebal_hyst_pct. A job whose CPU went offline or became the
+ * IRQ/DPC CPU is moved unconditionally, and when more than dhd_lb_rebal_lat_pct
+ * of NAPI polls waited over a millisecond the hysteresis is dropped. After a
+ * move a job stays put for DHD_LB_REBAL_DWELL periods to avoid ping-pong.
+ *
+ * The picks are kept across dhd_select_cpu_candidacy() runs for as long as
+ * they remain valid. Each move is recorded in a small log exported through
+ * the lb sysfs node.
+ */
+uint dhd_lb_rebal_enable = TRUE;
+uint dhd_lb_rebal_period_ms = 1000u;
+uint dhd_lb_rebal_hyst_pct = 25u;
+/* current cpu must be at least this busy before a load move is considered */
+uint dhd_lb_rebal_busy_pct = 50u;
+uint dhd_lb_rebal_lat_pct = 10u;
+
+#define DHD_LB_REBAL_LOG_SIZE		32u
+#define DHD_LB_REBAL_DWELL		3u
+#define DHD_LB_REBAL_MIN_PERIOD_MS	100u
+/* napi_latency row holding polls scheduled 1024us or more after dispatch */
+#define DHD_LB_REBAL_LAT_ROW		10u
+
+enum {
+	DHD_LB_REBAL_JOB_NAPI = 0,
+	DHD_LB_REBAL_JOB_TX = 1,
+	DHD_LB_REBAL_JOB_MAX = 2
+};
+
+enum {
+	DHD_LB_REBAL_LOAD = 0,		/* better headroom beyond hysteresis */
+	DHD_LB_REBAL_LATENCY = 1,	/* napi scheduling latency */
+	DHD_LB_REBAL_IRQ = 2,		/* job cpu is now the irq/dpc cpu */
+	DHD_LB_REBAL_OFFLINE = 3,	/* job cpu went offline */
+	DHD_LB_REBAL_NONE = 4
+};
+
+static const char *dhd_lb_rebal_job_str[DHD_LB_REBAL_JOB_MAX] = { "napi", "tx" };
+static const char *dhd_lb_rebal_reason_str[DHD_LB_REBAL_NONE] = {
+	"load", "latency", "irq", "offline"
+};
+
+typedef struct dhd_lb_rebal_log {
+	uint64 ts_us;
+	uint8 job;
+	uint8 reason;
+	uint16 lat_pct;
+	int16 from;
+	int16 to;
+	uint16 from_util;	/* permille busy over the last period */
+	uint16 to_util;
+	uint16 from_score;	/* headroom scaled by max cpu frequency */
+	uint16 to_score;
+} dhd_lb_rebal_log_t;
+
+struct dhd_lb_rebal {
+	int num_cpus;
+	uint64 last_ns;
+	uint64 *prev_busy;	/* per cpu busy ns at last sample */
+	uint16 *util;		/* per cpu busy permille over the last period */
+	uint32 *cap;		/* per cpu max frequency in kHz */
+	uint32 max_cap;
+	uint64 prev_lat_total;
+	uint64 prev_lat_high;
+	bool primed;
+	atomic_t pick[DHD_LB_REBAL_JOB_MAX];	/* -1 if no pick */
+	uint32 dwell[DHD_LB_REBAL_JOB_MAX];
+	uint32 moves[DHD_LB_REBAL_JOB_MAX];
+	spinlock_t log_lock;
+	uint32 log_idx;
+	uint32 log_cnt;
+	dhd_lb_rebal_log_t log[DHD_LB_REBAL_LOG_SIZE];
+};
+
+static uint64
+dhd_lb_rebal_cpu_busy(int cpu)
+{
+	u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+	return cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+		cpustat[CPUTIME_SYSTEM] + cpustat[CPUTIME_IRQ] +
+		cpustat[CPUTIME_SOFTIRQ] + cpustat[CPUTIME_STEAL];
+}
+
+static void
+dhd_lb_rebal_sample(struct dhd_lb_rebal *rebal)
+{
+	uint64 now = ktime_get_ns();
+	uint64 wall = now - rebal->last_ns;
+	uint64 busy, delta;
+	int cpu;
+
+	rebal->max_cap = 1u;
+	for_each_possible_cpu(cpu) {
+		if (cpu >= rebal->num_cpus) {
+			break;
+		}
+		busy = dhd_lb_rebal_cpu_busy(cpu);
+		delta = busy - rebal->prev_busy[cpu];
+		rebal->prev_busy[cpu] = busy;
+
+		if (!cpu_online(cpu) || !wall) {
+			rebal->util[cpu] = 1000u;
+		} else {
+			rebal->util[cpu] = (uint16)MIN(div64_u64(delta * 1000u, wall), 1000u);
+		}
+		rebal->cap[cpu] = cpufreq_quick_get_max(cpu);
+		rebal->max_cap = MAX(rebal->max_cap, rebal->cap[cpu]);
+	}
+	rebal->last_ns = now;
+}
+
+/* Idle permille of the cpu scaled by its max frequency relative to the fastest cpu */
+static uint32
+dhd_lb_rebal_score(struct dhd_lb_rebal *rebal, int cpu)
+{
+	uint32 cap;
+
+	if (cpu < 0 || cpu >= rebal->num_cpus || !cpu_online(cpu)) {
+		return 0;
+	}
+	/* no cpufreq: treat every cpu as equally fast */
+	cap = rebal->cap[cpu] ? rebal->cap[cpu] : rebal->max_cap;
+	return (uint32)div_u64((uint64)(1000u - rebal->util[cpu]) * cap, rebal->max_cap);
+}
+
+/* Percentage of NAPI polls in the last period that started a millisecond late or more */
+static uint32
+dhd_lb_rebal_napi_lat(dhd_info_t *dhd, struct dhd_lb_rebal *rebal)
+{
+	uint32 pct = 0;
+#if defined(DHD_LB_STATS) && defined(DHD_LB_RXP)
+	uint64 total = 0, high = 0, dtotal;
+	uint32 i;
+
+	if (!dhd->napi_latency) {
+		return 0;
+	}
+	for (i = 0; i < DHD_NUM_NAPI_LATENCY_ROWS; i++) {
+		total += dhd->napi_latency[i];
+		if (i >= DHD_LB_REBAL_LAT_ROW) {
+			high += dhd->napi_latency[i];
+		}
+	}
+	/* histogram may have been cleared through dhd_lb_stats_reset */
+	if (total < rebal->prev_lat_total || high < rebal->prev_lat_high) {
+		rebal->prev_lat_total = rebal->prev_lat_high = 0;
+	}
+	dtotal = total - rebal->prev_lat_total;
+	if (dtotal) {
+		pct = (uint32)div64_u64((high - rebal->prev_lat_high) * 100u, dtotal);
+	}
+	rebal->prev_lat_total = total;
+	rebal->prev_lat_high = high;
+#endif /* DHD_LB_STATS && DHD_LB_RXP */
+	return pct;
+}
+
+static bool
+dhd_lb_rebal_cpu_allowed(dhd_info_t *dhd, int cpu)
+{
+	if (!cpumask_test_cpu(cpu, dhd->cpumask_curr_avail)) {
+		return FALSE;
+	}
+	if (cpu == atomic_read(&dhd->dpc_cpu) || cpu == atomic_read(&dhd->net_tx_cpu)) {
+		return FALSE;
+	}
+#if defined(DHD_LB_HOST_CTRL)
+	if (!dhd->permitted_primary_cpu) {
+		return cpumask_test_cpu(cpu, dhd->cpumask_set0);
+	}
+#endif /* DHD_LB_HOST_CTRL */
+	if (cpumask_test_cpu(cpu, dhd->cpumask_set8)) {
+		return dhd_plat_pcie_enable_big_core();
+	}
+	return cpumask_test_cpu(cpu, dhd->cpumask_set4) ||
+		cpumask_test_cpu(cpu, dhd->cpumask_set0);
+}
+
+static void
+dhd_lb_rebal_log_add(struct dhd_lb_rebal *rebal, uint8 job, uint8 reason,
+	int from, int to, uint32 lat_pct)
+{
+	dhd_lb_rebal_log_t *ent;
+
+	spin_lock_bh(&rebal->log_lock);
+	ent = &rebal->log[rebal->log_idx];
+	ent->ts_us = OSL_SYSUPTIME_US();
+	ent->job = job;
+	ent->reason = reason;
+	ent->lat_pct = (uint16)lat_pct;
+	ent->from = (int16)from;
+	ent->to = (int16)to;
+	ent->from_util = (from >= 0 && from < rebal->num_cpus) ? rebal->util[from] : 0;
+	ent->to_util = rebal->util[to];
+	ent->from_score = (uint16)dhd_lb_rebal_score(rebal, from);
+	ent->to_score = (uint16)dhd_lb_rebal_score(rebal, to);
+	rebal->log_idx = (rebal->log_idx + 1u) % DHD_LB_REBAL_LOG_SIZE;
+	if (rebal->log_cnt < DHD_LB_REBAL_LOG_SIZE) {
+		rebal->log_cnt++;
+	}
+	spin_unlock_bh(&rebal->log_lock);
+}
+
+/* Moves the job to a better cpu, returns the reason or DHD_LB_REBAL_NONE */
+static uint8
+dhd_lb_rebal_pick(dhd_info_t *dhd, struct dhd_lb_rebal *rebal, uint8 job,
+	atomic_t *job_cpu, atomic_t *other_cpu, uint32 lat_pct, int *from, int *to)
+{
+	int cur = atomic_read(job_cpu);
+	int cpu, best = -1;
+	uint32 score, best_score = 0, cur_score;
+	uint8 reason = DHD_LB_REBAL_NONE;
+
+	if (cur >= rebal->num_cpus || !cpu_online(cur) ||
+		!cpumask_test_cpu(cur, dhd->cpumask_curr_avail)) {
+		reason = DHD_LB_REBAL_OFFLINE;
+	} else if (cur == atomic_read(&dhd->dpc_cpu)) {
+		reason = DHD_LB_REBAL_IRQ;
+	} else if (rebal->dwell[job]) {
+		rebal->dwell[job]--;
+		return DHD_LB_REBAL_NONE;
+	} else if (lat_pct >= dhd_lb_rebal_lat_pct) {
+		reason = DHD_LB_REBAL_LATENCY;
+	}
+
+	for_each_online_cpu(cpu) {
+		if (cpu >= rebal->num_cpus) {
+			break;
+		}
+		if (cpu == cur || cpu == atomic_read(other_cpu) || !dhd_lb_rebal_cpu_allowed(dhd, cpu)) {
+			continue;
+		}
+		score = dhd_lb_rebal_score(rebal, cpu);
+		if (best < 0 || score > best_score) {
+			best = cpu;
+			best_score = score;
+		}
+	}
+	if (best < 0) {
+		return DHD_LB_REBAL_NONE;
+	}
+
+	cur_score = dhd_lb_rebal_score(rebal, cur);
+	switch (reason) {
+		case DHD_LB_REBAL_NONE:
+			if (rebal->util[cur] < dhd_lb_rebal_busy_pct * 10u ||
+				best_score * 100u <= cur_score * (100u + dhd_lb_rebal_hyst_pct)) {
+				return DHD_LB_REBAL_NONE;
+			}
+			reason = DHD_LB_REBAL_LOAD;
+			break;
+		case DHD_LB_REBAL_LATENCY:
+			if (best_score <= cur_score) {
+				return DHD_LB_REBAL_NONE;
+			}
+			break;
+		default:
+			break;
+	}
+
+	atomic_set(&rebal->pick[job], best);
+	atomic_set(job_cpu, best);
+	rebal->dwell[job] = DHD_LB_REBAL_DWELL;
+	rebal->moves[job]++;
+	*from = cur;
+	*to = best;
+	return reason;
+}
+
+static void
+dhd_lb_rebal_job(dhd_info_t *dhd, struct dhd_lb_rebal *rebal, uint8 job,
+	atomic_t *job_cpu, atomic_t *other_cpu, uint32 lat_pct)
+{
+	unsigned long flags;
+	int from = -1, to = -1;
+	uint8 reason;
+
+	/* same lock as dhd_select_cpu_candidacy(), which the hotplug callbacks run */
+	spin_lock_irqsave(&dhd->lb_cpu_lock, flags);
+	reason = dhd_lb_rebal_pick(dhd, rebal, job, job_cpu, other_cpu, lat_pct, &from, &to);
+	spin_unlock_irqrestore(&dhd->lb_cpu_lock, flags);
+
+	if (reason == DHD_LB_REBAL_NONE) {
+		return;
+	}
+	dhd_lb_rebal_log_add(rebal, job, reason, from, to, lat_pct);
+	DHD_INFO(("%s: %s cpu %d -> %d (%s) lat %u%%\n", __FUNCTION__,
+		dhd_lb_rebal_job_str[job], from, to, dhd_lb_rebal_reason_str[reason], lat_pct));
+}
+
+static bool
+dhd_lb_rebal_lb_active(dhd_info_t *dhd)
+{
+#if defined(DHD_LB_RXP)
+	if (atomic_read(&dhd->lb_rxp_active)) {
+		return TRUE;
+	}
+#endif /* DHD_LB_RXP */
+#if defined(DHD_LB_TXP)
+	if (atomic_read(&dhd->lb_txp_active)) {
+		return TRUE;
+	}
+#endif /* DHD_LB_TXP */
+	return FALSE;
+}
+
+/* Deferrable, so an idle system is not woken up just to sample cpu load */
+static void
+dhd_lb_rebal_arm(dhd_info_t *dhd)
+{
+	queue_delayed_work(system_power_efficient_wq, &dhd->lb_rebal_work,
+		msecs_to_jiffies(MAX(dhd_lb_rebal_period_ms, DHD_LB_REBAL_MIN_PERIOD_MS)));
+}
+
+static void
+dhd_lb_rebal_work(struct work_struct *work)
+{
+	struct delayed_work *dw = to_delayed_work(work);
+	dhd_info_t *dhd;
+	struct dhd_lb_rebal *rebal;
+	uint32 lat_pct;
+
+	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
+	dhd = container_of(dw, dhd_info_t, lb_rebal_work);
+	GCC_DIAGNOSTIC_POP();
+
+	rebal = dhd->lb_rebal;
+	if (!(dhd->dhd_state & DHD_ATTACH_STATE_LB_ATTACH_DONE)) {
+		/* kicked from attach before it completed */
+		dhd_lb_rebal_arm(dhd);
+		return;
+	}
+
+	dhd_lb_rebal_sample(rebal);
+	lat_pct = dhd_lb_rebal_napi_lat(dhd, rebal);
+
+	if (!dhd_lb_rebal_enable || dhd->dhd_lb_candidacy_override) {
+		/* hand selection back to the candidacy algorithm / sysfs */
+		atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_NAPI], -1);
+		atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_TX], -1);
+	} else if (rebal->primed) {
+#if defined(DHD_LB_RXP)
+		if (atomic_read(&dhd->lb_rxp_active)) {
+			dhd_lb_rebal_job(dhd, rebal, DHD_LB_REBAL_JOB_NAPI, &dhd->rx_napi_cpu,
+				&dhd->tx_cpu, lat_pct);
+		}
+#endif /* DHD_LB_RXP */
+#if defined(DHD_LB_TXP)
+		if (atomic_read(&dhd->lb_txp_active)) {
+			dhd_lb_rebal_job(dhd, rebal, DHD_LB_REBAL_JOB_TX, &dhd->tx_cpu,
+				&dhd->rx_napi_cpu, 0);
+		}
+#endif /* DHD_LB_TXP */
+	}
+	rebal->primed = TRUE;
+
+	if (dhd_lb_rebal_lb_active(dhd)) {
+		dhd_lb_rebal_arm(dhd);
+	} else {
+		/* idle until dhd_lb_rebal_kick(), restart the busy time samples */
+		rebal->primed = FALSE;
+	}
+}
+
+/* Re-arms the rebalancer once rx or tx load balancing is turned on */
+void
+dhd_lb_rebal_kick(dhd_info_t *dhd)
+{
+	if (dhd->lb_rebal && dhd_lb_rebal_lb_active(dhd)) {
+		dhd_lb_rebal_arm(dhd);
+	}
+}
+
+/*
+ * Called at the end of dhd_select_cpu_candidacy(): keep the rebalancer's picks
+ * as long as they are still eligible, otherwise drop them so the static choice
+ * stands until the next period.
+ */
+void
+dhd_lb_rebal_keep_cpus(dhd_info_t *dhd, uint32 *napi_cpu, uint32 *tx_cpu)
+{
+	struct dhd_lb_rebal *rebal = dhd->lb_rebal;
+	uint32 *job_cpu[DHD_LB_REBAL_JOB_MAX] = { napi_cpu, tx_cpu };
+	uint32 napi_static = *napi_cpu, tx_static = *tx_cpu;
+	int job, pick;
+
+	if (!rebal || !dhd_lb_rebal_enable || dhd->dhd_lb_candidacy_override) {
+		return;
+	}
+	for (job = 0; job < DHD_LB_REBAL_JOB_MAX; job++) {
+		pick = atomic_read(&rebal->pick[job]);
+		if (pick < 0) {
+			continue;
+		}
+		if (cpu_online(pick) && dhd_lb_rebal_cpu_allowed(dhd, pick)) {
+			*job_cpu[job] = (uint32)pick;
+		} else {
+			atomic_set(&rebal->pick[job], -1);
+		}
+	}
+#if defined(DHD_LB_TXP)
+	/* a surviving pick must not land on the other job's static cpu */
+	if (atomic_read(&dhd->lb_txp_active) && *napi_cpu == *tx_cpu &&
+		napi_static != tx_static) {
+		atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_NAPI], -1);
+		atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_TX], -1);
+		*napi_cpu = napi_static;
+		*tx_cpu = tx_static;
+	}
+#else
+	BCM_REFERENCE(napi_static);
+	BCM_REFERENCE(tx_static);
+#endif /* DHD_LB_TXP */
+}
+
+ssize_t
+dhd_lb_rebal_log_show(dhd_info_t *dhd, char *buf, size_t len)
+{
+	struct dhd_lb_rebal *rebal = dhd->lb_rebal;
+	dhd_lb_rebal_log_t *ent;
+	ssize_t ret = 0;
+	uint32 i, idx;
+	int cpu;
+
+	if (!rebal) {
+		return scnprintf(buf, len, "rebalancer not running\n");
+	}
+
+	ret += scnprintf(buf + ret, len - ret,
+		"enable %u period %ums hyst %u%% busy %u%% lat %u%% moves napi %u tx %u\n",
+		dhd_lb_rebal_enable, dhd_lb_rebal_period_ms, dhd_lb_rebal_hyst_pct,
+		dhd_lb_rebal_busy_pct, dhd_lb_rebal_lat_pct,
+		rebal->moves[DHD_LB_REBAL_JOB_NAPI], rebal->moves[DHD_LB_REBAL_JOB_TX]);
+	ret += scnprintf(buf + ret, len - ret, "napi_cpu %d tx_cpu %d dpc_cpu %d util(permille):",
+		atomic_read(&dhd->rx_napi_cpu), atomic_read(&dhd->tx_cpu),
+		atomic_read(&dhd->dpc_cpu));
+	for (cpu = 0; cpu < rebal->num_cpus; cpu++) {
+		ret += scnprintf(buf + ret, len - ret, " %u", rebal->util[cpu]);
+	}
+	ret += scnprintf(buf + ret, len - ret,
+		"\n%-14s %-5s %-8s %-9s %-11s %-11s %s\n", "time_us", "job", "reason",
+		"cpu", "util", "score", "lat%");
+
+	spin_lock_bh(&rebal->log_lock);
+	for (i = 0; i < rebal->log_cnt; i++) {
+		idx = (rebal->log_idx + DHD_LB_REBAL_LOG_SIZE - rebal->log_cnt + i) %
+			DHD_LB_REBAL_LOG_SIZE;
+		ent = &rebal->log[idx];
+		ret += scnprintf(buf + ret, len - ret,
+			"%-14llu %-5s %-8s %3d->%-4d %4u->%-5u %4u->%-5u %u\n",
+			ent->ts_us, dhd_lb_rebal_job_str[ent->job],
+			dhd_lb_rebal_reason_str[ent->reason], ent->from, ent->to,
+			ent->from_util, ent->to_util, ent->from_score, ent->to_score,
+			ent->lat_pct);
+	}
+	spin_unlock_bh(&rebal->log_lock);
+
+	return ret;
+}
+
+void
+dhd_lb_rebal_log_clear(dhd_info_t *dhd)
+{
+	struct dhd_lb_rebal *rebal = dhd->lb_rebal;
+
+	if (!rebal) {
+		return;
+	}
+	spin_lock_bh(&rebal->log_lock);
+	rebal->log_idx = rebal->log_cnt = 0;
+	rebal->moves[DHD_LB_REBAL_JOB_NAPI] = rebal->moves[DHD_LB_REBAL_JOB_TX] = 0;
+	spin_unlock_bh(&rebal->log_lock);
+}
+
+void
+dhd_lb_rebal_init(dhd_info_t *dhd)
+{
+	struct dhd_lb_rebal *rebal;
+	int num_cpus = nr_cpu_ids;
+
+	rebal = (struct dhd_lb_rebal *)MALLOCZ(dhd->pub.osh, sizeof(*rebal));
+	if (!rebal) {
+		DHD_ERROR(("%s(): rebal malloc failed\n", __FUNCTION__));
+		return;
+	}
+	rebal->num_cpus = num_cpus;
+	rebal->prev_busy = (uint64 *)MALLOCZ(dhd->pub.osh, sizeof(uint64) * num_cpus);
+	rebal->util = (uint16 *)MALLOCZ(dhd->pub.osh, sizeof(uint16) * num_cpus);
+	rebal->cap = (uint32 *)MALLOCZ(dhd->pub.osh, sizeof(uint32) * num_cpus);
+	if (!rebal->prev_busy || !rebal->util || !rebal->cap) {
+		DHD_ERROR(("%s(): per cpu malloc failed\n", __FUNCTION__));
+		dhd->lb_rebal = rebal;
+		dhd_lb_rebal_deinit(dhd);
+		return;
+	}
+	atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_NAPI], -1);
+	atomic_set(&rebal->pick[DHD_LB_REBAL_JOB_TX], -1);
+	spin_lock_init(&rebal->log_lock);
+	rebal->last_ns = ktime_get_ns();
+
+	dhd->lb_rebal = rebal;
+	/* armed by dhd_lb_rebal_kick() once rx/tx load balancing is active */
+	INIT_DEFERRABLE_WORK(&dhd->lb_rebal_work, dhd_lb_rebal_work);
+}
+
+void
+dhd_lb_rebal_deinit(dhd_info_t *dhd)
+{
+	struct dhd_lb_rebal *rebal = dhd->lb_rebal;
+	int num_cpus;
+
+	if (!rebal) {
+		return;
+	}
+	if (rebal->prev_busy && rebal->util && rebal->cap) {
+		/* work is only initialised once every allocation succeeded */
+		cancel_delayed_work_sync(&dhd->lb_rebal_work);
+	}
+	dhd->lb_rebal = NULL;
+
+	num_cpus = rebal->num_cpus;
+	if (rebal->prev_busy) {
+		MFREE(dhd->pub.osh, rebal->prev_busy, sizeof(uint64) * num_cpus);
+	}
+	if (rebal->util) {
+		MFREE(dhd->pub.osh, rebal->util, sizeof(uint16) * num_cpus);
+	}
+	if (rebal->cap) {
+		MFREE(dhd->pub.osh, rebal->cap, sizeof(uint32) * num_cpus);
+	}
+	MFREE(dhd->pub.osh, rebal, sizeof(*rebal));
+}
+#endif /* DHD_LB_REBAL_SUPPORT */
+
 #if defined(DHD_LB_STATS)
 void dhd_lb_stats_reset(dhd_pub_t *dhdp)
 {
@@ -498,11 +1062,23 @@ void dhd_lb_stats_reset(dhd_pub_t *dhdp)
 		}
 	}
 
+	for (j = 0; j < HIST_BIN_SIZE; j++) {
+		if (!dhd->rx_list_hist[j]) {
+			continue;
+		}
+		for (i = 0; i < num_cpus; i++) {
+			DHD_LB_STATS_CLR(dhd->rx_list_hist[j][i]);
+		}
+	}
+
 	dhd->pub.lb_rxp_strt_thr_hitcnt = 0;
 	dhd->pub.lb_rxp_stop_thr_hitcnt = 0;
 
 	dhd->pub.lb_rxp_napi_sched_cnt = 0;
 	dhd->pub.lb_rxp_napi_complete_cnt = 0;
+#ifdef DHD_NAPI_BUSY_POLL
+	dhd->pub.lb_rxp_busy_poll_cnt = 0;
+#endif /* DHD_NAPI_BUSY_POLL */
 	dhd->pub.lb_rxp_emerge_enqueue_err = 0;
 	return;
 }
@@ -610,11 +1186,26 @@ void dhd_lb_stats_init(dhd_pub_t *dhdp)
 		}
 	}
 
+	for (j = 0; j < HIST_BIN_SIZE; j++) {
+		dhd->rx_list_hist[j] = (uint32 *)MALLOC(dhdp->osh, alloc_size);
+		if (!dhd->rx_list_hist[j]) {
+			DHD_ERROR(("%s(): dhd->rx_list_hist[%d] malloc failed \n",
+				__FUNCTION__, j));
+			return;
+		}
+		for (i = 0; i < num_cpus; i++) {
+			DHD_LB_STATS_CLR(dhd->rx_list_hist[j][i]);
+		}
+	}
+
 	dhd->pub.lb_rxp_strt_thr_hitcnt = 0;
 	dhd->pub.lb_rxp_stop_thr_hitcnt = 0;
 
 	dhd->pub.lb_rxp_napi_sched_cnt = 0;
 	dhd->pub.lb_rxp_napi_complete_cnt = 0;
+#ifdef DHD_NAPI_BUSY_POLL
+	dhd->pub.lb_rxp_busy_poll_cnt = 0;
+#endif /* DHD_NAPI_BUSY_POLL */
 	return;
 }
 
@@ -669,6 +1260,12 @@ void dhd_lb_stats_deinit(dhd_pub_t *dhdp)
 		}
 	}
 
+	for (j = 0; j < HIST_BIN_SIZE; j++) {
+		if (dhd->rx_list_hist[j]) {
+			MFREE(dhdp->osh, dhd->rx_list_hist[j], alloc_size);
+		}
+	}
+
 	return;
 }
 
@@ -834,6 +1431,12 @@ void dhd_lb_stats_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	dhd_lb_stats_dump_cpu_array(strbuf, dhd->napi_percpu_run_cnt);
 	bcm_bprintf(strbuf, "\nNAPI Packets Received Histogram:\n");
 	dhd_lb_stats_dump_histo(dhdp, strbuf, dhd->napi_rx_hist);
+#ifdef DHD_LB_RXP_LIST_RCV
+	if (dhd->rx_list_hist[HIST_BIN_SIZE - 1]) {
+		bcm_bprintf(strbuf, "\nNAPI List Receive Batch Histogram:\n");
+		dhd_lb_stats_dump_histo(dhdp, strbuf, dhd->rx_list_hist);
+	}
+#endif /* DHD_LB_RXP_LIST_RCV */
 	bcm_bprintf(strbuf, "\nNAPI poll latency stats ie from napi schedule to napi execution\n");
 	dhd_lb_stats_dump_napi_latency(dhdp, strbuf, dhd->napi_latency);
 
@@ -844,6 +1447,9 @@ void dhd_lb_stats_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhdp->rx_dma_stall_hc_ignore_cnt);
 	bcm_bprintf(strbuf, "\nlb_rxp_napi_sched_cnt: %llu lb_rxp_napi_omplete_cnt: %llu\n",
 		dhdp->lb_rxp_napi_sched_cnt, dhdp->lb_rxp_napi_complete_cnt);
+#ifdef DHD_NAPI_BUSY_POLL
+	bcm_bprintf(strbuf, "lb_rxp_busy_poll_cnt: %llu\n", dhdp->lb_rxp_busy_poll_cnt);
+#endif /* DHD_NAPI_BUSY_POLL */
 #endif /* DHD_LB_RXP */
 
 #ifdef DHD_LB_TXP
@@ -922,6 +1528,22 @@ void dhd_lb_stats_update_napi_histo(dhd_pub_t *dhdp, uint32 count)
 	return;
 }
 
+void dhd_lb_stats_update_rx_list_histo(dhd_pub_t *dhdp, uint32 count)
+{
+	int cpu;
+	dhd_info_t *dhd = dhdp->info;
+
+	if (!dhd->rx_list_hist[HIST_BIN_SIZE - 1]) {
+		return;
+	}
+
+	cpu = get_cpu();
+	put_cpu();
+	dhd_lb_stats_update_histo(dhd->rx_list_hist, count, cpu);
+
+	return;
+}
+
 void dhd_lb_stats_update_txc_histo(dhd_pub_t *dhdp, uint32 count)
 {
 	int cpu;
@@ -1082,9 +1704,12 @@ int
 dhd_napi_poll(struct napi_struct *napi, int budget)
 {
 	int ifid;
-	const int pkt_count = 1;
+	int pkt_count = 1;
 	const int chan = 0;
 	struct sk_buff * skb;
+#ifdef DHD_LB_RXP_LIST_RCV
+	struct sk_buff *skb_head, *skb_next;
+#endif /* DHD_LB_RXP_LIST_RCV */
 	unsigned long flags;
 	struct dhd_info *dhd;
 	int processed = 0;
@@ -1092,15 +1717,37 @@ dhd_napi_poll(struct napi_struct *napi, int budget)
 #ifdef DHD_LB_STATS
 	uint32 napi_latency;
 #endif /* DHD_LB_STATS */
+	bool busy_poll = FALSE;
 
 	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
 	dhd = container_of(napi, struct dhd_info, rx_napi_struct);
 	GCC_DIAGNOSTIC_POP();
 
+#ifdef DHD_BUSY_POLL_SUPPORT
+	/*
+	 * A socket is spinning on this napi_id: pull completions straight off
+	 * the rxcpl rings instead of waiting for the interrupt and DPC. They are
+	 * dispatched into rx_napi_queue and handled below.
+	 */
+	if (test_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state)) {
+		busy_poll = TRUE;
+#ifdef DHD_LB_STATS
+		dhd->pub.lb_rxp_busy_poll_cnt++;
+#endif /* DHD_LB_STATS */
+		dhd->rx_busy_poll_active = TRUE;
+		(void)dhd_bus_rx_busy_poll(dhd->pub.bus);
+		dhd->rx_busy_poll_active = FALSE;
+	}
+#endif /* DHD_BUSY_POLL_SUPPORT */
+
 #ifdef DHD_LB_STATS
-	napi_latency = (uint32)(OSL_SYSUPTIME_US() - dhd->napi_schedule_time);
-	dhd_lb_stats_update_napi_latency(dhd->napi_latency, napi_latency);
+	/* busy poll runs were not scheduled, there is no dispatch latency to record */
+	if (!busy_poll) {
+		napi_latency = (uint32)(OSL_SYSUPTIME_US() - dhd->napi_schedule_time);
+		dhd_lb_stats_update_napi_latency(dhd->napi_latency, napi_latency);
+	}
 #endif /* DHD_LB_STATS */
+	BCM_REFERENCE(busy_poll);
 	DHD_INFO(("%s napi_queue<%d> budget<%d>\n",
 		__FUNCTION__, skb_queue_len(&dhd->rx_napi_queue), budget));
 
@@ -1122,12 +1769,37 @@ dhd_napi_poll(struct napi_struct *napi, int budget)
 		OSL_PREFETCH(skb->data);
 
 		ifid = DHD_PKTTAG_IFID((dhd_pkttag_fr_t *)PKTTAG(skb));
+#ifdef DHD_BUSY_POLL_SUPPORT
+		/* lets receiving sockets learn which napi to busy poll */
+		skb_mark_napi_id(skb, napi);
+#endif /* DHD_BUSY_POLL_SUPPORT */
 
 		DHD_INFO(("%s dhd_rx_frame pkt<%p> ifid<%d>\n",
 			__FUNCTION__, skb, ifid));
 
+#ifdef DHD_LB_RXP_LIST_RCV
+		/* Chain the following frames of the same interface so that
+		 * dhd_rx_frame can pass them up in one netif_receive_skb_list
+		 */
+		skb_head = skb;
+		pkt_count = 1;
+		while ((processed + pkt_count) < budget &&
+			(skb_next = skb_peek(&dhd->rx_process_queue)) != NULL &&
+			DHD_PKTTAG_IFID((dhd_pkttag_fr_t *)PKTTAG(skb_next)) == ifid) {
+			__skb_unlink(skb_next, &dhd->rx_process_queue);
+#ifdef DHD_BUSY_POLL_SUPPORT
+			skb_mark_napi_id(skb_next, napi);
+#endif /* DHD_BUSY_POLL_SUPPORT */
+			PKTSETNEXT(dhd->pub.osh, skb, skb_next);
+			skb = skb_next;
+			pkt_count++;
+		}
+		dhd_rx_frame(&dhd->pub, ifid, skb_head, pkt_count, chan);
+		processed += pkt_count;
+#else
 		dhd_rx_frame(&dhd->pub, ifid, skb, pkt_count, chan);
 		processed++;
+#endif /* DHD_LB_RXP_LIST_RCV */
 	}
 
 	if (atomic_read(&dhd->pub.lb_rxp_flow_ctrl) &&
@@ -1299,6 +1971,13 @@ dhd_lb_rx_napi_dispatch(dhd_pub_t *dhdp)
 	skb_queue_splice_tail_init(&dhd->rx_pend_queue, &dhd->rx_napi_queue);
 	DHD_RX_NAPI_QUEUE_UNLOCK(&dhd->rx_napi_queue.lock, flags);
 
+#ifdef DHD_BUSY_POLL_SUPPORT
+	/* Dispatched from the busy polling napi, which drains the queue next */
+	if (dhd->rx_busy_poll_active) {
+		return;
+	}
+#endif /* DHD_BUSY_POLL_SUPPORT */
+
 	/* If sysfs lb_rxp_active is not set, schedule on current cpu */
 	if (!atomic_read(&dhd->lb_rxp_active))
 	{
@@ -58,10 +58,35 @@ struct dhd_sock_qos_info;
 #ifdef RX_PKT_POOL
 #define RX_PKTPOOL_RESCHED_DELAY_MS 500u
 #define RX_PKTPOOL_FETCH_MAX_ATTEMPTS 10u
+/* floor of the adaptive fill level */
+#define RX_PKTPOOL_MIN_SIZE 128u
+/* skbs allocated before they are spliced into the pool in one go */
+#define RX_PKTPOOL_ALLOC_BATCH 32u
+/* period over which pool consumption is sampled to size the pool */
+#define RX_PKTPOOL_SIZE_WIN_US (100u * 1000u)
 typedef struct pkt_pool {
 	struct sk_buff_head skb_q     ____cacheline_aligned;
 	uint32 max_size;
 	uint16 rxbuf_sz;
+	uint32 target;		/* adaptive fill level, RX_PKTPOOL_MIN_SIZE..max_size */
+	/* hits and misses are bumped by rx post and read by the pool thread */
+	atomic_t hits;		/* skbs handed out from the pool */
+	atomic_t misses;	/* pool was empty */
+	uint32 len_mismatch;	/* requests with a length other than rxbuf_sz */
+	/* updated by the pool thread only */
+	uint32 refills;		/* refill rounds done by the pool thread */
+	uint32 kicked_refills;	/* refill rounds that served a pending kick */
+	uint32 trimmed;		/* skbs freed when the pool shrank */
+	uint32 refill_lat_max_us;	/* kick to refill done */
+	uint64 refill_lat_total_us;
+	/* oldest pending refill request, 0 if none. Set by rx post with cmpxchg,
+	 * taken by the pool thread with xchg
+	 */
+	atomic64_t kick_ts_us;
+	/* sizing window */
+	uint64 win_ts_us;
+	uint32 win_hits;
+	uint32 win_misses;
 } pkt_pool_t;
 #endif /* RX_PKT_POOL */
 
@@ -245,6 +270,10 @@ typedef struct dhd_info {
 	struct napi_struct    rx_napi_struct ____cacheline_aligned;
 	atomic_t                   rx_napi_cpu; /* cpu on which the napi is dispatched */
 	struct net_device    *rx_napi_netdev; /* netdev of primary interface */
+#ifdef DHD_BUSY_POLL_SUPPORT
+	/* rxcpl rings are being drained from the napi poll itself */
+	bool rx_busy_poll_active;
+#endif /* DHD_BUSY_POLL_SUPPORT */
 
 	struct work_struct    rx_napi_dispatcher_work;
 	struct work_struct    tx_compl_dispatcher_work;
@@ -352,10 +381,19 @@ typedef struct dhd_info {
 	uint32 *napi_rx_hist[HIST_BIN_SIZE];
 	uint32 *txc_hist[HIST_BIN_SIZE];
 	uint32 *rxc_hist[HIST_BIN_SIZE];
+	/* frames handed to netif_receive_skb_list per call */
+	uint32 *rx_list_hist[HIST_BIN_SIZE];
 	struct kobject dhd_lb_kobj;
 	bool dhd_lb_kobj_inited;
 	bool dhd_lb_candidacy_override;
 	enum cpuhp_state dhd_cpuhp_state;
+#ifdef DHD_LB_REBAL_SUPPORT
+	/* Periodic load driven re-selection of napi/tx cpus */
+	struct delayed_work lb_rebal_work;
+	struct dhd_lb_rebal *lb_rebal;
+	/* Serializes napi/tx cpu selection between candidacy and the rebalancer */
+	spinlock_t lb_cpu_lock;
+#endif /* DHD_LB_REBAL_SUPPORT */
 #endif /* DHD_LB */
 
 	/* DPC bounds sysfs */
@@ -476,6 +514,9 @@ typedef struct dhd_info {
 #ifdef DHD_PCIE_WRAPPER_DUMP
 	struct proc_dir_entry *dhd_wrapper_dump_proc;
 #endif /* DHD_PCIE_WRAPPER_DUMP */
+#if defined(DHD_PKT_LOGGING) && defined(DHD_PKTLOG_SNAP)
+	struct proc_dir_entry *dhd_pktlog_proc;
+#endif /* DHD_PKT_LOGGING && DHD_PKTLOG_SNAP */
 } dhd_info_t;
 
 /** priv_link is the link between netdev and the dhdif and dhd_info structs. */
@@ -537,13 +578,35 @@ int dhd_cpu_callback(struct notifier_block *nfb, unsigned long action, void *hcp
 
 int dhd_register_cpuhp_callback(dhd_info_t *dhd);
 int dhd_unregister_cpuhp_callback(dhd_info_t *dhd);
+
+#ifdef DHD_LB_REBAL_SUPPORT
+extern uint dhd_lb_rebal_enable;
+extern uint dhd_lb_rebal_period_ms;
+extern uint dhd_lb_rebal_hyst_pct;
+extern uint dhd_lb_rebal_busy_pct;
+extern uint dhd_lb_rebal_lat_pct;
+void dhd_lb_rebal_init(dhd_info_t *dhd);
+void dhd_lb_rebal_deinit(dhd_info_t *dhd);
+void dhd_lb_rebal_kick(dhd_info_t *dhd);
+void dhd_lb_rebal_keep_cpus(dhd_info_t *dhd, uint32 *napi_cpu, uint32 *tx_cpu);
+ssize_t dhd_lb_rebal_log_show(dhd_info_t *dhd, char *buf, size_t len);
+void dhd_lb_rebal_log_clear(dhd_info_t *dhd);
+#endif /* DHD_LB_REBAL_SUPPORT */
 #endif /* DHD_LB */
 
 #ifdef RX_PKT_POOL
 void dhd_rx_pktpool_init(dhd_info_t *dhd);
 void dhd_rx_pktpool_deinit(dhd_info_t *dhd);
+void dhd_rx_pktpool_dump(dhd_info_t *dhd, struct bcmstrbuf *strbuf);
 #endif /* RX_PKT_POOL */
 
+#ifdef DHD_XDP_SUPPORT
+int dhd_xdp_bpf(struct net_device *net, struct netdev_bpf *bpf);
+void dhd_xdp_if_deinit(dhd_if_t *ifp);
+ssize_t dhd_xdp_show_stats(dhd_info_t *dhd, char *buf, ssize_t sz);
+void dhd_xdp_clear_stats(dhd_info_t *dhd);
+#endif /* DHD_XDP_SUPPORT */
+
 #if defined(SET_PCIE_IRQ_CPU_CORE) || \
 	defined(DHD_CONTROL_PCIE_CPUCORE_WIFI_TURNON)
 void dhd_irq_set_affinity(dhd_pub_t *dhdp, const struct cpumask *cpumask);
@@ -64,6 +64,9 @@
 #include <asm/uaccess.h>
 #include <asm/unaligned.h>
 #include <dhd_linux_priv.h>
+#ifdef DHD_XDP_SUPPORT
+#include <trace/events/xdp.h>
+#endif /* DHD_XDP_SUPPORT */
 
 #include <epivers.h>
 #include <bcmutils.h>
@@ -321,6 +324,247 @@ dhd_is_rxthread_enabled(dhd_pub_t *dhdp)
 }
 #endif /* DHD_WMF */
 
+#if defined(DHD_LB_RXP) && defined(DHD_LB_RXP_LIST_RCV) && \
+	(LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0))
+#define DHD_RX_LIST_RCV
+#endif /* DHD_LB_RXP && DHD_LB_RXP_LIST_RCV && LINUX_VERSION >= 4.19 */
+
+#ifdef DHD_RX_LIST_RCV
+/* Hand the frames collected by dhd_rx_frame to the stack in one go */
+static void
+dhd_rx_list_flush(dhd_pub_t *dhdp, struct list_head *rx_list, uint32 *rx_list_cnt)
+{
+	if (*rx_list_cnt == 0) {
+		return;
+	}
+	netif_receive_skb_list(rx_list);
+	DHD_LB_STATS_UPDATE_RX_LIST_HISTO(dhdp, *rx_list_cnt);
+	INIT_LIST_HEAD(rx_list);
+	*rx_list_cnt = 0;
+}
+
+#define DHD_RX_NETIF_RECEIVE(skb) \
+	do { \
+		list_add_tail(&(skb)->list, &rx_list); \
+		rx_list_cnt++; \
+	} while (0)
+#else
+#define DHD_RX_NETIF_RECEIVE(skb)	netif_receive_skb(skb)
+#endif /* DHD_RX_LIST_RCV */
+
+#ifdef DHD_XDP_SUPPORT
+/*
+ * Run the XDP program attached to ifp on a received frame, ahead of the L2 filters
+ * and eth_type_trans(). The RX buffers posted to the dongle are already skbs, so the
+ * xdp_buff is laid over the linear skb data the way generic XDP does it, and any
+ * head/tail adjustment made by the program is folded back into the skb.
+ * Returns TRUE if the verdict consumed the packet.
+ */
+static bool
+BCMFASTPATH(dhd_rx_xdp)(dhd_pub_t *dhdp, dhd_if_t *ifp, int ifidx, void *pktbuf)
+{
+	struct sk_buff *skb = (struct sk_buff *)pktbuf;
+	struct bpf_prog *prog;
+	struct xdp_buff xdp;
+	void *orig_data, *orig_data_end;
+	uint32 frame_sz;
+	uint32 act;
+	int off;
+	bool consumed = TRUE;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0))
+	struct bpf_net_context __bpf_net_ctx, *bpf_net_ctx;
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0) */
+
+	rcu_read_lock();
+	prog = rcu_dereference(ifp->xdp_prog);
+	if (prog == NULL) {
+		rcu_read_unlock();
+		return FALSE;
+	}
+
+	if (skb_is_nonlinear(skb) || skb_cloned(skb)) {
+		ifp->xdp_stats.bypass++;
+		rcu_read_unlock();
+		return FALSE;
+	}
+
+	frame_sz = (uint32)(skb_end_pointer(skb) - skb->head);
+	frame_sz += SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	xdp_init_buff(&xdp, frame_sz, &ifp->xdp_rxq);
+	xdp_prepare_buff(&xdp, skb->head, skb_headroom(skb), skb_headlen(skb), TRUE);
+	orig_data = xdp.data;
+	orig_data_end = xdp.data_end;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0))
+	/* DPC is not NAPI, bpf_redirect() needs a net context of its own */
+	bpf_net_ctx = bpf_net_ctx_set(&__bpf_net_ctx);
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0) */
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+
+	/* bpf_xdp_adjust_head()/bpf_xdp_adjust_tail() */
+	off = (int)((uint8 *)xdp.data - (uint8 *)orig_data);
+	if (off > 0) {
+		__skb_pull(skb, off);
+	} else if (off < 0) {
+		__skb_push(skb, -off);
+	}
+	off = (int)((uint8 *)orig_data_end - (uint8 *)xdp.data_end);
+	if (off != 0) {
+		skb_set_tail_pointer(skb, (uint8 *)xdp.data_end - (uint8 *)xdp.data);
+		skb->len -= off;
+	}
+
+	switch (act) {
+	case XDP_PASS:
+		ifp->xdp_stats.pass++;
+		consumed = FALSE;
+		break;
+	case XDP_TX:
+		/* round trip through native so TX starts with a clean pkttag,
+		 * as it does from dhd_start_xmit
+		 */
+		ifp->xdp_stats.tx++;
+		skb = PKTTONATIVE(dhdp->osh, pktbuf);
+		dhd_sendpkt(dhdp, ifidx, PKTFRMNATIVE(dhdp->osh, skb));
+		break;
+	case XDP_REDIRECT:
+		skb = PKTTONATIVE(dhdp->osh, pktbuf);
+		skb->dev = ifp->net;
+		/* cpumap/xskmap targets expect protocol and mac header to be set */
+		skb->protocol = eth_type_trans(skb, ifp->net);
+		__skb_push(skb, ETH_HLEN);
+		bcm_object_trace_opr(skb, BCM_OBJDBG_REMOVE, __FUNCTION__, __LINE__);
+		if (xdp_do_generic_redirect(ifp->net, skb, &xdp, prog) == 0) {
+			ifp->xdp_stats.redirect++;
+		} else {
+			ifp->xdp_stats.redirect_err++;
+			dev_kfree_skb_any(skb);
+		}
+		break;
+	default:
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0))
+		bpf_warn_invalid_xdp_action(ifp->net, prog, act);
+#else
+		bpf_warn_invalid_xdp_action(act);
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0) */
+		/* intentional fall through */
+	case XDP_ABORTED:
+		trace_xdp_exception(ifp->net, prog, act);
+		ifp->xdp_stats.aborted++;
+		PKTFREE(dhdp->osh, pktbuf, FALSE);
+		break;
+	case XDP_DROP:
+		ifp->xdp_stats.drop++;
+		PKTFREE(dhdp->osh, pktbuf, FALSE);
+		break;
+	}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0))
+	bpf_net_ctx_clear(bpf_net_ctx);
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0) */
+	rcu_read_unlock();
+
+	return consumed;
+}
+
+/* ndo_bpf handler, called with rtnl held */
+int
+dhd_xdp_bpf(struct net_device *net, struct netdev_bpf *bpf)
+{
+	dhd_if_t *ifp = DHD_DEV_IFP(net);
+	struct bpf_prog *old_prog;
+	int err;
+
+	if (bpf->command != XDP_SETUP_PROG) {
+		return -EINVAL;
+	}
+
+	if (ifp == NULL) {
+		return -ENODEV;
+	}
+
+	if (bpf->prog && !xdp_rxq_info_is_reg(&ifp->xdp_rxq)) {
+		err = xdp_rxq_info_reg(&ifp->xdp_rxq, net, 0, 0);
+		if (err) {
+			NL_SET_ERR_MSG_MOD(bpf->extack, "xdp rxq registration failed");
+			return err;
+		}
+		err = xdp_rxq_info_reg_mem_model(&ifp->xdp_rxq, MEM_TYPE_PAGE_SHARED, NULL);
+		if (err) {
+			xdp_rxq_info_unreg(&ifp->xdp_rxq);
+			NL_SET_ERR_MSG_MOD(bpf->extack, "xdp rxq mem model failed");
+			return err;
+		}
+	}
+
+	/* the reference taken by the core on bpf->prog is handed over to ifp */
+	old_prog = rcu_replace_pointer(ifp->xdp_prog, bpf->prog, lockdep_rtnl_is_held());
+	if (old_prog) {
+		bpf_prog_put(old_prog);
+	}
+
+	DHD_PRINT(("%s: %s xdp prog %s\n", __FUNCTION__, net->name,
+		bpf->prog ? "attached" : "detached"));
+
+	return 0;
+}
+
+void
+dhd_xdp_if_deinit(dhd_if_t *ifp)
+{
+	struct bpf_prog *prog;
+
+	/* unregister_netdev() already detached it through ndo_bpf */
+	prog = rcu_replace_pointer(ifp->xdp_prog, NULL, TRUE);
+	if (prog) {
+		bpf_prog_put(prog);
+	}
+	if (xdp_rxq_info_is_reg(&ifp->xdp_rxq)) {
+		xdp_rxq_info_unreg(&ifp->xdp_rxq);
+	}
+}
+
+ssize_t
+dhd_xdp_show_stats(dhd_info_t *dhd, char *buf, ssize_t sz)
+{
+	dhd_if_t *ifp;
+	dhd_xdp_stats_t *st;
+	ssize_t ret = 0;
+	int i;
+
+	for (i = 0; i < DHD_MAX_IFS; i++) {
+		ifp = dhd->iflist[i];
+		if (ifp == NULL || ifp->net == NULL) {
+			continue;
+		}
+		st = &ifp->xdp_stats;
+		ret += scnprintf(buf + ret, sz - ret,
+			"%s: prog %s pass %llu drop %llu tx %llu redirect %llu "
+			"redirect_err %llu aborted %llu bypass %llu\n",
+			ifp->net->name, rcu_access_pointer(ifp->xdp_prog) ? "on" : "off",
+			st->pass, st->drop, st->tx, st->redirect,
+			st->redirect_err, st->aborted, st->bypass);
+	}
+
+	return ret;
+}
+
+void
+dhd_xdp_clear_stats(dhd_info_t *dhd)
+{
+	dhd_if_t *ifp;
+	int i;
+
+	for (i = 0; i < DHD_MAX_IFS; i++) {
+		ifp = dhd->iflist[i];
+		if (ifp) {
+			bzero(&ifp->xdp_stats, sizeof(ifp->xdp_stats));
+		}
+	}
+}
+#endif /* DHD_XDP_SUPPORT */
+
 /** Called when a frame is received by the dongle on interface 'ifidx' */
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
@@ -356,6 +600,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	bool dhd_gro_enable = TRUE;
 	struct Qdisc *qdisc = NULL;
 #endif /* ENABLE_DHD_GRO */
+#ifdef DHD_RX_LIST_RCV
+	LIST_HEAD(rx_list);
+	uint32 rx_list_cnt = 0;
+#endif /* DHD_RX_LIST_RCV */
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 	BCM_REFERENCE(dump_data);
@@ -502,6 +750,16 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			continue;
 		}
 #endif
+#ifdef DHD_XDP_SUPPORT
+		/* Data frames only, dongle events always go up to the event handler */
+		if (rcu_access_pointer(ifp->xdp_prog) &&
+			(ntoh16(eh->ether_type) != ETHER_TYPE_BRCM) &&
+			dhd_rx_xdp(dhdp, ifp, ifidx, pktbuf)) {
+			continue;
+		}
+		/* the program may have moved the frame start */
+		eh = (struct ether_header *)PKTDATA(dhdp->osh, pktbuf);
+#endif /* DHD_XDP_SUPPORT */
 #ifdef DHD_L2_FILTER
 		/* If block_ping is enabled drop the ping packet */
 		if (ifp->block_ping) {
@@ -1054,10 +1312,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 				ntoh16(skb->protocol) != ETHER_TYPE_BRCM) {
 				napi_gro_receive(&dhd->rx_napi_struct, skb);
 			} else {
-				netif_receive_skb(skb);
+				DHD_RX_NETIF_RECEIVE(skb);
 			}
 #else
-			netif_receive_skb(skb);
+			DHD_RX_NETIF_RECEIVE(skb);
 #endif /* ENABLE_DHD_GRO */
 #else /* !defined(DHD_LB_RXP) */
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0))
@@ -1093,10 +1351,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 					ntoh16(skb->protocol) != ETHER_TYPE_BRCM) {
 					napi_gro_receive(&dhd->rx_napi_struct, skb);
 				} else {
-					netif_receive_skb(skb);
+					DHD_RX_NETIF_RECEIVE(skb);
 				}
 #else
-				netif_receive_skb(skb);
+				DHD_RX_NETIF_RECEIVE(skb);
 #endif /* ENABLE_DHD_GRO */
 #else /* !defined(DHD_LB_RXP) */
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0))
@@ -1109,6 +1367,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		}
 	}
 
+#ifdef DHD_RX_LIST_RCV
+	dhd_rx_list_flush(dhdp, &rx_list, &rx_list_cnt);
+#endif /* DHD_RX_LIST_RCV */
+
 	if (dhd->rxthread_enabled && skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
 
@@ -1593,11 +1855,25 @@ BCMFASTPATH(dhd_rxpool_pktget)(osl_t *osh, dhd_info_t *dhd, uint16 len)
 	if (dhd->rx_pktpool_thread.thr_pid >= 0) {
 		if (rx_pool->rxbuf_sz == len) {
 			p = skb_dequeue(&rx_pool->skb_q);
+			if (p) {
+				atomic_inc(&rx_pool->hits);
+			} else {
+				atomic_inc(&rx_pool->misses);
+			}
 			/* kick rx buffer mgmt thread to alloc more rx
-			 * buffers into the pool
+			 * buffers into the pool once it drains below 3/4 of target
 			 */
-			binary_sema_up(&dhd->rx_pktpool_thread);
+			if (skb_queue_len(&rx_pool->skb_q) <
+				(rx_pool->target - (rx_pool->target >> 2))) {
+				/* keep the oldest pending kick */
+				if (!atomic64_read(&rx_pool->kick_ts_us)) {
+					atomic64_cmpxchg(&rx_pool->kick_ts_us, 0,
+						(s64)OSL_SYSUPTIME_US());
+				}
+				binary_sema_up(&dhd->rx_pktpool_thread);
+			}
 		} else {
+			rx_pool->len_mismatch++;
 			DHD_ERROR_RLMT(("%s: PKTGET_RX_POOL is called with length %u, "
 				"but pkt pool created with length : %u\n", __FUNCTION__,
 				len, rx_pool->rxbuf_sz));
@@ -1610,6 +1886,38 @@ BCMFASTPATH(dhd_rxpool_pktget)(osl_t *osh, dhd_info_t *dhd, uint16 len)
 	return p;
 }
 
+/*
+ * Size the pool from what was drawn from it during the last window.
+ * Running dry grows the target to at least one window worth of skbs,
+ * a window using less than half of the target shrinks it by 1/8.
+ */
+static void
+dhd_rx_pktpool_resize(pkt_pool_t *rx_pool)
+{
+	uint64 now = OSL_SYSUPTIME_US();
+	uint32 hits, misses, need, target;
+
+	if ((now - rx_pool->win_ts_us) < RX_PKTPOOL_SIZE_WIN_US) {
+		return;
+	}
+
+	hits = (uint32)atomic_read(&rx_pool->hits) - rx_pool->win_hits;
+	misses = (uint32)atomic_read(&rx_pool->misses) - rx_pool->win_misses;
+	need = hits + misses;
+	target = rx_pool->target;
+
+	if (misses) {
+		target = MAX(target << 1, need);
+	} else if (need < (target >> 1)) {
+		target -= (target >> 3);
+	}
+	rx_pool->target = MIN(MAX(target, RX_PKTPOOL_MIN_SIZE), rx_pool->max_size);
+
+	rx_pool->win_hits += hits;
+	rx_pool->win_misses += misses;
+	rx_pool->win_ts_us = now;
+}
+
 static int
 dhd_rx_pktpool_thread(void *data)
 {
@@ -1617,11 +1925,16 @@ dhd_rx_pktpool_thread(void *data)
 	dhd_info_t *dhd = (dhd_info_t *)tsk->parent;
 	dhd_pub_t *dhdp = (dhd_pub_t *)&dhd->pub;
 	pkt_pool_t *rx_pool = &dhd->rx_pkt_pool;
+	struct sk_buff_head batch_q;
+	unsigned long flags;
 	void *p = NULL;
 	int qlen = 0;
 	int num_attempts = 0;
+	uint32 i, n, lat;
+	uint64 kick_ts;
 
 	DHD_TRACE(("%s: STARTED...\n", __FUNCTION__));
+	__skb_queue_head_init(&batch_q);
 	while (1) {
 		if (!binary_sema_down(tsk)) {
 			SMP_RD_BARRIER_DEPENDS();
@@ -1634,14 +1947,30 @@ dhd_rx_pktpool_thread(void *data)
 			 * handshake the actual rxbuf size.
 			 */
 			if (rx_pool->rxbuf_sz) {
+				dhd_rx_pktpool_resize(rx_pool);
 				qlen = skb_queue_len(&rx_pool->skb_q);
-				DHD_TRACE(("%s: before alloc - skb_q len=%u, max_size=%u "
-					"rxbuf_sz : %u\n", __FUNCTION__, qlen, rx_pool->max_size,
-					rx_pool->rxbuf_sz));
+				DHD_TRACE(("%s: before alloc - skb_q len=%u, target=%u max_size=%u "
+					"rxbuf_sz : %u\n", __FUNCTION__, qlen, rx_pool->target,
+					rx_pool->max_size, rx_pool->rxbuf_sz));
 				num_attempts = 0;
-				while (qlen < rx_pool->max_size) {
-					p = PKTGET(dhdp->osh, rx_pool->rxbuf_sz, FALSE);
-					if (!p) {
+				while (qlen < rx_pool->target) {
+					/* allocate a batch outside the queue lock so the rx
+					 * post path only contends once per batch
+					 */
+					n = MIN(RX_PKTPOOL_ALLOC_BATCH, rx_pool->target - qlen);
+					for (i = 0; i < n; i++) {
+						p = PKTGET(dhdp->osh, rx_pool->rxbuf_sz, FALSE);
+						if (!p) {
+							break;
+						}
+						__skb_queue_tail(&batch_q, p);
+					}
+					if (!skb_queue_empty(&batch_q)) {
+						spin_lock_irqsave(&rx_pool->skb_q.lock, flags);
+						skb_queue_splice_tail_init(&batch_q, &rx_pool->skb_q);
+						spin_unlock_irqrestore(&rx_pool->skb_q.lock, flags);
+					}
+					if (i < n) {
 						DHD_ERROR_RLMT(("%s: pktget fails, resched...\n",
 							__FUNCTION__));
 						/* retry after some time to fetch packets
@@ -1654,11 +1983,30 @@ dhd_rx_pktpool_thread(void *data)
 							break;
 						}
 						OSL_SLEEP(RX_PKTPOOL_RESCHED_DELAY_MS);
-					} else {
-						skb_queue_tail(&rx_pool->skb_q, p);
 					}
 					qlen = skb_queue_len(&rx_pool->skb_q);
 				}
+				/* give back what a shrunk target no longer needs,
+				 * with some slack to avoid trimming and refilling in turns
+				 */
+				while (qlen > (rx_pool->target + (rx_pool->target >> 2))) {
+					p = skb_dequeue(&rx_pool->skb_q);
+					if (!p) {
+						break;
+					}
+					PKTFREE(dhdp->osh, p, FALSE);
+					rx_pool->trimmed++;
+					qlen = skb_queue_len(&rx_pool->skb_q);
+				}
+				kick_ts = (uint64)atomic64_xchg(&rx_pool->kick_ts_us, 0);
+				if (kick_ts) {
+					lat = (uint32)(OSL_SYSUPTIME_US() - kick_ts);
+					rx_pool->kicked_refills++;
+					rx_pool->refill_lat_total_us += lat;
+					rx_pool->refill_lat_max_us =
+						MAX(rx_pool->refill_lat_max_us, lat);
+				}
+				rx_pool->refills++;
 				DHD_TRACE(("%s: after alloc - skb_q len=%u, max_size=%u \n",
 					__FUNCTION__, qlen, rx_pool->max_size));
 			}
@@ -1687,6 +2035,7 @@ dhd_rx_pktpool_init(dhd_info_t *dhd)
 
 	skb_queue_head_init(&rx_pool->skb_q);
 	rx_pool->max_size = MAX_RX_PKT_POOL;
+	rx_pool->target = RX_PKTPOOL_MIN_SIZE;
 	rx_pool->rxbuf_sz = 0;
 
 	PROC_START(dhd_rx_pktpool_thread, dhd, &dhd->rx_pktpool_thread, 0, "dhd_rx_pktpool_thread");
@@ -1712,6 +2061,25 @@ dhd_rx_pktpool_deinit(dhd_info_t *dhd)
 	DHD_PRINT(("%s: de-alloc'd rx buffers in pool \n",
 		__FUNCTION__));
 }
+
+void
+dhd_rx_pktpool_dump(dhd_info_t *dhd, struct bcmstrbuf *strbuf)
+{
+	pkt_pool_t *rx_pool = &dhd->rx_pkt_pool;
+
+	bcm_bprintf(strbuf, "rx_pkt_pool: qlen %u target %u max_size %u rxbuf_sz %u\n",
+		skb_queue_len(&rx_pool->skb_q), rx_pool->target, rx_pool->max_size,
+		rx_pool->rxbuf_sz);
+	bcm_bprintf(strbuf, "hits %u misses %u len_mismatch %u refills %u kicked %u "
+		"trimmed %u\n", atomic_read(&rx_pool->hits), atomic_read(&rx_pool->misses),
+		rx_pool->len_mismatch, rx_pool->refills, rx_pool->kicked_refills,
+		rx_pool->trimmed);
+	/* only refills that served a kick have a latency */
+	bcm_bprintf(strbuf, "refill latency(us): max %u avg %u\n",
+		rx_pool->refill_lat_max_us, rx_pool->kicked_refills ?
+		(uint32)(DIV_U64_BY_U32(rx_pool->refill_lat_total_us,
+		rx_pool->kicked_refills)) : 0);
+}
 #endif /* RX_PKT_POOL */
 
 #ifdef RX_CSO
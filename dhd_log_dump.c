@@ -42,6 +42,9 @@
 #if defined(WL_CFG80211)
 #include <wl_cfg80211.h>
 #endif
+#ifdef DHD_LOG_DUMP_ASYNC
+#include <linux/lz4.h>
+#endif /* DHD_LOG_DUMP_ASYNC */
 
 extern char dhd_version[];
 extern char fw_version[];
@@ -81,6 +84,64 @@ int logdump_rtt_enable = FALSE;
 
 int logdump_prsrv_tailsize = DHD_LOG_DUMP_MAX_TAIL_FLUSH_SIZE;
 
+#ifdef DHD_LOG_DUMP_ASYNC
+/* Render the debug_dump sections to memory and write the file from a worker */
+int logdump_async = FALSE;
+module_param(logdump_async, int, 0644);
+/* LZ4 compress the file written by the worker, see dhd_log_dump_lz4_hdr_t */
+int logdump_async_comp = FALSE;
+module_param(logdump_async_comp, int, 0644);
+
+#define DHD_LOG_DUMP_ARENA_MIN_SIZE	(256u * 1024u)
+#define DHD_LOG_DUMP_ARENA_MAX_SEC	24u
+
+#define DHD_LOG_DUMP_LZ4_MAGIC		0x34444C44U	/* "DLD4" */
+#define DHD_LOG_DUMP_LZ4_VER		1U
+#define DHD_LOG_DUMP_LZ4_CHUNK		(64U * 1024U)
+
+/* A compressed debug_dump is this header, then for every chunk of at most
+ * DHD_LOG_DUMP_LZ4_CHUNK bytes a uint32 original length, a uint32 compressed
+ * length and the LZ4 block. Chunks never straddle two sections.
+ */
+typedef struct dhd_log_dump_lz4_hdr {
+	uint32 magic;
+	uint32 version;
+	uint32 orig_size;	/* size of the uncompressed debug_dump */
+	uint32 blk_size;	/* largest chunk */
+} dhd_log_dump_lz4_hdr_t;
+
+typedef struct dhd_log_dump_arena_sec {
+	const char *name;
+	uint32 off;
+	uint32 len;
+	uint64 snap_ns;
+	uint64 write_ns;
+} dhd_log_dump_arena_sec_t;
+
+/* Memory the debug_dump sections are rendered to, in file layout. Only one
+ * dump is in flight at a time, like the g_dld_buf log buffers it is global.
+ */
+typedef struct dhd_log_dump_arena {
+	dhd_pub_t *dhdp;
+	atomic_t busy;
+	uint8 *buf;
+	uint32 size;
+	uint32 used;
+	uint32 size_hint;	/* bytes used by the previous dump */
+	char dump_path[128];
+	uint64 snap_start_ns;
+	uint64 snap_ns;
+	uint64 sec_start_ns;
+	uint32 nsec;
+	dhd_log_dump_arena_sec_t sec[DHD_LOG_DUMP_ARENA_MAX_SEC];
+} dhd_log_dump_arena_t;
+
+static dhd_log_dump_arena_t g_dld_arena;
+
+static void dhd_log_dump_arena_work(struct work_struct *work);
+static DECLARE_WORK(dhd_log_dump_arena_wk, dhd_log_dump_arena_work);
+#endif /* DHD_LOG_DUMP_ASYNC */
+
 #ifdef DHD_DEBUGABILITY_DEBUG_DUMP
 static dhd_debug_dump_ring_entry_t dhd_debug_dump_ring_map[] = {
 	{LOG_DUMP_SECTION_TIMESTAMP, DEBUG_DUMP_RING1_ID},
@@ -1478,48 +1539,14 @@ dhd_init_sec_hdr(log_dump_section_hdr_t *sec_hdr)
 	sec_hdr->timestamp = local_clock();
 }
 
-/* Must hold 'dhd_os_logdump_lock' before calling this function ! */
-int
-do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type)
+/* Opens the debug_dump file, on an installed android image trying '/data' as well */
+static int
+dhd_log_dump_open_file(dhd_pub_t *dhdp, char *dump_path, uint32 path_len, struct file **fpp)
 {
-	int ret = 0, i = 0;
-	struct file *fp = NULL;
-	MM_SEGMENT_T fs;
-	loff_t pos = 0;
-	char dump_path[128];
-	uint32 file_mode;
-	unsigned long flags = 0;
+	struct file *fp;
 	struct kstat stat;
-	char time_str[128];
-	unsigned int len = 0;
-	log_dump_section_hdr_t sec_hdr;
-
-	DHD_PRINT(("%s: ENTER \n", __FUNCTION__));
-
-	DHD_GENERAL_LOCK(dhdp, flags);
-	if (DHD_BUS_CHECK_DOWN_OR_DOWN_IN_PROGRESS(dhdp)) {
-		DHD_GENERAL_UNLOCK(dhdp, flags);
-		DHD_ERROR(("%s: bus is down! can't collect log dump. \n", __FUNCTION__));
-		goto exit1;
-	}
-	DHD_BUS_BUSY_SET_IN_LOGDUMP(dhdp);
-	DHD_GENERAL_UNLOCK(dhdp, flags);
-
-	if ((ret = dhd_log_flush(dhdp, type)) < 0) {
-		goto exit1;
-	}
-
-	GETFS_AND_SETFS_TO_KERNEL_DS(fs);
-
-	dhd_get_debug_dump_file_name(NULL, dhdp, dump_path, sizeof(dump_path));
-
-	DHD_PRINT(("debug_dump_path = %s\n", dump_path));
-	DHD_PRINT(("DHD version: %s\n", dhd_version));
-	DHD_PRINT(("F/W version: %s\n", fw_version));
-
-	dhd_log_dump_buf_addr(dhdp, type);
-
-	dhd_get_time_str(dhdp, time_str, 128);
+	uint32 file_mode;
+	int ret;
 
 	file_mode = O_CREAT | O_WRONLY | O_SYNC | O_TRUNC;
 	fp = dhd_filp_open(dump_path, file_mode, 0664);
@@ -1529,15 +1556,15 @@ do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type)
 #if defined(CONFIG_X86) && defined(OEM_ANDROID)
 		DHD_ERROR(("%s: File open error on Installed android image, trying /data...\n",
 			__FUNCTION__));
-		snprintf(dump_path, sizeof(dump_path), "/data/" DHD_DEBUG_DUMP_TYPE);
+		snprintf(dump_path, path_len, "/data/" DHD_DEBUG_DUMP_TYPE);
 		snprintf(dump_path + strlen(dump_path),
-			sizeof(dump_path) - strlen(dump_path),
+			path_len - strlen(dump_path),
 			"_%s", dhdp->debug_dump_time_str);
 		fp = dhd_filp_open(dump_path, file_mode, 0664);
 		if (IS_ERR(fp) || (fp == NULL)) {
 			ret = PTR_ERR(fp);
 			DHD_ERROR(("open file error, err = %d\n", ret));
-			goto exit2;
+			return ret;
 		}
 		DHD_PRINT(("debug_dump_path = %s\n", dump_path));
 #endif /* defined(CONFIG_X86) && defined(OEM_ANDROID) */
@@ -1545,58 +1572,364 @@ do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type)
 #if !(defined(CONFIG_X86) && defined(OEM_ANDROID))
 		ret = PTR_ERR(fp);
 		DHD_ERROR(("open file error, err = %d\n", ret));
-		goto exit2;
+		return ret;
 #endif /* CONFIG_X86 && OEM_ANDROID */
 	}
+	*fpp = fp;
 
 	ret = dhd_vfs_stat(dump_path, &stat);
 	if (ret < 0) {
 		DHD_ERROR(("file stat error, err = %d\n", ret));
-		goto exit2;
 	}
+	return ret;
+}
+
+#ifdef DHD_LOG_DUMP_ASYNC
+bool
+dhd_log_dump_is_arena(void *fp)
+{
+	return (fp != NULL) && (fp == (void *)&g_dld_arena);
+}
 
-	dhd_print_time_str(0, fp, len, &pos);
+/* Waits for a snapshot handed to the worker to reach the file */
+void
+dhd_log_dump_async_flush(void)
+{
+	flush_work(&dhd_log_dump_arena_wk);
+}
+
+static int
+dhd_log_dump_arena_grow(dhd_log_dump_arena_t *arena, uint32 need)
+{
+	uint32 size = MAX(arena->size, DHD_LOG_DUMP_ARENA_MIN_SIZE);
+	uint8 *buf;
+
+	if (need > (1u << 30)) {
+		return BCME_NOMEM;
+	}
+	while (size < need) {
+		size <<= 1;
+	}
+
+	buf = VMALLOC(arena->dhdp->osh, size);
+	if (!buf) {
+		DHD_ERROR(("%s: VMALLOC of %u bytes failed\n", __FUNCTION__, size));
+		return BCME_NOMEM;
+	}
+	if (arena->buf) {
+		memcpy(buf, arena->buf, arena->used);
+		VMFREE(arena->dhdp->osh, arena->buf, arena->size);
+	}
+	arena->buf = buf;
+	arena->size = size;
+	return BCME_OK;
+}
+
+/* Backs dhd_export_debug_data() and dhd_os_write_file_posn() while the sections
+ * are snapshotted. Writes are positional as the ring sections rewrite their
+ * section header once the length is known.
+ */
+int
+dhd_log_dump_arena_write(void *fp, uint32 off, void *buf, uint32 len)
+{
+	dhd_log_dump_arena_t *arena = (dhd_log_dump_arena_t *)fp;
+	uint32 end = off + len;
+
+	if (!buf || end < off) {
+		return BCME_BADARG;
+	}
+	if (end > arena->size && dhd_log_dump_arena_grow(arena, end) != BCME_OK) {
+		return BCME_NOMEM;
+	}
+	if (off > arena->used) {
+		bzero(arena->buf + arena->used, off - arena->used);
+	}
+	memcpy(arena->buf + off, buf, len);
+	arena->used = MAX(arena->used, end);
+	return BCME_OK;
+}
+
+/* Ends the current section at 'pos' and starts 'name' there, NULL only ends it */
+static void
+dhd_log_dump_arena_mark(void *fp, const char *name, uint32 pos)
+{
+	dhd_log_dump_arena_t *arena = (dhd_log_dump_arena_t *)fp;
+	dhd_log_dump_arena_sec_t *sec;
+	uint64 now;
+
+	if (!dhd_log_dump_is_arena(fp)) {
+		return;
+	}
+	/* out of slots, the last section takes in the rest */
+	if (name && arena->nsec == DHD_LOG_DUMP_ARENA_MAX_SEC) {
+		return;
+	}
+
+	now = OSL_LOCALTIME_NS();
+	if (arena->nsec) {
+		sec = &arena->sec[arena->nsec - 1];
+		sec->len = pos - sec->off;
+		sec->snap_ns = now - arena->sec_start_ns;
+	}
+	if (name) {
+		sec = &arena->sec[arena->nsec++];
+		bzero(sec, sizeof(*sec));
+		sec->name = name;
+		sec->off = pos;
+	}
+	arena->sec_start_ns = now;
+}
+#define DHD_LOG_DUMP_SECTION(fp, name, pos)	\
+	dhd_log_dump_arena_mark((fp), (name), (uint32)(pos))
+
+static void
+dhd_log_dump_arena_free(dhd_log_dump_arena_t *arena)
+{
+	if (arena->buf) {
+		VMFREE(arena->dhdp->osh, arena->buf, arena->size);
+		arena->buf = NULL;
+	}
+	arena->size = 0;
+	atomic_set(&arena->busy, 0);
+}
+
+/* Returns the arena to snapshot to, or NULL to write the file synchronously */
+static dhd_log_dump_arena_t *
+dhd_log_dump_arena_get(dhd_pub_t *dhdp, char *dump_path)
+{
+	dhd_log_dump_arena_t *arena = &g_dld_arena;
+
+	if (!logdump_async) {
+		return NULL;
+	}
+#ifdef DHD_FW_COREDUMP
+	/* the dump may be followed by BUG_ON, the file has to be complete by then */
+	if (dhdp->memdump_enabled == DUMP_MEMFILE_BUGON) {
+		return NULL;
+	}
+#endif /* DHD_FW_COREDUMP */
+
+	/* keep dumps in order, the previous one has to reach the file first */
+	flush_work(&dhd_log_dump_arena_wk);
+	if (atomic_cmpxchg(&arena->busy, 0, 1) != 0) {
+		DHD_ERROR(("%s: arena in use, writing synchronously\n", __FUNCTION__));
+		return NULL;
+	}
+
+	arena->dhdp = dhdp;
+	arena->used = 0;
+	arena->nsec = 0;
+	if (dhd_log_dump_arena_grow(arena, arena->size_hint) != BCME_OK) {
+		dhd_log_dump_arena_free(arena);
+		return NULL;
+	}
+	strlcpy(arena->dump_path, dump_path, sizeof(arena->dump_path));
+	arena->snap_start_ns = OSL_LOCALTIME_NS();
+	return arena;
+}
+
+/* Closes the snapshot ending at 'pos' and hands it to the worker */
+static void
+dhd_log_dump_arena_put(dhd_log_dump_arena_t *arena, uint32 pos)
+{
+	dhd_log_dump_arena_mark(arena, NULL, pos);
+	arena->snap_ns = OSL_LOCALTIME_NS() - arena->snap_start_ns;
+	DHD_PRINT(("%s: %u bytes in %u sections snapshotted in %llu us\n", __FUNCTION__,
+		arena->used, arena->nsec, arena->snap_ns / NSEC_PER_USEC));
+	queue_work(system_unbound_wq, &dhd_log_dump_arena_wk);
+}
 
+static int
+dhd_log_dump_write_lz4(void *fp, unsigned long *pos, uint8 *src, uint32 len,
+	uint8 *cbuf, void *wrkmem)
+{
+	uint32 blen, clen;
+	int ret = 0;
+	int n;
+
+	while (len) {
+		blen = MIN(len, DHD_LOG_DUMP_LZ4_CHUNK);
+		n = LZ4_compress_default((char *)src, (char *)cbuf + 2u * sizeof(uint32),
+			blen, LZ4_COMPRESSBOUND(DHD_LOG_DUMP_LZ4_CHUNK), wrkmem);
+		if (n <= 0) {
+			DHD_ERROR(("%s: compression failed\n", __FUNCTION__));
+			return BCME_ERROR;
+		}
+		clen = (uint32)n;
+		memcpy(cbuf, &blen, sizeof(blen));
+		memcpy(cbuf + sizeof(blen), &clen, sizeof(clen));
+		ret = dhd_os_write_file_posn(fp, pos, cbuf, 2u * sizeof(uint32) + clen);
+		if (ret < 0) {
+			return ret;
+		}
+		src += blen;
+		len -= blen;
+	}
+	return ret;
+}
+
+/* Writes the snapshot to the debug_dump file one section at a time */
+static void
+dhd_log_dump_arena_work(struct work_struct *work)
+{
+	dhd_log_dump_arena_t *arena = &g_dld_arena;
+	dhd_pub_t *dhdp = arena->dhdp;
+	dhd_log_dump_arena_sec_t *sec;
+	dhd_log_dump_lz4_hdr_t hdr;
+	struct file *fp = NULL;
+	MM_SEGMENT_T fs;
+	unsigned long pos = 0;
+	uint32 cbuf_size = 2u * sizeof(uint32) + LZ4_COMPRESSBOUND(DHD_LOG_DUMP_LZ4_CHUNK);
+	uint8 *cbuf = NULL;
+	void *wrkmem = NULL;
+	bool comp = (logdump_async_comp != 0);
+	uint64 start_ns = OSL_LOCALTIME_NS(), ts;
+	uint32 i;
+	int ret;
+
+	BCM_REFERENCE(work);
+
+	DHD_OS_WAKE_LOCK(dhdp);
+	if (comp) {
+		cbuf = VMALLOC(dhdp->osh, cbuf_size);
+		wrkmem = VMALLOC(dhdp->osh, LZ4_MEM_COMPRESS);
+		if (!cbuf || !wrkmem) {
+			DHD_ERROR(("%s: no memory to compress, writing it as is\n", __FUNCTION__));
+			comp = FALSE;
+		} else {
+			strlcat(arena->dump_path, ".lz4", sizeof(arena->dump_path));
+		}
+	}
+
+	GETFS_AND_SETFS_TO_KERNEL_DS(fs);
+
+	ret = dhd_log_dump_open_file(dhdp, arena->dump_path, sizeof(arena->dump_path), &fp);
+	if (ret < 0) {
+		goto exit;
+	}
+
+	if (comp) {
+		hdr.magic = DHD_LOG_DUMP_LZ4_MAGIC;
+		hdr.version = DHD_LOG_DUMP_LZ4_VER;
+		hdr.orig_size = arena->used;
+		hdr.blk_size = DHD_LOG_DUMP_LZ4_CHUNK;
+		ret = dhd_os_write_file_posn(fp, &pos, &hdr, sizeof(hdr));
+	}
+
+	for (i = 0; i < arena->nsec && ret >= 0; i++) {
+		sec = &arena->sec[i];
+		if (!sec->len) {
+			continue;
+		}
+		ts = OSL_LOCALTIME_NS();
+		if (comp) {
+			ret = dhd_log_dump_write_lz4(fp, &pos, arena->buf + sec->off, sec->len,
+				cbuf, wrkmem);
+		} else {
+			ret = dhd_os_write_file_posn(fp, &pos, arena->buf + sec->off, sec->len);
+		}
+		sec->write_ns = OSL_LOCALTIME_NS() - ts;
+	}
+	if (ret < 0) {
+		DHD_ERROR(("%s: write file error !\n", __FUNCTION__));
+	}
+
+exit:
+	if (!IS_ERR(fp) && fp != NULL) {
+		dhd_filp_close(fp, NULL);
+		DHD_ERROR(("%s: Finished writing log dump to file - '%s' \n",
+				__FUNCTION__, arena->dump_path));
+	}
+	SETFS(fs);
+
+	for (i = 0; i < arena->nsec; i++) {
+		sec = &arena->sec[i];
+		if (sec->len) {
+			DHD_PRINT(("%s: %-12s %8u bytes snapshot %6llu us write %6llu us\n",
+				__FUNCTION__, sec->name, sec->len, sec->snap_ns / NSEC_PER_USEC,
+				sec->write_ns / NSEC_PER_USEC));
+		}
+	}
+	DHD_PRINT(("%s: ret %d, %u bytes to %lu bytes on file, snapshot %llu us write %llu us\n",
+		__FUNCTION__, ret, arena->used, pos, arena->snap_ns / NSEC_PER_USEC,
+		(OSL_LOCALTIME_NS() - start_ns) / NSEC_PER_USEC));
+
+#ifdef DHD_DUMP_MNGR
+	if (ret >= 0) {
+		dhd_dump_file_manage_enqueue(dhdp, arena->dump_path, DHD_DEBUG_DUMP_TYPE);
+	}
+#endif /* DHD_DUMP_MNGR */
+
+	if (wrkmem) {
+		VMFREE(dhdp->osh, wrkmem, LZ4_MEM_COMPRESS);
+	}
+	if (cbuf) {
+		VMFREE(dhdp->osh, cbuf, cbuf_size);
+	}
+	/* start the next dump with enough room for this one */
+	arena->size_hint = arena->used;
+	dhd_log_dump_arena_free(arena);
+	DHD_OS_WAKE_UNLOCK(dhdp);
+}
+#else
+#define DHD_LOG_DUMP_SECTION(fp, name, pos)
+#endif /* DHD_LOG_DUMP_ASYNC */
+
+/* Writes every debug_dump section to 'fp', the file or the async arena */
+static int
+dhd_log_dump_sections(dhd_pub_t *dhdp, log_dump_type_t *type, void *fp, loff_t *pos)
+{
+	int i = 0;
+	unsigned int len = 0;
+	log_dump_section_hdr_t sec_hdr;
+
+	DHD_LOG_DUMP_SECTION(fp, "timestamp", *pos);
+	dhd_print_time_str(0, fp, len, pos);
+
+	DHD_LOG_DUMP_SECTION(fp, "dld", *pos);
 	for (i = 0; i < DLD_BUFFER_NUM; ++i) {
 
 		if (*type != DLD_BUF_TYPE_ALL && i != *type)
 			continue;
 
 		len = dhd_get_dld_len(i);
-		dhd_get_dld_log_dump(NULL, dhdp, 0, fp, len, i, &pos);
+		dhd_get_dld_log_dump(NULL, dhdp, 0, fp, len, i, pos);
 		if (*type != DLD_BUF_TYPE_ALL)
 			break;
 	}
 
 #ifdef EWP_ECNTRS_LOGGING
+	DHD_LOG_DUMP_SECTION(fp, "ecntrs", *pos);
 	if (*type == DLD_BUF_TYPE_ALL &&
 			logdump_ecntr_enable &&
 			dhdp->ecntr_dbg_ring) {
 		dhd_log_dump_ring_to_file(dhdp, dhdp->ecntr_dbg_ring,
-				fp, (unsigned long *)&pos,
+				fp, (unsigned long *)pos,
 				&sec_hdr, ECNTRS_LOG_HDR, LOG_DUMP_SECTION_ECNTRS);
 	}
 #endif /* EWP_ECNTRS_LOGGING */
 
 #ifdef EWP_DACS
+	DHD_LOG_DUMP_SECTION(fp, "ewp_hw", *pos);
 	for (i = LOG_DUMP_SECTION_EWP_HW_INIT_LOG; i <= LOG_DUMP_SECTION_EWP_HW_REG_DUMP; ++i) {
 		len = dhd_get_init_dump_len(NULL, dhdp, i);
 		if (len) {
 			if (dhd_print_init_dump_data(NULL, dhdp, 0, fp,
-				len, &pos, i) < 0)
-				goto exit2;
+				len, pos, i) < 0)
+				return BCME_ERROR;
 		}
 	}
 #endif /* EWP_DACS */
 
 #ifdef DHD_STATUS_LOGGING
+	DHD_LOG_DUMP_SECTION(fp, "statlog", *pos);
 	if (dhdp->statlog) {
 		/* write the statlog */
 		len = dhd_get_status_log_len(NULL, dhdp);
 		if (len) {
 			if (dhd_print_status_log_data(NULL, dhdp, 0, fp,
-				len, &pos) < 0) {
-				goto exit2;
+				len, pos) < 0) {
+				return BCME_ERROR;
 			}
 		}
 	}
@@ -1610,96 +1943,180 @@ do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type)
 #endif /* DHD_STATUS_LOGGING */
 
 #ifdef EWP_RTT_LOGGING
+	DHD_LOG_DUMP_SECTION(fp, "rtt", *pos);
 	if (*type == DLD_BUF_TYPE_ALL &&
 			logdump_rtt_enable &&
 			dhdp->rtt_dbg_ring) {
 		dhd_log_dump_ring_to_file(dhdp, dhdp->rtt_dbg_ring,
-				fp, (unsigned long *)&pos,
+				fp, (unsigned long *)pos,
 				&sec_hdr, RTT_LOG_HDR, LOG_DUMP_SECTION_RTT);
 	}
 #endif /* EWP_RTT_LOGGING */
 
 #ifdef EWP_BCM_TRACE
+	DHD_LOG_DUMP_SECTION(fp, "bcm_trace", *pos);
 	if (*type == DLD_BUF_TYPE_ALL &&
 		dhdp->bcm_trace_dbg_ring) {
 		dhd_log_dump_ring_to_file(dhdp, dhdp->bcm_trace_dbg_ring,
-				fp, (unsigned long *)&pos,
+				fp, (unsigned long *)pos,
 				&sec_hdr, BCM_TRACE_LOG_HDR, LOG_DUMP_SECTION_BCM_TRACE);
 	}
 #endif /* EWP_BCM_TRACE */
 
 #ifdef EWP_CX_TIMELINE
+	DHD_LOG_DUMP_SECTION(fp, "cx_timeline", *pos);
 	if (*type == DLD_BUF_TYPE_ALL && dhdp->cx_timeline_dbg_ring) {
 		dhd_log_dump_ring_to_file(dhdp, dhdp->cx_timeline_dbg_ring,
-				fp, (unsigned long *)&pos,
+				fp, (unsigned long *)pos,
 				&sec_hdr, CX_TIMELINE_LOG_HDR, LOG_DUMP_SECTION_COEX_TIMELINE);
 	}
 #endif /* EWP_CX_TIMELINE */
 
 #ifdef BCMPCIE
+	DHD_LOG_DUMP_SECTION(fp, "ext_trap", *pos);
 	len = dhd_get_ext_trap_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_ext_trap_data(NULL, dhdp, 0, fp, len, &pos) < 0)
-			goto exit2;
+		if (dhd_print_ext_trap_data(NULL, dhdp, 0, fp, len, pos) < 0)
+			return BCME_ERROR;
 	}
 #endif /* BCMPCIE */
 
 #if defined(DHD_FW_COREDUMP) && defined (DNGL_EVENT_SUPPORT)
+	DHD_LOG_DUMP_SECTION(fp, "health_chk", *pos);
 	len = dhd_get_health_chk_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_health_chk_data(NULL, dhdp, 0, fp, len, &pos) < 0)
-			goto exit2;
+		if (dhd_print_health_chk_data(NULL, dhdp, 0, fp, len, pos) < 0)
+			return BCME_ERROR;
 	}
 #endif /* DHD_FW_COREDUMP && DNGL_EVENT_SUPPORT */
 
+	DHD_LOG_DUMP_SECTION(fp, "dhd_dump", *pos);
 	len = dhd_get_dhd_dump_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_dump_data(NULL, dhdp, 0, fp, len, &pos) < 0)
-			goto exit2;
+		if (dhd_print_dump_data(NULL, dhdp, 0, fp, len, pos) < 0)
+			return BCME_ERROR;
 	}
 
+	DHD_LOG_DUMP_SECTION(fp, "cookie", *pos);
 	len = dhd_get_cookie_log_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_cookie_data(NULL, dhdp, 0, fp, len, &pos) < 0)
-			goto exit2;
+		if (dhd_print_cookie_data(NULL, dhdp, 0, fp, len, pos) < 0)
+			return BCME_ERROR;
 	}
 
+	DHD_LOG_DUMP_SECTION(fp, "wrapper_reg", *pos);
 	len = dhd_get_wrapper_regdump_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_any_buffer_data(NULL, dhdp, NULL, fp, len, &pos,
+		if (dhd_print_any_buffer_data(NULL, dhdp, NULL, fp, len, pos,
 			LOG_DUMP_SECTION_WRAPPER_REG_DUMP, WRAPPER_REG_DUMP_LOG_HDR,
 			dhdp->dbg->wrapper_buf.buf) < 0) {
-			goto exit2;
+			return BCME_ERROR;
 		}
 	}
 
 #ifdef DHD_DUMP_PCIE_RINGS
+	DHD_LOG_DUMP_SECTION(fp, "flowring", *pos);
 	len = dhd_get_flowring_len(NULL, dhdp);
 	if (len) {
-		if (dhd_print_flowring_data(NULL, dhdp, 0, fp, len, &pos) < 0)
-			goto exit2;
+		if (dhd_print_flowring_data(NULL, dhdp, 0, fp, len, pos) < 0)
+			return BCME_ERROR;
 	}
 #endif /* DHD_DUMP_PCIE_RINGS */
 
 #ifdef DHD_MAP_PKTID_LOGGING
+	DHD_LOG_DUMP_SECTION(fp, "pktid_map", *pos);
 	/* dump pktid data for dma map */
 	len = dhd_get_pktid_map_logging_len(NULL, dhdp, TRUE);
 	if (len) {
 		if (dhd_print_pktid_map_log_data(NULL, dhdp, NULL,
-			fp, len, &pos, TRUE) < 0) {
-			goto exit2;
+			fp, len, pos, TRUE) < 0) {
+			return BCME_ERROR;
 		}
 	}
+	DHD_LOG_DUMP_SECTION(fp, "pktid_unmap", *pos);
 	/* dump pktid data for dma unmap */
 	len = dhd_get_pktid_map_logging_len(NULL, dhdp, FALSE);
 	if (len) {
 		if (dhd_print_pktid_map_log_data(NULL, dhdp, NULL,
-			fp, len, &pos, FALSE) < 0) {
-			goto exit2;
+			fp, len, pos, FALSE) < 0) {
+			return BCME_ERROR;
 		}
 	}
 #endif /* DHD_MAP_PKTID_LOGGING */
 
+	return BCME_OK;
+}
+
+/* Must hold 'dhd_os_logdump_lock' before calling this function ! */
+int
+do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type)
+{
+	int ret = 0;
+	struct file *fp = NULL;
+	MM_SEGMENT_T fs;
+	loff_t pos = 0;
+	char dump_path[128];
+	unsigned long flags = 0;
+	char time_str[128];
+	bool async = FALSE;
+#ifdef DHD_LOG_DUMP_ASYNC
+	dhd_log_dump_arena_t *arena;
+#endif /* DHD_LOG_DUMP_ASYNC */
+
+	BCM_REFERENCE(async);
+
+	DHD_PRINT(("%s: ENTER \n", __FUNCTION__));
+
+	DHD_GENERAL_LOCK(dhdp, flags);
+	if (DHD_BUS_CHECK_DOWN_OR_DOWN_IN_PROGRESS(dhdp)) {
+		DHD_GENERAL_UNLOCK(dhdp, flags);
+		DHD_ERROR(("%s: bus is down! can't collect log dump. \n", __FUNCTION__));
+		goto exit1;
+	}
+	DHD_BUS_BUSY_SET_IN_LOGDUMP(dhdp);
+	DHD_GENERAL_UNLOCK(dhdp, flags);
+
+	if ((ret = dhd_log_flush(dhdp, type)) < 0) {
+		goto exit1;
+	}
+
+	GETFS_AND_SETFS_TO_KERNEL_DS(fs);
+
+	dhd_get_debug_dump_file_name(NULL, dhdp, dump_path, sizeof(dump_path));
+
+	DHD_PRINT(("debug_dump_path = %s\n", dump_path));
+	DHD_PRINT(("DHD version: %s\n", dhd_version));
+	DHD_PRINT(("F/W version: %s\n", fw_version));
+
+	dhd_log_dump_buf_addr(dhdp, type);
+
+	dhd_get_time_str(dhdp, time_str, 128);
+
+#ifdef DHD_LOG_DUMP_ASYNC
+	arena = dhd_log_dump_arena_get(dhdp, dump_path);
+	if (arena) {
+		/* only the snapshot is taken with the bus marked busy,
+		 * the file is written by dhd_log_dump_arena_work
+		 */
+		if (dhd_log_dump_sections(dhdp, type, arena, &pos) < 0) {
+			DHD_ERROR(("%s: snapshot incomplete, %u bytes\n",
+				__FUNCTION__, arena->used));
+		}
+		dhd_log_dump_arena_put(arena, (uint32)pos);
+		async = TRUE;
+		goto exit2;
+	}
+#endif /* DHD_LOG_DUMP_ASYNC */
+
+	ret = dhd_log_dump_open_file(dhdp, dump_path, sizeof(dump_path), &fp);
+	if (ret < 0) {
+		goto exit2;
+	}
+
+	if (dhd_log_dump_sections(dhdp, type, fp, &pos) < 0) {
+		DHD_ERROR(("%s: failed to write all sections\n", __FUNCTION__));
+	}
+
 exit2:
 	if (!IS_ERR(fp) && fp != NULL) {
 		dhd_filp_close(fp, NULL);
@@ -1717,7 +2134,8 @@ exit1:
 	DHD_GENERAL_UNLOCK(dhdp, flags);
 
 #ifdef DHD_DUMP_MNGR
-	if (ret >= 0) {
+	/* an async dump is handed to the dump manager once it is on file */
+	if (ret >= 0 && !async) {
 		dhd_dump_file_manage_enqueue(dhdp, dump_path, DHD_DEBUG_DUMP_TYPE);
 	}
 #endif /* DHD_DUMP_MNGR */
@@ -2041,6 +2459,11 @@ dhd_log_dump_deinit(dhd_pub_t *dhd)
 
 	BCM_REFERENCE(ring);
 
+#ifdef DHD_LOG_DUMP_ASYNC
+	/* a snapshot still being written out uses dhd */
+	flush_work(&dhd_log_dump_arena_wk);
+#endif /* DHD_LOG_DUMP_ASYNC */
+
 	if (dhd->concise_dbg_buf) {
 		MFREE(dhd->osh, dhd->concise_dbg_buf, CONCISE_DUMP_BUFLEN);
 		dhd->concise_dbg_buf = NULL;
@@ -2362,8 +2785,11 @@ dhd_dump_debug_ring(dhd_pub_t *dhdp, void *ring_ptr, const void *user_buf,
 	}
 #endif /* DHD_DEBUGABILITY_DEBUG_DUMP */
 	/* do not allow further writes to the ring
-	 * till we flush it
+	 * till we flush it, staged records included
 	 */
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 	ring->state = RING_SUSPEND;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
@@ -2432,6 +2858,10 @@ dhd_dump_debug_ring(dhd_pub_t *dhdp, void *ring_ptr, const void *user_buf,
 	 */
 	ring->rp = ring->wp = 0;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
+	/* records that raced with the suspend were kept staged */
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 
 	return ret;
 }
@@ -2454,8 +2884,11 @@ dhd_log_dump_ring_to_file(dhd_pub_t *dhdp, void *ring_ptr, void *file,
 		return BCME_BADARG;
 
 	/* do not allow further writes to the ring
-	 * till we flush it
+	 * till we flush it, staged records included
 	 */
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 	DHD_DBG_RING_LOCK(ring->lock, flags);
 	ring->state = RING_SUSPEND;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
@@ -2489,6 +2922,9 @@ dhd_log_dump_ring_to_file(dhd_pub_t *dhdp, void *ring_ptr, void *file,
 					DHD_DBG_RING_LOCK(ring->lock, flags);
 					ring->state = RING_ACTIVE;
 					DHD_DBG_RING_UNLOCK(ring->lock, flags);
+#ifdef DHD_DBG_RING_PCPU_STAGE
+					dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 					return BCME_ERROR;
 				}
 			}
@@ -2508,6 +2944,10 @@ dhd_log_dump_ring_to_file(dhd_pub_t *dhdp, void *ring_ptr, void *file,
 	 */
 	ring->rp = ring->wp = 0;
 	DHD_DBG_RING_UNLOCK(ring->lock, flags);
+	/* records that raced with the suspend were kept staged */
+#ifdef DHD_DBG_RING_PCPU_STAGE
+	dhd_dbg_ring_merge(ring);
+#endif /* DHD_DBG_RING_PCPU_STAGE */
 	return BCME_OK;
 }
 
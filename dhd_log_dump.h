@@ -449,6 +449,11 @@ int do_dhd_log_dump(dhd_pub_t *dhdp, log_dump_type_t *type);
 void dhd_print_buf_addr(dhd_pub_t *dhdp, char *name, void *buf, unsigned int size);
 void dhd_log_dump_buf_addr(dhd_pub_t *dhdp, log_dump_type_t *type);
 int dhd_log_flush(dhd_pub_t *dhdp, log_dump_type_t *type);
+#ifdef DHD_LOG_DUMP_ASYNC
+bool dhd_log_dump_is_arena(void *fp);
+int dhd_log_dump_arena_write(void *fp, uint32 off, void *buf, uint32 len);
+void dhd_log_dump_async_flush(void);
+#endif /* DHD_LOG_DUMP_ASYNC */
 
 extern void get_debug_dump_time(char *str);
 extern void clear_debug_dump_time(char *str);
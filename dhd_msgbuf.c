@@ -728,6 +728,24 @@ uint dhd_ctrl_cpl_post_bound = DHD_CTRL_CPL_POST_BOUND;
  */
 #define PKTID_MAX_MAP_SZ_TXFLOWRING	(DHD_MAX_PKTID_16BITS - 1)
 
+#ifdef DHD_TXCPL_BULK_FREE
+#ifndef DHD_TXCPL_FREE_BATCH
+#define DHD_TXCPL_FREE_BATCH	64u	/* max TX packets held for one bulk free */
+#endif /* DHD_TXCPL_FREE_BATCH */
+#endif /* DHD_TXCPL_BULK_FREE */
+
+#ifdef DHD_MSGBUF_EMU
+#ifdef DHD_FAKE_TX_STATUS
+#error "DHD_MSGBUF_EMU makes its own txstatus, DHD_FAKE_TX_STATUS must be off"
+#endif /* DHD_FAKE_TX_STATUS */
+/* Serve the msgbuf rings from the host side dongle emulator, see dhd_msgbuf_emu_start() */
+uint msgbuf_emu = 0;
+/* Rx completions made per second by the emulator */
+uint msgbuf_emu_rx_pps = 0;
+/* Frame length of the emulated rx completions */
+uint msgbuf_emu_rx_len = 1500;
+#endif /* DHD_MSGBUF_EMU */
+
 #ifdef AGG_H2D_DB
 bool agg_h2d_db_enab = TRUE;
 
@@ -744,6 +762,34 @@ uint32 agg_h2d_db_inflight_thresh = AGG_H2D_DB_INFLIGHT_THRESH;
 #define DHD_NUM_INFLIGHT_HISTO_ROWS (14u)
 #define DHD_INFLIGHT_HISTO_SIZE (sizeof(uint64) * DHD_NUM_INFLIGHT_HISTO_ROWS)
 
+#ifdef AGG_H2D_DB_ADAPTIVE
+/* Pick the doorbell delay and inflight threshold from the observed load */
+bool agg_h2d_db_adaptive = TRUE;
+
+/* Load is sampled over epochs of this length before the operating point moves */
+#define AGG_H2D_DB_ADAPT_EPOCH_US	(5000u)
+
+/*
+ * Coalescing operating points, from lowest latency to fewest doorbells. A level is
+ * chosen while the txpost rate is at most max_rate items per msec. The last level
+ * matches the static AGG_H2D_DB_TIMEOUT_USEC/AGG_H2D_DB_INFLIGHT_THRESH defaults.
+ */
+typedef struct agg_h2d_db_profile {
+	uint32 timeout_us;	/* doorbell timer delay */
+	uint32 inflight_thresh;	/* ring the doorbell directly up to this many inflight */
+	uint32 max_rate;	/* txpost items per msec */
+} agg_h2d_db_profile_t;
+
+static const agg_h2d_db_profile_t agg_h2d_db_profiles[] = {
+	{ 50u,	128u,	8u },
+	{ 100u,	96u,	32u },
+	{ 250u,	64u,	128u },
+	{ 500u,	AGG_H2D_DB_INFLIGHT_THRESH,	512u },
+	{ AGG_H2D_DB_TIMEOUT_USEC,	AGG_H2D_DB_INFLIGHT_THRESH,	(uint32)-1 },
+};
+#define AGG_H2D_DB_NUM_LEVELS	ARRAYSIZE(agg_h2d_db_profiles)
+#endif /* AGG_H2D_DB_ADAPTIVE */
+
 typedef struct _agg_h2d_db_info {
 	void *dhd;
 	struct hrtimer timer;
@@ -751,6 +797,22 @@ typedef struct _agg_h2d_db_info {
 	uint32 direct_db_cnt;
 	uint32 timer_db_cnt;
 	uint64  *inflight_histo;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	spinlock_t epoch_lock;	/* flowring paths and the timer, the timer runs in isr */
+	uint32 level;		/* current index in agg_h2d_db_profiles */
+	uint32 timeout_us;	/* doorbell delay of the current level */
+	uint32 inflight_thresh;	/* direct doorbell threshold of the current level */
+	uint32 level_changes;
+	uint32 level_epochs[AGG_H2D_DB_NUM_LEVELS];	/* epochs spent at each level */
+	uint64 epoch_start_us;
+	uint32 epoch_items;	/* txpost items flushed in this epoch */
+	uint32 epoch_db;	/* doorbells rung in this epoch */
+	uint32 epoch_samples;	/* inflight samples in this epoch */
+	uint64 epoch_inflight;	/* sum of inflight samples in this epoch */
+	uint64 arm_ts_us;	/* when the doorbell timer was armed */
+	uint64 *db_delay_histo;	/* usec from timer arm to timer doorbell */
+	uint64 *db_rate_histo;	/* doorbells per msec, one sample per epoch */
+#endif /* AGG_H2D_DB_ADAPTIVE */
 } agg_h2d_db_info_t;
 #endif /* AGG_H2D_DB */
 
@@ -772,6 +834,9 @@ typedef struct dhd_prot {
 	osl_t *osh;		/* OSL handle */
 	uint16 rxbufpost_sz;		/* Size of rx buffer posted to dongle */
 	uint16 rxbufpost_alloc_sz;	/* Actual rx buffer packet allocated in the host */
+#ifdef OSL_PAGE_POOL
+	void *rx_page_pool;		/* page_pool with persistent DMA mapping for rx buffers */
+#endif /* OSL_PAGE_POOL */
 	uint16 rxbufpost;
 	uint16 rx_buf_burst;
 	uint16 rx_bufpost_threshold;
@@ -854,6 +919,11 @@ typedef struct dhd_prot {
 #endif /* EWP_EDL */
 	ulong d2h_sync_wait_max; /* max number of wait loops to receive one msg */
 	ulong d2h_sync_wait_tot; /* total wait loops */
+#ifdef DHD_D2H_SYNC_BATCH
+	ulong d2h_sync_batch_runs; /* runs validated by batch xorcsum */
+	ulong d2h_sync_batch_items; /* items validated by batch xorcsum */
+	ulong d2h_sync_batch_miss; /* runs ending before the last item */
+#endif /* DHD_D2H_SYNC_BATCH */
 
 	dhd_dmaxfer_t	dmaxfer; /* for test/DMA loopback */
 
@@ -948,6 +1018,21 @@ typedef struct dhd_prot {
 	msgbuf_ring_t *d2hring_mesh_rxcpl; /* D2H Mesh Rx completion ring */
 #endif /* DHD_MESH */
 	uint32 txcpl_db_cnt;
+#ifdef DHD_TXCPL_BULK_FREE
+	/* completed TX packets, freed in bulk at the end of each txcpl batch */
+	void *txcpl_free_pkts[DHD_TXCPL_FREE_BATCH];
+	uint32 txcpl_free_cnt;
+	uint64 txcpl_bulk_free;		/* bulk free calls */
+	uint64 txcpl_bulk_pkts;		/* packets freed in bulk */
+#endif /* DHD_TXCPL_BULK_FREE */
+#ifdef DHD_FAKE_TX_STATUS
+	uint32 fake_txcpl_seqnum;	/* producer side epoch of the host made txcpl ring */
+	uint32 fake_txcpl_cnt;		/* txcpl work items made by the host */
+	uint32 fake_txcpl_fail;		/* txpost without txcpl, txcpl ring full */
+#endif /* DHD_FAKE_TX_STATUS */
+#ifdef DHD_MSGBUF_EMU
+	struct dhd_msgbuf_emu *emu;	/* host side dongle emulator */
+#endif /* DHD_MSGBUF_EMU */
 #ifdef AGG_H2D_DB
 	agg_h2d_db_info_t agg_h2d_db_info;
 #endif /* AGG_H2D_DB */
@@ -1062,6 +1147,13 @@ void dhd_prot_dma_indx_set(dhd_pub_t *dhd, uint16 new_index, uint8 type,
 	uint16 ringid);
 static uint16 dhd_prot_dma_indx_get(dhd_pub_t *dhd, uint8 type, uint16 ringid);
 
+#ifdef DHD_MSGBUF_EMU
+static int dhd_msgbuf_emu_start(dhd_pub_t *dhd);
+static void dhd_msgbuf_emu_stop(dhd_pub_t *dhd);
+static void dhd_msgbuf_emu_detach(dhd_pub_t *dhd);
+static void dhd_msgbuf_emu_dump(dhd_pub_t *dhd, struct bcmstrbuf *b);
+#endif /* DHD_MSGBUF_EMU */
+
 /* Locate a packet given a pktid */
 static INLINE void *dhd_prot_packet_get(dhd_pub_t *dhd, uint32 pktid, uint8 pkttype,
 	bool free_pktid);
@@ -1360,6 +1452,13 @@ dhd_prot_get_rx_cpl_post_bound(dhd_pub_t *dhd)
 	return prot->rx_cpl_post_bound;
 }
 
+uint32
+dhd_prot_get_tot_rxcpl(dhd_pub_t *dhd)
+{
+	dhd_prot_t *prot = dhd->prot;
+	return prot->tot_rxcpl;
+}
+
 void
 dhd_prot_set_tx_post_bound(dhd_pub_t *dhd, uint32 val)
 {
@@ -1590,6 +1689,13 @@ static uint8 dhd_prot_d2h_sync_xorcsum(dhd_pub_t *dhd, msgbuf_ring_t *ring,
                                        volatile cmn_msg_hdr_t *msg, int msglen);
 static uint8 dhd_prot_d2h_sync_none(dhd_pub_t *dhd, msgbuf_ring_t *ring,
                                     volatile cmn_msg_hdr_t *msg, int msglen);
+#ifdef DHD_D2H_SYNC_BATCH
+static uint32 dhd_prot_d2h_sync_batch(dhd_pub_t *dhd, msgbuf_ring_t *ring,
+                                      uint8 *buf, uint32 nitems);
+#endif /* DHD_D2H_SYNC_BATCH */
+#ifdef DHD_TXCPL_BULK_FREE
+static void dhd_prot_txcpl_free_flush(dhd_pub_t *dhd);
+#endif /* DHD_TXCPL_BULK_FREE */
 static void dhd_prot_d2h_sync_init(dhd_pub_t *dhd);
 static int dhd_send_d2h_ringcreate(dhd_pub_t *dhd, msgbuf_ring_t *ring_to_create,
 	uint16 ring_type, uint32 id);
@@ -1839,6 +1945,100 @@ dma_completed:
 	return msg->msg_type;
 }
 
+#ifdef DHD_D2H_SYNC_BATCH
+/**
+ * dhd_prot_d2h_xor64 - XOR of one work item read as 64bit words, folded to 32bit.
+ * The fold yields the same result as bcm_compute_xor32 over the same bytes, so a
+ * good item still checks to zero. Caller ensures msglen is a multiple of 8 and
+ * msg is 8 byte aligned.
+ */
+static INLINE uint32
+dhd_prot_d2h_xor64(const uint64 *msg, int num_u64)
+{
+	uint64 xor64 = 0;
+	int idx = 0;
+
+	/* Work items are 16/24/32/40 bytes, unroll in pairs */
+	for (; idx + 1 < num_u64; idx += 2) {
+		xor64 ^= msg[idx] ^ msg[idx + 1];
+	}
+	if (idx < num_u64) {
+		xor64 ^= msg[idx];
+	}
+
+	return (uint32)(xor64 ^ (xor64 >> 32));
+}
+
+/**
+ * dhd_prot_d2h_sync_batch - Validate a contiguous run of D2H work items in XORCSUM
+ * mode in one pass, before the items are consumed. Returns the number of leading
+ * items whose epoch and xorcsum are good; the caller may consume them through
+ * dhd_prot_d2h_sync_item without the per item sync. The first item that does not
+ * validate, and everything after it, goes through d2h_sync_cb which retains the
+ * retry and livelock handling. ring->seqnum is only advanced as items are consumed.
+ */
+static uint32
+BCMFASTPATH(dhd_prot_d2h_sync_batch)(dhd_pub_t *dhd, msgbuf_ring_t *ring,
+                        uint8 *buf, uint32 nitems)
+{
+	dhd_prot_t *prot = dhd->prot;
+	uint16 item_len = ring->item_len;
+	uint32 seqnum = ring->seqnum;
+	uint32 cnt;
+
+	if ((prot->d2h_sync_cb != dhd_prot_d2h_sync_xorcsum) || (nitems == 0) ||
+		(dhd->dhd_induce_error == DHD_INDUCE_LIVELOCK)) {
+		return 0;
+	}
+
+	if (((item_len & (sizeof(uint64) - 1)) == 0) &&
+		ISALIGNED(buf, sizeof(uint64))) {
+		int num_u64 = item_len / sizeof(uint64);
+
+		for (cnt = 0; cnt < nitems; cnt++, buf += item_len, seqnum++) {
+			if ((((cmn_msg_hdr_t *)buf)->epoch != (seqnum % D2H_EPOCH_MODULO)) ||
+				(dhd_prot_d2h_xor64((const uint64 *)buf, num_u64) != 0U)) {
+				break;
+			}
+		}
+	} else {
+		int num_words = item_len / sizeof(uint32);
+
+		for (cnt = 0; cnt < nitems; cnt++, buf += item_len, seqnum++) {
+			if ((((cmn_msg_hdr_t *)buf)->epoch != (seqnum % D2H_EPOCH_MODULO)) ||
+				(bcm_compute_xor32((volatile uint32 *)buf, num_words) != 0U)) {
+				break;
+			}
+		}
+	}
+
+	prot->d2h_sync_batch_runs++;
+	prot->d2h_sync_batch_items += cnt;
+	if (cnt < nitems) {
+		prot->d2h_sync_batch_miss++;
+	}
+
+	return cnt;
+}
+
+/**
+ * dhd_prot_d2h_sync_item - Return the msg_type of an item that was already
+ * validated by dhd_prot_d2h_sync_batch, else sync on it through d2h_sync_cb.
+ */
+static INLINE uint8
+dhd_prot_d2h_sync_item(dhd_pub_t *dhd, msgbuf_ring_t *ring,
+	cmn_msg_hdr_t *msg, int msglen, uint32 *batch_ok)
+{
+	if (*batch_ok) {
+		(*batch_ok)--;
+		ring->seqnum++; /* next expected sequence number */
+		return msg->msg_type;
+	}
+
+	return dhd->prot->d2h_sync_cb(dhd, ring, msg, msglen);
+}
+#endif /* DHD_D2H_SYNC_BATCH */
+
 /**
  * dhd_prot_d2h_sync_none - Dongle ensure that the DMA will complete and host
  * need to try to sync. This noop sync handler will be bound when the dongle
@@ -2054,12 +2254,20 @@ dhd_prot_d2h_sync_init(dhd_pub_t *dhd)
 	dhd_prot_t *prot = dhd->prot;
 	prot->d2h_sync_wait_max = 0UL;
 	prot->d2h_sync_wait_tot = 0UL;
+#ifdef DHD_D2H_SYNC_BATCH
+	prot->d2h_sync_batch_runs = 0UL;
+	prot->d2h_sync_batch_items = 0UL;
+	prot->d2h_sync_batch_miss = 0UL;
+#endif /* DHD_D2H_SYNC_BATCH */
 
 	prot->d2hring_ctrl_cpln.seqnum = D2H_EPOCH_INIT_VAL;
 	prot->d2hring_ctrl_cpln.current_phase = BCMPCIE_CMNHDR_PHASE_BIT_INIT;
 
 	prot->d2hring_tx_cpln.seqnum = D2H_EPOCH_INIT_VAL;
 	prot->d2hring_tx_cpln.current_phase = BCMPCIE_CMNHDR_PHASE_BIT_INIT;
+#ifdef DHD_FAKE_TX_STATUS
+	prot->fake_txcpl_seqnum = D2H_EPOCH_INIT_VAL;
+#endif /* DHD_FAKE_TX_STATUS */
 
 	prot->d2hring_rx_cpln.seqnum = D2H_EPOCH_INIT_VAL;
 	prot->d2hring_rx_cpln.current_phase = BCMPCIE_CMNHDR_PHASE_BIT_INIT;
@@ -2687,6 +2895,50 @@ typedef enum dhd_pktid_map_type {
 	} while (0)
 #endif /* !USE_DHD_PKTID_LOCK */
 
+typedef uint32 dhd_pktid_key_t;
+
+/*
+ * DHD_PKTID_PCPU_CACHE: Per CPU magazine of free numbered keys in front of the
+ * global keys[] stack. A CPU allocates from and frees into its own magazine
+ * with only local preemption protection. The shared pktid_lock is taken once
+ * per DHD_PKTID_PCPU_CACHE_BATCH keys, to refill an empty magazine or to flush
+ * half of a full magazine back to the global stack. Lockers are owned by the
+ * holder of the numbered key, so saving into and retrieving from a locker does
+ * not need the shared lock. Maps smaller than DHD_PKTID_PCPU_CACHE_MIN_ITEMS
+ * per possible CPU (e.g. ctrl/ioctl maps) keep using the global stack only,
+ * as keys parked in remote magazines could otherwise deplete the pool.
+ */
+#if defined(DHD_PKTID_PCPU_CACHE)
+#if !defined(__linux__)
+#error "DHD_PKTID_PCPU_CACHE only supported on LINUX"
+#endif /* !__linux__ */
+#include <linux/percpu.h>
+
+#ifndef DHD_PKTID_PCPU_CACHE_SZ
+#define DHD_PKTID_PCPU_CACHE_SZ		64u
+#endif /* DHD_PKTID_PCPU_CACHE_SZ */
+#define DHD_PKTID_PCPU_CACHE_BATCH	(DHD_PKTID_PCPU_CACHE_SZ / 2u)
+#define DHD_PKTID_PCPU_CACHE_MIN_ITEMS	(DHD_PKTID_PCPU_CACHE_SZ * 8u)
+
+typedef struct dhd_pktid_pcpu_cache {
+	uint32 count;	/* number of free keys held in this magazine */
+	dhd_pktid_key_t keys[DHD_PKTID_PCPU_CACHE_SZ];
+} dhd_pktid_pcpu_cache_t;
+
+/* Serialize against the same CPU only; contexts mirror those of pktid_lock */
+#ifdef DHD_USE_SPIN_LOCK_BH
+#define DHD_PKTID_PCPU_LOCK(flags)	\
+	do { \
+		BCM_REFERENCE(flags); \
+		local_bh_disable(); \
+	} while (0)
+#define DHD_PKTID_PCPU_UNLOCK(flags)	local_bh_enable()
+#else
+#define DHD_PKTID_PCPU_LOCK(flags)	local_irq_save(flags)
+#define DHD_PKTID_PCPU_UNLOCK(flags)	local_irq_restore(flags)
+#endif /* DHD_USE_SPIN_LOCK_BH */
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 typedef enum dhd_locker_state {
 	LOCKER_IS_FREE,
 	LOCKER_IS_BUSY,
@@ -2708,14 +2960,17 @@ typedef struct dhd_pktid_item {
 
 } dhd_pktid_item_t;
 
-typedef uint32 dhd_pktid_key_t;
-
 typedef struct dhd_pktid_map {
 	uint32      items;    /* total items in map */
 	uint32      avail;    /* total available items */
 	int         failures; /* lockers unavailable count */
 	/* Spinlock to protect dhd_pktid_map in process/tasklet context */
 	void        *pktid_lock; /* Used when USE_DHD_PKTID_LOCK is defined */
+#if defined(DHD_PKTID_PCPU_CACHE)
+	dhd_pktid_pcpu_cache_t __percpu *pcpu_cache; /* NULL if map is too small */
+	uint32      pcpu_refills; /* magazine refills from keys[] stack */
+	uint32      pcpu_flushes; /* magazine flushes into keys[] stack */
+#endif /* DHD_PKTID_PCPU_CACHE */
 
 #if defined(DHD_PKTID_AUDIT_ENABLED)
 	void		*pktid_audit_lock;
@@ -2978,6 +3233,91 @@ dhd_pktid_audit_ring_debug(dhd_pub_t *dhdp, dhd_pktid_map_t *map, uint32 pktid,
  * +---------------------------------------------------------------------------+
  */
 
+#if defined(DHD_PKTID_PCPU_CACHE)
+/** Empty all per CPU magazines. Caller holds pktid_lock and rebuilds keys[] */
+static void
+dhd_pktid_pcpu_cache_reset(dhd_pktid_map_t *map)
+{
+	int cpu;
+
+	if (map->pcpu_cache == NULL) {
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		per_cpu_ptr(map->pcpu_cache, cpu)->count = 0;
+	}
+}
+
+/**
+ * Pop up to a batch of free keys from the global keys[] stack into an empty
+ * magazine. Caller holds DHD_PKTID_PCPU_LOCK. Returns number of keys moved.
+ */
+static uint32
+BCMFASTPATH(dhd_pktid_pcpu_cache_refill)(dhd_pktid_map_t *map,
+	dhd_pktid_pcpu_cache_t *cache)
+{
+	uint32 cnt;
+	unsigned long flags;
+
+	DHD_PKTID_LOCK(map->pktid_lock, flags);
+
+	cnt = MIN(map->avail, DHD_PKTID_PCPU_CACHE_BATCH);
+	if (cnt == 0) {
+		map->failures++;
+	} else {
+		ASSERT(map->avail <= map->items);
+		map->pcpu_refills++;
+		while (cache->count < cnt) {
+			cache->keys[cache->count++] = map->keys[map->avail--];
+		}
+	}
+
+	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+
+	return cnt;
+}
+
+/**
+ * Push a batch of free keys from a full magazine back onto the global keys[]
+ * stack. Caller holds DHD_PKTID_PCPU_LOCK.
+ */
+static void
+BCMFASTPATH(dhd_pktid_pcpu_cache_flush)(dhd_pktid_map_t *map,
+	dhd_pktid_pcpu_cache_t *cache)
+{
+	uint32 cnt;
+	unsigned long flags;
+
+	DHD_PKTID_LOCK(map->pktid_lock, flags);
+
+	map->pcpu_flushes++;
+	for (cnt = 0; cnt < DHD_PKTID_PCPU_CACHE_BATCH; cnt++) {
+		map->keys[++map->avail] = cache->keys[--cache->count];
+	}
+	ASSERT(map->avail <= map->items);
+
+	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+}
+
+/* Lockers are owned by the key holder when magazines are in use */
+#define DHD_PKTID_MAP_LOCK(map, flags) \
+	do { \
+		if ((map)->pcpu_cache == NULL) { \
+			DHD_PKTID_LOCK((map)->pktid_lock, flags); \
+		} \
+	} while (0)
+#define DHD_PKTID_MAP_UNLOCK(map, flags) \
+	do { \
+		if ((map)->pcpu_cache == NULL) { \
+			DHD_PKTID_UNLOCK((map)->pktid_lock, flags); \
+		} \
+	} while (0)
+#else
+#define DHD_PKTID_MAP_LOCK(map, flags)		DHD_PKTID_LOCK((map)->pktid_lock, flags)
+#define DHD_PKTID_MAP_UNLOCK(map, flags)	DHD_PKTID_UNLOCK((map)->pktid_lock, flags)
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 /** Allocate and initialize a mapper of num_items <numbered_key, locker> */
 
 static dhd_pktid_map_handle_t *
@@ -3002,6 +3342,9 @@ dhd_pktid_map_init(dhd_pub_t *dhd, uint32 num_items)
 
 	map->items = num_items;
 	map->avail = num_items;
+#if defined(DHD_PKTID_PCPU_CACHE)
+	map->pcpu_cache = NULL;
+#endif /* DHD_PKTID_PCPU_CACHE */
 
 	map_items = DHD_PKIDMAP_ITEMS(map->items);
 
@@ -3021,6 +3364,19 @@ dhd_pktid_map_init(dhd_pub_t *dhd, uint32 num_items)
 		goto error;
 	}
 
+#if defined(DHD_PKTID_PCPU_CACHE)
+	map->pcpu_refills = 0;
+	map->pcpu_flushes = 0;
+	if (num_items >= (DHD_PKTID_PCPU_CACHE_MIN_ITEMS * num_possible_cpus())) {
+		map->pcpu_cache = alloc_percpu(dhd_pktid_pcpu_cache_t);
+		if (map->pcpu_cache == NULL) {
+			/* Not fatal, fall back to the global keys[] stack */
+			DHD_ERROR(("%s:%d: alloc_percpu failed for pcpu_cache\n",
+				__FUNCTION__, __LINE__));
+		}
+	}
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 #if defined(DHD_PKTID_AUDIT_ENABLED)
 		/* Incarnate a hierarchical multiword bitmap for auditing pktid allocator */
 		map->pktid_audit = bcm_mwbmap_init(osh, map_items + 1);
@@ -3068,6 +3424,12 @@ error:
 			VMFREE(osh, map->keys, map_keys_sz);
 		}
 
+#if defined(DHD_PKTID_PCPU_CACHE)
+		if (map->pcpu_cache) {
+			free_percpu(map->pcpu_cache);
+		}
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 		if (map->pktid_lock) {
 			DHD_PKTID_LOCK_DEINIT(osh, map->pktid_lock);
 		}
@@ -3077,6 +3439,21 @@ error:
 	return (dhd_pktid_map_handle_t *)NULL;
 }
 
+/* Rx buffers from the page pool keep their mapping, the CPU only needs a sync */
+#ifdef OSL_PAGE_POOL
+#define DHD_RX_DMA_UNMAP(dhd, pkt, pa, len, dir, dmah) \
+	do { \
+		if (PKTISPAGEPOOL((dhd)->osh, (pkt))) { \
+			osl_page_pool_sync_for_cpu((dhd)->osh, (pa), (len)); \
+		} else { \
+			DMA_UNMAP((dhd)->osh, (pa), (len), (dir), 0, (dmah)); \
+		} \
+	} while (0)
+#else
+#define DHD_RX_DMA_UNMAP(dhd, pkt, pa, len, dir, dmah) \
+	DMA_UNMAP((dhd)->osh, (pa), (len), (dir), 0, (dmah))
+#endif /* OSL_PAGE_POOL */
+
 /**
  * Retrieve all allocated keys and free all <numbered_key, locker>.
  * Freeing implies: unmapping the buffers and freeing the native packet
@@ -3122,7 +3499,12 @@ dhd_pktid_map_reset(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle)
 				locker->pkttype);
 #endif /* DHD_MAP_PKTID_LOGGING */
 
-			DMA_UNMAP(osh, locker->pa, locker->len, locker->dir, 0, locker->dmah);
+			/* the mapping of a page pool buffer belongs to the pool */
+			if ((locker->pkttype != PKTTYPE_DATA_RX) ||
+				!PKTISPAGEPOOL(osh, locker->pkt)) {
+				DMA_UNMAP(osh, locker->pa, locker->len, locker->dir, 0,
+					locker->dmah);
+			}
 			dhd_prot_packet_free(dhd, (ulong*)locker->pkt,
 				locker->pkttype, data_tx);
 		}
@@ -3136,6 +3518,9 @@ dhd_pktid_map_reset(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle)
 
 	map->avail = map_items;
 	bzero(&map->lockers[1], sizeof(dhd_pktid_item_t) * map_items);
+#if defined(DHD_PKTID_PCPU_CACHE)
+	dhd_pktid_pcpu_cache_reset(map);
+#endif /* DHD_PKTID_PCPU_CACHE */
 	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
 }
 
@@ -3182,6 +3567,9 @@ dhd_pktid_map_reset_ioctl(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle)
 
 	map->avail = map_items;
 	bzero(&map->lockers[1], sizeof(dhd_pktid_item_t) * map_items);
+#if defined(DHD_PKTID_PCPU_CACHE)
+	dhd_pktid_pcpu_cache_reset(map);
+#endif /* DHD_PKTID_PCPU_CACHE */
 	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
 }
 #endif /* IOCTLRESP_USE_CONSTMEM */
@@ -3208,6 +3596,12 @@ dhd_pktid_map_fini(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle)
 	map_keys_sz = DHD_PKTIDMAP_KEYS_SZ(map->items);
 
 	DHD_PKTID_LOCK_DEINIT(dhd->osh, map->pktid_lock);
+#if defined(DHD_PKTID_PCPU_CACHE)
+	if (map->pcpu_cache) {
+		free_percpu(map->pcpu_cache);
+		map->pcpu_cache = NULL;
+	}
+#endif /* DHD_PKTID_PCPU_CACHE */
 
 #if defined(DHD_PKTID_AUDIT_ENABLED)
 	if (map->pktid_audit != (struct bcm_mwbmap *)NULL) {
@@ -3241,6 +3635,12 @@ dhd_pktid_map_fini_ioctl(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle)
 	map_keys_sz = DHD_PKTIDMAP_KEYS_SZ(map->items);
 
 	DHD_PKTID_LOCK_DEINIT(dhd->osh, map->pktid_lock);
+#if defined(DHD_PKTID_PCPU_CACHE)
+	if (map->pcpu_cache) {
+		free_percpu(map->pcpu_cache);
+		map->pcpu_cache = NULL;
+	}
+#endif /* DHD_PKTID_PCPU_CACHE */
 
 #if defined(DHD_PKTID_AUDIT_ENABLED)
 	if (map->pktid_audit != (struct bcm_mwbmap *)NULL) {
@@ -3272,6 +3672,17 @@ BCMFASTPATH(dhd_pktid_map_avail_cnt)(dhd_pktid_map_handle_t *handle)
 	avail = map->avail;
 	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
 
+#if defined(DHD_PKTID_PCPU_CACHE)
+	if (map->pcpu_cache) {
+		int cpu;
+
+		/* Approximate, magazines are not locked */
+		for_each_possible_cpu(cpu) {
+			avail += READ_ONCE(per_cpu_ptr(map->pcpu_cache, cpu)->count);
+		}
+	}
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 	return avail;
 }
 
@@ -3294,6 +3705,41 @@ dhd_pktid_map_reserve(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 	ASSERT(handle != NULL);
 	map = (dhd_pktid_map_t *)handle;
 
+#if defined(DHD_PKTID_PCPU_CACHE)
+	if (map->pcpu_cache) {
+		dhd_pktid_pcpu_cache_t *cache;
+
+		flags = 0;
+		DHD_PKTID_PCPU_LOCK(flags);
+		cache = this_cpu_ptr(map->pcpu_cache);
+		if ((cache->count == 0) &&
+			(dhd_pktid_pcpu_cache_refill(map, cache) == 0)) {
+			DHD_PKTID_PCPU_UNLOCK(flags);
+			DHD_INFO(("%s:%d: failed, no free keys\n", __FUNCTION__, __LINE__));
+			return DHD_PKTID_INVALID; /* failed alloc request */
+		}
+		nkey = cache->keys[--cache->count]; /* fetch a free locker, pop magazine */
+
+		if ((nkey == DHD_PKTID_INVALID) || (nkey > map->items)) {
+			/* push it back, as the locked path leaves it on the stack */
+			cache->count++;
+			DHD_PKTID_PCPU_UNLOCK(flags);
+			DHD_ERROR(("%s:%d: failed to allocate a new pktid,"
+				" nkey<%u>, pkttype<%u>\n",
+				__FUNCTION__, __LINE__, nkey, pkttype));
+			return DHD_PKTID_INVALID; /* failed alloc request */
+		}
+		DHD_PKTID_PCPU_UNLOCK(flags);
+
+		locker = &map->lockers[nkey]; /* save packet metadata in locker */
+		locker->pkt = pkt; /* pkt is saved, other params not yet saved. */
+		locker->len = 0;
+		locker->state = LOCKER_IS_BUSY; /* reserve this locker */
+
+		return nkey; /* return locker's numbered key */
+	}
+#endif /* DHD_PKTID_PCPU_CACHE */
+
 	DHD_PKTID_LOCK(map->pktid_lock, flags);
 
 	if ((int)(map->avail) <= 0) { /* no more pktids to allocate */
@@ -3341,18 +3787,18 @@ dhd_pktid_map_save(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle, void *pkt,
 {
 	dhd_pktid_map_t *map;
 	dhd_pktid_item_t *locker;
-	unsigned long flags;
+	unsigned long flags = 0;
 
 	ASSERT(handle != NULL);
 	map = (dhd_pktid_map_t *)handle;
 
-	DHD_PKTID_LOCK(map->pktid_lock, flags);
+	DHD_PKTID_MAP_LOCK(map, flags);
 
 	if ((nkey == DHD_PKTID_INVALID) || (nkey > DHD_PKIDMAP_ITEMS(map->items)) ||
 			(dhd->dhd_induce_error == DHD_INDUCE_PKTID_INVALID_SAVE)) {
 		DHD_ERROR(("%s:%d: Error! saving invalid pktid<%u> pkttype<%u>\n",
 			__FUNCTION__, __LINE__, nkey, pkttype));
-		DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+		DHD_PKTID_MAP_UNLOCK(map, flags);
 #ifdef DHD_FW_COREDUMP
 		if (dhd->memdump_enabled) {
 			dhd->pktid_invalid_occured = TRUE;
@@ -3388,7 +3834,7 @@ dhd_pktid_map_save(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle, void *pkt,
 #ifdef DHD_MAP_PKTID_LOGGING
 	DHD_PKTID_LOG(dhd, dhd->prot->pktid_dma_map, pa, nkey, len, pkttype);
 #endif /* DHD_MAP_PKTID_LOGGING */
-	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+	DHD_PKTID_MAP_UNLOCK(map, flags);
 }
 
 /**
@@ -3427,20 +3873,20 @@ BCMFASTPATH(dhd_pktid_map_free)(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 	dhd_pktid_item_t *locker;
 	void * pkt;
 	unsigned long long locker_addr;
-	unsigned long flags;
+	unsigned long flags = 0;
 
 	ASSERT(handle != NULL);
 
 	map = (dhd_pktid_map_t *)handle;
 
-	DHD_PKTID_LOCK(map->pktid_lock, flags);
+	DHD_PKTID_MAP_LOCK(map, flags);
 
 	/* PLEASE DO NOT remove this ASSERT, fix the bug in caller. */
 	if ((nkey == DHD_PKTID_INVALID) || (nkey > DHD_PKIDMAP_ITEMS(map->items)) ||
 			(dhd->dhd_induce_error == DHD_INDUCE_PKTID_INVALID_FREE)) {
 		DHD_ERROR(("%s:%d: Error! Try to free invalid pktid<%u>, pkttype<%d>\n",
 		           __FUNCTION__, __LINE__, nkey, pkttype));
-		DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+		DHD_PKTID_MAP_UNLOCK(map, flags);
 #ifdef DHD_FW_COREDUMP
 		if (dhd->memdump_enabled) {
 			dhd->pktid_invalid_occured = TRUE;
@@ -3468,7 +3914,7 @@ BCMFASTPATH(dhd_pktid_map_free)(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 	if (locker->state == LOCKER_IS_FREE) {
 		DHD_ERROR(("%s:%d: Error! freeing already freed invalid pktid<%u>\n",
 		           __FUNCTION__, __LINE__, nkey));
-		DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+		DHD_PKTID_MAP_UNLOCK(map, flags);
 		/* PLEASE DO NOT remove this ASSERT, fix the bug in caller. */
 #ifdef DHD_FW_COREDUMP
 		if (dhd->memdump_enabled) {
@@ -3504,7 +3950,7 @@ BCMFASTPATH(dhd_pktid_map_free)(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 			"pkttype <%d> locker->pa <0x%llx> \n",
 			__FUNCTION__, __LINE__, locker->state, locker->pkttype,
 			pkttype, locker_addr));
-		DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+		DHD_PKTID_MAP_UNLOCK(map, flags);
 #ifdef DHD_FW_COREDUMP
 		if (dhd->memdump_enabled) {
 			dhd->pktid_invalid_occured = TRUE;
@@ -3522,23 +3968,12 @@ BCMFASTPATH(dhd_pktid_map_free)(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 		return NULL;
 	}
 
-	if (rsv_locker == DHD_PKTID_FREE_LOCKER) {
-		map->avail++;
-		map->keys[map->avail] = nkey; /* make this numbered key available */
-		locker->state = LOCKER_IS_FREE; /* open and free Locker */
-	} else {
-		/* pktid will be reused, but the locker does not have a valid pkt */
-		locker->state = LOCKER_IS_RSVD;
-	}
-
-#if defined(DHD_PKTID_AUDIT_MAP)
-	DHD_PKTID_AUDIT(dhd, map, nkey, DHD_TEST_IS_FREE);
-#endif /* DHD_PKTID_AUDIT_MAP */
 #ifdef DHD_MAP_PKTID_LOGGING
 	DHD_PKTID_LOG(dhd, dhd->prot->pktid_dma_unmap, locker->pa, nkey,
 		(uint32)locker->len, pkttype);
 #endif /* DHD_MAP_PKTID_LOGGING */
 
+	/* Empty the locker before its key may be handed out again */
 	*pa = locker->pa; /* return contents of locker */
 	*len = (uint32)locker->len;
 	*dmah = locker->dmah;
@@ -3548,7 +3983,35 @@ BCMFASTPATH(dhd_pktid_map_free)(dhd_pub_t *dhd, dhd_pktid_map_handle_t *handle,
 	locker->pkt = NULL; /* Clear pkt */
 	locker->len = 0;
 
-	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+#if defined(DHD_PKTID_AUDIT_MAP)
+	DHD_PKTID_AUDIT(dhd, map, nkey, DHD_TEST_IS_FREE);
+#endif /* DHD_PKTID_AUDIT_MAP */
+
+	if (rsv_locker == DHD_PKTID_FREE_LOCKER) {
+		locker->state = LOCKER_IS_FREE; /* open and free Locker */
+#if defined(DHD_PKTID_PCPU_CACHE)
+		if (map->pcpu_cache) {
+			dhd_pktid_pcpu_cache_t *cache;
+			unsigned long pflags = 0;
+
+			DHD_PKTID_PCPU_LOCK(pflags);
+			cache = this_cpu_ptr(map->pcpu_cache);
+			if (cache->count == DHD_PKTID_PCPU_CACHE_SZ) {
+				dhd_pktid_pcpu_cache_flush(map, cache);
+			}
+			cache->keys[cache->count++] = nkey; /* make this numbered key available */
+			DHD_PKTID_PCPU_UNLOCK(pflags);
+			return pkt;
+		}
+#endif /* DHD_PKTID_PCPU_CACHE */
+		map->avail++;
+		map->keys[map->avail] = nkey; /* make this numbered key available */
+	} else {
+		/* pktid will be reused, but the locker does not have a valid pkt */
+		locker->state = LOCKER_IS_RSVD;
+	}
+
+	DHD_PKTID_MAP_UNLOCK(map, flags);
 
 	return pkt;
 }
@@ -4464,6 +4927,13 @@ dhd_msgbuf_agg_h2d_db_timer_fn(struct hrtimer *timer)
 	prot = dhd->prot;
 
 	prot->agg_h2d_db_info.timer_db_cnt++;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	spin_lock(&agg_db_info->epoch_lock);
+	agg_db_info->epoch_db++;
+	dhd_histo_update(dhd, agg_db_info->db_delay_histo,
+		(uint32)(OSL_SYSUPTIME_US() - agg_db_info->arm_ts_us));
+	spin_unlock(&agg_db_info->epoch_lock);
+#endif /* AGG_H2D_DB_ADAPTIVE */
 	if (IDMA_ACTIVE(dhd)) {
 		db_index = IDMA_IDX0;
 		if (dhd->bus->sih) {
@@ -4489,14 +4959,123 @@ void
 dhd_msgbuf_agg_h2d_db_timer_start(dhd_prot_t *prot)
 {
 	agg_h2d_db_info_t *agg_db_info = &prot->agg_h2d_db_info;
+	uint32 timeout_us = agg_h2d_db_timeout;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	unsigned long flags;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 
 	/* Queue the timer only when it is not in the queue */
 	if (!hrtimer_active(&agg_db_info->timer)) {
-		hrtimer_start(&agg_db_info->timer, ns_to_ktime(agg_h2d_db_timeout * NSEC_PER_USEC),
+#ifdef AGG_H2D_DB_ADAPTIVE
+		spin_lock_irqsave(&agg_db_info->epoch_lock, flags);
+		if (agg_h2d_db_adaptive) {
+			timeout_us = agg_db_info->timeout_us;
+		}
+		agg_db_info->arm_ts_us = OSL_SYSUPTIME_US();
+		spin_unlock_irqrestore(&agg_db_info->epoch_lock, flags);
+#endif /* AGG_H2D_DB_ADAPTIVE */
+		hrtimer_start(&agg_db_info->timer, ns_to_ktime(timeout_us * NSEC_PER_USEC),
 				HRTIMER_MODE_REL);
 	}
 }
 
+#ifdef AGG_H2D_DB_ADAPTIVE
+static void
+dhd_agg_h2d_db_set_level(agg_h2d_db_info_t *agg_db_info, uint32 level)
+{
+	agg_db_info->level = level;
+	agg_db_info->timeout_us = agg_h2d_db_profiles[level].timeout_us;
+	agg_db_info->inflight_thresh = agg_h2d_db_profiles[level].inflight_thresh;
+}
+
+/**
+ * Adaptive doorbell coalescing, in the manner of NIC interrupt moderation. The txpost
+ * rate and mean inflight depth are sampled per epoch; the operating point follows the
+ * rate, one level further towards coalescing when the dongle already has more inflight
+ * than the level would ring directly for. It moves one level per epoch for hysteresis.
+ * Called from the flowring paths of every flow, returns the direct doorbell threshold.
+ */
+static uint32
+BCMFASTPATH(dhd_agg_h2d_db_adapt)(dhd_pub_t *dhd, uint32 items, uint32 inflight)
+{
+	agg_h2d_db_info_t *agg_db_info = &dhd->prot->agg_h2d_db_info;
+	uint64 now_us, elapsed_us;
+	uint32 rate, db_rate, avg_inflight = 0;
+	uint32 target, inflight_thresh;
+	unsigned long flags;
+
+	spin_lock_irqsave(&agg_db_info->epoch_lock, flags);
+	agg_db_info->epoch_items += items;
+	agg_db_info->epoch_inflight += inflight;
+	agg_db_info->epoch_samples++;
+
+	now_us = OSL_SYSUPTIME_US();
+	elapsed_us = now_us - agg_db_info->epoch_start_us;
+	if (elapsed_us < AGG_H2D_DB_ADAPT_EPOCH_US) {
+		goto exit;
+	}
+
+	rate = (uint32)DIV_U64_BY_U64((uint64)agg_db_info->epoch_items * 1000u, elapsed_us);
+	db_rate = (uint32)DIV_U64_BY_U64((uint64)agg_db_info->epoch_db * 1000u, elapsed_us);
+	if (agg_db_info->epoch_samples) {
+		avg_inflight = (uint32)DIV_U64_BY_U32(agg_db_info->epoch_inflight,
+			agg_db_info->epoch_samples);
+	}
+
+	for (target = 0; target < AGG_H2D_DB_NUM_LEVELS - 1; target++) {
+		if (rate <= agg_h2d_db_profiles[target].max_rate) {
+			break;
+		}
+	}
+	if ((avg_inflight > agg_h2d_db_profiles[target].inflight_thresh) &&
+		(target < AGG_H2D_DB_NUM_LEVELS - 1)) {
+		target++;
+	}
+
+	if (target != agg_db_info->level) {
+		dhd_agg_h2d_db_set_level(agg_db_info, (target > agg_db_info->level) ?
+			agg_db_info->level + 1 : agg_db_info->level - 1);
+		agg_db_info->level_changes++;
+	}
+
+	agg_db_info->level_epochs[agg_db_info->level]++;
+	dhd_histo_update(dhd, agg_db_info->db_rate_histo, db_rate);
+
+	agg_db_info->epoch_start_us = now_us;
+	agg_db_info->epoch_items = 0;
+	agg_db_info->epoch_db = 0;
+	agg_db_info->epoch_samples = 0;
+	agg_db_info->epoch_inflight = 0;
+
+exit:
+	inflight_thresh = agg_db_info->inflight_thresh;
+	spin_unlock_irqrestore(&agg_db_info->epoch_lock, flags);
+	return inflight_thresh;
+}
+
+static void
+dhd_agg_h2d_db_adapt_dump(dhd_pub_t *dhd, struct bcmstrbuf *strbuf)
+{
+	agg_h2d_db_info_t *agg_db_info = &dhd->prot->agg_h2d_db_info;
+	uint32 i;
+
+	bcm_bprintf(strbuf, "agg_h2d_db_adaptive:%d level:%u timeout_us:%u inflight_thresh:%u"
+		" level_changes:%u\n", agg_h2d_db_adaptive, agg_db_info->level,
+		agg_db_info->timeout_us, agg_db_info->inflight_thresh,
+		agg_db_info->level_changes);
+	bcm_bprintf(strbuf, "%5s %10s %15s %12s %10s\n",
+		"level", "timeout_us", "inflight_thresh", "max_rate/ms", "epochs");
+	for (i = 0; i < AGG_H2D_DB_NUM_LEVELS; i++) {
+		bcm_bprintf(strbuf, "%5u %10u %15u %12u %10u\n", i,
+			agg_h2d_db_profiles[i].timeout_us, agg_h2d_db_profiles[i].inflight_thresh,
+			agg_h2d_db_profiles[i].max_rate, agg_db_info->level_epochs[i]);
+	}
+	dhd_histo_tag_dump(dhd, strbuf, "bin");
+	dhd_histo_dump(dhd, strbuf, agg_db_info->db_delay_histo, "db_delay_us");
+	dhd_histo_dump(dhd, strbuf, agg_db_info->db_rate_histo, "db_per_ms");
+}
+#endif /* AGG_H2D_DB_ADAPTIVE */
+
 static void
 dhd_msgbuf_agg_h2d_db_timer_init(dhd_pub_t *dhd)
 {
@@ -4511,6 +5090,13 @@ dhd_msgbuf_agg_h2d_db_timer_init(dhd_pub_t *dhd)
 	agg_db_info->timer_db_cnt = 0;
 	agg_db_info->direct_db_cnt = 0;
 	agg_db_info->inflight_histo = (uint64 *)MALLOCZ(dhd->osh, DHD_INFLIGHT_HISTO_SIZE);
+#ifdef AGG_H2D_DB_ADAPTIVE
+	spin_lock_init(&agg_db_info->epoch_lock);
+	dhd_agg_h2d_db_set_level(agg_db_info, AGG_H2D_DB_NUM_LEVELS - 1);
+	agg_db_info->epoch_start_us = OSL_SYSUPTIME_US();
+	agg_db_info->db_delay_histo = dhd_histo_init(dhd);
+	agg_db_info->db_rate_histo = dhd_histo_init(dhd);
+#endif /* AGG_H2D_DB_ADAPTIVE */
 }
 
 static void
@@ -4523,6 +5109,12 @@ dhd_msgbuf_agg_h2d_db_timer_reset(dhd_pub_t *dhd)
 			MFREE(dhd->osh, agg_db_info->inflight_histo, DHD_INFLIGHT_HISTO_SIZE);
 		}
 		hrtimer_try_to_cancel(&agg_db_info->timer);
+#ifdef AGG_H2D_DB_ADAPTIVE
+		dhd_histo_deinit(dhd, agg_db_info->db_delay_histo);
+		agg_db_info->db_delay_histo = NULL;
+		dhd_histo_deinit(dhd, agg_db_info->db_rate_histo);
+		agg_db_info->db_rate_histo = NULL;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 		agg_db_info->init = FALSE;
 	}
 }
@@ -4547,6 +5139,12 @@ dhd_prot_clearcounts(dhd_pub_t *dhd)
 	}
 	agg_db_info->direct_db_cnt = 0;
 	agg_db_info->timer_db_cnt = 0;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	dhd_histo_clear(dhd, agg_db_info->db_delay_histo);
+	dhd_histo_clear(dhd, agg_db_info->db_rate_histo);
+	bzero(agg_db_info->level_epochs, sizeof(agg_db_info->level_epochs));
+	agg_db_info->level_changes = 0;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 #endif /* AGG_H2D_DB */
 	prot->txcpl_db_cnt = 0;
 	prot->tx_h2d_db_cnt = 0;
@@ -4873,6 +5471,18 @@ dhd_prot_init(dhd_pub_t *dhd)
 		}
 	}
 
+#ifdef DHD_MSGBUF_EMU
+	/* Rings are set up, from here on they are served by the host side emulator.
+	 * It is refused while firmware is loaded, the rings then stay with the dongle.
+	 */
+	if (msgbuf_emu) {
+		ret = dhd_msgbuf_emu_start(dhd);
+		if ((ret != BCME_OK) && (ret != BCME_BUSY)) {
+			return ret;
+		}
+	}
+#endif /* DHD_MSGBUF_EMU */
+
 	/* Host should configure soft doorbells if needed ... here */
 
 	/* Post to dongle host configured soft doorbells */
@@ -5004,6 +5614,9 @@ void dhd_prot_detach(dhd_pub_t *dhd)
 		 * so call prot_reset here. It is harmless if called twice.
 		 */
 		dhd_prot_reset(dhd);
+#ifdef DHD_MSGBUF_EMU
+		dhd_msgbuf_emu_detach(dhd);
+#endif /* DHD_MSGBUF_EMU */
 
 		/* free up all DMA-able buffers allocated during prot attach/init */
 
@@ -5094,6 +5707,10 @@ void dhd_prot_detach(dhd_pub_t *dhd)
 		DHD_NATIVE_TO_PKTID_FINI(dhd, prot->pktid_ctrl_map);
 		DHD_NATIVE_TO_PKTID_FINI(dhd, prot->pktid_rx_map);
 		DHD_NATIVE_TO_PKTID_FINI(dhd, prot->pktid_tx_map);
+#ifdef OSL_PAGE_POOL
+		osl_page_pool_destroy(dhd->osh, prot->rx_page_pool);
+		prot->rx_page_pool = NULL;
+#endif /* OSL_PAGE_POOL */
 #ifdef IOCTLRESP_USE_CONSTMEM
 		DHD_NATIVE_TO_PKTID_FINI_IOCTL(dhd, prot->pktid_map_handle_ioctl);
 #endif
@@ -5142,6 +5759,10 @@ dhd_prot_reset(dhd_pub_t *dhd)
 
 	dhd->ring_attached = FALSE;
 
+#ifdef DHD_MSGBUF_EMU
+	dhd_msgbuf_emu_stop(dhd);
+#endif /* DHD_MSGBUF_EMU */
+
 	dhd_prot_flowrings_pool_reset(dhd);
 
 	/* Reset Common MsgBuf Rings */
@@ -5271,6 +5892,11 @@ dhd_prot_reset(dhd_pub_t *dhd)
 	DHD_NATIVE_TO_PKTID_RESET(dhd, prot->pktid_ctrl_map);
 	DHD_NATIVE_TO_PKTID_RESET(dhd, prot->pktid_rx_map);
 	DHD_NATIVE_TO_PKTID_RESET(dhd, prot->pktid_tx_map);
+#ifdef OSL_PAGE_POOL
+	/* posted rx buffers are back with the pool, rx buffer size may change on re-init */
+	osl_page_pool_destroy(dhd->osh, prot->rx_page_pool);
+	prot->rx_page_pool = NULL;
+#endif /* OSL_PAGE_POOL */
 #ifdef IOCTLRESP_USE_CONSTMEM
 	DHD_NATIVE_TO_PKTID_RESET_IOCTL(dhd, prot->pktid_map_handle_ioctl);
 #endif /* IOCTLRESP_USE_CONSTMEM */
@@ -6218,6 +6844,17 @@ int dhd_sync_with_dongle(dhd_pub_t *dhd)
 	dhd_rx_pktpool_create(dhd->info, prot->rxbufpost_alloc_sz);
 #endif /* RX_PKT_POOL */
 
+#ifdef OSL_PAGE_POOL
+	/* Page pool for rx buffers, sized to hold every posted buffer */
+	if (!prot->rx_page_pool) {
+		prot->rx_page_pool = osl_page_pool_create(dhd->osh, prot->max_rxbufpost);
+		if (!prot->rx_page_pool) {
+			DHD_ERROR(("%s: rx page pool not available, using PKTGET\n",
+				__FUNCTION__));
+		}
+	}
+#endif /* OSL_PAGE_POOL */
+
 	/* Post buffers for packet reception */
 	dhd_msgbuf_rxbuf_post(dhd, FALSE); /* alloc pkt ids */
 
@@ -6765,6 +7402,9 @@ BCMFASTPATH(dhd_prot_rxbuf_post)(dhd_pub_t *dhd, uint16 count, bool use_rsv_pkti
 	uint32 pktid;
 	dhd_prot_t *prot = dhd->prot;
 	msgbuf_ring_t *ring = &prot->h2dring_rxp_subn;
+#ifdef OSL_PAGE_POOL
+	bool emerge;
+#endif /* OSL_PAGE_POOL */
 
 #ifdef BCM_ROUTER_DHD
 	prot->rxbufpost_sz = DHD_FLOWRING_RX_BUFPOST_PKTSZ + BCMEXTRAHDROOM;
@@ -6786,6 +7426,13 @@ BCMFASTPATH(dhd_prot_rxbuf_post)(dhd_pub_t *dhd, uint16 count, bool use_rsv_pkti
 		 * during rx flow control.
 		*/
 		p = dhd_rx_emerge_dequeue(dhd);
+#ifdef OSL_PAGE_POOL
+		emerge = (p != NULL);
+		if ((p == NULL) && prot->rx_page_pool) {
+			p = PKTGET_PAGE_POOL(dhd->osh, prot->rx_page_pool,
+				prot->rxbufpost_alloc_sz);
+		}
+#endif /* OSL_PAGE_POOL */
 		if ((p == NULL) &&
 			((p = PKTGET(dhd->osh, prot->rxbufpost_alloc_sz, FALSE)) == NULL)) {
 			dhd->rx_pktgetfail++;
@@ -6834,7 +7481,21 @@ BCMFASTPATH(dhd_prot_rxbuf_post)(dhd_pub_t *dhd, uint16 count, bool use_rsv_pkti
 			ASSERT(0);
 			break;
 		}
-		pa = DMA_MAP(dhd->osh, PKTDATA(dhd->osh, p), pktlen[i], DMA_RX, p, 0);
+#ifdef OSL_PAGE_POOL
+		if (PKTISPAGEPOOL(dhd->osh, p)) {
+			/* already mapped by the page pool, fresh pages are synced for
+			 * the device by the pool, recycled ones were synced for the cpu
+			 * on completion and must be handed back
+			 */
+			pa = osl_page_pool_dma_addr(dhd->osh, p);
+			if (emerge) {
+				osl_page_pool_sync_for_device(dhd->osh, pa, pktlen[i]);
+			}
+		} else
+#endif /* OSL_PAGE_POOL */
+		{
+			pa = DMA_MAP(dhd->osh, PKTDATA(dhd->osh, p), pktlen[i], DMA_RX, p, 0);
+		}
 
 		if (PHYSADDRISZERO(pa)) {
 			PKTFREE(dhd->osh, p, FALSE);
@@ -6962,7 +7623,7 @@ cleanup:
 		p = pktbuf[i];
 		pa = pktbuf_pa[i];
 
-		DMA_UNMAP(dhd->osh, pa, pktlen[i], DMA_RX, 0, DHD_DMAH_NULL);
+		DHD_RX_DMA_UNMAP(dhd, p, pa, pktlen[i], DMA_RX, DHD_DMAH_NULL);
 		PKTFREE(dhd->osh, p, FALSE);
 	}
 
@@ -8002,7 +8663,7 @@ BCMFASTPATH(dhd_prot_get_msgbuf_rxcpl_pkt)(dhd_pub_t *dhd, host_rxbuf_cmpl_item_
 	dhd->prot->tot_rxcpl++;
 
 	/* For Rx buffers, keep direction as bidirectional to handle packet fetch cases */
-	DMA_UNMAP(dhd->osh, pa, (uint) len, DMA_RXTX, 0, dmah);
+	DHD_RX_DMA_UNMAP(dhd, pkt, pa, (uint) len, DMA_RXTX, dmah);
 
 #ifdef DMAMAP_STATS
 	dhd->dma_stats.rxdata--;
@@ -8039,6 +8700,9 @@ BCMFASTPATH(dhd_prot_process_msgbuf_rxcpl)(dhd_pub_t *dhd, int ringtype, uint32
 	host_rxbuf_cmpl_t *msg = NULL;
 	uint8 *msg_addr;
 	uint32 msg_len;
+#ifdef DHD_D2H_SYNC_BATCH
+	uint32 batch_ok = 0;
+#endif /* DHD_D2H_SYNC_BATCH */
 	uint16 pkt_cnt = 0, pkt_cnt_newidx = 0;
 	unsigned long flags;
 	dmaaddr_t pa;
@@ -8114,12 +8778,20 @@ BCMFASTPATH(dhd_prot_process_msgbuf_rxcpl)(dhd_pub_t *dhd, int ringtype, uint32
 		}
 
 		*rxcpl_items = msg_len / ring->item_len;
+#ifdef DHD_D2H_SYNC_BATCH
+		batch_ok = dhd_prot_d2h_sync_batch(dhd, ring, msg_addr, *rxcpl_items);
+#endif /* DHD_D2H_SYNC_BATCH */
 
 		while (msg_len > 0) {
 			msg = (host_rxbuf_cmpl_t *)msg_addr;
 
 			/* Wait until DMA completes, then fetch msg_type */
+#ifdef DHD_D2H_SYNC_BATCH
+			sync = dhd_prot_d2h_sync_item(dhd, ring, &msg->cmn_hdr, item_len,
+				&batch_ok);
+#else
 			sync = prot->d2h_sync_cb(dhd, ring, &msg->cmn_hdr, item_len);
+#endif /* DHD_D2H_SYNC_BATCH */
 			/*
 			 * Update the curr_rd to the current index in the ring, from where
 			 * the work item is fetched. This way if the fetched work item
@@ -8216,7 +8888,7 @@ BCMFASTPATH(dhd_prot_process_msgbuf_rxcpl)(dhd_pub_t *dhd, int ringtype, uint32
 #endif /* CUSTOMER_HW6 */
 				prot->tot_rxcpl++;
 
-				DMA_UNMAP(dhd->osh, pa, (uint) len, DMA_RX, 0, dmah);
+				DHD_RX_DMA_UNMAP(dhd, pkt, pa, (uint) len, DMA_RX, dmah);
 
 #ifdef RX_CSO
 			if (RXCSO_ENAB(dhd)) {
@@ -8282,6 +8954,13 @@ BCMFASTPATH(dhd_prot_process_msgbuf_rxcpl)(dhd_pub_t *dhd, int ringtype, uint32
 #endif /* DHD_DBG_SHOW_METADATA */
 #endif /* !BCM_ROUTER_DHD */
 
+#ifdef DHD_MSGBUF_EMU
+				/* the emulator returns a buffer it could not fill with an error */
+				if (unlikely(ltoh16(msg->compl_hdr.status) != BCMPCIE_SUCCESS)) {
+					PKTFREE(dhd->osh, pkt, FALSE);
+					continue;
+				}
+#endif /* DHD_MSGBUF_EMU */
 #ifdef DHD_LB_RXP
 				/* If flow control is hit, do not enqueue the pkt into napi queue,
 				 * rather enque it in emergency queue and same will be dequeued
@@ -8710,6 +9389,9 @@ BCMFASTPATH(dhd_prot_process_msgtype)(dhd_pub_t *dhd, msgbuf_ring_t *ring, uint8
 	uint8 msg_type;
 	cmn_msg_hdr_t *msg = NULL;
 	int ret = BCME_OK;
+#ifdef DHD_D2H_SYNC_BATCH
+	uint32 batch_ok;
+#endif /* DHD_D2H_SYNC_BATCH */
 
 	ASSERT(ring);
 	item_len = ring->item_len;
@@ -8719,6 +9401,10 @@ BCMFASTPATH(dhd_prot_process_msgtype)(dhd_pub_t *dhd, msgbuf_ring_t *ring, uint8
 		return BCME_ERROR;
 	}
 
+#ifdef DHD_D2H_SYNC_BATCH
+	batch_ok = dhd_prot_d2h_sync_batch(dhd, ring, buf, buf_len / item_len);
+#endif /* DHD_D2H_SYNC_BATCH */
+
 	while (buf_len > 0) {
 		if (dhd->hang_was_sent) {
 			ret = BCME_ERROR;
@@ -8740,7 +9426,11 @@ BCMFASTPATH(dhd_prot_process_msgtype)(dhd_pub_t *dhd, msgbuf_ring_t *ring, uint8
 		msg = (cmn_msg_hdr_t *)buf;
 
 		/* Wait until DMA completes, then fetch msg_type */
+#ifdef DHD_D2H_SYNC_BATCH
+		msg_type = dhd_prot_d2h_sync_item(dhd, ring, msg, item_len, &batch_ok);
+#else
 		msg_type = dhd->prot->d2h_sync_cb(dhd, ring, msg, item_len);
+#endif /* DHD_D2H_SYNC_BATCH */
 
 		/*
 		 * Update the curr_rd to the current index in the ring, from where
@@ -8821,6 +9511,9 @@ done:
 #ifdef DHD_RX_CHAINING
 	dhd_rxchain_commit(dhd);
 #endif
+#ifdef DHD_TXCPL_BULK_FREE
+	dhd_prot_txcpl_free_flush(dhd);
+#endif /* DHD_TXCPL_BULK_FREE */
 
 	return ret;
 } /* dhd_prot_process_msgtype */
@@ -9180,22 +9873,58 @@ exit:
 }
 
 
-#ifdef DHD_AGGR_WI
+#ifdef DHD_TXCPL_BULK_FREE
+/**
+ * Free the TX packets held by dhd_prot_txcpl_pktfree. TX completions are only
+ * processed from the DPC, so the free list needs no lock.
+ */
 static void
-BCMFASTPATH(dhd_prot_txstatus_process_each_aggr_item)(dhd_pub_t *dhd, msgbuf_ring_t *ring,
-		host_txbuf_cmpl_aggr_t * txstatus, uint32 request_id)
+BCMFASTPATH(dhd_prot_txcpl_free_flush)(dhd_pub_t *dhd)
 {
 	dhd_prot_t *prot = dhd->prot;
-	unsigned long flags;
-	uint32 pktid;
-	void *pkt;
-	dmaaddr_t pa;
-	uint32 len;
-	void *dmah;
-	void *secdma;
-	bool pkt_fate;
-#ifdef AGG_H2D_DB
-	msgbuf_ring_t *flow_ring;
+
+	if (prot->txcpl_free_cnt == 0) {
+		return;
+	}
+
+	PKTFREE_BULK(dhd->osh, prot->txcpl_free_pkts, prot->txcpl_free_cnt);
+	prot->txcpl_bulk_free++;
+	prot->txcpl_bulk_pkts += prot->txcpl_free_cnt;
+	prot->txcpl_free_cnt = 0;
+}
+
+/** Hold a completed TX packet for the bulk free at the end of the txcpl batch */
+static INLINE void
+dhd_prot_txcpl_pktfree(dhd_pub_t *dhd, void *pkt)
+{
+	dhd_prot_t *prot = dhd->prot;
+
+	prot->txcpl_free_pkts[prot->txcpl_free_cnt++] = pkt;
+	if (prot->txcpl_free_cnt == DHD_TXCPL_FREE_BATCH) {
+		dhd_prot_txcpl_free_flush(dhd);
+	}
+}
+#define DHD_TXCPL_PKTFREE(dhd, pkt)	dhd_prot_txcpl_pktfree((dhd), (pkt))
+#else
+#define DHD_TXCPL_PKTFREE(dhd, pkt)	PKTFREE((dhd)->osh, (pkt), TRUE)
+#endif /* DHD_TXCPL_BULK_FREE */
+
+#ifdef DHD_AGGR_WI
+static void
+BCMFASTPATH(dhd_prot_txstatus_process_each_aggr_item)(dhd_pub_t *dhd, msgbuf_ring_t *ring,
+		host_txbuf_cmpl_aggr_t * txstatus, uint32 request_id)
+{
+	dhd_prot_t *prot = dhd->prot;
+	unsigned long flags;
+	uint32 pktid;
+	void *pkt;
+	dmaaddr_t pa;
+	uint32 len;
+	void *dmah;
+	void *secdma;
+	bool pkt_fate;
+#ifdef AGG_H2D_DB
+	msgbuf_ring_t *flow_ring;
 #endif /* AGG_H2D_DB */
 	flow_ring_node_t *flow_ring_node;
 	uint16 flowid;
@@ -9261,6 +9990,9 @@ BCMFASTPATH(dhd_prot_txstatus_process_each_aggr_item)(dhd_pub_t *dhd, msgbuf_rin
 	}
 
 	DMA_UNMAP(dhd->osh, pa, (uint) len, DMA_TX, 0, dmah);
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_update(dhd, flow_ring_node, OSL_SYSUPTIME_US() - DHD_PKT_GET_QTIME(pkt));
+#endif /* DHD_TXCPL_LAT_HIST */
 
 #ifdef HOST_SFH_LLC
 	if (dhd->host_sfhllc_supported) {
@@ -9305,6 +10037,9 @@ BCMFASTPATH(dhd_prot_txstatus_process_each_aggr_item)(dhd_pub_t *dhd, msgbuf_rin
 #endif
 	DHD_RING_UNLOCK(ring->ring_lock, flags);
 
+#ifdef DHD_FLOWRING_BQL
+	dhd_flow_bql_complete(dhd, flow_ring_node, PKTLEN(dhd->osh, pkt));
+#endif /* DHD_FLOWRING_BQL */
 #ifdef DHD_MEM_STATS
 	DHD_MEM_STATS_LOCK(dhd->mem_stats_lock, flags);
 	DHD_TRACE(("%s txpath_mem: %llu PKTLEN: %d\n",
@@ -9312,7 +10047,7 @@ BCMFASTPATH(dhd_prot_txstatus_process_each_aggr_item)(dhd_pub_t *dhd, msgbuf_rin
 	dhd->txpath_mem -= PKTLEN(dhd->osh, pkt);
 	DHD_MEM_STATS_UNLOCK(dhd->mem_stats_lock, flags);
 #endif /* DHD_MEM_STATS */
-	PKTFREE(dhd->osh, pkt, TRUE);
+	DHD_TXCPL_PKTFREE(dhd, pkt);
 
 	return;
 }
@@ -9517,6 +10252,9 @@ BCMFASTPATH(dhd_prot_txstatus_process)(dhd_pub_t *dhd, void *msg)
 	tx_status_latency = OSL_SYSUPTIME_US() - DHD_PKT_GET_QTIME(pkt);
 	flow_info->cum_tx_status_latency += tx_status_latency;
 #endif /* TX_STATUS_LATENCY_STATS */
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_update(dhd, flow_ring_node, OSL_SYSUPTIME_US() - DHD_PKT_GET_QTIME(pkt));
+#endif /* DHD_TXCPL_LAT_HIST */
 	flow_info->num_tx_status++;
 
 
@@ -9638,6 +10376,9 @@ BCMFASTPATH(dhd_prot_txstatus_process)(dhd_pub_t *dhd, void *msg)
 		txstatus->tx_status);
 	DHD_RING_UNLOCK(ring->ring_lock, flags);
 
+#ifdef DHD_FLOWRING_BQL
+	dhd_flow_bql_complete(dhd, flow_ring_node, PKTLEN(dhd->osh, pkt));
+#endif /* DHD_FLOWRING_BQL */
 
 #ifdef DHD_MEM_STATS
 	DHD_MEM_STATS_LOCK(dhd->mem_stats_lock, flags);
@@ -9646,7 +10387,7 @@ BCMFASTPATH(dhd_prot_txstatus_process)(dhd_pub_t *dhd, void *msg)
 	dhd->txpath_mem -= PKTLEN(dhd->osh, pkt);
 	DHD_MEM_STATS_UNLOCK(dhd->mem_stats_lock, flags);
 #endif /* DHD_MEM_STATS */
-	PKTFREE(dhd->osh, pkt, TRUE);
+	DHD_TXCPL_PKTFREE(dhd, pkt);
 
 	return;
 } /* dhd_prot_txstatus_process */
@@ -9892,13 +10633,39 @@ dhd_prot_hdrlen(dhd_pub_t *dhd, void *PKTBUF)
 
 #define PKTBUF pktbuf
 
+#if defined(DHD_FAKE_TX_STATUS) || defined(DHD_MSGBUF_EMU)
+/*
+ * Fill in the epoch and the last word of a D2H work item made by the host
+ * the way the dongle would for the D2H sync mode in use. The item must be
+ * zeroed beyond the fields already filled in.
+ */
+static void
+dhd_prot_d2h_item_seal(dhd_pub_t *dhd, cmn_msg_hdr_t *msg, uint16 item_len, uint32 seqnum)
+{
+	uint32 *marker;
+
+	seqnum %= D2H_EPOCH_MODULO;
+	msg->epoch = (uint8)seqnum;
+	marker = (uint32 *)msg + (item_len / sizeof(uint32) - 1);
+	if (dhd->d2h_sync_mode & PCIE_SHARED_D2H_SYNC_SEQNUM) {
+		*marker = htol32(seqnum);
+	} else if (dhd->d2h_sync_mode & PCIE_SHARED_D2H_SYNC_XORCSUM) {
+		/* last word makes the xor of the whole item zero */
+		*marker = bcm_compute_xor32((volatile uint32 *)msg, item_len / sizeof(uint32));
+	}
+}
+#endif /* DHD_FAKE_TX_STATUS || DHD_MSGBUF_EMU */
+
 #ifdef DHD_FAKE_TX_STATUS
 /* This function will copy the txpost workitem's
  * common msg hdr to the txcmpl workitem and change
  * only the msg type. It will then write the txcmpl
  * work item to the d2h tx cpln ring and schedule
  * the DPC in order to provide a fake success Tx
- * status
+ * status. The epoch and the last word are filled
+ * in as the dongle would for the D2H sync mode in
+ * use, so the host completion path, including the
+ * sync callbacks, runs the same as with a dongle.
  */
 static void
 dhd_prot_fake_tx_status(dhd_pub_t *dhd, host_txbuf_post_t *txdesc,
@@ -9918,17 +10685,930 @@ dhd_prot_fake_tx_status(dhd_pub_t *dhd, host_txbuf_post_t *txdesc,
 		DHD_ERROR_RLMT(("%s: unable to write to txcmpl ring ! \n", __func__));
 		goto end;
 	}
-	bzero(txcpl_msg, sizeof(*txcpl_msg));
+	bzero(txcpl_msg, txcpl_ring->item_len);
 	memcpy(&txcpl_msg->cmn_hdr, &txdesc->cmn_hdr, sizeof(cmn_msg_hdr_t));
 	txcpl_msg->cmn_hdr.msg_type = MSG_TYPE_TX_STATUS;
 	txcpl_msg->compl_hdr.ring_id = ringid;
 	txcpl_msg->compl_hdr.flow_ring_id = flowid;
+
+	dhd_prot_d2h_item_seal(dhd, &txcpl_msg->cmn_hdr, txcpl_ring->item_len,
+		prot->fake_txcpl_seqnum++);
+	prot->fake_txcpl_cnt++;
+	DHD_RING_UNLOCK(txcpl_ring->ring_lock, flags);
+	dhd_sched_dpc(dhd);
+	return;
 end:
+	prot->fake_txcpl_fail++;
 	DHD_RING_UNLOCK(txcpl_ring->ring_lock, flags);
 	dhd_sched_dpc(dhd);
 }
 #endif /* DHD_FAKE_TX_STATUS */
 
+#ifdef DHD_MSGBUF_EMU
+/*
+ * Host side dongle emulator, enabled by the msgbuf_emu module parameter.
+ *
+ * It stands in for the dongle firmware at the ring interface so that the
+ * msgbuf and flowring datapath can be benchmarked at a chosen packet rate
+ * without traffic over the air. It is a test build option only, and it is
+ * refused while firmware is loaded as a running dongle would DMA into the
+ * same rings. mb_ring_fn/mb_2_ring_fn queue the emulator work instead of
+ * ringing a doorbell. The work consumes the H2D rings and produces D2H work items
+ * through the same RD/WR index locations the dongle uses (DMA index arrays
+ * or TCM), sealed for the D2H sync mode in use.
+ *  - control submit: ioctl -> ack and completion on a posted response
+ *    buffer, flowring create/delete/flush and H2D/D2H ring create ->
+ *    completions, event buffers are taken but no event is ever sent
+ *  - flowrings: txpost -> txstatus
+ *  - rxpost: buffers are kept in posting order and returned as rx
+ *    completions carrying a synthetic frame, msgbuf_emu_rx_pps per second
+ */
+#define MSGBUF_EMU_D2H_IDX(ring)	((ring)->idx - BCMPCIE_H2D_COMMON_MSGRINGS)
+#define MSGBUF_EMU_BUDGET		256u	/* items per H2D ring per pass */
+#define MSGBUF_EMU_RX_TICK_NS		(1000u * 1000u)	/* rx credit tick, 1 msec */
+#define MSGBUF_EMU_RX_TICKS_PER_SEC	1000u
+#define MSGBUF_EMU_STALL_USEC		50u	/* backoff while a D2H ring is full */
+#define MSGBUF_EMU_ETHER_TYPE		0x88B5u	/* local experimental ethertype */
+
+static const uint8 msgbuf_emu_ether_src[ETHER_ADDR_LEN] = { 0x02, 0, 0, 0, 0, 0x01 };
+
+typedef struct msgbuf_emu_buf {
+	uint32 pktid;
+	uint16 len;
+} msgbuf_emu_buf_t;
+
+/* Host buffers held by the emulator, in posting order */
+typedef struct msgbuf_emu_bufq {
+	msgbuf_emu_buf_t *bufs;
+	uint16 max;
+	uint16 rd;
+	uint16 cnt;
+} msgbuf_emu_bufq_t;
+
+typedef struct msgbuf_emu_flow {
+	bool active;
+	uint16 rd;
+} msgbuf_emu_flow_t;
+
+typedef struct dhd_msgbuf_emu {
+	dhd_pub_t *dhd;
+	bool active;
+	bool stalled;		/* a D2H ring was full in this pass */
+	struct workqueue_struct *wq;
+	struct work_struct work;
+	struct hrtimer rx_timer;
+	uint64 kick_ns;		/* first doorbell since the last pass */
+
+	/* dongle side ring state */
+	uint16 ctrl_rd;
+	uint16 rxp_rd;
+	uint16 d2h_wr[BCMPCIE_D2H_COMMON_MSGRINGS];
+	uint16 d2h_rd[BCMPCIE_D2H_COMMON_MSGRINGS];	/* last host RD seen */
+	uint32 d2h_seqnum[BCMPCIE_D2H_COMMON_MSGRINGS];
+	uint32 d2h_dirty;	/* D2H rings with an unpublished WR */
+	msgbuf_emu_flow_t *flows;
+	uint16 max_flows;
+	msgbuf_emu_bufq_t rxq;
+	msgbuf_emu_bufq_t ioctq;
+
+	atomic_t rx_credit;	/* rx completions due */
+	uint32 rx_credit_max;
+	uint32 rx_frac;		/* rx_pps remainder carried between ticks */
+
+	atomic_t doorbells;
+	uint32 passes;
+	uint32 stalls;
+	uint32 unhandled;
+	uint32 bad_index;
+	uint32 ioctls;
+	uint32 evtbufs;
+	uint32 flow_creates;
+	uint32 flow_deletes;
+	uint32 flow_flushes;
+	uint32 ring_creates;
+	uint32 txcpls;
+	uint32 rxposts;
+	uint32 rxcpls;
+	uint32 rx_nobuf;	/* passes with rx credit but no posted buffer */
+	uint32 rx_short;	/* rx buffers returned with an error, too short for a frame */
+	uint32 rx_overrun;	/* frames not made, rx credit already a ring deep */
+	uint64 *kick_histo;	/* usec from doorbell to service pass */
+	uint64 *batch_histo;	/* work items handled per service pass */
+} dhd_msgbuf_emu_t;
+
+typedef bool (*msgbuf_emu_item_fn_t)(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, void *msg);
+
+/* Native packet of a pktid the host has handed over, NULL if it is not in use */
+static void *
+dhd_msgbuf_emu_pktid_peek(void *handle, uint32 pktid)
+{
+#if defined(DHD_PCIE_PKTID)
+	dhd_pktid_map_t *map = (dhd_pktid_map_t *)handle;
+	unsigned long flags;
+	void *pkt = NULL;
+
+	if ((map == NULL) || (pktid == DHD_PKTID_INVALID) || (pktid > map->items)) {
+		return NULL;
+	}
+	DHD_PKTID_LOCK(map->pktid_lock, flags);
+	if (map->lockers[pktid].state == LOCKER_IS_BUSY) {
+		pkt = map->lockers[pktid].pkt;
+	}
+	DHD_PKTID_UNLOCK(map->pktid_lock, flags);
+	return pkt;
+#else
+	BCM_REFERENCE(handle);
+	return DHD_PKTPTR32(pktid);
+#endif /* DHD_PCIE_PKTID */
+}
+
+static bool
+dhd_msgbuf_emu_bufq_push(msgbuf_emu_bufq_t *q, uint32 pktid, uint16 len)
+{
+	msgbuf_emu_buf_t *buf;
+
+	if (q->cnt == q->max) {
+		return FALSE;
+	}
+	buf = &q->bufs[(q->rd + q->cnt) % q->max];
+	buf->pktid = pktid;
+	buf->len = len;
+	q->cnt++;
+	return TRUE;
+}
+
+static msgbuf_emu_buf_t *
+dhd_msgbuf_emu_bufq_pop(msgbuf_emu_bufq_t *q)
+{
+	msgbuf_emu_buf_t *buf;
+
+	if (q->cnt == 0) {
+		return NULL;
+	}
+	buf = &q->bufs[q->rd];
+	q->rd = (q->rd + 1) % q->max;
+	q->cnt--;
+	return buf;
+}
+
+static int
+dhd_msgbuf_emu_bufq_init(dhd_pub_t *dhd, msgbuf_emu_bufq_t *q, uint16 max)
+{
+	q->bufs = (msgbuf_emu_buf_t *)MALLOCZ(dhd->osh, sizeof(msgbuf_emu_buf_t) * max);
+	if (q->bufs == NULL) {
+		return BCME_NOMEM;
+	}
+	q->max = max;
+	q->rd = 0;
+	q->cnt = 0;
+	return BCME_OK;
+}
+
+static void
+dhd_msgbuf_emu_bufq_deinit(dhd_pub_t *dhd, msgbuf_emu_bufq_t *q)
+{
+	if (q->bufs) {
+		MFREE(dhd->osh, q->bufs, sizeof(msgbuf_emu_buf_t) * q->max);
+	}
+	bzero(q, sizeof(*q));
+}
+
+/* H2D WR as published by the host, see __dhd_prot_ring_write_complete() */
+static uint16
+dhd_msgbuf_emu_h2d_wr(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring)
+{
+	dhd_pub_t *dhd = emu->dhd;
+	uint16 wr;
+
+	if (IDMA_ACTIVE(dhd) || dhd->dma_h2d_ring_upd_support) {
+		wr = dhd_prot_dma_indx_get(dhd, H2D_DMA_INDX_WR_UPD, ring->idx);
+	} else {
+		dhd_bus_cmn_readshared(dhd->bus, &wr, RING_WR_UPD, ring->idx);
+	}
+	return wr;
+}
+
+/* Publish the H2D RD where the host reads it, see dhd_prot_alloc_ring_space() */
+static void
+dhd_msgbuf_emu_h2d_rd(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, uint16 rd)
+{
+	dhd_pub_t *dhd = emu->dhd;
+
+	if (dhd->dma_d2h_ring_upd_support) {
+		dhd_prot_dma_indx_set(dhd, rd, H2D_DMA_INDX_RD_UPD, ring->idx);
+	} else {
+		dhd_bus_cmn_writeshared(dhd->bus, &rd, sizeof(uint16), RING_RD_UPD, ring->idx);
+	}
+}
+
+/* Next free D2H work item, zeroed, or NULL if the host has not made room yet */
+static void *
+dhd_msgbuf_emu_d2h_alloc(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring)
+{
+	dhd_pub_t *dhd = emu->dhd;
+	uint idx = MSGBUF_EMU_D2H_IDX(ring);
+	uint16 wr = emu->d2h_wr[idx];
+	void *msg;
+
+	if (WRITE_SPACE_AVAIL(emu->d2h_rd[idx], wr, ring->max_items) <= 0) {
+		/* RD as published by the host, see __dhd_prot_upd_read_idx() */
+		if (IDMA_ACTIVE(dhd) || dhd->dma_h2d_ring_upd_support) {
+			emu->d2h_rd[idx] = dhd_prot_dma_indx_get(dhd, D2H_DMA_INDX_RD_UPD,
+				ring->idx);
+		} else {
+			dhd_bus_cmn_readshared(dhd->bus, &emu->d2h_rd[idx], RING_RD_UPD,
+				ring->idx);
+		}
+		if (WRITE_SPACE_AVAIL(emu->d2h_rd[idx], wr, ring->max_items) <= 0) {
+			emu->stalled = TRUE;
+			return NULL;
+		}
+	}
+	msg = (uint8 *)ring->dma_buf.va + (wr * ring->item_len);
+	bzero(msg, ring->item_len);
+	return msg;
+}
+
+static void
+dhd_msgbuf_emu_d2h_commit(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, cmn_msg_hdr_t *msg)
+{
+	uint idx = MSGBUF_EMU_D2H_IDX(ring);
+
+	dhd_prot_d2h_item_seal(emu->dhd, msg, ring->item_len, emu->d2h_seqnum[idx]++);
+	OSL_CACHE_FLUSH((void *)msg, ring->item_len);
+	emu->d2h_wr[idx] = (emu->d2h_wr[idx] + 1 == ring->max_items) ? 0 :
+		emu->d2h_wr[idx] + 1;
+	emu->d2h_dirty |= (1u << idx);
+}
+
+/* Publish the WR of every D2H ring written in this pass and run the host DPC */
+static void
+dhd_msgbuf_emu_d2h_publish(dhd_msgbuf_emu_t *emu)
+{
+	dhd_pub_t *dhd = emu->dhd;
+	dhd_prot_t *prot = dhd->prot;
+	msgbuf_ring_t *rings[BCMPCIE_D2H_COMMON_MSGRINGS];
+	uint16 wr;
+	uint i;
+
+	if (emu->d2h_dirty == 0) {
+		return;
+	}
+	rings[MSGBUF_EMU_D2H_IDX(&prot->d2hring_ctrl_cpln)] = &prot->d2hring_ctrl_cpln;
+	rings[MSGBUF_EMU_D2H_IDX(&prot->d2hring_tx_cpln)] = &prot->d2hring_tx_cpln;
+	rings[MSGBUF_EMU_D2H_IDX(&prot->d2hring_rx_cpln)] = &prot->d2hring_rx_cpln;
+
+	for (i = 0; i < BCMPCIE_D2H_COMMON_MSGRINGS; i++) {
+		if (!(emu->d2h_dirty & (1u << i))) {
+			continue;
+		}
+		/* see dhd_prot_get_read_addr() */
+		wr = emu->d2h_wr[i];
+		if (dhd->dma_d2h_ring_upd_support) {
+			dhd_prot_dma_indx_set(dhd, wr, D2H_DMA_INDX_WR_UPD, rings[i]->idx);
+		} else {
+			dhd_bus_cmn_writeshared(dhd->bus, &wr, sizeof(uint16), RING_WR_UPD,
+				rings[i]->idx);
+		}
+	}
+	emu->d2h_dirty = 0;
+	dhd_sched_dpc(dhd);
+}
+
+/* Consume the H2D ring from *rd up to the host WR, until fn cannot take an item */
+static uint
+dhd_msgbuf_emu_h2d_drain(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, uint16 *rd,
+	msgbuf_emu_item_fn_t fn)
+{
+	uint16 wr = dhd_msgbuf_emu_h2d_wr(emu, ring);
+	uint n = 0;
+
+	if (wr >= ring->max_items) {
+		emu->bad_index++;
+		return 0;
+	}
+	while ((*rd != wr) && (n < MSGBUF_EMU_BUDGET)) {
+		if (!fn(emu, ring, (uint8 *)ring->dma_buf.va + (*rd * ring->item_len))) {
+			break;
+		}
+		*rd = (*rd + 1 == ring->max_items) ? 0 : *rd + 1;
+		n++;
+	}
+	if (n) {
+		dhd_msgbuf_emu_h2d_rd(emu, ring, *rd);
+	}
+	return n;
+}
+
+/* Fill an ioctl response buffer, returns the response length */
+static uint16
+dhd_msgbuf_emu_ioctl_fill(dhd_msgbuf_emu_t *emu, msgbuf_emu_buf_t *buf, uint32 cmd,
+	uint16 outlen)
+{
+	dhd_pub_t *dhd = emu->dhd;
+	uint16 len = MIN(outlen, buf->len);
+	uint8 *data;
+#ifndef IOCTLRESP_USE_CONSTMEM
+	void *pkt;
+
+	pkt = dhd_msgbuf_emu_pktid_peek(dhd->prot->pktid_ctrl_map, buf->pktid);
+	if (pkt == NULL) {
+		return 0;
+	}
+	data = PKTDATA(dhd->osh, pkt);
+#else
+	data = dhd_msgbuf_emu_pktid_peek(dhd->prot->pktid_map_handle_ioctl, buf->pktid);
+	if (data == NULL) {
+		return 0;
+	}
+#endif /* !IOCTLRESP_USE_CONSTMEM */
+
+	/* the emulator keeps no wl state, gets read back as zero */
+	bzero(data, len);
+	if (len >= sizeof(uint32)) {
+		if (cmd == WLC_GET_MAGIC) {
+			*(uint32 *)data = htol32(WLC_IOCTL_MAGIC);
+		} else if (cmd == WLC_GET_VERSION) {
+			*(uint32 *)data = htol32(WLC_IOCTL_VERSION);
+		}
+	}
+	OSL_CACHE_FLUSH((void *)data, len);
+	return len;
+}
+
+static bool
+dhd_msgbuf_emu_ioctl(dhd_msgbuf_emu_t *emu, ioctl_req_msg_t *req)
+{
+	msgbuf_ring_t *cpl = &emu->dhd->prot->d2hring_ctrl_cpln;
+	ioctl_req_ack_msg_t *ack;
+	ioctl_comp_resp_msg_t *resp;
+	msgbuf_emu_buf_t *buf;
+	uint16 resp_len;
+
+	/* wait for a response buffer, and room for the ack and the completion */
+	if ((emu->ioctq.cnt == 0) ||
+		((ack = dhd_msgbuf_emu_d2h_alloc(emu, cpl)) == NULL)) {
+		return FALSE;
+	}
+	if (WRITE_SPACE_AVAIL(emu->d2h_rd[MSGBUF_EMU_D2H_IDX(cpl)],
+		emu->d2h_wr[MSGBUF_EMU_D2H_IDX(cpl)], cpl->max_items) < 2) {
+		emu->stalled = TRUE;
+		return FALSE;
+	}
+
+	ack->cmn_hdr.msg_type = MSG_TYPE_IOCTLPTR_REQ_ACK;
+	ack->cmn_hdr.if_id = req->cmn_hdr.if_id;
+	ack->cmn_hdr.request_id = req->cmn_hdr.request_id;
+	ack->compl_hdr.status = htol16(BCMPCIE_SUCCESS);
+	ack->compl_hdr.flow_ring_id = htol16(BCMPCIE_H2D_MSGRING_CONTROL_SUBMIT);
+	ack->cmd = req->cmd;
+	dhd_msgbuf_emu_d2h_commit(emu, cpl, &ack->cmn_hdr);
+
+	buf = dhd_msgbuf_emu_bufq_pop(&emu->ioctq);
+	resp_len = dhd_msgbuf_emu_ioctl_fill(emu, buf, ltoh32(req->cmd),
+		ltoh16(req->output_buf_len));
+	resp = dhd_msgbuf_emu_d2h_alloc(emu, cpl);
+	resp->cmn_hdr.msg_type = MSG_TYPE_IOCTL_CMPLT;
+	resp->cmn_hdr.if_id = req->cmn_hdr.if_id;
+	resp->cmn_hdr.request_id = htol32(buf->pktid);
+	resp->compl_hdr.status = htol16(BCMPCIE_SUCCESS);
+	resp->compl_hdr.flow_ring_id = htol16(BCMPCIE_H2D_MSGRING_CONTROL_SUBMIT);
+	resp->resp_len = htol16(resp_len);
+	resp->trans_id = req->trans_id;
+	resp->cmd = req->cmd;
+	dhd_msgbuf_emu_d2h_commit(emu, cpl, &resp->cmn_hdr);
+	emu->ioctls++;
+	return TRUE;
+}
+
+static bool
+dhd_msgbuf_emu_txpost(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, void *msg)
+{
+	host_txbuf_post_t *txpost = (host_txbuf_post_t *)msg;
+	msgbuf_ring_t *cpl = &emu->dhd->prot->d2hring_tx_cpln;
+	host_txbuf_cmpl_t *txcpl;
+
+	if (txpost->cmn_hdr.msg_type != MSG_TYPE_TX_POST) {
+		emu->unhandled++;
+		return TRUE;
+	}
+	if ((txcpl = dhd_msgbuf_emu_d2h_alloc(emu, cpl)) == NULL) {
+		return FALSE;
+	}
+	memcpy(&txcpl->cmn_hdr, &txpost->cmn_hdr, sizeof(cmn_msg_hdr_t));
+	txcpl->cmn_hdr.msg_type = MSG_TYPE_TX_STATUS;
+	txcpl->compl_hdr.flow_ring_id = htol16(DHD_RINGID_TO_FLOWID(ring->idx));
+	dhd_msgbuf_emu_d2h_commit(emu, cpl, &txcpl->cmn_hdr);
+	emu->txcpls++;
+	return TRUE;
+}
+
+static bool
+dhd_msgbuf_emu_flowring(dhd_msgbuf_emu_t *emu, cmn_msg_hdr_t *req)
+{
+	dhd_prot_t *prot = emu->dhd->prot;
+	msgbuf_ring_t *cpl = &prot->d2hring_ctrl_cpln;
+	/* create and flush responses share the layout up to read_idx */
+	tx_flowring_delete_response_t *resp;
+	msgbuf_emu_flow_t *flow = NULL;
+	msgbuf_ring_t *ring = NULL;
+	uint16 flowid;
+	int16 status = BCMPCIE_SUCCESS;
+
+	/* create, delete and flush requests share the layout up to flow_ring_id */
+	flowid = ltoh16(((tx_flowring_delete_request_t *)req)->flow_ring_id);
+	if ((flowid >= DHD_FLOWRING_START_FLOWID) &&
+		(DHD_FLOWRINGS_POOL_OFFSET(flowid) < emu->max_flows)) {
+		flow = &emu->flows[DHD_FLOWRINGS_POOL_OFFSET(flowid)];
+		ring = DHD_RING_IN_FLOWRINGS_POOL(prot, flowid);
+	} else {
+		status = BCMPCIE_RING_ID_INVALID;
+	}
+
+	if (flow && flow->active && (req->msg_type != MSG_TYPE_FLOW_RING_CREATE)) {
+		/* complete every txpost before the host takes the ring back */
+		dhd_msgbuf_emu_h2d_drain(emu, ring, &flow->rd, dhd_msgbuf_emu_txpost);
+		if (dhd_msgbuf_emu_h2d_wr(emu, ring) != flow->rd) {
+			return FALSE;
+		}
+	}
+	if ((resp = dhd_msgbuf_emu_d2h_alloc(emu, cpl)) == NULL) {
+		return FALSE;
+	}
+
+	switch (req->msg_type) {
+		case MSG_TYPE_FLOW_RING_CREATE:
+			if (flow) {
+				/* reset the ring state before the host can post to it */
+				flow->rd = 0;
+				flow->active = TRUE;
+				if (IDMA_ACTIVE(emu->dhd) || emu->dhd->dma_h2d_ring_upd_support) {
+					dhd_prot_dma_indx_set(emu->dhd, 0, H2D_DMA_INDX_WR_UPD,
+						ring->idx);
+				} else {
+					dhd_bus_cmn_writeshared(emu->dhd->bus, &flow->rd,
+						sizeof(uint16), RING_WR_UPD, ring->idx);
+				}
+				dhd_msgbuf_emu_h2d_rd(emu, ring, 0);
+			}
+			resp->msg.msg_type = MSG_TYPE_FLOW_RING_CREATE_CMPLT;
+			emu->flow_creates++;
+			break;
+		case MSG_TYPE_FLOW_RING_DELETE:
+			if (flow) {
+				resp->read_idx = htol16(flow->rd);
+				flow->active = FALSE;
+			}
+			resp->msg.msg_type = MSG_TYPE_FLOW_RING_DELETE_CMPLT;
+			emu->flow_deletes++;
+			break;
+		default:
+			resp->msg.msg_type = MSG_TYPE_FLOW_RING_FLUSH_CMPLT;
+			emu->flow_flushes++;
+			break;
+	}
+	resp->msg.if_id = req->if_id;
+	resp->msg.request_id = req->request_id;
+	resp->cmplt.status = htol16(status);
+	resp->cmplt.flow_ring_id = htol16(flowid);
+	dhd_msgbuf_emu_d2h_commit(emu, cpl, &resp->msg);
+	return TRUE;
+}
+
+static bool
+dhd_msgbuf_emu_ring_create(dhd_msgbuf_emu_t *emu, cmn_msg_hdr_t *req)
+{
+	msgbuf_ring_t *cpl = &emu->dhd->prot->d2hring_ctrl_cpln;
+	ring_create_response_t *resp;
+
+	if ((resp = dhd_msgbuf_emu_d2h_alloc(emu, cpl)) == NULL) {
+		return FALSE;
+	}
+	if (req->msg_type == MSG_TYPE_H2D_RING_CREATE) {
+		resp->cmn_hdr.msg_type = MSG_TYPE_H2D_RING_CREATE_CMPLT;
+		resp->cmplt.ring_id = ((h2d_ring_create_req_t *)req)->ring_id;
+	} else {
+		resp->cmn_hdr.msg_type = MSG_TYPE_D2H_RING_CREATE_CMPLT;
+		resp->cmplt.ring_id = ((d2h_ring_create_req_t *)req)->ring_id;
+	}
+	resp->cmn_hdr.request_id = req->request_id;
+	resp->cmplt.status = htol16(BCMPCIE_SUCCESS);
+	dhd_msgbuf_emu_d2h_commit(emu, cpl, &resp->cmn_hdr);
+	emu->ring_creates++;
+	return TRUE;
+}
+
+static bool
+dhd_msgbuf_emu_ctrl(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, void *msg)
+{
+	cmn_msg_hdr_t *req = (cmn_msg_hdr_t *)msg;
+	ioctl_resp_evt_buf_post_msg_t *bufpost = (ioctl_resp_evt_buf_post_msg_t *)msg;
+
+	switch (req->msg_type) {
+		case MSG_TYPE_IOCTLPTR_REQ:
+			return dhd_msgbuf_emu_ioctl(emu, (ioctl_req_msg_t *)msg);
+		case MSG_TYPE_IOCTLRESP_BUF_POST:
+			return dhd_msgbuf_emu_bufq_push(&emu->ioctq, ltoh32(req->request_id),
+				ltoh16(bufpost->host_buf_len));
+		case MSG_TYPE_EVENT_BUF_POST:
+			/* stays posted until the host resets the rings */
+			emu->evtbufs++;
+			return TRUE;
+		case MSG_TYPE_FLOW_RING_CREATE:
+		case MSG_TYPE_FLOW_RING_DELETE:
+		case MSG_TYPE_FLOW_RING_FLUSH:
+			return dhd_msgbuf_emu_flowring(emu, req);
+		case MSG_TYPE_H2D_RING_CREATE:
+		case MSG_TYPE_D2H_RING_CREATE:
+			return dhd_msgbuf_emu_ring_create(emu, req);
+		default:
+			emu->unhandled++;
+			return TRUE;
+	}
+}
+
+static bool
+dhd_msgbuf_emu_rxpost(dhd_msgbuf_emu_t *emu, msgbuf_ring_t *ring, void *msg)
+{
+	host_rxbuf_post_t *rxpost = (host_rxbuf_post_t *)msg;
+
+	if (rxpost->cmn_hdr.msg_type != MSG_TYPE_RXBUF_POST) {
+		emu->unhandled++;
+		return TRUE;
+	}
+	if (!dhd_msgbuf_emu_bufq_push(&emu->rxq, ltoh32(rxpost->cmn_hdr.request_id),
+		ltoh16(rxpost->data_buf_len))) {
+		return FALSE;
+	}
+	emu->rxposts++;
+	return TRUE;
+}
+
+static uint
+dhd_msgbuf_emu_flowrings(dhd_msgbuf_emu_t *emu)
+{
+	dhd_prot_t *prot = emu->dhd->prot;
+	msgbuf_ring_t *ring;
+	uint16 i;
+	uint n = 0;
+
+	for (i = 0; i < emu->max_flows; i++) {
+		if (!emu->flows[i].active) {
+			continue;
+		}
+		ring = DHD_RING_IN_FLOWRINGS_POOL(prot, i + DHD_FLOWRING_START_FLOWID);
+		n += dhd_msgbuf_emu_h2d_drain(emu, ring, &emu->flows[i].rd,
+			dhd_msgbuf_emu_txpost);
+	}
+	return n;
+}
+
+/*
+ * Write a synthetic frame to a posted rx buffer. Returns BCME_NOTFOUND if the
+ * host does not own the pktid, BCME_BUFTOOSHORT if the buffer can not hold a
+ * frame, else BCME_OK with the frame length in *len.
+ */
+static int
+dhd_msgbuf_emu_rx_frame(dhd_msgbuf_emu_t *emu, msgbuf_emu_buf_t *buf, uint16 *len)
+{
+	dhd_pub_t *dhd = emu->dhd;
+	uint32 offset = dhd->prot->rx_dataoffset;
+	struct ether_header *eh;
+	uint8 *data;
+	void *pkt;
+
+	pkt = dhd_msgbuf_emu_pktid_peek(dhd->prot->pktid_rx_map, buf->pktid);
+	if (pkt == NULL) {
+		return BCME_NOTFOUND;
+	}
+	if (buf->len < offset + ETHER_HDR_LEN) {
+		return BCME_BUFTOOSHORT;
+	}
+	*len = (uint16)MIN(MAX(msgbuf_emu_rx_len, ETHER_HDR_LEN), buf->len - offset);
+
+	/* data_offset 0 in the completion, the host skips rx_dataoffset */
+	data = (uint8 *)PKTDATA(dhd->osh, pkt) + offset;
+	eh = (struct ether_header *)data;
+	eacopy(&dhd->mac, eh->ether_dhost);
+	eacopy(msgbuf_emu_ether_src, eh->ether_shost);
+	eh->ether_type = hton16(MSGBUF_EMU_ETHER_TYPE);
+	bzero(data + ETHER_HDR_LEN, *len - ETHER_HDR_LEN);
+	OSL_CACHE_FLUSH((void *)data, *len);
+	return BCME_OK;
+}
+
+static uint
+dhd_msgbuf_emu_rx(dhd_msgbuf_emu_t *emu)
+{
+	msgbuf_ring_t *cpl = &emu->dhd->prot->d2hring_rx_cpln;
+	host_rxbuf_cmpl_t *rxcpl;
+	msgbuf_emu_buf_t *buf;
+	int credit = atomic_read(&emu->rx_credit);
+	uint16 len = 0;
+	uint16 status;
+	uint n = 0;
+	int ret;
+
+	while ((int)n < credit) {
+		if (emu->rxq.cnt == 0) {
+			emu->rx_nobuf++;
+			break;
+		}
+		if ((rxcpl = dhd_msgbuf_emu_d2h_alloc(emu, cpl)) == NULL) {
+			break;
+		}
+		buf = dhd_msgbuf_emu_bufq_pop(&emu->rxq);
+		ret = dhd_msgbuf_emu_rx_frame(emu, buf, &len);
+		if (ret == BCME_NOTFOUND) {
+			/* not a buffer the host still owns, nothing to complete */
+			emu->bad_index++;
+			continue;
+		}
+		status = BCMPCIE_SUCCESS;
+		if (ret != BCME_OK) {
+			/* hand a buffer too short for a frame back with an error */
+			emu->rx_short++;
+			status = BCMPCIE_NO_RX_BUF;
+			len = 0;
+		}
+		rxcpl->cmn_hdr.msg_type = MSG_TYPE_RX_CMPLT;
+		rxcpl->cmn_hdr.request_id = htol32(buf->pktid);
+		rxcpl->compl_hdr.status = htol16(status);
+		rxcpl->compl_hdr.flow_ring_id = htol16(BCMPCIE_H2D_MSGRING_RXPOST_SUBMIT);
+		rxcpl->data_len = htol16(len);
+		rxcpl->flags = htol16(BCMPCIE_PKT_FLAGS_FRAME_802_3);
+		dhd_msgbuf_emu_d2h_commit(emu, cpl, &rxcpl->cmn_hdr);
+		n++;
+	}
+	if (n) {
+		atomic_sub(n, &emu->rx_credit);
+		emu->rxcpls += n;
+	}
+	return n;
+}
+
+/* One service pass of the emulated dongle, runs until the host has nothing pending */
+static void
+dhd_msgbuf_emu_work(struct work_struct *work)
+{
+	dhd_msgbuf_emu_t *emu;
+	dhd_pub_t *dhd;
+	dhd_prot_t *prot;
+	uint64 kick_ns;
+	uint n, total = 0;
+
+	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
+	emu = container_of(work, dhd_msgbuf_emu_t, work);
+	GCC_DIAGNOSTIC_POP();
+	dhd = emu->dhd;
+	prot = dhd->prot;
+
+	kick_ns = emu->kick_ns;
+	emu->kick_ns = 0;
+	if (kick_ns) {
+		dhd_histo_update(dhd, emu->kick_histo,
+			(uint32)DIV_U64_BY_U32(OSL_LOCALTIME_NS() - kick_ns, NSEC_PER_USEC));
+	}
+
+	while (emu->active) {
+		emu->stalled = FALSE;
+		/* control first, so a new flowring is served in the same pass */
+		n = dhd_msgbuf_emu_h2d_drain(emu, &prot->h2dring_ctrl_subn, &emu->ctrl_rd,
+			dhd_msgbuf_emu_ctrl);
+		n += dhd_msgbuf_emu_h2d_drain(emu, &prot->h2dring_rxp_subn, &emu->rxp_rd,
+			dhd_msgbuf_emu_rxpost);
+		n += dhd_msgbuf_emu_flowrings(emu);
+		n += dhd_msgbuf_emu_rx(emu);
+		dhd_msgbuf_emu_d2h_publish(emu);
+		total += n;
+		if (n == 0) {
+			if (!emu->stalled || (dhd->busstate == DHD_BUS_DOWN)) {
+				break;
+			}
+			/* a D2H ring is full, a TCM RD update rings no doorbell */
+			emu->stalls++;
+			usleep_range(MSGBUF_EMU_STALL_USEC, MSGBUF_EMU_STALL_USEC * 2);
+		}
+	}
+	emu->passes++;
+	dhd_histo_update(dhd, emu->batch_histo, total);
+}
+
+static void
+dhd_msgbuf_emu_kick(dhd_msgbuf_emu_t *emu)
+{
+	if (!emu->active) {
+		return;
+	}
+	atomic_inc(&emu->doorbells);
+	if (!emu->kick_ns) {
+		emu->kick_ns = OSL_LOCALTIME_NS();
+	}
+	queue_work(emu->wq, &emu->work);
+}
+
+/* Replace mb_ring_fn, the doorbell value does not matter to the emulator */
+static void
+dhd_msgbuf_emu_doorbell(struct dhd_bus *bus, uint32 value)
+{
+	BCM_REFERENCE(value);
+	dhd_msgbuf_emu_kick(bus->dhd->prot->emu);
+}
+
+/* Replace mb_2_ring_fn used with IDMA */
+static void
+dhd_msgbuf_emu_doorbell_2(struct dhd_bus *bus, uint32 value, bool devwake)
+{
+	BCM_REFERENCE(value);
+	BCM_REFERENCE(devwake);
+	dhd_msgbuf_emu_kick(bus->dhd->prot->emu);
+}
+
+/*
+ * The rx rate is applied as credit, one tick per msec. Credit beyond one rx
+ * completion ring is not kept, so an rx_overrun count means the host did not
+ * keep up with msgbuf_emu_rx_pps.
+ */
+static enum hrtimer_restart
+dhd_msgbuf_emu_rx_timer(struct hrtimer *timer)
+{
+	dhd_msgbuf_emu_t *emu;
+	uint32 pps = msgbuf_emu_rx_pps;
+	uint32 frames;
+
+	GCC_DIAGNOSTIC_PUSH_SUPPRESS_CAST();
+	emu = container_of(timer, dhd_msgbuf_emu_t, rx_timer);
+	GCC_DIAGNOSTIC_POP();
+
+	if (!emu->active) {
+		return HRTIMER_NORESTART;
+	}
+	if (pps) {
+		frames = (pps + emu->rx_frac) / MSGBUF_EMU_RX_TICKS_PER_SEC;
+		emu->rx_frac = (pps + emu->rx_frac) % MSGBUF_EMU_RX_TICKS_PER_SEC;
+		if ((uint32)atomic_read(&emu->rx_credit) + frames > emu->rx_credit_max) {
+			emu->rx_overrun += frames;
+		} else if (frames) {
+			atomic_add(frames, &emu->rx_credit);
+			queue_work(emu->wq, &emu->work);
+		}
+	}
+	hrtimer_forward_now(timer, ns_to_ktime(MSGBUF_EMU_RX_TICK_NS));
+	return HRTIMER_RESTART;
+}
+
+static void
+dhd_msgbuf_emu_stop(dhd_pub_t *dhd)
+{
+	dhd_msgbuf_emu_t *emu = dhd->prot->emu;
+
+	if (emu == NULL) {
+		return;
+	}
+	if (emu->active) {
+		emu->active = FALSE;
+		hrtimer_cancel(&emu->rx_timer);
+		cancel_work_sync(&emu->work);
+		DHD_PRINT(("%s: msgbuf emulator stopped\n", __FUNCTION__));
+	}
+
+	dhd_msgbuf_emu_bufq_deinit(dhd, &emu->rxq);
+	dhd_msgbuf_emu_bufq_deinit(dhd, &emu->ioctq);
+	if (emu->flows) {
+		MFREE(dhd->osh, emu->flows, sizeof(msgbuf_emu_flow_t) * emu->max_flows);
+	}
+	emu->max_flows = 0;
+}
+
+/*
+ * Called from dhd_prot_init() once the ring sizes are known and before any
+ * message is posted. From here on the H2D rings are served by the emulator.
+ */
+static int
+dhd_msgbuf_emu_start(dhd_pub_t *dhd)
+{
+	dhd_prot_t *prot = dhd->prot;
+	dhd_msgbuf_emu_t *emu = prot->emu;
+	uint i;
+
+	if (dhd_fw_download_status(dhd) == FW_DOWNLOAD_DONE) {
+		/* a running dongle would DMA into the same rings and indices */
+		DHD_ERROR(("%s: firmware is loaded, not emulating the dongle\n", __FUNCTION__));
+		return BCME_BUSY;
+	}
+	if (IFRM_ENAB(dhd)) {
+		DHD_ERROR(("%s: IFRM flowring indices are not emulated\n", __FUNCTION__));
+		return BCME_UNSUPPORTED;
+	}
+#ifdef DHD_DMA_INDICES_SEQNUM
+	if (prot->h2d_dma_indx_rd_copy_buf || prot->d2h_dma_indx_wr_copy_buf) {
+		DHD_ERROR(("%s: DMA indices seqnum is not emulated\n", __FUNCTION__));
+		return BCME_UNSUPPORTED;
+	}
+#endif /* DHD_DMA_INDICES_SEQNUM */
+#ifdef DHD_AGGR_WI
+	if (dhd->bus->d2h_aggr_wi_enab) {
+		/* rings are already sized for aggregated work items */
+		DHD_ERROR(("%s: work item aggregation is not emulated\n", __FUNCTION__));
+		return BCME_UNSUPPORTED;
+	}
+#endif /* DHD_AGGR_WI */
+
+	if (emu == NULL) {
+		emu = (dhd_msgbuf_emu_t *)MALLOCZ(dhd->osh, sizeof(dhd_msgbuf_emu_t));
+		if (emu == NULL) {
+			DHD_ERROR(("%s: out of memory\n", __FUNCTION__));
+			return BCME_NOMEM;
+		}
+		emu->dhd = dhd;
+		emu->wq = alloc_workqueue("dhd_msgbuf_emu", WQ_HIGHPRI | WQ_UNBOUND, 1);
+		if (emu->wq == NULL) {
+			DHD_ERROR(("%s: workqueue alloc failed\n", __FUNCTION__));
+			MFREE(dhd->osh, emu, sizeof(dhd_msgbuf_emu_t));
+			return BCME_NOMEM;
+		}
+		INIT_WORK(&emu->work, dhd_msgbuf_emu_work);
+		hrtimer_init(&emu->rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		emu->rx_timer.function = &dhd_msgbuf_emu_rx_timer;
+		emu->kick_histo = dhd_histo_init(dhd);
+		emu->batch_histo = dhd_histo_init(dhd);
+		prot->emu = emu;
+	}
+
+	emu->max_flows = dhd->bus->max_tx_flowrings;
+	emu->flows = (msgbuf_emu_flow_t *)MALLOCZ(dhd->osh,
+		sizeof(msgbuf_emu_flow_t) * emu->max_flows);
+	if ((emu->flows == NULL) ||
+		(dhd_msgbuf_emu_bufq_init(dhd, &emu->rxq, prot->max_rxbufpost) != BCME_OK) ||
+		(dhd_msgbuf_emu_bufq_init(dhd, &emu->ioctq,
+			prot->max_ioctlrespbufpost) != BCME_OK)) {
+		DHD_ERROR(("%s: out of memory\n", __FUNCTION__));
+		dhd_msgbuf_emu_stop(dhd);
+		return BCME_NOMEM;
+	}
+
+	emu->ctrl_rd = 0;
+	emu->rxp_rd = 0;
+	for (i = 0; i < BCMPCIE_D2H_COMMON_MSGRINGS; i++) {
+		emu->d2h_wr[i] = 0;
+		emu->d2h_rd[i] = 0;
+		emu->d2h_seqnum[i] = D2H_EPOCH_INIT_VAL;
+	}
+	emu->d2h_dirty = 0;
+	emu->kick_ns = 0;
+	atomic_set(&emu->rx_credit, 0);
+	emu->rx_credit_max = prot->d2hring_rx_cpln.max_items;
+	emu->rx_frac = 0;
+
+	prot->mb_ring_fn = dhd_msgbuf_emu_doorbell;
+	prot->mb_2_ring_fn = dhd_msgbuf_emu_doorbell_2;
+#ifdef DHD_DB0TS
+	prot->idma_db0_fn = dhd_msgbuf_emu_doorbell;
+#endif /* DHD_DB0TS */
+	emu->active = TRUE;
+	hrtimer_start(&emu->rx_timer, ns_to_ktime(MSGBUF_EMU_RX_TICK_NS), HRTIMER_MODE_REL);
+
+	DHD_PRINT(("%s: msgbuf rings served by the host side emulator, rx_pps %u rx_len %u\n",
+		__FUNCTION__, msgbuf_emu_rx_pps, msgbuf_emu_rx_len));
+	return BCME_OK;
+}
+
+static void
+dhd_msgbuf_emu_detach(dhd_pub_t *dhd)
+{
+	dhd_msgbuf_emu_t *emu = dhd->prot->emu;
+
+	if (emu == NULL) {
+		return;
+	}
+	dhd_msgbuf_emu_stop(dhd);
+	destroy_workqueue(emu->wq);
+	dhd_histo_deinit(dhd, emu->kick_histo);
+	dhd_histo_deinit(dhd, emu->batch_histo);
+	MFREE(dhd->osh, emu, sizeof(dhd_msgbuf_emu_t));
+	dhd->prot->emu = NULL;
+}
+
+static void
+dhd_msgbuf_emu_dump(dhd_pub_t *dhd, struct bcmstrbuf *b)
+{
+	dhd_msgbuf_emu_t *emu = dhd->prot->emu;
+
+	bcm_bprintf(b, "msgbuf_emu: active %d doorbells %u passes %u stalls %u"
+		" unhandled %u bad_index %u\n", emu->active, atomic_read(&emu->doorbells),
+		emu->passes, emu->stalls, emu->unhandled, emu->bad_index);
+	bcm_bprintf(b, "msgbuf_emu: ioctl %u evtbuf %u flow create %u delete %u flush %u"
+		" ring create %u\n", emu->ioctls, emu->evtbufs, emu->flow_creates,
+		emu->flow_deletes, emu->flow_flushes, emu->ring_creates);
+	bcm_bprintf(b, "msgbuf_emu: txcpl %u rxpost %u rxcpl %u rx_nobuf %u rx_overrun %u"
+		" rx_short %u rxbufs held %u\n", emu->txcpls, emu->rxposts, emu->rxcpls,
+		emu->rx_nobuf, emu->rx_overrun, emu->rx_short, emu->rxq.cnt);
+	dhd_histo_tag_dump(dhd, b, "bin");
+	dhd_histo_dump(dhd, b, emu->kick_histo, "db_to_pass_us");
+	dhd_histo_dump(dhd, b, emu->batch_histo, "items_per_pass");
+}
+#endif /* DHD_MSGBUF_EMU */
+
 #ifdef TX_FLOW_RING_INDICES_TRACE
 static void
 dhd_prot_txflowring_rw_trace(dhd_pub_t *dhd, msgbuf_ring_t *ring, bool start)
@@ -10411,10 +12091,10 @@ BCMFASTPATH(dhd_prot_txdata)(dhd_pub_t *dhd, void *PKTBUF, uint8 ifidx)
 	dhd_prot_ring_write_complete(dhd, ring, txdesc, 1);
 #endif /* TXP_FLUSH_NITEMS */
 
-#ifdef TX_STATUS_LATENCY_STATS
+#if defined(TX_STATUS_LATENCY_STATS) || defined(DHD_TXCPL_LAT_HIST)
 	/* set the time when pkt is queued to flowring */
 	DHD_PKT_SET_QTIME(PKTBUF, OSL_SYSUPTIME_US());
-#endif /* TX_STATUS_LATENCY_STATS */
+#endif /* TX_STATUS_LATENCY_STATS || DHD_TXCPL_LAT_HIST */
 #ifndef TX_STATUS_LATENCY_STATS
 
 #endif /* TX_STATUS_LATENCY_STATS */
@@ -12213,6 +13893,11 @@ void dhd_prot_dump(dhd_pub_t *dhd, struct bcmstrbuf *b)
 		bcm_bprintf(b, "\nd2h_sync: NONE:");
 	bcm_bprintf(b, " d2h_sync_wait max<%lu> tot<%lu>\n",
 		dhd->prot->d2h_sync_wait_max, dhd->prot->d2h_sync_wait_tot);
+#ifdef DHD_D2H_SYNC_BATCH
+	bcm_bprintf(b, "d2h_sync_batch runs<%lu> items<%lu> miss<%lu>\n",
+		dhd->prot->d2h_sync_batch_runs, dhd->prot->d2h_sync_batch_items,
+		dhd->prot->d2h_sync_batch_miss);
+#endif /* DHD_D2H_SYNC_BATCH */
 
 	bcm_bprintf(b, "\nDongle DMA Indices: h2d %d  d2h %d index size %d bytes\n",
 		dhd->dma_h2d_ring_upd_support,
@@ -12224,6 +13909,9 @@ void dhd_prot_dump(dhd_pub_t *dhd, struct bcmstrbuf *b)
 #endif /* DHD_DMA_INDICES_SEQNUM */
 
 	dhd_prot_counters(dhd, b, FALSE, FALSE);
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_dump(dhd, b, TRUE);
+#endif /* DHD_TXCPL_LAT_HIST */
 }
 
 void dhd_prot_counters(dhd_pub_t *dhd, struct bcmstrbuf *b,
@@ -12238,6 +13926,19 @@ void dhd_prot_counters(dhd_pub_t *dhd, struct bcmstrbuf *b,
 			h2d_htput_max_txpost, dhd->prot->h2d_htput_max_txpost);
 	}
 	bcm_bprintf(b, "txcpl_db_cnt: %d\n", dhd->prot->txcpl_db_cnt);
+#ifdef DHD_TXCPL_BULK_FREE
+	bcm_bprintf(b, "txcpl_bulk_free: calls %llu pkts %llu\n",
+		dhd->prot->txcpl_bulk_free, dhd->prot->txcpl_bulk_pkts);
+#endif /* DHD_TXCPL_BULK_FREE */
+#ifdef DHD_FAKE_TX_STATUS
+	bcm_bprintf(b, "fake_txcpl: cnt %u fail %u\n",
+		dhd->prot->fake_txcpl_cnt, dhd->prot->fake_txcpl_fail);
+#endif /* DHD_FAKE_TX_STATUS */
+#ifdef DHD_MSGBUF_EMU
+	if (dhd->prot->emu) {
+		dhd_msgbuf_emu_dump(dhd, b);
+	}
+#endif /* DHD_MSGBUF_EMU */
 	bcm_bprintf(b, "tx_h2d_db_cnt:%llu\n", dhd->prot->tx_h2d_db_cnt);
 	bcm_bprintf(b, "\n");
 
@@ -12248,6 +13949,9 @@ void dhd_prot_counters(dhd_pub_t *dhd, struct bcmstrbuf *b,
 	bcm_bprintf(b, "agg_h2d_db: timer_db_cnt:%d direct_db_cnt:%d\n",
 		dhd->prot->agg_h2d_db_info.timer_db_cnt, dhd->prot->agg_h2d_db_info.direct_db_cnt);
 	dhd_agg_inflight_stats_dump(dhd, b);
+#ifdef AGG_H2D_DB_ADAPTIVE
+	dhd_agg_h2d_db_adapt_dump(dhd, b);
+#endif /* AGG_H2D_DB_ADAPTIVE */
 #endif /* AGG_H2D_DB */
 
 #ifdef DHD_AGGR_WI
@@ -13188,14 +14892,26 @@ dhd_prot_schedule_aggregate_h2d_db(dhd_pub_t *dhd, uint16 flowid)
 	uint16 inflight;
 	bool db_req = FALSE;
 	bool flush;
+	uint32 inflight_thresh = agg_h2d_db_inflight_thresh;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	uint32 pend_items;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 
 	ring = DHD_RING_IN_FLOWRINGS_POOL(prot, flowid);
 	flush = !!ring->pend_items_count;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	pend_items = ring->pend_items_count;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 	dhd_prot_txdata_aggr_db_write_flush(dhd, flowid);
 
 	inflight = OSL_ATOMIC_READ(dhd->osh, &ring->inflight);
 	if (flush && inflight) {
-		if (inflight <= agg_h2d_db_inflight_thresh) {
+#ifdef AGG_H2D_DB_ADAPTIVE
+		if (agg_h2d_db_adaptive) {
+			inflight_thresh = dhd_agg_h2d_db_adapt(dhd, pend_items, inflight);
+		}
+#endif /* AGG_H2D_DB_ADAPTIVE */
+		if (inflight <= inflight_thresh) {
 			db_req = TRUE;
 		}
 		dhd_agg_inflights_stats_update(dhd, inflight);
@@ -13303,11 +15019,19 @@ dhd_prot_aggregate_db_ring_door_bell(dhd_pub_t *dhd, uint16 flowid, bool ring_db
 	msgbuf_ring_t *ring = (msgbuf_ring_t *)flow_ring_node->prot_info;
 	uint32 db_index;
 	uint corerev;
+#ifdef AGG_H2D_DB_ADAPTIVE
+	unsigned long flags;
+#endif /* AGG_H2D_DB_ADAPTIVE */
 
 
 	if (ring_db == TRUE) {
 		dhd_msgbuf_agg_h2d_db_timer_cancel(dhd);
 		prot->agg_h2d_db_info.direct_db_cnt++;
+#ifdef AGG_H2D_DB_ADAPTIVE
+		spin_lock_irqsave(&prot->agg_h2d_db_info.epoch_lock, flags);
+		prot->agg_h2d_db_info.epoch_db++;
+		spin_unlock_irqrestore(&prot->agg_h2d_db_info.epoch_lock, flags);
+#endif /* AGG_H2D_DB_ADAPTIVE */
 		/* raise h2d interrupt */
 		if (IDMA_ACTIVE(dhd) || (IFRM_ACTIVE(dhd))) {
 			db_index = IDMA_IDX0;
@@ -13715,6 +15439,19 @@ dhd_prot_dma_indx_set(dhd_pub_t *dhd, uint16 new_index, uint8 type, uint16 ringi
 			offset = DHD_H2D_FRM_FLOW_RING_OFFSET(ringid);
 			break;
 
+#ifdef DHD_MSGBUF_EMU
+		/* dongle side indices, only written by the emulator */
+		case H2D_DMA_INDX_RD_UPD:
+			ptr = (uint8 *)(prot->h2d_dma_indx_rd_buf.va);
+			offset = DHD_H2D_RING_OFFSET(ringid);
+			break;
+
+		case D2H_DMA_INDX_WR_UPD:
+			ptr = (uint8 *)(prot->d2h_dma_indx_wr_buf.va);
+			offset = DHD_D2H_RING_OFFSET(ringid, max_h2d_rings);
+			break;
+#endif /* DHD_MSGBUF_EMU */
+
 		default:
 			DHD_ERROR(("%s: Invalid option for DMAing read/write index\n",
 				__FUNCTION__));
@@ -14790,6 +16527,16 @@ void dhd_prot_print_info(dhd_pub_t *dhd, struct bcmstrbuf *strbuf)
 		DHD_PKTID_AVAIL(prot->pktid_ctrl_map),
 		DHD_PKTID_AVAIL(prot->pktid_rx_map),
 		DHD_PKTID_AVAIL(prot->pktid_tx_map));
+#if defined(DHD_PCIE_PKTID) && defined(DHD_PKTID_PCPU_CACHE)
+	if (prot->pktid_rx_map && prot->pktid_tx_map) {
+		dhd_pktid_map_t *rx_map = (dhd_pktid_map_t *)prot->pktid_rx_map;
+		dhd_pktid_map_t *tx_map = (dhd_pktid_map_t *)prot->pktid_tx_map;
+
+		bcm_bprintf(strbuf, "pktidmap pcpu refills/flushes rx %u/%u tx %u/%u\n",
+			rx_map->pcpu_refills, rx_map->pcpu_flushes,
+			tx_map->pcpu_refills, tx_map->pcpu_flushes);
+	}
+#endif /* DHD_PCIE_PKTID && DHD_PKTID_PCPU_CACHE */
 
 	bcm_bprintf(strbuf, "Total wakeup packet rcvd: Event:%d,\t RX:%d,\t Info:%d\n",
 		prot->event_wakeup_pkt, prot->rx_wakeup_pkt,
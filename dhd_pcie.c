@@ -87,6 +87,10 @@
 #include <linux/pm_runtime.h>
 #endif /* DHD_PCIE_NATIVE_RUNTIMEPM */
 
+#if defined(DHD_FW_COREDUMP) && defined(DHD_MEMDUMP_STREAM)
+#include <linux/lz4.h>
+#endif /* DHD_FW_COREDUMP && DHD_MEMDUMP_STREAM */
+
 #if defined(DEBUGGER) || defined (DHD_DSCOPE)
 #include <debugger.h>
 #endif /* DEBUGGER || DHD_DSCOPE */
@@ -113,6 +117,12 @@
 #define EXTENDED_PCIE_DEBUG_DUMP 1	/* Enable Extended pcie registers dump */
 
 #define MEMBLOCK	2048		/* Block size used for downloading of dongle image */
+#ifdef DHD_FW_DNLD_FAST
+#define DHD_FW_DNLD_BLKSZ	(64 * 1024)	/* image block read and written per iteration */
+#define DHD_FW_DNLD_BURST	4096		/* memcpy_toio burst per bar1 switch lock hold */
+#else
+#define DHD_FW_DNLD_BLKSZ	MEMBLOCK
+#endif /* DHD_FW_DNLD_FAST */
 #if defined(__linux__)
 #define MAX_WKLK_IDLE_CHECK	3 /* times dhd_wake_lock checked before deciding not to suspend */
 #endif /* __linux__ */
@@ -208,6 +218,32 @@ bool force_trap_bad_h2d_phase = 0;
 /* This can be overwritten by module parameter ptm_sync_periodic */
 int ptm_sync_periodic = TRUE;
 
+#ifdef DHD_FW_DNLD_FAST
+/* This can be overwritten by module parameter(fw_dnld_verify) defined in dhd_linux.c */
+uint fw_dnld_verify = 0;
+#endif /* DHD_FW_DNLD_FAST */
+
+#if defined(DHD_FW_COREDUMP) && defined(DHD_MEMDUMP_STREAM)
+/* This can be overwritten by module parameter(memdump_stream) defined in dhd_linux.c */
+uint memdump_stream = 0;
+
+#define DHD_MEMDUMP_STREAM_MAGIC	0x34445A4DU	/* "MZD4" */
+#define DHD_MEMDUMP_STREAM_VER		1U
+#define DHD_MEMDUMP_STREAM_CHUNK	(64U * 1024U)
+
+/* A streamed SoC RAM dump is this header, then for every DHD_MEMDUMP_STREAM_CHUNK
+ * bytes of RAM (the last chunk may be shorter) a uint32 compressed length followed
+ * by an LZ4 block. The block layout is that of a compressed fwpkg unit.
+ */
+typedef struct dhd_memdump_stream_hdr {
+	uint32 magic;
+	uint32 version;
+	uint32 ram_base;	/* dongle address of the first byte */
+	uint32 orig_size;	/* RAM bytes in the dump */
+	uint32 blk_size;	/* RAM bytes per chunk */
+} dhd_memdump_stream_hdr_t;
+#endif /* DHD_FW_COREDUMP && DHD_MEMDUMP_STREAM */
+
 #ifdef DHD_PCIE_WRAPPER_DUMP
 typedef struct pcie_wrapper {
 	char *core;
@@ -289,9 +325,12 @@ static int dhdpcie_bus_download_state(dhd_bus_t *bus, bool enter);
 static int _dhdpcie_download_firmware(struct dhd_bus *bus);
 static int dhdpcie_download_firmware(dhd_bus_t *bus, osl_t *osh);
 #ifndef DHD_LINUX_STD_FW_API
-static int dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize,
-	uint32 addr, char *path);
+static int dhdpcie_download_file(dhd_bus_t *bus, void *filep, fwpkg_stream_t *st,
+	uint32 fsize, uint32 addr, char *path);
 #endif
+#ifdef DHD_FW_DNLD_FAST
+static int dhdpcie_bus_membytes_burst(dhd_bus_t *bus, ulong address, uint8 *data, uint size);
+#endif /* DHD_FW_DNLD_FAST */
 
 #if defined(FW_SIGNATURE)
 static int dhdpcie_bus_download_fw_signature(dhd_bus_t *bus, bool *do_write);
@@ -605,6 +644,9 @@ enum {
 	IOV_PTM_ENABLE,
 	IOV_PCIE_DMAXFER_PTRN,
 	IOV_HOST_INIT_HW_EXIT_LATENCY,
+#ifdef DHD_FLOWRING_SCHED
+	IOV_FLOW_SCHED,
+#endif /* DHD_FLOWRING_SCHED */
 
 	IOV_PCIE_LAST /**< unused IOVAR */
 };
@@ -780,6 +822,9 @@ const bcm_iovar_t dhdpcie_iovars[] = {
 	{"ptm_enable", IOV_PTM_ENABLE,	0,	0, IOVT_UINT32,	0 },
 	{"host_init_hw_exit_latency", IOV_HOST_INIT_HW_EXIT_LATENCY, 0, 0,
 	IOVT_UINT32, 0 },
+#ifdef DHD_FLOWRING_SCHED
+	{"flow_sched", IOV_FLOW_SCHED, 0, 0, IOVT_UINT32, 0 },
+#endif /* DHD_FLOWRING_SCHED */
 	{NULL, 0, 0, 0, 0, 0 }
 };
 
@@ -1462,6 +1507,9 @@ int dhdpcie_bus_attach(osl_t *osh, dhd_bus_t **bus_ptr,
 #ifdef DHD_MESH
 		bus->mesh_rxcpl_max_items = DHD_MAX_ITEMS_MESH_RXCPL_RING;
 #endif /* DHD_MESH */
+#ifdef DHD_FLOWRING_SCHED
+		dhd_bus_flow_sched_set_mode(bus, FLOW_SCHED_DEFAULT);
+#endif /* DHD_FLOWRING_SCHED */
 
 		DHD_TRACE(("%s: EXIT SUCCESS\n",
 			__FUNCTION__));
@@ -4610,6 +4658,41 @@ dhdpcie_download_firmware(struct dhd_bus *bus, osl_t *osh)
 } /* dhdpcie_download_firmware */
 
 
+#ifdef DHD_FW_DNLD_FAST
+/**
+ * Writes one image block to dongle RAM through the burst path and, if fw_dnld_verify
+ * is set, reads it back into 'vbuf' for comparison. Copy and verify times are added
+ * to the download stats of the bus.
+ */
+static int
+dhdpcie_download_block(dhd_bus_t *bus, ulong address, uint8 *data, uint len, uint8 *vbuf)
+{
+	uint64 ts = OSL_LOCALTIME_NS();
+	int bcmerror;
+
+	bcmerror = dhdpcie_bus_membytes_burst(bus, address, data, len);
+	bus->fw_dnld_copy_ns += OSL_LOCALTIME_NS() - ts;
+	if (bcmerror != BCME_OK) {
+		return bcmerror;
+	}
+	bus->fw_dnld_bytes += len;
+
+	if (vbuf) {
+		ts = OSL_LOCALTIME_NS();
+		bcmerror = dhdpcie_bus_membytes(bus, FALSE, DHD_PCIE_MEM_BAR1, address,
+			vbuf, len);
+		if (bcmerror == BCME_OK && memcmp(vbuf, data, len)) {
+			DHD_ERROR(("%s: readback mismatch, %u bytes at 0x%08lx\n",
+				__FUNCTION__, len, address));
+			bcmerror = BCME_ERROR;
+		}
+		bus->fw_dnld_verify_ns += OSL_LOCALTIME_NS() - ts;
+	}
+
+	return bcmerror;
+}
+#endif /* DHD_FW_DNLD_FAST */
+
 #ifdef DHD_LINUX_STD_FW_API
 static int
 dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
@@ -4621,6 +4704,17 @@ dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	int offset_end = bus->ramsize;
 	const struct firmware *fw = NULL;
 	int buf_offset = 0, residual_len = 0;
+	uint8 *data;
+#ifdef DHD_FW_DNLD_FAST
+	uint8 *vbuf = NULL;
+	uint64 ts;
+#endif /* DHD_FW_DNLD_FAST */
+#ifdef DHD_FWPKG_COMP
+	fwpkg_stream_t st;
+	uint8 *dbuf = NULL;
+
+	bzero(&st, sizeof(st));
+#endif /* DHD_FWPKG_COMP */
 
 #if defined(DHD_FW_MEM_CORRUPTION)
 	if (dhd_bus_get_fw_mode(bus->dhd) == DHD_FLAG_MFG_MODE) {
@@ -4655,6 +4749,9 @@ dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	store_reset = (si_setcore(bus->sih, ARMCR4_CORE_ID, 0) ||
 			si_setcore(bus->sih, ARMCA7_CORE_ID, 0));
 
+#ifdef DHD_FW_DNLD_FAST
+	ts = OSL_LOCALTIME_NS();
+#endif /* DHD_FW_DNLD_FAST */
 	bcmerror = dhd_os_get_img_fwreq(&fw, bus->fw_path);
 	if (bcmerror < 0) {
 		DHD_ERROR(("dhd_os_get_img(Request Firmware API) error : %d\n",
@@ -4662,39 +4759,103 @@ dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
 		goto err;
 	}
 	DHD_PRINT(("dhd_os_get_img(Request Firmware API) success\n"));
+#ifdef DHD_FW_DNLD_FAST
+	/* request_firmware() hands over the whole image, so it is all read time */
+	bus->fw_dnld_read_ns += OSL_LOCALTIME_NS() - ts;
+	if (fw_dnld_verify) {
+		vbuf = VMALLOC(bus->dhd->osh, DHD_FW_DNLD_BLKSZ);
+		if (vbuf == NULL) {
+			DHD_ERROR(("%s: no memory for readback, skip verify\n", __FUNCTION__));
+		}
+	}
+#endif /* DHD_FW_DNLD_FAST */
 	residual_len = fw->size;
+#ifdef DHD_FWPKG_COMP
+	/* a combined package may carry the firmware unit compressed */
+	bcmerror = fwpkg_init_mem(&bus->fwpkg, (const char *)fw->data, fw->size);
+	if (bcmerror == BCME_ERROR) {
+		goto err;
+	}
+	if (bcmerror == BCME_OK) {
+		bcmerror = fwpkg_stream_open_mem(&st, &bus->fwpkg, FWPKG_TAG_FW,
+			(const char *)fw->data);
+		if (bcmerror != BCME_OK) {
+			DHD_ERROR(("%s: can't read firmware unit, err %d\n",
+				__FUNCTION__, bcmerror));
+			goto err;
+		}
+		dbuf = VMALLOC(bus->dhd->osh, DHD_FW_DNLD_BLKSZ);
+		if (dbuf == NULL) {
+			DHD_ERROR(("%s: Failed to allocate memory %d bytes\n", __FUNCTION__,
+				DHD_FW_DNLD_BLKSZ));
+			bcmerror = BCME_NOMEM;
+			goto err;
+		}
+		residual_len = fwpkg_get_firmware_img_size(&bus->fwpkg);
+		DHD_INFO(("%s Using COMBINED image (size %d)\n", __FUNCTION__, residual_len));
+	}
+	bcmerror = BCME_OK;
+#endif /* DHD_FWPKG_COMP */
 	while (residual_len) {
-		len = MIN(residual_len, MEMBLOCK);
+		len = MIN(residual_len, DHD_FW_DNLD_BLKSZ);
+		data = (uint8 *)fw->data + buf_offset;
+#ifdef DHD_FWPKG_COMP
+		if (dbuf) {
+			/* inflate the next block of the unit */
+			if (fwpkg_stream_read(&st, (char *)dbuf, len) != len) {
+				DHD_ERROR(("%s: can't read %d bytes of the firmware unit\n",
+					__FUNCTION__, len));
+				bcmerror = BCME_ERROR;
+				goto err;
+			}
+			data = dbuf;
+		}
+#endif /* DHD_FWPKG_COMP */
 
 		/* if address is 0, store the reset instruction to be written in 0 */
 		if (store_reset) {
 			ASSERT(offset == 0);
-			bus->resetinstr = *(((uint32*)fw->data + buf_offset));
+			bus->resetinstr = *((uint32 *)data);
 			/* Add start of RAM address to the address given by user */
 			offset += bus->dongle_ram_base;
 			offset_end += offset;
 			store_reset = FALSE;
 		}
 
-		bcmerror = dhdpcie_bus_membytes(bus, TRUE, DHD_PCIE_MEM_BAR1, offset,
-			(uint8 *)fw->data + buf_offset, len);
-		if (bcmerror) {
-			DHD_ERROR(("%s: error %d on writing %d membytes at 0x%08x\n",
-				__FUNCTION__, bcmerror, MEMBLOCK, offset));
+		if (offset + len > offset_end) {
+			DHD_ERROR(("%s: invalid address access to %x len %d (offset end: %x)\n",
+				__FUNCTION__, offset, len, offset_end));
+			bcmerror = BCME_ERROR;
 			goto err;
 		}
-		offset += MEMBLOCK;
 
-		if (offset >= offset_end) {
-			DHD_ERROR(("%s: invalid address access to %x (offset end: %x)\n",
-				__FUNCTION__, offset, offset_end));
-			bcmerror = BCME_ERROR;
+#ifdef DHD_FW_DNLD_FAST
+		bcmerror = dhdpcie_download_block(bus, offset, data, len, vbuf);
+#else
+		bcmerror = dhdpcie_bus_membytes(bus, TRUE, DHD_PCIE_MEM_BAR1, offset,
+			data, len);
+#endif /* DHD_FW_DNLD_FAST */
+		if (bcmerror) {
+			DHD_ERROR(("%s: error %d on writing %d membytes at 0x%08x\n",
+				__FUNCTION__, bcmerror, len, offset));
 			goto err;
 		}
+		offset += DHD_FW_DNLD_BLKSZ;
 		residual_len -= len;
 		buf_offset += len;
 	}
 err:
+#ifdef DHD_FW_DNLD_FAST
+	if (vbuf) {
+		VMFREE(bus->dhd->osh, vbuf, DHD_FW_DNLD_BLKSZ);
+	}
+#endif /* DHD_FW_DNLD_FAST */
+#ifdef DHD_FWPKG_COMP
+	fwpkg_stream_close(&st);
+	if (dbuf) {
+		VMFREE(bus->dhd->osh, dbuf, DHD_FW_DNLD_BLKSZ);
+	}
+#endif /* DHD_FWPKG_COMP */
 	if (fw) {
 		dhd_os_close_img_fwreq(fw);
 	}
@@ -4716,6 +4877,9 @@ dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	void *filep = NULL;
 	uint32 file_size = 0;
 	fwpkg_info_t *fwpkg;
+	fwpkg_stream_t st;
+
+	bzero(&st, sizeof(st));
 
 #if defined(__linux__)
 #if defined(DHD_FW_MEM_CORRUPTION)
@@ -4769,10 +4933,17 @@ dhdpcie_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	bus->fw_download_len = file_size;
 	bus->fw_download_addr = bus->dongle_ram_base;
 
+	/* compressed units are inflated straight into the download blocks */
+	bcmerror = fwpkg_stream_open(&st, fwpkg, FWPKG_TAG_FW, filep);
+	if (bcmerror != BCME_OK) {
+		DHD_ERROR(("%s: can't read firmware unit, err %d\n", __FUNCTION__, bcmerror));
+		goto err;
+	}
 
-	bcmerror = dhdpcie_download_file(bus, filep, file_size,
+	bcmerror = dhdpcie_download_file(bus, filep, &st, file_size,
 		bus->fw_download_addr, pfw_path);
 err:
+	fwpkg_stream_close(&st);
 	if (filep) {
 		dhd_os_close_image1(bus->dhd, filep);
 	}
@@ -4780,8 +4951,14 @@ err:
 	return bcmerror;
 } /* dhdpcie_download_code_file */
 
+/**
+ * Downloads 'fsize' bytes read from 'filep' into dongle RAM at 'addr'.
+ * If 'st' is given, the data is read through it, which inflates compressed
+ * fwpkg units on the fly.
+ */
 static int
-dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize, uint32 addr, char *path)
+dhdpcie_download_file(dhd_bus_t *bus, void *filep, fwpkg_stream_t *st, uint32 fsize,
+	uint32 addr, char *path)
 {
 	int bcmerror = BCME_OK;
 	int offset = 0;
@@ -4794,18 +4971,36 @@ dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize, uint32 addr, ch
 	int buf_offset, total_len, residual_len;
 	char * dnld_buf = NULL;
 #endif /* CACHE_FW_IMAGE */
+#ifdef DHD_FW_DNLD_FAST
+	uint8 *vbuf = NULL;
+	uint64 ts;
+#endif /* DHD_FW_DNLD_FAST */
 
 	BCM_REFERENCE(path);
 
-	memptr = memblock = MALLOC(bus->dhd->osh, MEMBLOCK + DHD_SDALIGN);
+#ifdef DHD_FW_DNLD_FAST
+	/* the block needs no physical contiguity, avoid a high order kmalloc */
+	memptr = memblock = VMALLOC(bus->dhd->osh, DHD_FW_DNLD_BLKSZ + DHD_SDALIGN);
+#else
+	memptr = memblock = MALLOC(bus->dhd->osh, DHD_FW_DNLD_BLKSZ + DHD_SDALIGN);
+#endif /* DHD_FW_DNLD_FAST */
 	if (memblock == NULL) {
-		DHD_ERROR(("%s: Failed to allocate memory %d bytes\n", __FUNCTION__, MEMBLOCK));
+		DHD_ERROR(("%s: Failed to allocate memory %d bytes\n", __FUNCTION__,
+			DHD_FW_DNLD_BLKSZ));
 		bcmerror = BCME_NOMEM;
 		goto err;
 	}
 	if ((uint32)(uintptr)memblock % DHD_SDALIGN) {
 		memptr += (DHD_SDALIGN - ((uint32)(uintptr)memblock % DHD_SDALIGN));
 	}
+#ifdef DHD_FW_DNLD_FAST
+	if (fw_dnld_verify) {
+		vbuf = VMALLOC(bus->dhd->osh, DHD_FW_DNLD_BLKSZ);
+		if (vbuf == NULL) {
+			DHD_ERROR(("%s: no memory for readback, skip verify\n", __FUNCTION__));
+		}
+	}
+#endif /* DHD_FW_DNLD_FAST */
 
 	/* check if CR4/CA7 */
 	store_reset = (si_setcore(bus->sih, ARMCR4_CORE_ID, 0) ||
@@ -4821,10 +5016,10 @@ dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize, uint32 addr, ch
 		goto err;
 	}
 	residual_len = total_len;
-	/* Download image with MEMBLOCK size */
+	/* Download image with DHD_FW_DNLD_BLKSZ size */
 	while (residual_len) {
-		len = MIN(residual_len, MEMBLOCK);
-		bcmerror = memcpy_s(memptr, MEMBLOCK, dnld_buf + buf_offset, len);
+		len = MIN(residual_len, DHD_FW_DNLD_BLKSZ);
+		bcmerror = memcpy_s(memptr, DHD_FW_DNLD_BLKSZ, dnld_buf + buf_offset, len);
 		if (bcmerror) {
 			DHD_ERROR(("%s: failed to copy part of image, err=%d\n",
 				__FUNCTION__, bcmerror));
@@ -4833,8 +5028,25 @@ dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize, uint32 addr, ch
 		residual_len -= len;
 		buf_offset += len;
 #else
-	/* Download image with MEMBLOCK size */
-	while ((len = dhd_os_get_image_block((char*)memptr, MEMBLOCK, filep))) {
+	/* Download image with DHD_FW_DNLD_BLKSZ size. Sequential reads of the image
+	 * trigger the page cache readahead, so the next block is being fetched from
+	 * storage while the current one is copied to the dongle.
+	 */
+	while (TRUE) {
+#ifdef DHD_FW_DNLD_FAST
+		ts = OSL_LOCALTIME_NS();
+#endif /* DHD_FW_DNLD_FAST */
+		if (st) {
+			len = fwpkg_stream_read(st, (char*)memptr, DHD_FW_DNLD_BLKSZ);
+		} else {
+			len = dhd_os_get_image_block((char*)memptr, DHD_FW_DNLD_BLKSZ, filep);
+		}
+#ifdef DHD_FW_DNLD_FAST
+		bus->fw_dnld_read_ns += OSL_LOCALTIME_NS() - ts;
+#endif /* DHD_FW_DNLD_FAST */
+		if (len == 0) {
+			break;
+		}
 		if (len < 0) {
 			DHD_ERROR(("%s: dhd_os_get_image_block failed (%d)\n", __FUNCTION__, len));
 			bcmerror = BCME_ERROR;
@@ -4860,30 +5072,43 @@ dhdpcie_download_file(dhd_bus_t *bus, void *filep, uint32 fsize, uint32 addr, ch
 			store_reset = FALSE;
 		}
 
+		if (offset + len > offset_end) {
+			DHD_ERROR(("%s: invalid address access to %x len %d (offset end: %x)\n",
+				__FUNCTION__, offset, len, offset_end));
+			bcmerror = BCME_ERROR;
+			goto err;
+		}
+
+#ifdef DHD_FW_DNLD_FAST
+		bcmerror = dhdpcie_download_block(bus, offset, (uint8 *)memptr, len, vbuf);
+#else
 		bcmerror = dhdpcie_bus_membytes(bus, TRUE, DHD_PCIE_MEM_BAR1, offset,
 				(uint8 *)memptr, len);
+#endif /* DHD_FW_DNLD_FAST */
 		if (bcmerror) {
 			DHD_ERROR(("%s: error %d on writing %d membytes at 0x%08x\n",
-				__FUNCTION__, bcmerror, MEMBLOCK, offset));
-			goto err;
-		}
-		offset += MEMBLOCK;
-
-		if (offset >= offset_end) {
-			DHD_ERROR(("%s: invalid address access to %x (offset end: %x)\n",
-				__FUNCTION__, offset, offset_end));
-			bcmerror = BCME_ERROR;
+				__FUNCTION__, bcmerror, len, offset));
 			goto err;
 		}
+		offset += DHD_FW_DNLD_BLKSZ;
 
 		if (read_len >= fsize) {
 			break;
 		}
 	}
 err:
+#ifdef DHD_FW_DNLD_FAST
+	if (vbuf) {
+		VMFREE(bus->dhd->osh, vbuf, DHD_FW_DNLD_BLKSZ);
+	}
+	if (memblock) {
+		VMFREE(bus->dhd->osh, memblock, DHD_FW_DNLD_BLKSZ + DHD_SDALIGN);
+	}
+#else
 	if (memblock) {
-		MFREE(bus->dhd->osh, memblock, MEMBLOCK + DHD_SDALIGN);
+		MFREE(bus->dhd->osh, memblock, DHD_FW_DNLD_BLKSZ + DHD_SDALIGN);
 	}
+#endif /* DHD_FW_DNLD_FAST */
 #if defined(CACHE_FW_IMAGES)
 	if (dnld_buf) {
 		dhd_free_download_buffer(bus->dhd, dnld_buf, total_len);
@@ -5142,6 +5367,9 @@ _dhdpcie_download_firmware(struct dhd_bus *bus)
 
 	bool embed = FALSE;	/* download embedded firmware */
 	bool dlok = FALSE;	/* download firmware succeeded */
+#ifdef DHD_FW_DNLD_FAST
+	uint64 dnld_start;
+#endif /* DHD_FW_DNLD_FAST */
 
 	/* Out immediately if no image to download */
 	if ((bus->fw_path == NULL) || (bus->fw_path[0] == '\0')) {
@@ -5154,6 +5382,18 @@ _dhdpcie_download_firmware(struct dhd_bus *bus)
 		return 0;
 	}
 #endif
+#ifdef DHD_FW_DNLD_FAST
+	dnld_start = OSL_LOCALTIME_NS();
+	bus->fw_dnld_bytes = 0;
+	bus->fw_dnld_read_ns = 0;
+	bus->fw_dnld_copy_ns = 0;
+	bus->fw_dnld_verify_ns = 0;
+	/* without the write-combined mapping the download falls back to word writes */
+	if (dhdpcie_bus_tcm_wc_map(bus) != BCME_OK) {
+		DHD_ERROR(("%s: no write-combined BAR1 mapping, using PIO\n", __FUNCTION__));
+	}
+#endif /* DHD_FW_DNLD_FAST */
+
 	/* Keep arm in reset */
 	if (dhdpcie_bus_download_state(bus, TRUE)) {
 		DHD_ERROR(("%s: error placing ARM core in reset\n", __FUNCTION__));
@@ -5200,6 +5440,14 @@ _dhdpcie_download_firmware(struct dhd_bus *bus)
 	bcmerror = 0;
 
 err:
+#ifdef DHD_FW_DNLD_FAST
+	dhdpcie_bus_tcm_wc_unmap(bus);
+	DHD_PRINT(("%s: %u bytes in %llu us: read %llu us, copy %llu us, verify %llu us\n",
+		__FUNCTION__, bus->fw_dnld_bytes,
+		(OSL_LOCALTIME_NS() - dnld_start) / NSEC_PER_USEC,
+		bus->fw_dnld_read_ns / NSEC_PER_USEC, bus->fw_dnld_copy_ns / NSEC_PER_USEC,
+		bus->fw_dnld_verify_ns / NSEC_PER_USEC));
+#endif /* DHD_FW_DNLD_FAST */
 #ifdef BCM_ROUTER_DHD
 	_dhdpcie_free_nvram_params(bus);
 #endif /* BCM_ROUTER_DHD */
@@ -5940,16 +6188,13 @@ void dhdpcie_mem_dump_bugcheck(dhd_bus_t *bus, uint8 *buf)
  *   BCME_OK if succeed or errors from dongle access
  */
 static int
-dhdpcie_read_dnglbp(dhd_bus_t *bus, int src, int src_size, uint8 *obuf)
+dhdpcie_read_dnglbp_blocks(dhd_bus_t *bus, int src, int src_size, uint8 *obuf)
 {
 	int read_size;
 	int ret = BCME_OK;
 #if defined(BOARD_HIKEY) || defined (BOARD_STB)
 	unsigned long flags_bus;
 #endif /* BOARD_HIKEY || BOARD_STB */
-	uint32 *sharea_addr = 0;
-
-	DHD_TRACE_HW4(("Dump dongle memory\n"));
 
 	while (src_size > 0) {
 		read_size = MIN(MEMBLOCK, src_size);
@@ -5976,6 +6221,25 @@ dhdpcie_read_dnglbp(dhd_bus_t *bus, int src, int src_size, uint8 *obuf)
 		obuf += read_size;
 	}
 
+exit:
+	return ret;
+}
+
+/* Same as dhdpcie_read_dnglbp_blocks(), then sanity checks the last word read */
+static int
+dhdpcie_read_dnglbp(dhd_bus_t *bus, int src, int src_size, uint8 *obuf)
+{
+	int ret;
+	uint32 *sharea_addr = 0;
+
+	DHD_TRACE_HW4(("Dump dongle memory\n"));
+
+	ret = dhdpcie_read_dnglbp_blocks(bus, src, src_size, obuf);
+	if (ret) {
+		goto exit;
+	}
+	obuf += src_size;
+
 	/* check if last 4bytes is not 0xffffffff, the
 	 * last 4 bytes always have a valid pcie shared area
 	 * addr and cannot be 0xffffffff
@@ -6141,6 +6405,126 @@ exit:
 	return ret;
 }
 
+#ifdef DHD_MEMDUMP_STREAM
+/*
+ * The memdump work streams RAM to the kernel file writer instead of taking a
+ * full RAM copy, when asked to by the module parameter and when no other
+ * consumer needs the buffered copy. Of the DHD_COREDUMP paths only the platform
+ * coredump built with DHD_SSSR_COREDUMP reads the SoC RAM buffer, the trap
+ * string and EWP state it also collects do not depend on it. The HAL file dump
+ * (DHD_FILE_DUMP_EVENT) reads the buffer too.
+ */
+static bool
+dhdpcie_mem_dump_stream_enab(dhd_bus_t *bus)
+{
+#if defined(DHD_DUMP_FILE_WRITE_FROM_KERNEL) && !defined(DHD_FILE_DUMP_EVENT) && \
+	!defined(DHD_SSSR_COREDUMP)
+	return (memdump_stream != 0);
+#else
+	return FALSE;
+#endif /* DHD_DUMP_FILE_WRITE_FROM_KERNEL && !DHD_FILE_DUMP_EVENT && !DHD_SSSR_COREDUMP */
+}
+
+/**
+ * Reads dongle RAM one chunk at a time, LZ4 compresses the chunk and hands it to
+ * 'sink'. Peak memory is one chunk and its compressed copy rather than all of RAM.
+ * See dhd_memdump_stream_hdr_t for the output format.
+ */
+int
+dhd_bus_mem_dump_stream(dhd_pub_t *dhdp, dhd_memdump_sink_t sink, void *ctx)
+{
+	dhd_bus_t *bus = dhdp->bus;
+	dhd_memdump_stream_hdr_t hdr;
+	uint8 *chunk = NULL, *cbuf = NULL;
+	void *wrkmem = NULL;
+	uint32 cbuf_size = LZ4_COMPRESSBOUND(DHD_MEMDUMP_STREAM_CHUNK);
+	uint32 src, left, len = 0, comp_len;
+	uint32 out_bytes = 0;
+	uint64 start_ns = OSL_LOCALTIME_NS(), read_ns = 0, ts;
+	int ret = BCME_OK;
+	int clen;
+
+	if (bus == NULL || bus->link_state != DHD_PCIE_ALL_GOOD) {
+		DHD_ERROR(("%s: bus not ready\n", __FUNCTION__));
+		return BCME_NOTUP;
+	}
+
+	chunk = VMALLOC(dhdp->osh, DHD_MEMDUMP_STREAM_CHUNK);
+	/* the compressed length is emitted in front of the block */
+	cbuf = VMALLOC(dhdp->osh, sizeof(comp_len) + cbuf_size);
+	wrkmem = VMALLOC(dhdp->osh, LZ4_MEM_COMPRESS);
+	if (!chunk || !cbuf || !wrkmem) {
+		DHD_ERROR(("%s: Out of memory\n", __FUNCTION__));
+		ret = BCME_NOMEM;
+		goto exit;
+	}
+
+	hdr.magic = DHD_MEMDUMP_STREAM_MAGIC;
+	hdr.version = DHD_MEMDUMP_STREAM_VER;
+	hdr.ram_base = bus->dongle_ram_base;
+	hdr.orig_size = bus->ramsize;
+	hdr.blk_size = DHD_MEMDUMP_STREAM_CHUNK;
+	ret = sink(ctx, (uint8 *)&hdr, sizeof(hdr));
+	if (ret) {
+		goto exit;
+	}
+	out_bytes += sizeof(hdr);
+
+	src = bus->dongle_ram_base;
+	left = bus->ramsize;
+	while (left) {
+		len = MIN(left, DHD_MEMDUMP_STREAM_CHUNK);
+		ts = OSL_LOCALTIME_NS();
+		ret = dhdpcie_read_dnglbp_blocks(bus, src, len, chunk);
+		read_ns += OSL_LOCALTIME_NS() - ts;
+		if (ret) {
+			DHD_ERROR(("%s: Failed to read wlan ram at 0x%x\n", __FUNCTION__, src));
+			goto exit;
+		}
+
+		clen = LZ4_compress_default((char *)chunk, (char *)cbuf + sizeof(comp_len),
+			len, cbuf_size, wrkmem);
+		if (clen <= 0) {
+			DHD_ERROR(("%s: compression failed at 0x%x\n", __FUNCTION__, src));
+			ret = BCME_ERROR;
+			goto exit;
+		}
+		comp_len = (uint32)clen;
+		memcpy(cbuf, &comp_len, sizeof(comp_len));
+		ret = sink(ctx, cbuf, sizeof(comp_len) + comp_len);
+		if (ret) {
+			goto exit;
+		}
+		out_bytes += sizeof(comp_len) + comp_len;
+
+		src += len;
+		left -= len;
+	}
+
+	/* as for the buffered dump, the last word has to be the pcie shared address */
+	if (*(uint32 *)(chunk + len - sizeof(uint32)) == 0xFFFFFFFFU) {
+		DHD_ERROR(("%s: Error! Last word is 0xFFFFFFFF\n", __FUNCTION__));
+		ret = BCME_NOTUP;
+	}
+
+exit:
+	DHD_PRINT(("%s: ret %d, %u bytes of RAM to %u bytes in %llu us (read %llu us)\n",
+		__FUNCTION__, ret, bus->ramsize, out_bytes,
+		(OSL_LOCALTIME_NS() - start_ns) / NSEC_PER_USEC, read_ns / NSEC_PER_USEC));
+	if (wrkmem) {
+		VMFREE(dhdp->osh, wrkmem, LZ4_MEM_COMPRESS);
+	}
+	if (cbuf) {
+		VMFREE(dhdp->osh, cbuf, sizeof(comp_len) + cbuf_size);
+	}
+	if (chunk) {
+		VMFREE(dhdp->osh, chunk, DHD_MEMDUMP_STREAM_CHUNK);
+	}
+
+	return ret;
+}
+#endif /* DHD_MEMDUMP_STREAM */
+
 static int
 dhdpcie_retry_memdump(dhd_bus_t *bus)
 {
@@ -6230,6 +6614,7 @@ dhdpcie_mem_dump(dhd_bus_t *bus)
 	bool timeout = FALSE;
 	bool collect_cbaon_dmps = FALSE;
 	bool cmnbp_state = BCME_OK;
+	bool stream = FALSE;
 
 #ifdef GDB_PROXY
 	bus->gdb_proxy_mem_dump_count++;
@@ -6410,6 +6795,14 @@ dhdpcie_mem_dump(dhd_bus_t *bus)
 		dhdpcie_get_cbaon_coredumps(bus);
 	}
 
+#ifdef DHD_MEMDUMP_STREAM
+	if (dhdp->skip_memdump_map_read == FALSE && cmnbp_state == BCME_OK &&
+		dhdpcie_mem_dump_stream_enab(bus)) {
+		/* RAM is read out chunk by chunk by the memdump work, no copy here */
+		DHD_PRINT(("%s: mem dump is streamed by the writer\n", __FUNCTION__));
+		stream = TRUE;
+	} else
+#endif /* DHD_MEMDUMP_STREAM */
 	if (dhdp->skip_memdump_map_read == FALSE && cmnbp_state == BCME_OK) {
 		ret = dhdpcie_get_mem_dump(bus);
 		if (ret == BCME_NOTUP && CHIPTYPE(bus->sih->socitype) == SOCI_NCI) {
@@ -6462,7 +6855,12 @@ dhdpcie_mem_dump(dhd_bus_t *bus)
 #ifdef DHD_SSSR_DUMP
 sched_memdump:
 #endif /* DHD_SSSR_DUMP */
-	dhd_schedule_memdump(dhdp, dhdp->soc_ram, dhdp->soc_ram_length);
+	if (stream) {
+		/* a NULL buffer tells the memdump work to stream RAM itself */
+		dhd_schedule_memdump(dhdp, NULL, 0);
+	} else {
+		dhd_schedule_memdump(dhdp, dhdp->soc_ram, dhdp->soc_ram_length);
+	}
 	/* buf, actually soc_ram free handled in dhd_{free,clear} */
 
 #ifdef DHD_PCIE_NATIVE_RUNTIMEPM
@@ -6626,6 +7024,128 @@ dhdpcie_bus_membytes(dhd_bus_t *bus, bool write, dhd_pcie_mem_region_t region,
 	return BCME_OK;
 } /* dhdpcie_bus_membytes */
 
+#ifdef DHD_FLOWRING_SCHED
+/** DRR cost of a packet: its length in bytes */
+static uint32
+BCMFASTPATH(dhd_bus_flow_sched_cost_bytes)(struct dhd_bus *bus, flow_ring_node_t *node,
+	void *pkt)
+{
+	return PKTLEN(bus->dhd->osh, pkt);
+}
+
+#ifdef TX_STATUS_LATENCY_STATS
+/** Airtime cost of a packet: the flow's recent average txcpl latency, see refill */
+static uint32
+BCMFASTPATH(dhd_bus_flow_sched_cost_airtime)(struct dhd_bus *bus, flow_ring_node_t *node,
+	void *pkt)
+{
+	return node->sched.airtime_us;
+}
+#endif /* TX_STATUS_LATENCY_STATS */
+
+int
+dhd_bus_flow_sched_set_mode(struct dhd_bus *bus, uint32 mode)
+{
+	switch (mode) {
+		case FLOW_SCHED_NONE:
+			bus->flow_sched_cost = NULL;
+			break;
+		case FLOW_SCHED_DRR:
+			bus->flow_sched_cost = dhd_bus_flow_sched_cost_bytes;
+			break;
+#ifdef TX_STATUS_LATENCY_STATS
+		case FLOW_SCHED_AIRTIME:
+			bus->flow_sched_cost = dhd_bus_flow_sched_cost_airtime;
+			break;
+#endif /* TX_STATUS_LATENCY_STATS */
+		default:
+			DHD_ERROR(("%s: unsupported flow_sched mode %u\n", __FUNCTION__, mode));
+			return BCME_UNSUPPORTED;
+	}
+
+	bus->flow_sched_mode = mode;
+	DHD_PRINT(("%s: flow_sched mode %u\n", __FUNCTION__, mode));
+	return BCME_OK;
+}
+
+/**
+ * Grant a backlogged flowring its quantum for this round. In airtime mode the per
+ * packet cost is refreshed from the txcpl latency seen since the previous round,
+ * which is a proxy for the time the dongle needed to get the flow's packets on air.
+ * Called with the flowring lock held.
+ */
+static void
+BCMFASTPATH(dhd_bus_flow_sched_refill)(struct dhd_bus *bus, flow_ring_node_t *node)
+{
+	flow_sched_t *sched = &node->sched;
+	int32 quantum = FLOW_SCHED_QUANTUM_BYTES;
+
+#ifdef TX_STATUS_LATENCY_STATS
+	if (bus->flow_sched_mode == FLOW_SCHED_AIRTIME) {
+		flow_info_t *flow_info = &node->flow_info;
+		uint64 num = flow_info->num_tx_status - sched->lat_num_prev;
+
+		quantum = FLOW_SCHED_QUANTUM_US;
+		if (num) {
+			sched->airtime_us = (uint32)DIV_U64_BY_U64(
+				flow_info->cum_tx_status_latency - sched->lat_cum_prev, num);
+			sched->lat_cum_prev = flow_info->cum_tx_status_latency;
+			sched->lat_num_prev = flow_info->num_tx_status;
+		}
+		if (sched->airtime_us == 0) {
+			sched->airtime_us = FLOW_SCHED_AIRTIME_DEF_US;
+		}
+		/* a packet must always fit in one quantum */
+		sched->airtime_us = MIN(sched->airtime_us, FLOW_SCHED_QUANTUM_US);
+	}
+#endif /* TX_STATUS_LATENCY_STATS */
+
+	sched->rounds++;
+	sched->deficit = MIN(sched->deficit + quantum, quantum * FLOW_SCHED_MAX_QUANTA);
+}
+
+static void
+dhd_bus_flow_sched_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
+{
+	struct dhd_bus *bus = dhdp->bus;
+	flow_ring_node_t *flow_ring_node;
+	flow_sched_t *sched;
+	uint64 tot_cost = 0;
+	unsigned long flags;
+	uint16 flowid;
+
+	for (flowid = 0; flowid < dhdp->num_h2d_rings; flowid++) {
+		flow_ring_node = DHD_FLOW_RING(dhdp, flowid);
+		if (flow_ring_node->status == FLOW_RING_STATUS_OPEN) {
+			tot_cost += flow_ring_node->sched.tx_cost;
+		}
+	}
+
+	bcm_bprintf(strbuf, "\nFlowring scheduler: mode %u (0:none 1:drr 2:airtime)\n",
+		bus->flow_sched_mode);
+	bcm_bprintf(strbuf, "%4s %10s %10s %8s %16s %16s %6s %12s %12s\n",
+		"Flow", "Rounds", "Stalls", "Deficit", "TxBytes", "TxCost", "Share%",
+		"AvgQDly_Us", "MaxQDly_Us");
+	for (flowid = 0; flowid < dhdp->num_h2d_rings; flowid++) {
+		flow_ring_node = DHD_FLOW_RING(dhdp, flowid);
+		DHD_FLOWRING_LOCK(flow_ring_node->lock, flags);
+		if (flow_ring_node->status != FLOW_RING_STATUS_OPEN) {
+			DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
+			continue;
+		}
+		sched = &flow_ring_node->sched;
+		bcm_bprintf(strbuf, "%4d %10u %10u %8d %16llu %16llu %6llu %12llu %12u\n",
+			flowid, sched->rounds, sched->stalls, sched->deficit,
+			sched->tx_bytes, sched->tx_cost,
+			tot_cost ? DIV_U64_BY_U64(sched->tx_cost * 100u, tot_cost) : 0,
+			sched->num_qdelay ?
+			DIV_U64_BY_U64(sched->cum_qdelay_us, sched->num_qdelay) : 0,
+			sched->max_qdelay_us);
+		DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
+	}
+}
+#endif /* DHD_FLOWRING_SCHED */
+
 extern bool agg_h2d_db_enab;
 /**
  * Transfers one transmit (ethernet) packet that was queued in the (flow controlled) flow ring queue
@@ -6646,6 +7166,15 @@ BCMFASTPATH(dhd_bus_schedule_queue)(struct dhd_bus  *bus, uint16 flow_id, bool t
 	uint8 *pktdata;
 #endif /* CUSTOMER_HW6 && DHD_LOSSLESS_ROAMING */
 	uint32 cnt = 0;
+#ifdef DHD_FLOWRING_SCHED
+	flow_sched_t *sched;
+	uint32 now_us, qdelay_us, pktlen;
+	uint32 cost = 0;
+	bool drr, stalled;
+#endif /* DHD_FLOWRING_SCHED */
+#ifdef DHD_FLOWRING_BQL
+	uint32 bql_len;
+#endif /* DHD_FLOWRING_BQL */
 
 	DHD_TRACE(("%s: flow_id is %d\n", __FUNCTION__, flow_id));
 
@@ -6688,12 +7217,46 @@ BCMFASTPATH(dhd_bus_schedule_queue)(struct dhd_bus  *bus, uint16 flow_id, bool t
 		}
 
 		if (queue->len == 0) {
+#ifdef DHD_FLOWRING_SCHED
+			/* an idle flow does not bank credit */
+			flow_ring_node->sched.deficit = 0;
+			flow_ring_node->sched.backlogged = FALSE;
+#endif /* DHD_FLOWRING_SCHED */
 			DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
 			return BCME_NOTREADY;
 		}
 
+#ifdef DHD_FLOWRING_SCHED
+		/*
+		 * Both the enqueue path and the rounds from dhd_update_txflowrings spend
+		 * credit. Once a flow is held back on credit only the rounds refill it, a
+		 * flow that is not backlogged is granted its quantum on enqueue.
+		 */
+		sched = &flow_ring_node->sched;
+		drr = (bus->flow_sched_cost != NULL);
+		if (drr && (txs || !sched->backlogged)) {
+			dhd_bus_flow_sched_refill(bus, flow_ring_node);
+		}
+		now_us = (uint32)OSL_SYSUPTIME_US();
+#endif /* DHD_FLOWRING_SCHED */
+
 		ifidx = flow_ring_node->flow_info.ifindex;
 		while ((txp = dhd_flow_queue_dequeue(bus->dhd, queue)) != NULL) {
+#ifdef DHD_FLOWRING_SCHED
+			if (drr) {
+				cost = bus->flow_sched_cost(bus, flow_ring_node, txp);
+				if ((int32)cost > sched->deficit) {
+					/* out of credit, resume on the next round */
+					dhd_flow_queue_reinsert(bus->dhd, queue, txp);
+					sched->stalls++;
+					sched->backlogged = TRUE;
+					bus->flow_sched_pending = TRUE;
+					break;
+				}
+			}
+			pktlen = PKTLEN(bus->dhd->osh, txp);
+			qdelay_us = now_us - DHD_PKT_GET_ENQ_TIME(txp);
+#endif /* DHD_FLOWRING_SCHED */
 			PKTORPHAN(txp);
 
 			/*
@@ -6735,9 +7298,17 @@ BCMFASTPATH(dhd_bus_schedule_queue)(struct dhd_bus  *bus, uint16 flow_id, bool t
 			/* Attempt to transfer packet over flow ring */
 			/* ifidx is wrong */
 			++cnt;
+#ifdef DHD_FLOWRING_BQL
+			/* ahead of the post, its txcpl may race the rest of this loop */
+			bql_len = PKTLEN(bus->dhd->osh, txp);
+			flow_ring_node->bql.posted_bytes += bql_len;
+#endif /* DHD_FLOWRING_BQL */
 			ret = dhd_prot_txdata(bus->dhd, txp, ifidx);
 			if (ret != BCME_OK) { /* may not have resources in flow ring */
 				DHD_INFO(("%s: Reinserrt %d\n", __FUNCTION__, ret));
+#ifdef DHD_FLOWRING_BQL
+				flow_ring_node->bql.posted_bytes -= bql_len;
+#endif /* DHD_FLOWRING_BQL */
 #ifdef AGG_H2D_DB
 				if (agg_h2d_db_enab) {
 					dhd_prot_schedule_aggregate_h2d_db(bus->dhd, flow_id);
@@ -6766,6 +7337,19 @@ BCMFASTPATH(dhd_bus_schedule_queue)(struct dhd_bus  *bus, uint16 flow_id, bool t
 			DHD_MEM_STATS_UNLOCK(bus->dhd->mem_stats_lock, flags);
 #endif /* DHD_MEM_STATS */
 
+#ifdef DHD_FLOWRING_SCHED
+			if (drr) {
+				sched->deficit -= (int32)cost;
+				sched->tx_cost += cost;
+			}
+			sched->tx_bytes += pktlen;
+			sched->num_qdelay++;
+			sched->cum_qdelay_us += qdelay_us;
+			if (qdelay_us > sched->max_qdelay_us) {
+				sched->max_qdelay_us = qdelay_us;
+			}
+#endif /* DHD_FLOWRING_SCHED */
+
 			/* check bound and break if exceeded */
 			if (bound && cnt >= bound) {
 				break;
@@ -6786,11 +7370,23 @@ BCMFASTPATH(dhd_bus_schedule_queue)(struct dhd_bus  *bus, uint16 flow_id, bool t
 			}
 		}
 
+#ifdef DHD_FLOWRING_SCHED
+		if (queue->len == 0) {
+			sched->backlogged = FALSE;
+		}
+		stalled = drr && !txs && (queue->len > 0);
+#endif /* DHD_FLOWRING_SCHED */
 		DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
 
 		if (is_qempty) {
 			*is_qempty = queue->len > 0 ? FALSE : TRUE;
 		}
+#ifdef DHD_FLOWRING_SCHED
+		/* held back on enqueue, the DPC round moves the rest */
+		if (stalled) {
+			dhd_sched_dpc(bus->dhd);
+		}
+#endif /* DHD_FLOWRING_SCHED */
 	}
 
 	return ret;
@@ -6905,6 +7501,9 @@ BCMFASTPATH(dhd_bus_txdata)(struct dhd_bus *bus, void *txp, uint8 ifidx)
 		txp_pend = txp;
 #endif /* defined(BCM_ROUTER_DHD) && defined(HNDCTF */
 
+#ifdef DHD_FLOWRING_BQL
+	dhd_flow_bql_check_stop(bus->dhd, flow_ring_node);
+#endif /* DHD_FLOWRING_BQL */
 	DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
 
 	if (flow_ring_node->status) {
@@ -7229,6 +7828,67 @@ dhdpcie_bus_chkandshift_bpoffset(dhd_bus_t *bus, dhd_pcie_mem_region_t region, u
 	return offset - bpwin;
 }
 
+#ifdef DHD_FW_DNLD_FAST
+/**
+ * Host to dongle bulk write used by the firmware download. Copies with memcpy_toio
+ * through the write-combined BAR1 mapping, in DHD_FW_DNLD_BURST pieces so that the
+ * bar1 switch lock is held briefly and a burst never straddles a BAR1 window.
+ * Falls back to dhdpcie_bus_membytes() if the mapping is not available.
+ * Parameter 'address' is a backplane address.
+ */
+static int
+dhdpcie_bus_membytes_burst(dhd_bus_t *bus, ulong address, uint8 *data, uint size)
+{
+	ulong flags = 0;
+	ulong offset;
+	uint dsize;
+
+	if (bus->tcm_wc == NULL) {
+		return dhdpcie_bus_membytes(bus, TRUE, DHD_PCIE_MEM_BAR1, address, data, size);
+	}
+
+	if (bus->is_linkdown) {
+		DHD_ERROR(("%s: PCIe link was down\n", __FUNCTION__));
+		return BCME_ERROR;
+	}
+
+	if (MULTIBP_ENAB(bus->sih)) {
+		dhd_bus_pcie_pwr_req(bus);
+	}
+
+	while (size) {
+		dsize = MIN(size, DHD_FW_DNLD_BURST);
+		dsize = MIN(dsize, bus->bar1_size - (address & (bus->bar1_size - 1)));
+
+		DHD_BUS_BAR1_SWITCH_LOCK(bus, flags);
+		offset = dhdpcie_bus_chkandshift_bpoffset(bus, DHD_PCIE_MEM_BAR1, address);
+		if (offset + dsize > bus->tcm_wc_size) {
+			DHD_BUS_BAR1_SWITCH_UNLOCK(bus, flags);
+			break;
+		}
+		memcpy_toio((volatile void __iomem *)(bus->tcm_wc + offset), data, dsize);
+		/* drain the write-combine buffers before the window can move */
+		wmb();
+		DHD_BUS_BAR1_SWITCH_UNLOCK(bus, flags);
+
+		size -= dsize;
+		data += dsize;
+		address += dsize;
+	}
+
+	if (MULTIBP_ENAB(bus->sih)) {
+		dhd_bus_pcie_pwr_req_clear(bus);
+	}
+
+	/* whatever is beyond the write-combined mapping goes the slow way */
+	if (size) {
+		return dhdpcie_bus_membytes(bus, TRUE, DHD_PCIE_MEM_BAR1, address, data, size);
+	}
+
+	return BCME_OK;
+} /* dhdpcie_bus_membytes_burst */
+#endif /* DHD_FW_DNLD_FAST */
+
 /** 'offset' is a backplane address */
 void
 dhdpcie_bus_wtcm8(dhd_bus_t *bus, dhd_pcie_mem_region_t region, ulong offset, uint8 data)
@@ -7888,9 +8548,30 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 		flow_info->num_tx_pkts = 0;
 		flow_info->num_tx_dropped = 0;
 		flow_info->num_tx_status = 0;
+#ifdef DHD_FLOWRING_SCHED
+		bzero(&flow_ring_node->sched, sizeof(flow_ring_node->sched));
+#ifdef TX_STATUS_LATENCY_STATS
+		flow_ring_node->sched.lat_cum_prev = flow_info->cum_tx_status_latency;
+#endif /* TX_STATUS_LATENCY_STATS */
+#endif /* DHD_FLOWRING_SCHED */
+#ifdef DHD_FLOWRING_BQL
+		flow_ring_node->bql.stops = 0;
+		flow_ring_node->bql.starved = 0;
+#endif /* DHD_FLOWRING_BQL */
 		DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
 	}
 
+#ifdef DHD_TXCPL_LAT_HIST
+	dhd_txcpl_lat_clear(dhdp);
+#endif /* DHD_TXCPL_LAT_HIST */
+#ifdef DHD_NAPI_BUSY_POLL
+	bus->rxcpl_irq_items = 0;
+	bus->rxcpl_busy_poll_items = 0;
+	bus->rxcpl_busy_poll_calls = 0;
+	bus->rxcpl_busy_poll_skip = 0;
+	bus->rxcpl_dpc_deferred = 0;
+#endif /* DHD_NAPI_BUSY_POLL */
+
 #ifdef DHD_TREAT_D3ACKTO_AS_LINKDWN
 	bus->d3ackto_as_linkdwn_cnt = 0;
 	bus->iovarto_as_linkdwn_cnt = 0;
@@ -10930,6 +11611,15 @@ dhdpcie_bus_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, cons
 	case IOV_SVAL(IOV_HOST_INIT_HW_EXIT_LATENCY):
 		dhdpcie_set_host_init_hw_exit_latency(bus, int_val);
 		break;
+#ifdef DHD_FLOWRING_SCHED
+	case IOV_SVAL(IOV_FLOW_SCHED):
+		bcmerror = dhd_bus_flow_sched_set_mode(bus, (uint32)int_val);
+		break;
+	case IOV_GVAL(IOV_FLOW_SCHED):
+		int_val = (int32)bus->flow_sched_mode;
+		bcopy(&int_val, arg, val_size);
+		break;
+#endif /* DHD_FLOWRING_SCHED */
 	case IOV_GVAL(IOV_HOST_INIT_HW_EXIT_LATENCY):
 		si_corereg(bus->sih, bus->sih->buscoreidx, PCIE_REG_OFF(ConfigIndAddr), ~0,
 			PCIECFGREG_L1SS_EXT_STATE_TMR);
@@ -12823,7 +13513,7 @@ dhdpcie_bus_download_ram_bootloader(dhd_bus_t *bus)
 		goto err;
 	}
 
-	ret = dhdpcie_download_file(bus, filep, file_size, bus->bootloader_addr,
+	ret = dhdpcie_download_file(bus, filep, NULL, file_size, bus->bootloader_addr,
 		bus->bootloader_filename);
 
 err:
@@ -12844,6 +13534,9 @@ dhdpcie_download_sig_file(dhd_bus_t *bus, char *path, uint32 type)
 	int len;
 	uint32 dest_size = 0;	/* dongle RAM dest size */
 	fwpkg_info_t *fwpkg = NULL;
+	fwpkg_stream_t st;
+
+	bzero(&st, sizeof(st));
 
 	if (path == NULL || path[0] == '\0') {
 		DHD_ERROR(("%s: no file\n", __FUNCTION__));
@@ -12879,7 +13572,12 @@ dhdpcie_download_sig_file(dhd_bus_t *bus, char *path, uint32 type)
 		bcmerror = BCME_NOMEM;
 		goto exit;
 	}
-	len = dhd_os_get_image_block(srcbuf, srcsize, filep);
+	bcmerror = fwpkg_stream_open(&st, fwpkg, FWPKG_TAG_SIG, filep);
+	if (bcmerror != BCME_OK) {
+		DHD_ERROR(("%s: can't read signature unit, err %d\n", __FUNCTION__, bcmerror));
+		goto exit;
+	}
+	len = fwpkg_stream_read(&st, (char *)srcbuf, srcsize);
 	if (len != srcsize) {
 		DHD_ERROR(("%s: dhd_os_get_image_block failed (%d)\n", __FUNCTION__, len));
 		bcmerror = BCME_BADLEN;
@@ -12893,6 +13591,7 @@ dhdpcie_download_sig_file(dhd_bus_t *bus, char *path, uint32 type)
 	bus->fwsig_download_len = dest_size;
 
 exit:
+	fwpkg_stream_close(&st);
 	if (filep) {
 		dhd_os_close_image1(bus->dhd, filep);
 	}
@@ -13503,6 +14202,12 @@ void dhd_dump_intr_counters(dhd_pub_t *dhd, struct bcmstrbuf *strbuf)
 		GET_SEC_USEC(bus->last_oob_irq_disable_time), dhdpcie_get_oob_irq_status(bus),
 		dhdpcie_get_oob_irq_level());
 #endif /* BCMPCIE_OOB_HOST_WAKE */
+#ifdef DHD_NAPI_BUSY_POLL
+	bcm_bprintf(strbuf, "rxcpl_irq_items=%llu rxcpl_busy_poll_items=%llu\n"
+		"rxcpl_busy_poll_calls=%lu rxcpl_busy_poll_skip=%lu rxcpl_dpc_deferred=%lu\n",
+		bus->rxcpl_irq_items, bus->rxcpl_busy_poll_items,
+		bus->rxcpl_busy_poll_calls, bus->rxcpl_busy_poll_skip, bus->rxcpl_dpc_deferred);
+#endif /* DHD_NAPI_BUSY_POLL */
 	bcm_bprintf(strbuf, "\ncurrent_time="SEC_USEC_FMT" isr_entry_time="SEC_USEC_FMT
 		" isr_exit_time="SEC_USEC_FMT"\n"
 		"isr_sched_dpc_time="SEC_USEC_FMT" rpm_sched_dpc_time="SEC_USEC_FMT"\n"
@@ -13668,6 +14373,13 @@ void dhd_bus_dump_flowring(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		DHD_FLOWRING_UNLOCK(flow_ring_node->lock, flags);
 	}
 
+#ifdef DHD_FLOWRING_SCHED
+	dhd_bus_flow_sched_dump(dhdp, strbuf);
+#endif /* DHD_FLOWRING_SCHED */
+#ifdef DHD_FLOWRING_BQL
+	dhd_flow_bql_dump(dhdp, strbuf);
+#endif /* DHD_FLOWRING_BQL */
+
 	/* additional per flowring stats */
 	bcm_bprintf(strbuf, "\nPer Flowring stats:\n");
 	bcm_bprintf(strbuf, "%4s   %13s   %13s", "Flow", "High Watermark", "Cur Num Items");
@@ -13832,6 +14544,12 @@ void dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	dhd_dump_intr_counters(dhdp, strbuf);
 	bcm_bprintf(strbuf, "h2d_mb_data_ptr_addr 0x%x, d2h_mb_data_ptr_addr 0x%x\n",
 		dhdp->bus->h2d_mb_data_ptr_addr, dhdp->bus->d2h_mb_data_ptr_addr);
+#ifdef DHD_FW_DNLD_FAST
+	bcm_bprintf(strbuf, "fw_dnld bytes %u read %llu us copy %llu us verify %llu us\n",
+		dhdp->bus->fw_dnld_bytes, dhdp->bus->fw_dnld_read_ns / NSEC_PER_USEC,
+		dhdp->bus->fw_dnld_copy_ns / NSEC_PER_USEC,
+		dhdp->bus->fw_dnld_verify_ns / NSEC_PER_USEC);
+#endif /* DHD_FW_DNLD_FAST */
 	bcm_bprintf(strbuf, "dhd cumm_ctr %d\n", DHD_CUMM_CTR_READ(&dhdp->cumm_ctr));
 	if (dhdp->htput_support) {
 		bcm_bprintf(strbuf, "htput_flow_ring_start:%d total_htput:%d client_htput=%d\n",
@@ -14386,6 +15104,10 @@ dhd_update_txflowrings(dhd_pub_t *dhd)
 		return more;
 	}
 
+#ifdef DHD_FLOWRING_SCHED
+	bus->flow_sched_pending = FALSE;
+#endif /* DHD_FLOWRING_SCHED */
+
 	/* Hold flowring_list_lock to ensure no race condition while accessing the List */
 	DHD_FLOWRING_LIST_LOCK(bus->dhd->flowring_list_lock, flags);
 	for (item = dll_head_p(&bus->flowring_active_list);
@@ -14420,6 +15142,11 @@ dhd_update_txflowrings(dhd_pub_t *dhd)
 	}
 	DHD_FLOWRING_LIST_UNLOCK(bus->dhd->flowring_list_lock, flags);
 
+#ifdef DHD_FLOWRING_SCHED
+	/* a flowring held back on credit needs another round */
+	more |= bus->flow_sched_pending;
+#endif /* DHD_FLOWRING_SCHED */
+
 	return more;
 }
 
@@ -15674,6 +16401,117 @@ dhdpci_bus_rte_log_time_sync_poll(dhd_bus_t *bus)
 #endif /* DHD_H2D_LOG_TIME_SYNC */
 
 
+static bool
+dhdpci_bus_read_rxcpl(dhd_bus_t *bus, uint32 *rxcpl_items)
+{
+	bool more = FALSE;
+
+#ifdef DHD_HP2P
+	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_HP2P_RING, rxcpl_items);
+#endif /* DHD_HP2P */
+#ifdef DHD_MESH
+	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_MESH_RING, rxcpl_items);
+#endif /* DHD_MESH */
+	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_REGULAR_RING, rxcpl_items);
+
+	return more;
+}
+
+#ifdef DHD_NAPI_BUSY_POLL
+static bool
+dhd_bus_rxcpl_claim(dhd_bus_t *bus)
+{
+	return atomic_cmpxchg(&bus->rxcpl_owner, 0, 1) == 0;
+}
+
+/*
+ * Claim for the DPC. When a busy poll owns the rings, leave it a request to
+ * schedule the DPC on release instead of having the DPC spin on the claim.
+ */
+static bool
+dhd_bus_rxcpl_claim_dpc(dhd_bus_t *bus)
+{
+	if (dhd_bus_rxcpl_claim(bus)) {
+		return TRUE;
+	}
+	atomic_set(&bus->rxcpl_dpc_pending, 1);
+	smp_mb__after_atomic();
+	/* the owner may have released before it could see the request */
+	if (dhd_bus_rxcpl_claim(bus)) {
+		atomic_set(&bus->rxcpl_dpc_pending, 0);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+dhd_bus_rxcpl_release(dhd_bus_t *bus)
+{
+	atomic_set_release(&bus->rxcpl_owner, 0);
+	smp_mb__after_atomic();
+	if (atomic_xchg(&bus->rxcpl_dpc_pending, 0)) {
+		/* the DPC found the rings claimed, let it process the rest */
+		dhd_sched_dpc(bus->dhd);
+	}
+}
+
+/*
+ * Called from the NAPI poll while a socket busy polls on its napi_id, with BH
+ * disabled. Drains the rx completion rings without waiting for the interrupt
+ * and DPC; frames reach the stack through the usual LB RX dispatch into the
+ * NAPI queue the caller is about to process. Skipped when the DPC is already
+ * draining the rings or the bus is not in a state where the DPC would.
+ */
+bool
+dhd_bus_rx_busy_poll(struct dhd_bus *bus)
+{
+	dhd_pub_t *dhdp = bus->dhd;
+	uint32 rxcpl_items = 0;
+	uint32 tot_rxcpl;
+	unsigned long flags;
+	bool more = FALSE;
+
+	bus->rxcpl_busy_poll_calls++;
+
+#ifdef DHD_DMA_INDICES_SEQNUM
+	/* DMA index snapshots are handshaked with the dongle from the DPC only */
+	bus->rxcpl_busy_poll_skip++;
+	return FALSE;
+#endif /* DHD_DMA_INDICES_SEQNUM */
+
+	if (dhd_query_bus_erros(dhdp) || DHD_CHK_BUS_IN_LPS(bus)) {
+		bus->rxcpl_busy_poll_skip++;
+		return FALSE;
+	}
+
+	DHD_GENERAL_LOCK(dhdp, flags);
+	if (dhdp->busstate != DHD_BUS_DATA ||
+		DHD_BUS_CHECK_SUSPEND_OR_ANY_SUSPEND_IN_PROGRESS(dhdp)) {
+		DHD_GENERAL_UNLOCK(dhdp, flags);
+		bus->rxcpl_busy_poll_skip++;
+		return FALSE;
+	}
+	DHD_BUS_BUSY_SET_IN_BUSY_POLL(dhdp);
+	DHD_GENERAL_UNLOCK(dhdp, flags);
+
+	if (dhd_bus_rxcpl_claim(bus)) {
+		tot_rxcpl = dhd_prot_get_tot_rxcpl(dhdp);
+		more = dhdpci_bus_read_rxcpl(bus, &rxcpl_items);
+		bus->rxcpl_busy_poll_items += (uint32)(dhd_prot_get_tot_rxcpl(dhdp) - tot_rxcpl);
+		dhd_bus_rxcpl_release(bus);
+	} else {
+		bus->rxcpl_busy_poll_skip++;
+	}
+
+	DHD_GENERAL_LOCK(dhdp, flags);
+	DHD_BUS_BUSY_CLEAR_IN_BUSY_POLL(dhdp);
+	dhd_os_busbusy_wake(dhdp);
+	DHD_GENERAL_UNLOCK(dhdp, flags);
+
+	return more;
+}
+#endif /* DHD_NAPI_BUSY_POLL */
+
 static bool
 dhdpci_bus_read_frames(dhd_bus_t *bus)
 {
@@ -15747,13 +16585,20 @@ dhdpci_bus_read_frames(dhd_bus_t *bus)
 	/* With heavy RX traffic, this routine potentially could spend some time
 	 * processing RX frames without RX bound
 	 */
-#ifdef DHD_HP2P
-	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_HP2P_RING, &rxcpl_items);
-#endif /* DHD_HP2P */
-#ifdef DHD_MESH
-	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_MESH_RING, &rxcpl_items);
-#endif /* DHD_MESH */
-	more |= dhd_prot_process_msgbuf_rxcpl(bus->dhd, DHD_REGULAR_RING, &rxcpl_items);
+#ifdef DHD_NAPI_BUSY_POLL
+	if (dhd_bus_rxcpl_claim_dpc(bus)) {
+		uint32 tot_rxcpl = dhd_prot_get_tot_rxcpl(bus->dhd);
+
+		more |= dhdpci_bus_read_rxcpl(bus, &rxcpl_items);
+		bus->rxcpl_irq_items += (uint32)(dhd_prot_get_tot_rxcpl(bus->dhd) - tot_rxcpl);
+		dhd_bus_rxcpl_release(bus);
+	} else {
+		/* A busy polling socket is draining the rings, it reschedules the DPC */
+		bus->rxcpl_dpc_deferred++;
+	}
+#else
+	more |= dhdpci_bus_read_rxcpl(bus, &rxcpl_items);
+#endif /* DHD_NAPI_BUSY_POLL */
 	bus->last_process_rxcpl_time = OSL_LOCALTIME_NS();
 
 	bus->rx_cpl_post_time_usec =
@@ -18009,6 +18854,9 @@ void dhd_bus_clean_flow_ring(dhd_bus_t *bus, void *node)
 
 	/* Reinitialise flowring's queue */
 	dhd_flow_queue_reinit(bus->dhd, queue, flowring_bkp_qsize);
+#ifdef DHD_FLOWRING_BQL
+	dhd_flow_bql_init(bus->dhd, flow_ring_node);
+#endif /* DHD_FLOWRING_BQL */
 	flow_ring_node->status = FLOW_RING_STATUS_CLOSED;
 	flow_ring_node->active = FALSE;
 
@@ -517,6 +517,16 @@ typedef struct dhd_bus {
 	ulong dngl_intmask_enable_count;
 	ulong dpc_return_busdown_count;
 	ulong non_ours_irq_count;
+#ifdef DHD_NAPI_BUSY_POLL
+	/* rxcpl rings are drained by either the DPC or a NAPI busy poll, never both */
+	atomic_t rxcpl_owner;
+	atomic_t rxcpl_dpc_pending;	/* DPC found the rings claimed, run it on release */
+	uint64 rxcpl_irq_items;		/* rx completions consumed from the DPC */
+	uint64 rxcpl_busy_poll_items;	/* rx completions consumed from busy poll */
+	ulong rxcpl_busy_poll_calls;
+	ulong rxcpl_busy_poll_skip;	/* bus not ready or DPC owned the rings */
+	ulong rxcpl_dpc_deferred;	/* DPC found busy poll owning the rings */
+#endif /* DHD_NAPI_BUSY_POLL */
 #ifdef BCMPCIE_OOB_HOST_WAKE
 	ulong oob_intr_count;
 	ulong oob_intr_enable_count;
@@ -617,6 +627,14 @@ typedef struct dhd_bus {
 	uint32 ramtop_addr;		/* Dongle address of unused space at top of RAM */
 	uint32 fw_download_addr;	/* Dongle address of FW download */
 	uint32 fw_download_len;		/* Length in bytes of FW download */
+#ifdef DHD_FW_DNLD_FAST
+	volatile char *tcm_wc;		/* write-combined BAR1 mapping, only during download */
+	uint32 tcm_wc_size;
+	uint32 fw_dnld_bytes;		/* bytes written by the last download */
+	uint64 fw_dnld_read_ns;		/* last download: reading the image */
+	uint64 fw_dnld_copy_ns;		/* last download: writing dongle RAM */
+	uint64 fw_dnld_verify_ns;	/* last download: reading dongle RAM back */
+#endif /* DHD_FW_DNLD_FAST */
 	uint32 fwsig_download_addr;	/* Dongle address of FW signature download */
 	uint32 fwsig_download_len;	/* Length in bytes of FW signature download */
 	uint32 fwstat_download_addr;	/* Dongle address of FWS status download */
@@ -691,8 +709,18 @@ typedef struct dhd_bus {
 	uint32 lpbk_xfer_data_pattern_type; /*  data Pattern type DMA lpbk */
 	bool ltr_active_set_during_init;
 	uint32 etb_config_addr;
+#ifdef DHD_FLOWRING_SCHED
+	uint32 flow_sched_mode;	/* FLOW_SCHED_xxx */
+	/* cost of a packet against the flowring credit, NULL if no scheduler */
+	uint32 (*flow_sched_cost)(struct dhd_bus *bus, flow_ring_node_t *node, void *pkt);
+	bool flow_sched_pending; /* a flowring ran out of credit with packets queued */
+#endif /* DHD_FLOWRING_SCHED */
 } dhd_bus_t;
 
+#ifdef DHD_FLOWRING_SCHED
+extern int dhd_bus_flow_sched_set_mode(struct dhd_bus *bus, uint32 mode);
+#endif /* DHD_FLOWRING_SCHED */
+
 #define LPBK_DMA_XFER_DTPTRN_DEFAULT	0
 #define LPBK_DMA_XFER_DTPTRN_0x00	1
 #define LPBK_DMA_XFER_DTPTRN_0xFF	2
@@ -894,6 +922,10 @@ extern int dhdpcie_disable_device(dhd_bus_t *bus);
 extern int dhdpcie_alloc_resource(dhd_bus_t *bus);
 extern void dhdpcie_free_resource(dhd_bus_t *bus);
 extern void dhdpcie_dump_resource(dhd_bus_t *bus);
+#ifdef DHD_FW_DNLD_FAST
+extern int dhdpcie_bus_tcm_wc_map(dhd_bus_t *bus);
+extern void dhdpcie_bus_tcm_wc_unmap(dhd_bus_t *bus);
+#endif /* DHD_FW_DNLD_FAST */
 extern int dhdpcie_bus_request_irq(struct dhd_bus *bus);
 void dhdpcie_os_setbar1win(dhd_bus_t *bus, uint32 addr);
 void dhdpcie_os_wtcm8(dhd_bus_t *bus, ulong offset, uint8 data);
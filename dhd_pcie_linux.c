@@ -2985,6 +2985,51 @@ dhdpcie_free_resource(dhd_bus_t *bus)
 	}
 }
 
+#ifdef DHD_FW_DNLD_FAST
+/**
+ * Maps BAR1 a second time, write-combined, for the firmware download bursts.
+ * bus->tcm keeps its uncached mapping for all other dongle memory accesses.
+ * Where the architecture tracks memory types per physical range, the alias
+ * may silently inherit the uncached attribute; the download still works.
+ */
+int
+dhdpcie_bus_tcm_wc_map(dhd_bus_t *bus)
+{
+	phys_addr_t bar1_addr;
+	ulong bar1_size;
+
+	if (bus->tcm_wc) {
+		return BCME_OK;
+	}
+
+	bar1_addr = pci_resource_start(bus->dev, 2);
+	bar1_size = pci_resource_len(bus->dev, 2);
+	if ((bar1_size == 0) || (bar1_addr == 0)) {
+		return BCME_ERROR;
+	}
+	bar1_size = MIN(bar1_size, bus->bar1_size);
+
+	bus->tcm_wc = (volatile char *)ioremap_wc(bar1_addr, bar1_size);
+	if (bus->tcm_wc == NULL) {
+		DHD_ERROR(("%s: ioremap_wc() for bar1 failed\n", __FUNCTION__));
+		return BCME_NOMEM;
+	}
+	bus->tcm_wc_size = (uint32)bar1_size;
+
+	return BCME_OK;
+}
+
+void
+dhdpcie_bus_tcm_wc_unmap(dhd_bus_t *bus)
+{
+	if (bus->tcm_wc) {
+		iounmap((void __iomem *)bus->tcm_wc);
+		bus->tcm_wc = NULL;
+		bus->tcm_wc_size = 0;
+	}
+}
+#endif /* DHD_FW_DNLD_FAST */
+
 int
 dhdpcie_bus_request_irq(struct dhd_bus *bus)
 {
@@ -57,6 +57,93 @@ extern int wl_pattern_atoh(char *src, char *dst);
 extern int pattern_atoh_len(char *src, char *dst, int len);
 extern wifi_tx_packet_fate __dhd_dbg_map_tx_status_to_pkt_fate(uint16 status);
 
+#ifdef DHD_PKTLOG_SNAP
+/* Bytes kept per logged packet, 0 keeps a full copy of the packet.
+ * This can be overwritten by module parameter(pktlog_snaplen) defined in dhd_linux.c
+ */
+uint pktlog_snaplen = DHD_PKTLOG_SNAP_DEFAULT;
+
+#define DHD_PKTLOG_SNAP_SLOT(ring, ri) \
+	((ring)->snap_mem + ((uint32)((ri) - (ring)->ring_info_mem) * DHD_PKTLOG_SNAP_MAX))
+#endif /* DHD_PKTLOG_SNAP */
+
+/* Start of the logged frame, in the snap slot or the copied packet */
+static uint8 *
+dhd_pktlog_item_data(dhd_pktlog_ring_t *ring, dhd_pktlog_ring_info_t *ri)
+{
+#ifdef DHD_PKTLOG_SNAP
+	if (ri->info.snap_len) {
+		return DHD_PKTLOG_SNAP_SLOT(ring, ri);
+	}
+#endif /* DHD_PKTLOG_SNAP */
+	return ri->info.pkt ? (uint8 *)PKTDATA(ring->dhdp->osh, ri->info.pkt) : NULL;
+}
+
+/* Bytes of a 'frame_len' frame that were captured */
+static uint32
+dhd_pktlog_item_caplen(dhd_pktlog_ring_info_t *ri, uint32 frame_len)
+{
+#ifdef DHD_PKTLOG_SNAP
+	if (ri->info.snap_len) {
+		return MIN(frame_len, ri->info.snap_len);
+	}
+#endif /* DHD_PKTLOG_SNAP */
+	return frame_len;
+}
+
+static void
+dhd_pktlog_item_release(dhd_pktlog_ring_t *ring, dhd_pktlog_ring_info_t *ri)
+{
+	if (ri->info.pkt) {
+		PKTFREE(ring->dhdp->osh, ri->info.pkt, TRUE);
+		DHD_PKT_LOG(("%s(): pkt free pos %p\n", __FUNCTION__, ri->info.pkt));
+		ri->info.pkt = NULL;
+	}
+#ifdef DHD_PKTLOG_SNAP
+	ri->info.snap_len = 0;
+#endif /* DHD_PKTLOG_SNAP */
+}
+
+#ifdef DHD_PKTLOG_SNAP
+/* The dump and reinit paths hold the ring while they walk it, and a pcapng
+ * reader holds it from open to close. Each fails while the other holds it.
+ */
+static int
+dhd_pktlog_ring_hold(dhd_pub_t *dhdp)
+{
+	unsigned long flags = 0;
+	int ret = BCME_OK;
+
+	DHD_PKT_LOG_LOCK(dhdp->pktlog->pcapng_lock, flags);
+	if (dhdp->pktlog->pcapng_rd) {
+		ret = BCME_BUSY;
+	} else {
+		dhdp->pktlog->ring_users++;
+	}
+	DHD_PKT_LOG_UNLOCK(dhdp->pktlog->pcapng_lock, flags);
+
+	if (ret != BCME_OK) {
+		DHD_ERROR(("%s(): pcapng reader is open\n", __FUNCTION__));
+	}
+	return ret;
+}
+
+static void
+dhd_pktlog_ring_unhold(dhd_pub_t *dhdp)
+{
+	unsigned long flags = 0;
+
+	DHD_PKT_LOG_LOCK(dhdp->pktlog->pcapng_lock, flags);
+	dhdp->pktlog->ring_users--;
+	DHD_PKT_LOG_UNLOCK(dhdp->pktlog->pcapng_lock, flags);
+}
+#define DHD_PKTLOG_RING_HOLD(dhdp)	dhd_pktlog_ring_hold(dhdp)
+#define DHD_PKTLOG_RING_UNHOLD(dhdp)	dhd_pktlog_ring_unhold(dhdp)
+#else
+#define DHD_PKTLOG_RING_HOLD(dhdp)	BCME_OK
+#define DHD_PKTLOG_RING_UNHOLD(dhdp)	do { } while (0)
+#endif /* DHD_PKTLOG_SNAP */
+
 #ifdef DHD_COMPACT_PKT_LOG
 #define CPKT_LOG_BITS_PER_BYTE		8
 
@@ -181,6 +268,15 @@ dhd_os_attach_pktlog(dhd_pub_t *dhdp)
 #ifdef DHD_PKT_LOGGING_DBGRING
 	OSL_ATOMIC_INIT(dhdp->osh, &pktlog->enable);
 #endif /* DHD_PKT_LOGGING_DBGRING */
+#ifdef DHD_PKTLOG_SNAP
+	pktlog->pcapng_lock = osl_spin_lock_init(dhdp->osh);
+	if (unlikely(!pktlog->pcapng_lock)) {
+		DHD_ERROR(("%s(): could not allocate pcapng lock\n", __FUNCTION__));
+		VMFREE(dhdp->osh, pktlog, sizeof(dhd_pktlog_t));
+		dhdp->pktlog = NULL;
+		return BCME_ERROR;
+	}
+#endif /* DHD_PKTLOG_SNAP */
 
 	/* pktlog ring */
 	dhdp->pktlog->pktlog_ring = dhd_pktlog_ring_init(dhdp, MIN_PKTLOG_LEN);
@@ -221,6 +317,11 @@ dhd_os_detach_pktlog(dhd_pub_t *dhdp)
 
 	DHD_INFO(("%s(): dhd_os_attach_pktlog detach\n", __FUNCTION__));
 
+#ifdef DHD_PKTLOG_SNAP
+	if (dhdp->pktlog->pcapng_lock) {
+		osl_spin_lock_deinit(dhdp->osh, dhdp->pktlog->pcapng_lock);
+	}
+#endif /* DHD_PKTLOG_SNAP */
 	VMFREE(dhdp->osh, dhdp->pktlog, sizeof(dhd_pktlog_t));
 
 	return BCME_OK;
@@ -322,6 +423,15 @@ dhd_pktlog_ring_init(dhd_pub_t *dhdp, int size)
 		goto fail;
 	}
 
+#ifdef DHD_PKTLOG_SNAP
+	/* header only captures are copied here, no allocation on the TX/RX path */
+	ring->snap_mem = (uint8 *)VMALLOCZ(dhdp->osh, DHD_PKTLOG_SNAP_MAX * size);
+	if (unlikely(!ring->snap_mem)) {
+		DHD_ERROR(("%s(): could not allocate %u bytes of snap slots, "
+			"logging full packets\n", __FUNCTION__, DHD_PKTLOG_SNAP_MAX * size));
+	}
+#endif /* DHD_PKTLOG_SNAP */
+
 	/* initialize free ring_info linked list */
 	for (i = 0; i < size; i++) {
 	    dll_append(&ring->ring_info_free, (dll_t *)&ring->ring_info_mem[i].p_info);
@@ -393,17 +503,18 @@ dhd_pktlog_ring_deinit(dhd_pub_t *dhdp, dhd_pktlog_ring_t *ring)
 
 		ring_info = (dhd_pktlog_ring_info_t *)item;
 
-		if (ring_info->info.pkt) {
-			PKTFREE(ring->dhdp->osh, ring_info->info.pkt, TRUE);
-			DHD_PKT_LOG(("%s(): pkt free pos %p\n",
-					__FUNCTION__, ring_info->info.pkt));
-		}
+		dhd_pktlog_item_release(ring, ring_info);
 	}
 
 	if (ring->ring_info_mem) {
 		VMFREE(ring->dhdp->osh, ring->ring_info_mem,
 			sizeof(dhd_pktlog_ring_info_t) * ring->pktlog_len);
 	}
+#ifdef DHD_PKTLOG_SNAP
+	if (ring->snap_mem) {
+		VMFREE(ring->dhdp->osh, ring->snap_mem, DHD_PKTLOG_SNAP_MAX * ring->pktlog_len);
+	}
+#endif /* DHD_PKTLOG_SNAP */
 
 	if (ring->pktlog_ring_lock) {
 		osl_spin_lock_deinit(ring->dhdp->osh, ring->pktlog_ring_lock);
@@ -439,6 +550,10 @@ dhd_pktlog_ring_reinit(dhd_pub_t *dhdp)
 		return -EINVAL;
 	}
 
+	if (DHD_PKTLOG_RING_HOLD(dhdp) != BCME_OK) {
+		return BCME_BUSY;
+	}
+
 	/* stop pkt log */
 	OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, FALSE);
 
@@ -454,6 +569,7 @@ dhd_pktlog_ring_reinit(dhd_pub_t *dhdp)
 			__FUNCTION__,
 			OSL_ATOMIC_READ(dhdp->osh, &dhdp->pktlog->pktlog_status)));
 		ASSERT(0);
+		DHD_PKTLOG_RING_UNHOLD(dhdp);
 		return -EINVAL;
 	}
 
@@ -466,11 +582,7 @@ dhd_pktlog_ring_reinit(dhd_pub_t *dhdp)
 		ring_info = (dhd_pktlog_ring_info_t *)item;
 
 		dll_delete((dll_t *)item);
-		if (ring_info->info.pkt) {
-			PKTFREE(pktlog_ring->dhdp->osh, ring_info->info.pkt, TRUE);
-			DHD_PKT_LOG(("%s(): pkt free pos %p\n",
-				__FUNCTION__, ring_info->info.pkt));
-		}
+		dhd_pktlog_item_release(pktlog_ring, ring_info);
 		dll_append(&pktlog_ring->ring_info_free, (dll_t *)item);
 	}
 
@@ -482,6 +594,7 @@ dhd_pktlog_ring_reinit(dhd_pub_t *dhdp)
 #ifdef DHD_PKT_LOGGING_DBGRING
 	OSL_ATOMIC_SET(dhdp->osh, &dhdp->pktlog->enable, TRUE);
 #endif /* DHD_PKT_LOGGING_DBGRING */
+	DHD_PKTLOG_RING_UNHOLD(dhdp);
 	DHD_PRINT(("%s: EXIT\n", __FUNCTION__));
 
 	return BCME_OK;
@@ -500,6 +613,9 @@ dhd_pktlog_ring_add_pkts(dhd_pub_t *dhdp, void *pkt, void *pktdata, uint32 pktid
 	dhd_pktlog_filter_t *pktlog_filter;
 	uint32 pktlog_case = 0;
 	unsigned long flags = 0;
+#ifdef DHD_PKTLOG_SNAP
+	uint32 snaplen;
+#endif /* DHD_PKTLOG_SNAP */
 #ifdef DHD_PKT_LOGGING_DBGRING
 	struct timespec64 ts;
 	dhd_dbg_ring_t *ring;
@@ -546,12 +662,19 @@ dhd_pktlog_ring_add_pkts(dhd_pub_t *dhdp, void *pkt, void *pktdata, uint32 pktid
 
 	/* get free ring_info and insert to ring_info_head */
 	DHD_PKT_LOG_LOCK(pktlog_ring->pktlog_ring_lock, flags);
+#ifdef DHD_PKTLOG_SNAP
+	/* a pcapng reader walks the list without the lock */
+	if (dhdp->pktlog->pcapng_rd) {
+		DHD_PKT_LOG_UNLOCK(pktlog_ring->pktlog_ring_lock, flags);
+		return BCME_OK;
+	}
+#endif /* DHD_PKTLOG_SNAP */
 	/* if free_list is empty, use the oldest ring_info */
 	if (dll_empty(&pktlog_ring->ring_info_free)) {
 		pkts = (dhd_pktlog_ring_info_t *)dll_head_p(&pktlog_ring->ring_info_head);
 		dll_delete((dll_t *)pkts);
 		/* free the oldest packet */
-		PKTFREE(pktlog_ring->dhdp->osh, pkts->info.pkt, TRUE);
+		dhd_pktlog_item_release(pktlog_ring, pkts);
 		pktlog_ring->pktcount--;
 	} else {
 		pkts = (dhd_pktlog_ring_info_t *)dll_tail_p(&pktlog_ring->ring_info_free);
@@ -572,14 +695,25 @@ dhd_pktlog_ring_add_pkts(dhd_pub_t *dhdp, void *pkt, void *pktdata, uint32 pktid
 	pkts->info.driver_ts_usec = (uint32)(rem_nsec/NSEC_PER_USEC);
 #endif /* DHD_PKT_LOGGING_DBGRING */
 
-	pkts->info.pkt = PKTDUP(dhdp->osh, pkt);
-	/*
-	 * skb clone can be NULL, but pktlog feature assume it alway  can be cloned
-	 * The dummy pkt info will be added in the list to fit pktcount & list items
-	 * and handled in the dhd_pktlog_dump_write() with ignoring info.pkt
-	 */
-	if (pkts->info.pkt == NULL) {
-		DHD_ERROR(("%s : skb clone returns NULL \n", __FUNCTION__));
+#ifdef DHD_PKTLOG_SNAP
+	snaplen = MIN(pktlog_snaplen, DHD_PKTLOG_SNAP_MAX);
+	if (snaplen && pktlog_ring->snap_mem) {
+		/* keep the headers only, in the entry's preallocated slot */
+		pkts->info.snap_len = MIN(snaplen, PKTLEN(dhdp->osh, pkt));
+		memcpy(DHD_PKTLOG_SNAP_SLOT(pktlog_ring, pkts), PKTDATA(dhdp->osh, pkt),
+			pkts->info.snap_len);
+	} else
+#endif /* DHD_PKTLOG_SNAP */
+	{
+		pkts->info.pkt = PKTDUP(dhdp->osh, pkt);
+		/*
+		 * skb clone can be NULL, but pktlog feature assume it alway  can be cloned
+		 * The dummy pkt info will be added in the list to fit pktcount & list items
+		 * and handled in the dhd_pktlog_dump_write() with ignoring info.pkt
+		 */
+		if (pkts->info.pkt == NULL) {
+			DHD_ERROR(("%s : skb clone returns NULL \n", __FUNCTION__));
+		}
 	}
 	pkts->info.pkt_len = PKTLEN(dhdp->osh, pkt);
 	pkts->info.firmware_ts = 0U;
@@ -669,9 +803,24 @@ dhd_pktlog_ring_tx_status(dhd_pub_t *dhdp, void *pkt, void *pktdata, uint32 pkti
 	    if (temp_hash == pkt_hash) {
 		tx_pkt->tx_fate = pkt_fate;
 #ifdef BDC
-		h = (struct bdc_header *)PKTDATA(dhdp->osh, tx_pkt->info.pkt);
-		PKTPULL(dhdp->osh, tx_pkt->info.pkt, BDC_HEADER_LEN);
-		PKTPULL(dhdp->osh, tx_pkt->info.pkt, (h->dataOffset << DHD_WORD_TO_LEN_SHIFT));
+		if (tx_pkt->info.pkt) {
+			h = (struct bdc_header *)PKTDATA(dhdp->osh, tx_pkt->info.pkt);
+			PKTPULL(dhdp->osh, tx_pkt->info.pkt, BDC_HEADER_LEN);
+			PKTPULL(dhdp->osh, tx_pkt->info.pkt,
+				(h->dataOffset << DHD_WORD_TO_LEN_SHIFT));
+		}
+#ifdef DHD_PKTLOG_SNAP
+		else if (tx_pkt->info.snap_len) {
+			uint8 *slot = DHD_PKTLOG_SNAP_SLOT(pktlog_ring, tx_pkt);
+			uint32 pull;
+
+			h = (struct bdc_header *)slot;
+			pull = BDC_HEADER_LEN + (h->dataOffset << DHD_WORD_TO_LEN_SHIFT);
+			pull = MIN(pull, tx_pkt->info.snap_len);
+			memmove(slot, slot + pull, tx_pkt->info.snap_len - pull);
+			tx_pkt->info.snap_len -= pull;
+		}
+#endif /* DHD_PKTLOG_SNAP */
 #endif /* BDC */
 		tx_pkt->info.tx_status_ts_sec = (uint32)ts_nsec;
 		tx_pkt->info.tx_status_ts_usec = (uint32)(rem_nsec/NSEC_PER_USEC);
@@ -1149,6 +1298,11 @@ dhd_pktlog_ring_change_size(dhd_pktlog_ring_t *ringbuf, int size)
 	pktlog_minmize = ringbuf->pktlog_minmize;
 	dhdp = ringbuf->dhdp;
 
+	if (DHD_PKTLOG_RING_HOLD(dhdp) != BCME_OK) {
+		/* keep the current ring */
+		return ringbuf;
+	}
+
 	/* free ring_info */
 	dhd_pktlog_ring_deinit(dhdp, ringbuf);
 
@@ -1160,6 +1314,7 @@ dhd_pktlog_ring_change_size(dhd_pktlog_ring_t *ringbuf, int size)
 		OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, TRUE);
 		pktlog_ring->pktlog_minmize = pktlog_minmize;
 	}
+	DHD_PKTLOG_RING_UNHOLD(dhdp);
 
 	return pktlog_ring;
 }
@@ -1250,6 +1405,7 @@ dhd_pktlog_get_item_length(dhd_pktlog_ring_info_t *report_ptr)
 	} else {
 		frame_len = (uint32)min(report_ptr->info.pkt_len, (size_t)MAX_FRAME_LEN_80211_MGMT);
 	}
+	frame_len = dhd_pktlog_item_caplen(report_ptr, frame_len);
 #ifdef DHD_PKT_LOGGING_DBGRING
 	frame_len = (uint32)min(frame_len, DHD_PKT_LOGGING_DBGRING_MAX_SIZE);
 	bytes_user_data = snprintf(buf, sizeof(buf), "%s:%s:%02d\n",
@@ -1296,6 +1452,10 @@ dhd_pktlog_get_dump_length(dhd_pub_t *dhdp)
 		return -EINVAL;
 	}
 
+	if (DHD_PKTLOG_RING_HOLD(dhdp) != BCME_OK) {
+		return BCME_BUSY;
+	}
+
 	pktlog_ring = dhdp->pktlog->pktlog_ring;
 	OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, FALSE);
 #ifndef DHD_PKT_LOGGING_DBGRING
@@ -1314,6 +1474,7 @@ dhd_pktlog_get_dump_length(dhd_pub_t *dhdp)
 #endif /* DHD_PKT_LOGGING_DBGRING */
 	}
 	OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, TRUE);
+	DHD_PKTLOG_RING_UNHOLD(dhdp);
 	DHD_PKT_LOG(("calcuated pkt log dump len:%d\n", len));
 
 	return len;
@@ -1378,6 +1539,10 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 		return -EINVAL;
 	}
 
+	if (DHD_PKTLOG_RING_HOLD(dhdp) != BCME_OK) {
+		return BCME_BUSY;
+	}
+
 	pktlog_ring = dhdp->pktlog->pktlog_ring;
 	OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, FALSE);
 #ifndef DHD_PKT_LOGGING_DBGRING
@@ -1398,9 +1563,8 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 	for (item_p = dll_head_p(&pktlog_ring->ring_info_head);
 			!dll_end(&pktlog_ring->ring_info_head, item_p);
 			item_p = next_p) {
-#ifdef DHD_PKT_LOGGING_DBGRING
 		uint32 captured_frame_len;
-#endif /* DHD_PKT_LOGGING_DBGRING */
+		uint8 *frame;
 
 		next_p = dll_next_p(item_p);
 		report_ptr = (dhd_pktlog_ring_info_t *)item_p;
@@ -1422,7 +1586,8 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 			break;
 		}
 
-		if (report_ptr->info.pkt == NULL) {
+		frame = dhd_pktlog_item_data(pktlog_ring, report_ptr);
+		if (frame == NULL) {
 			DHD_ERROR(("%s : pkt isn't located skip it\n", __FUNCTION__));
 			continue;
 		}
@@ -1450,6 +1615,7 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 				(report_ptr->tx_fate ? "Failure" : "Succeed"),
 				(report_ptr->tx_fate & !(TX_PKT_FATE_DRV_WAIT_UPDATE)));
 		write_frame_len = frame_len + bytes_user_data;
+		frame_len = dhd_pktlog_item_caplen(report_ptr, frame_len);
 		frame_len = (uint32)min(frame_len, DHD_PKT_LOGGING_DBGRING_MAX_SIZE);
 		captured_frame_len = frame_len + bytes_user_data;
 
@@ -1462,15 +1628,14 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 			(char*)&write_frame_len, sizeof(write_frame_len));
 		len += sizeof(write_frame_len);
 
-		ret = memcpy_s((void*)(user_buf + len), size - len, PKTDATA(pktlog_ring->dhdp->osh,
-			report_ptr->info.pkt), frame_len);
+		ret = memcpy_s((void*)(user_buf + len), size - len, frame, frame_len);
 		len += frame_len;
 
 		ret = memcpy_s((void*)(user_buf + len), size - len, buf, bytes_user_data);
 		len += bytes_user_data;
 
 		dll_delete((dll_t *)report_ptr);
-		PKTFREE(pktlog_ring->dhdp->osh, report_ptr->info.pkt, TRUE);
+		dhd_pktlog_item_release(pktlog_ring, report_ptr);
 		pktlog_ring->pktcount--;
 		dll_append(&pktlog_ring->ring_info_free, (dll_t *)report_ptr);
 #else
@@ -1499,22 +1664,22 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 				report_ptr->info.tx_status_ts_sec,
 				report_ptr->info.tx_status_ts_usec);
 		write_frame_len = frame_len + bytes_user_data;
+		frame_len = dhd_pktlog_item_caplen(report_ptr, frame_len);
+		captured_frame_len = frame_len + bytes_user_data;
 
 		/* pcap pkt head has incl_len and orig_len */
-		ret = dhd_export_debug_data((char*)&write_frame_len, file, user_buf,
-				sizeof(write_frame_len), &pos);
-		len += sizeof(write_frame_len);
+		ret = dhd_export_debug_data((char*)&captured_frame_len, file, user_buf,
+				sizeof(captured_frame_len), &pos);
+		len += sizeof(captured_frame_len);
 
 		ret = dhd_export_debug_data((char*)&write_frame_len, file, user_buf,
 				sizeof(write_frame_len), &pos);
 		len += sizeof(write_frame_len);
 
 		if (pktlog_ring->pktlog_minmize) {
-			dhd_pktlog_minimize_report(PKTDATA(pktlog_ring->dhdp->osh,
-					report_ptr->info.pkt), frame_len, file, user_buf, &pos);
+			dhd_pktlog_minimize_report((char *)frame, frame_len, file, user_buf, &pos);
 		} else {
-			ret = dhd_export_debug_data(PKTDATA(pktlog_ring->dhdp->osh,
-					report_ptr->info.pkt), file, user_buf, frame_len, &pos);
+			ret = dhd_export_debug_data(frame, file, user_buf, frame_len, &pos);
 		}
 		len += frame_len;
 
@@ -1527,6 +1692,7 @@ dhd_pktlog_dump_write(dhd_pub_t *dhdp, void *file, const void *user_buf, uint32
 	*written_bytes = len;
 #endif /* DHD_PKT_LOGGING_DBGRING */
 	OSL_ATOMIC_SET(dhdp->osh, &pktlog_ring->start, TRUE);
+	DHD_PKTLOG_RING_UNHOLD(dhdp);
 
 	return ret;
 }
@@ -1595,6 +1761,280 @@ fail:
 	return ret;
 }
 
+#ifdef DHD_PKTLOG_SNAP
+/* A pcapng block is emitted as head, frame bytes and tail. The head holds the
+ * SHB and IDB, or the EPB fields ahead of the frame. The tail holds the frame
+ * padding, the EPB options and the trailing block length.
+ */
+#define DHD_PKTLOG_PCAPNG_SEGS		3u
+#define DHD_PKTLOG_PCAPNG_HEAD_MAX	64u
+#define DHD_PKTLOG_PCAPNG_TAIL_MAX	(DHD_PKTLOG_FATE_INFO_STR_LEN + 32u)
+#define DHD_PKTLOG_PCAPNG_SHB_LEN	28u
+#define DHD_PKTLOG_PCAPNG_IDB_LEN	20u
+#define DHD_PKTLOG_PCAPNG_EPB_HDR_LEN	28u
+
+typedef struct dhd_pktlog_pcapng_rd {
+	dhd_pub_t *dhdp;
+	dhd_pktlog_ring_t *ring;
+	dll_t *item;		/* next ring entry to emit */
+	bool hdr_done;		/* SHB and IDB emitted */
+	int prev_start;		/* ring->start to restore on close */
+	uint8 *seg[DHD_PKTLOG_PCAPNG_SEGS];
+	uint32 seg_len[DHD_PKTLOG_PCAPNG_SEGS];
+	uint32 seg_idx;
+	uint32 seg_off;
+	uint8 head[DHD_PKTLOG_PCAPNG_HEAD_MAX];
+	uint8 tail[DHD_PKTLOG_PCAPNG_TAIL_MAX];
+} dhd_pktlog_pcapng_rd_t;
+
+static uint8 *
+dhd_pktlog_pcapng_put16(uint8 *p, uint16 val)
+{
+	memcpy(p, &val, sizeof(val));
+	return p + sizeof(val);
+}
+
+static uint8 *
+dhd_pktlog_pcapng_put32(uint8 *p, uint32 val)
+{
+	memcpy(p, &val, sizeof(val));
+	return p + sizeof(val);
+}
+
+static void
+dhd_pktlog_pcapng_hdr(dhd_pktlog_pcapng_rd_t *rd)
+{
+	uint8 *p = rd->head;
+
+	/* SHB, version 1.0 with an unspecified section length */
+	p = dhd_pktlog_pcapng_put32(p, PKTLOG_PCAPNG_SHB_TYPE);
+	p = dhd_pktlog_pcapng_put32(p, DHD_PKTLOG_PCAPNG_SHB_LEN);
+	p = dhd_pktlog_pcapng_put32(p, PKTLOG_PCAPNG_BYTE_ORDER);
+	p = dhd_pktlog_pcapng_put16(p, 1u);
+	p = dhd_pktlog_pcapng_put16(p, 0u);
+	p = dhd_pktlog_pcapng_put32(p, 0xFFFFFFFFu);
+	p = dhd_pktlog_pcapng_put32(p, 0xFFFFFFFFu);
+	p = dhd_pktlog_pcapng_put32(p, DHD_PKTLOG_PCAPNG_SHB_LEN);
+
+	/* IDB, snap length is left unlimited as entries may be full copies */
+	p = dhd_pktlog_pcapng_put32(p, PKTLOG_PCAPNG_IDB_TYPE);
+	p = dhd_pktlog_pcapng_put32(p, DHD_PKTLOG_PCAPNG_IDB_LEN);
+	p = dhd_pktlog_pcapng_put16(p, PKTLOG_PCAPNG_LINKTYPE_ETHERNET);
+	p = dhd_pktlog_pcapng_put16(p, 0u);
+	p = dhd_pktlog_pcapng_put32(p, 0u);
+	p = dhd_pktlog_pcapng_put32(p, DHD_PKTLOG_PCAPNG_IDB_LEN);
+
+	rd->seg[0] = rd->head;
+	rd->seg_len[0] = (uint32)(p - rd->head);
+	rd->seg_len[1] = 0;
+	rd->seg_len[2] = 0;
+}
+
+static void
+dhd_pktlog_pcapng_epb(dhd_pktlog_pcapng_rd_t *rd, dhd_pktlog_ring_info_t *ri, uint8 *frame)
+{
+	char buf[DHD_PKTLOG_FATE_INFO_STR_LEN];
+	uint32 frame_len, cap_len, pad, clen, cpad, blk_len;
+	uint64 ts;
+	uint8 *p;
+
+	if (ri->info.payload_type == FRAME_TYPE_ETHERNET_II) {
+		frame_len = (uint32)min(ri->info.pkt_len, (size_t)MAX_FRAME_LEN_ETHERNET);
+	} else {
+		frame_len = (uint32)min(ri->info.pkt_len, (size_t)MAX_FRAME_LEN_80211_MGMT);
+	}
+	cap_len = dhd_pktlog_item_caplen(ri, frame_len);
+	pad = ROUNDUP(cap_len, 4u) - cap_len;
+
+	clen = (uint32)snprintf(buf, sizeof(buf), "%s:%s:%02d:%s:%d.%d s",
+		DHD_PKTLOG_FATE_INFO_FORMAT,
+		(ri->tx_fate ? "Failure" : "Succeed"),
+		ri->tx_fate,
+		(ri->info.direction == PKT_TX) ? "TX" : "RX",
+		ri->info.tx_status_ts_sec,
+		ri->info.tx_status_ts_usec);
+	clen = MIN(clen, (uint32)sizeof(buf) - 1u);
+	cpad = ROUNDUP(clen, 4u) - clen;
+
+	/* fields, frame, comment option, flags option, end of options, length */
+	blk_len = DHD_PKTLOG_PCAPNG_EPB_HDR_LEN + cap_len + pad +
+		4u + clen + cpad + 8u + 4u + 4u;
+	ts = (uint64)ri->info.driver_ts_sec * USEC_PER_SEC + ri->info.driver_ts_usec;
+
+	p = rd->head;
+	p = dhd_pktlog_pcapng_put32(p, PKTLOG_PCAPNG_EPB_TYPE);
+	p = dhd_pktlog_pcapng_put32(p, blk_len);
+	p = dhd_pktlog_pcapng_put32(p, 0u);
+	p = dhd_pktlog_pcapng_put32(p, (uint32)(ts >> 32));
+	p = dhd_pktlog_pcapng_put32(p, (uint32)ts);
+	p = dhd_pktlog_pcapng_put32(p, cap_len);
+	p = dhd_pktlog_pcapng_put32(p, (uint32)ri->info.pkt_len);
+	rd->seg[0] = rd->head;
+	rd->seg_len[0] = (uint32)(p - rd->head);
+
+	/* frame bytes are copied out of the ring as they are */
+	rd->seg[1] = frame;
+	rd->seg_len[1] = cap_len;
+
+	p = rd->tail;
+	bzero(p, pad);
+	p += pad;
+	p = dhd_pktlog_pcapng_put16(p, PKTLOG_PCAPNG_OPT_COMMENT);
+	p = dhd_pktlog_pcapng_put16(p, (uint16)clen);
+	memcpy(p, buf, clen);
+	p += clen;
+	bzero(p, cpad);
+	p += cpad;
+	p = dhd_pktlog_pcapng_put16(p, PKTLOG_PCAPNG_OPT_EPB_FLAGS);
+	p = dhd_pktlog_pcapng_put16(p, 4u);
+	p = dhd_pktlog_pcapng_put32(p, (ri->info.direction == PKT_TX) ?
+		PKTLOG_PCAPNG_EPB_FLAG_OUT : PKTLOG_PCAPNG_EPB_FLAG_IN);
+	p = dhd_pktlog_pcapng_put32(p, 0u);
+	p = dhd_pktlog_pcapng_put32(p, blk_len);
+	rd->seg[2] = rd->tail;
+	rd->seg_len[2] = (uint32)(p - rd->tail);
+}
+
+/* Lays out the next block, FALSE once the ring is exhausted */
+static bool
+dhd_pktlog_pcapng_next(dhd_pktlog_pcapng_rd_t *rd)
+{
+	dhd_pktlog_ring_info_t *ri;
+	uint8 *frame;
+
+	rd->seg_idx = 0;
+	rd->seg_off = 0;
+
+	if (!rd->hdr_done) {
+		dhd_pktlog_pcapng_hdr(rd);
+		rd->hdr_done = TRUE;
+		return TRUE;
+	}
+
+	while (!dll_end(&rd->ring->ring_info_head, rd->item)) {
+		ri = (dhd_pktlog_ring_info_t *)rd->item;
+		rd->item = dll_next_p(rd->item);
+		frame = dhd_pktlog_item_data(rd->ring, ri);
+		if (frame) {
+			dhd_pktlog_pcapng_epb(rd, ri, frame);
+			return TRUE;
+		}
+	}
+
+	rd->seg_idx = DHD_PKTLOG_PCAPNG_SEGS;
+	return FALSE;
+}
+
+/* Pauses logging and returns a reader over the ring, one reader at a time */
+void *
+dhd_pktlog_pcapng_open(dhd_pub_t *dhdp)
+{
+	dhd_pktlog_pcapng_rd_t *rd;
+	dhd_pktlog_ring_t *ring;
+	unsigned long flags = 0;
+	bool busy;
+
+	if (!dhdp || !dhdp->pktlog || !dhdp->pktlog->pktlog_ring) {
+		DHD_ERROR(("%s(): pktlog is not initialized\n", __FUNCTION__));
+		return NULL;
+	}
+
+	rd = (dhd_pktlog_pcapng_rd_t *)MALLOCZ(dhdp->osh, sizeof(*rd));
+	if (!rd) {
+		DHD_ERROR(("%s(): failed to allocate reader\n", __FUNCTION__));
+		return NULL;
+	}
+
+	/* A dump or reinit in progress, or another reader, keeps us out */
+	DHD_PKT_LOG_LOCK(dhdp->pktlog->pcapng_lock, flags);
+	busy = (dhdp->pktlog->pcapng_rd || dhdp->pktlog->ring_users);
+	if (!busy) {
+		dhdp->pktlog->pcapng_rd = rd;
+	}
+	DHD_PKT_LOG_UNLOCK(dhdp->pktlog->pcapng_lock, flags);
+
+	if (busy) {
+		DHD_ERROR(("%s(): pktlog ring is busy\n", __FUNCTION__));
+		MFREE(dhdp->osh, rd, sizeof(*rd));
+		return NULL;
+	}
+
+	/* Stop logging while the ring is walked, as the file dump does.
+	 * Taking the ring lock once lets an add already past the start
+	 * check finish, later ones see pcapng_rd and drop the packet.
+	 */
+	ring = dhdp->pktlog->pktlog_ring;
+	rd->prev_start = OSL_ATOMIC_READ(dhdp->osh, &ring->start);
+	OSL_ATOMIC_SET(dhdp->osh, &ring->start, FALSE);
+	DHD_PKT_LOG_LOCK(ring->pktlog_ring_lock, flags);
+	DHD_PKT_LOG_UNLOCK(ring->pktlog_ring_lock, flags);
+
+	rd->dhdp = dhdp;
+	rd->ring = ring;
+	rd->item = dll_head_p(&ring->ring_info_head);
+	rd->seg_idx = DHD_PKTLOG_PCAPNG_SEGS;
+
+	return rd;
+}
+
+/* Copies up to 'len' bytes of pcapng to 'user_buf', returns the bytes copied */
+int
+dhd_pktlog_pcapng_read(void *handle, const void *user_buf, uint32 len)
+{
+	dhd_pktlog_pcapng_rd_t *rd = (dhd_pktlog_pcapng_rd_t *)handle;
+	int pos = 0;
+	uint32 n;
+
+	if (!rd || !user_buf) {
+		return BCME_BADARG;
+	}
+
+	while ((uint32)pos < len) {
+		if (rd->seg_idx >= DHD_PKTLOG_PCAPNG_SEGS && !dhd_pktlog_pcapng_next(rd)) {
+			break;
+		}
+
+		n = MIN(rd->seg_len[rd->seg_idx] - rd->seg_off, len - (uint32)pos);
+		if (n) {
+			if (dhd_export_debug_data(rd->seg[rd->seg_idx] + rd->seg_off,
+					NULL, user_buf, n, &pos)) {
+				return BCME_ERROR;
+			}
+			rd->seg_off += n;
+		}
+
+		if (rd->seg_off == rd->seg_len[rd->seg_idx]) {
+			rd->seg_idx++;
+			rd->seg_off = 0;
+		}
+	}
+
+	return pos;
+}
+
+void
+dhd_pktlog_pcapng_close(void *handle)
+{
+	dhd_pktlog_pcapng_rd_t *rd = (dhd_pktlog_pcapng_rd_t *)handle;
+	dhd_pub_t *dhdp;
+	unsigned long flags = 0;
+
+	if (!rd) {
+		return;
+	}
+	dhdp = rd->dhdp;
+
+	/* leave logging as it was before the reader opened */
+	OSL_ATOMIC_SET(dhdp->osh, &rd->ring->start, rd->prev_start);
+
+	DHD_PKT_LOG_LOCK(dhdp->pktlog->pcapng_lock, flags);
+	dhdp->pktlog->pcapng_rd = NULL;
+	DHD_PKT_LOG_UNLOCK(dhdp->pktlog->pcapng_lock, flags);
+
+	MFREE(dhdp->osh, rd, sizeof(*rd));
+}
+#endif /* DHD_PKTLOG_SNAP */
+
 #ifdef DHD_COMPACT_PKT_LOG
 static uint64
 dhd_cpkt_log_calc_time_diff(dhd_pktlog_ring_info_t *pkt_info, uint64 curr_ts_nsec)
@@ -1741,6 +2181,10 @@ dhd_cpkt_log_get_pkt_info(dhd_pktlog_t *pktlog, dhd_pktlog_ring_info_t *pkt_info
 	struct ipv6_hdr *ipv6;
 	struct icmp6_hdr *icmpv6_hdr;
 
+	/* header only entries have no packet to parse */
+	if (pkt_info->info.pkt == NULL) {
+		return BCME_ERROR;
+	}
 	pkt_data = (uint8 *)PKTDATA(pktlog->dhdp->osh, pkt_info->info.pkt);
 
 	eth_hdr = (struct ether_header *)pkt_data;
@@ -48,6 +48,12 @@
 #define MAX_FILTER_PATTERN_LEN \
 	((MAX_MASK_PATTERN_FILTER_LEN * HD_BYTE_SIZE) + HD_PREFIX_SIZE + 1) * 2
 #define PKTLOG_DUMP_BUF_SIZE		(64 * 1024)
+#ifdef DHD_PKTLOG_SNAP
+/* bytes reserved per ring entry for a header only capture */
+#define DHD_PKTLOG_SNAP_MAX		256u
+/* Ethernet, IPv6 and a TCP header with options */
+#define DHD_PKTLOG_SNAP_DEFAULT		128u
+#endif /* DHD_PKTLOG_SNAP */
 
 typedef struct dhd_dbg_pktlog_info {
 	frame_type payload_type;
@@ -60,6 +66,9 @@ typedef struct dhd_dbg_pktlog_info {
 	uint32 tx_status_ts_usec;
 	bool direction;
 	void *pkt;
+#ifdef DHD_PKTLOG_SNAP
+	uint32 snap_len;		/* bytes in the ring's snap slot, pkt is NULL then */
+#endif /* DHD_PKTLOG_SNAP */
 } dhd_dbg_pktlog_info_t;
 
 typedef struct dhd_pktlog_ring_info
@@ -84,6 +93,9 @@ typedef struct dhd_pktlog_ring
 	spinlock_t *pktlog_ring_lock;
 	dhd_pub_t *dhdp;
 	dhd_pktlog_ring_info_t *ring_info_mem; /* ring_info mem pointer */
+#ifdef DHD_PKTLOG_SNAP
+	uint8 *snap_mem;		/* pktlog_len slots of DHD_PKTLOG_SNAP_MAX bytes */
+#endif /* DHD_PKTLOG_SNAP */
 #ifdef DHD_PKT_LOGGING_DBGRING
 	void *dbg_ring;
 #endif /* DHD_PKT_LOGGING_DBGRING */
@@ -118,6 +130,11 @@ typedef struct dhd_pktlog
 #ifdef DHD_PKT_LOGGING_DBGRING
 	osl_atomic_t enable; /* logging suspend/resume */
 #endif /* DHD_PKT_LOGGING_DBGRING */
+#ifdef DHD_PKTLOG_SNAP
+	spinlock_t *pcapng_lock;	/* guards pcapng_rd and ring_users */
+	uint32 ring_users;	/* dump and reinit paths walking the ring */
+	void *pcapng_rd;	/* the open pcapng reader, one at a time */
+#endif /* DHD_PKTLOG_SNAP */
 } dhd_pktlog_t;
 
 typedef struct dhd_pktlog_pcap_hdr
@@ -137,6 +154,18 @@ typedef struct dhd_pktlog_pcap_hdr
 #define PKTLOG_PCAP_SNAP_LEN 0x40000
 #define PKTLOG_PCAP_NETWORK_TYPE 147
 
+#ifdef DHD_PKTLOG_SNAP
+#define PKTLOG_PCAPNG_SHB_TYPE		0x0A0D0D0Au
+#define PKTLOG_PCAPNG_IDB_TYPE		0x00000001u
+#define PKTLOG_PCAPNG_EPB_TYPE		0x00000006u
+#define PKTLOG_PCAPNG_BYTE_ORDER	0x1A2B3C4Du
+#define PKTLOG_PCAPNG_LINKTYPE_ETHERNET	1u
+#define PKTLOG_PCAPNG_OPT_COMMENT	1u
+#define PKTLOG_PCAPNG_OPT_EPB_FLAGS	2u
+#define PKTLOG_PCAPNG_EPB_FLAG_IN	0x1u
+#define PKTLOG_PCAPNG_EPB_FLAG_OUT	0x2u
+#endif /* DHD_PKTLOG_SNAP */
+
 extern int dhd_os_attach_pktlog(dhd_pub_t *dhdp);
 extern int dhd_os_detach_pktlog(dhd_pub_t *dhdp);
 #ifdef DHD_PKT_LOGGING_DBGRING
@@ -302,6 +331,11 @@ extern void dhd_pktlog_dump(void *handle, void *event_info, u8 event);
 extern void dhd_schedule_pktlog_dump(dhd_pub_t *dhdp);
 extern int dhd_pktlog_dump_write_memory(dhd_pub_t *dhdp, const void *user_buf, uint32 size);
 extern int dhd_pktlog_dump_write_file(dhd_pub_t *dhdp);
+#ifdef DHD_PKTLOG_SNAP
+extern void *dhd_pktlog_pcapng_open(dhd_pub_t *dhdp);
+extern int dhd_pktlog_pcapng_read(void *handle, const void *user_buf, uint32 len);
+extern void dhd_pktlog_pcapng_close(void *handle);
+#endif /* DHD_PKTLOG_SNAP */
 
 #define DHD_PKTLOG_FATE_INFO_STR_LEN 256
 #define DHD_PKTLOG_FATE_INFO_FORMAT	"BRCM_Packet_Fate"
@@ -151,6 +151,7 @@ uint32 dhd_prot_get_tx_post_bound(dhd_pub_t *dhd);
 uint32 dhd_prot_get_ctrl_cpl_post_bound(dhd_pub_t *dhd);
 uint32 dhd_prot_get_tx_cpl_bound(dhd_pub_t *dhd);
 uint32 dhd_prot_get_rx_cpl_post_bound(dhd_pub_t *dhd);
+uint32 dhd_prot_get_tot_rxcpl(dhd_pub_t *dhd);
 void dhd_prot_set_tx_cpl_bound(dhd_pub_t *dhd, uint32 val);
 void dhd_prot_set_rx_cpl_post_bound(dhd_pub_t *dhd, uint32 val);
 void dhd_prot_set_tx_post_bound(dhd_pub_t *dhd, uint32 val);
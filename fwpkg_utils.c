@@ -40,12 +40,24 @@
 #include <errno.h>
 #endif /* BCMDRIVER */
 #include <fwpkg_utils.h>
+#ifdef DHD_FWPKG_COMP
+#ifdef BCMDRIVER
+#include <linux/lz4.h>
+#else
+#include <lz4.h>
+#endif /* BCMDRIVER */
+#endif /* DHD_FWPKG_COMP */
 
 #define FWPKG_UNIT_IDX(tag)	(tag-1)
 
 const uint32 FWPKG_HDR_MGCW0 = 0xDEAD2BAD;
 const uint32 FWPKG_HDR_MGCW1 = 0xFEE1DEAD;
+#ifdef DHD_FWPKG_COMP
+/* version 2 packages may carry compressed units */
+const uint32 FWPKG_MAX_SUPPORTED_VER = 2;
+#else
 const uint32 FWPKG_MAX_SUPPORTED_VER = 1;
+#endif /* DHD_FWPKG_COMP */
 
 #ifdef BCMDRIVER
 #define FWPKG_ERR(msg)	DHD_ERROR(msg)
@@ -59,6 +71,10 @@ const uint32 FWPKG_MAX_SUPPORTED_VER = 1;
 	dhd_os_get_image_block(buf, len, file)
 #define fwpkg_getsize(file)	\
 	dhd_os_get_image_size(file)
+#define fwpkg_alloc(size)	\
+	VMALLOC(NULL, size)
+#define fwpkg_free(ptr, size)	\
+	VMFREE(NULL, ptr, size)
 
 #else
 #if defined(_WIN32)
@@ -76,6 +92,10 @@ const uint32 FWPKG_MAX_SUPPORTED_VER = 1;
 	app_fread(buf, len, file)
 #define fwpkg_getsize(file)	\
 	app_getsize(file)
+#define fwpkg_alloc(size)	\
+	malloc(size)
+#define fwpkg_free(ptr, size)	\
+	free(ptr)
 
 #endif /* BCMDRIVER */
 
@@ -87,6 +107,13 @@ static int fwpkg_parse(fwpkg_info_t *fwpkg, char *fname);
 static int fwpkg_open_unit(fwpkg_info_t *fwpkg, char *fname,
 	uint32 unit_type, FWPKG_FILE **fp);
 static uint32 fwpkg_get_unit_size(fwpkg_info_t *fwpkg, uint32 unit_type);
+static bool fwpkg_parse_rtlvs_mem(fwpkg_info_t *fwpkg, const char *data, uint32 len);
+static int fwpkg_stream_get(fwpkg_stream_t *st, char *buf, uint32 len);
+#ifdef DHD_FWPKG_COMP
+static bool fwpkg_check_comp_hdr(fwpkg_unit_t *fw_unit, const fwpkg_comp_hdr_t *chdr);
+static bool fwpkg_parse_comp_hdr(fwpkg_unit_t *fw_unit, FWPKG_FILE *file);
+static int fwpkg_stream_inflate(fwpkg_stream_t *st, char *dst, uint32 len);
+#endif /* DHD_FWPKG_COMP */
 
 /* open file, if combined fw package parse common header,
  * parse each unit header, keep information
@@ -107,6 +134,48 @@ fwpkg_init(fwpkg_info_t *fwpkg, char *fname)
 	return fwpkg_parse(fwpkg, fname);
 }
 
+/*
+ * same as fwpkg_init() for a package that is already in memory, e.g. handed over
+ * by request_firmware(). 'data' has to stay around while the units are read.
+ */
+int
+fwpkg_init_mem(fwpkg_info_t *fwpkg, const char *data, uint32 len)
+{
+	fwpkg_hdr_t hdr;
+	int ret;
+
+	if (fwpkg == NULL || data == NULL) {
+		FWPKG_ERR(("fwpkg_init_mem: missing argument\n"));
+		return BCME_ERROR;
+	}
+	bzero(fwpkg, sizeof(*fwpkg));
+	fwpkg->file_size = len;
+
+	if (len < sizeof(hdr)) {
+		fwpkg->status = FWPKG_SINGLE_FLG;
+		return BCME_UNSUPPORTED;
+	}
+	memcpy(&hdr, data + len - sizeof(hdr), sizeof(hdr));
+
+	ret = fwpkg_hdr_validation(&hdr, len);
+	if (ret == BCME_ERROR) {
+		FWPKG_ERR(("fwpkg_init_mem: can't parse pkg header\n"));
+		return ret;
+	}
+	if (ret == BCME_UNSUPPORTED) {
+		fwpkg->status = FWPKG_SINGLE_FLG;
+		return ret;
+	}
+
+	fwpkg->status = FWPKG_COMBND_FLG;
+	if (fwpkg_parse_rtlvs_mem(fwpkg, data, len) == FALSE) {
+		FWPKG_ERR(("fwpkg_init_mem: can't parse rtlvs\n"));
+		return BCME_ERROR;
+	}
+
+	return BCME_OK;
+}
+
 int
 fwpkg_open_firmware_img(fwpkg_info_t *fwpkg, char *fname, FWPKG_FILE **fp)
 {
@@ -218,8 +287,9 @@ fwpkg_parse_rtlvs(fwpkg_info_t *fwpkg, uint32 file_size, char *fname)
 	bool ret = FALSE;
 	const uint32 l_len = sizeof(uint32);		/* len of rTLV's field length */
 	const uint32 t_len = sizeof(uint32);		/* len of rTLV's field type */
-	uint32 unit_size = 0, unit_type = 0;
+	uint32 unit_size = 0, unit_type = 0, unit_comp;
 	FWPKG_FILE *file = NULL;
+	fwpkg_unit_t *fw_unit;
 	uint32 left_size = file_size - sizeof(fwpkg_hdr_t);
 
 	while (left_size) {
@@ -243,18 +313,38 @@ fwpkg_parse_rtlvs(fwpkg_info_t *fwpkg, uint32 file_size, char *fname)
 			FWPKG_ERR(("fwpkg_parse_rtlvs: can't read rtlv data type\n"));
 			goto done;
 		}
+		unit_comp = FWPKG_TYPE_COMP(unit_type);
+		unit_type = FWPKG_TYPE_TAG(unit_type);
 		if ((unit_type == 0) || (unit_type >= FWPKG_TAG_LAST)) {
 			FWPKG_ERR(("fwpkg_parse_rtlvs: unsupported data type(%d)\n",
 				unit_type));
 			goto done;
 		}
-		fwpkg->units[UNIT_TYPE_IDX(unit_type)].type = unit_type;
-		fwpkg->units[UNIT_TYPE_IDX(unit_type)].size = unit_size;
+		if (unit_size > left_size) {
+			FWPKG_ERR(("fwpkg_parse_rtlvs: bad data len(%d)\n", unit_size));
+			goto done;
+		}
+		fw_unit = &fwpkg->units[UNIT_TYPE_IDX(unit_type)];
+		fw_unit->type = unit_type;
+		fw_unit->size = unit_size;
 		left_size -= unit_size;
-		fwpkg->units[UNIT_TYPE_IDX(unit_type)].offset = left_size;
-
-		FWPKG_ERR(("fwpkg_parse_rtlvs: type x%04x, len %d, off %d\n",
-			unit_type, unit_size, left_size));
+		fw_unit->offset = left_size;
+		fw_unit->comp = unit_comp;
+		fw_unit->orig_size = unit_size;
+
+		FWPKG_ERR(("fwpkg_parse_rtlvs: type x%04x, comp %d, len %d, off %d\n",
+			unit_type, unit_comp, unit_size, left_size));
+
+		if (unit_comp != FWPKG_COMP_NONE) {
+#ifdef DHD_FWPKG_COMP
+			if (fwpkg_parse_comp_hdr(fw_unit, file) == FALSE) {
+				goto done;
+			}
+#else
+			FWPKG_ERR(("fwpkg_parse_rtlvs: compressed units not supported\n"));
+			goto done;
+#endif /* DHD_FWPKG_COMP */
+		}
 
 		fwpkg_close(file);
 		file = NULL;
@@ -268,6 +358,67 @@ done:
 	return ret;
 }
 
+/* parse rtlvs of a combined fw package in memory */
+static bool
+fwpkg_parse_rtlvs_mem(fwpkg_info_t *fwpkg, const char *data, uint32 len)
+{
+	const uint32 l_len = sizeof(uint32);		/* len of rTLV's field length */
+	const uint32 t_len = sizeof(uint32);		/* len of rTLV's field type */
+	uint32 unit_size = 0, unit_type = 0, unit_comp;
+	fwpkg_unit_t *fw_unit;
+	uint32 left_size = len - sizeof(fwpkg_hdr_t);
+
+	while (left_size) {
+		if (left_size < (t_len + l_len)) {
+			FWPKG_ERR(("fwpkg_parse_rtlvs_mem: truncated rtlv\n"));
+			return FALSE;
+		}
+		/* remove length of rTLV's fields type, length */
+		left_size -= (t_len + l_len);
+		memcpy(&unit_size, data + left_size, l_len);
+		memcpy(&unit_type, data + left_size + l_len, t_len);
+		unit_comp = FWPKG_TYPE_COMP(unit_type);
+		unit_type = FWPKG_TYPE_TAG(unit_type);
+		if ((unit_type == 0) || (unit_type >= FWPKG_TAG_LAST)) {
+			FWPKG_ERR(("fwpkg_parse_rtlvs_mem: unsupported data type(%d)\n",
+				unit_type));
+			return FALSE;
+		}
+		if (unit_size > left_size) {
+			FWPKG_ERR(("fwpkg_parse_rtlvs_mem: bad data len(%d)\n", unit_size));
+			return FALSE;
+		}
+		fw_unit = &fwpkg->units[UNIT_TYPE_IDX(unit_type)];
+		fw_unit->type = unit_type;
+		fw_unit->size = unit_size;
+		left_size -= unit_size;
+		fw_unit->offset = left_size;
+		fw_unit->comp = unit_comp;
+		fw_unit->orig_size = unit_size;
+
+		if (unit_comp != FWPKG_COMP_NONE) {
+#ifdef DHD_FWPKG_COMP
+			fwpkg_comp_hdr_t chdr;
+
+			if (unit_size < sizeof(chdr)) {
+				FWPKG_ERR(("fwpkg_parse_rtlvs_mem: unit too short(%d)\n",
+					unit_size));
+				return FALSE;
+			}
+			memcpy(&chdr, data + fw_unit->offset, sizeof(chdr));
+			if (fwpkg_check_comp_hdr(fw_unit, &chdr) == FALSE) {
+				return FALSE;
+			}
+#else
+			FWPKG_ERR(("fwpkg_parse_rtlvs_mem: compressed units not supported\n"));
+			return FALSE;
+#endif /* DHD_FWPKG_COMP */
+		}
+	}
+
+	return TRUE;
+}
+
 /* parse file if is combined fw package */
 static int
 fwpkg_parse(fwpkg_info_t *fwpkg, char *fname)
@@ -358,8 +509,9 @@ fwpkg_open_unit(fwpkg_info_t *fwpkg, char *fname, uint32 unit_type, FWPKG_FILE *
 
 	fw_unit = &fwpkg->units[FWPKG_UNIT_IDX(unit_type)];
 
-	/* seek to the last sizeof(fwpkg_hdr_t) bytes in the file */
-	if (fwpkg_seek(*fp, fw_unit->offset) != BCME_OK) {
+	/* seek to the unit data, past the compression header if there is one */
+	if (fwpkg_seek(*fp, fw_unit->offset +
+		((fw_unit->comp != FWPKG_COMP_NONE) ? sizeof(fwpkg_comp_hdr_t) : 0)) != BCME_OK) {
 		FWPKG_ERR(("fwpkg_open_unit: can't get to the pkg header offset\n"));
 		ret = BCME_ERROR;
 		goto done;
@@ -381,8 +533,268 @@ fwpkg_get_unit_size(fwpkg_info_t *fwpkg, uint32 unit_type)
 	}
 
 	fw_unit = &fwpkg->units[FWPKG_UNIT_IDX(unit_type)];
-	size = fw_unit->size;
+	size = fw_unit->orig_size;
 
 done:
 	return size;
 }
+
+#ifdef DHD_FWPKG_COMP
+/* validate the compression header of a unit and keep its sizes */
+static bool
+fwpkg_check_comp_hdr(fwpkg_unit_t *fw_unit, const fwpkg_comp_hdr_t *chdr)
+{
+	if (fw_unit->comp >= FWPKG_COMP_LAST) {
+		FWPKG_ERR(("fwpkg_check_comp_hdr: unsupported compression(%d)\n",
+			fw_unit->comp));
+		return FALSE;
+	}
+	if (chdr->orig_size == 0 || chdr->blk_size == 0 ||
+		chdr->blk_size > LZ4_MAX_INPUT_SIZE) {
+		FWPKG_ERR(("fwpkg_check_comp_hdr: bad header, size %d, block %d\n",
+			chdr->orig_size, chdr->blk_size));
+		return FALSE;
+	}
+	fw_unit->orig_size = chdr->orig_size;
+	fw_unit->blk_size = chdr->blk_size;
+
+	return TRUE;
+}
+
+/* read the compression header at the start of a unit, 'file' is positioned anywhere */
+static bool
+fwpkg_parse_comp_hdr(fwpkg_unit_t *fw_unit, FWPKG_FILE *file)
+{
+	fwpkg_comp_hdr_t chdr;
+
+	if (fw_unit->size < sizeof(chdr)) {
+		FWPKG_ERR(("fwpkg_parse_comp_hdr: unit too short(%d)\n", fw_unit->size));
+		return FALSE;
+	}
+	if (fwpkg_seek(file, fw_unit->offset) != BCME_OK) {
+		FWPKG_ERR(("fwpkg_parse_comp_hdr: can't get to the unit offset\n"));
+		return FALSE;
+	}
+	if (fwpkg_read((char *)&chdr, sizeof(chdr), file) < 0) {
+		FWPKG_ERR(("fwpkg_parse_comp_hdr: can't read the compression header\n"));
+		return FALSE;
+	}
+
+	return fwpkg_check_comp_hdr(fw_unit, &chdr);
+}
+
+/* read the next compressed block and inflate it, it has to produce exactly 'len' bytes */
+static int
+fwpkg_stream_inflate(fwpkg_stream_t *st, char *dst, uint32 len)
+{
+	uint32 comp_len = 0;
+	const char *src;
+	int ret;
+
+	if (st->in_left < sizeof(comp_len)) {
+		FWPKG_ERR(("fwpkg_stream_inflate: truncated unit\n"));
+		return BCME_BADLEN;
+	}
+	if (fwpkg_stream_get(st, (char *)&comp_len, sizeof(comp_len)) != sizeof(comp_len)) {
+		FWPKG_ERR(("fwpkg_stream_inflate: can't read block len\n"));
+		return BCME_ERROR;
+	}
+	st->in_left -= sizeof(comp_len);
+	if (comp_len > st->cbuf_size || comp_len > st->in_left) {
+		FWPKG_ERR(("fwpkg_stream_inflate: bad block len(%d)\n", comp_len));
+		return BCME_BADLEN;
+	}
+	if (st->mem) {
+		/* inflate straight from the package in memory */
+		src = st->mem;
+		st->mem += comp_len;
+		st->mem_left -= comp_len;
+	} else {
+		if (fwpkg_read(st->cbuf, comp_len, st->fp) != (int)comp_len) {
+			FWPKG_ERR(("fwpkg_stream_inflate: can't read block\n"));
+			return BCME_ERROR;
+		}
+		src = st->cbuf;
+	}
+	st->in_left -= comp_len;
+
+	ret = LZ4_decompress_safe(src, dst, comp_len, len);
+	if (ret != (int)len) {
+		FWPKG_ERR(("fwpkg_stream_inflate: corrupt block, got %d of %d\n", ret, len));
+		return BCME_ERROR;
+	}
+	st->out_left -= len;
+
+	return ret;
+}
+#endif /* DHD_FWPKG_COMP */
+
+/*
+ * set up reading of a unit opened by fwpkg_open_xxx_img() on 'fp'.
+ * a unit stored as is, or a single binary file, is read straight from the file.
+ */
+int
+fwpkg_stream_open(fwpkg_stream_t *st, fwpkg_info_t *fwpkg, uint32 unit_type, FWPKG_FILE *fp)
+{
+	fwpkg_unit_t *fw_unit;
+
+	bzero(st, sizeof(*st));
+	st->fp = fp;
+
+	if (IS_FWPKG_SINGLE(fwpkg)) {
+		return BCME_OK;
+	}
+
+	fw_unit = &fwpkg->units[FWPKG_UNIT_IDX(unit_type)];
+	if (fw_unit->comp == FWPKG_COMP_NONE) {
+		return BCME_OK;
+	}
+
+#ifdef DHD_FWPKG_COMP
+	st->unit = fw_unit;
+	st->in_left = fw_unit->size - sizeof(fwpkg_comp_hdr_t);
+	st->out_left = fw_unit->orig_size;
+	st->cbuf_size = LZ4_COMPRESSBOUND(fw_unit->blk_size);
+	st->cbuf = fwpkg_alloc(st->cbuf_size);
+	if (st->cbuf == NULL) {
+		FWPKG_ERR(("fwpkg_stream_open: can't allocate %d bytes\n", st->cbuf_size));
+		st->cbuf_size = 0;
+		return BCME_NOMEM;
+	}
+
+	return BCME_OK;
+#else
+	return BCME_UNSUPPORTED;
+#endif /* DHD_FWPKG_COMP */
+}
+
+/*
+ * same as fwpkg_stream_open() for a package parsed by fwpkg_init_mem().
+ * compressed blocks are inflated straight from 'data'.
+ */
+int
+fwpkg_stream_open_mem(fwpkg_stream_t *st, fwpkg_info_t *fwpkg, uint32 unit_type,
+	const char *data)
+{
+	fwpkg_unit_t *fw_unit;
+
+	bzero(st, sizeof(*st));
+
+	if (IS_FWPKG_SINGLE(fwpkg)) {
+		st->mem = data;
+		st->mem_left = fwpkg->file_size;
+		return BCME_OK;
+	}
+
+	fw_unit = &fwpkg->units[FWPKG_UNIT_IDX(unit_type)];
+	st->mem = data + fw_unit->offset;
+	st->mem_left = fw_unit->size;
+	if (fw_unit->comp == FWPKG_COMP_NONE) {
+		return BCME_OK;
+	}
+
+#ifdef DHD_FWPKG_COMP
+	st->unit = fw_unit;
+	st->mem += sizeof(fwpkg_comp_hdr_t);
+	st->mem_left -= sizeof(fwpkg_comp_hdr_t);
+	st->in_left = st->mem_left;
+	st->out_left = fw_unit->orig_size;
+	/* bounds a block, there is no block buffer to fill */
+	st->cbuf_size = LZ4_COMPRESSBOUND(fw_unit->blk_size);
+
+	return BCME_OK;
+#else
+	return BCME_UNSUPPORTED;
+#endif /* DHD_FWPKG_COMP */
+}
+
+/* read 'len' bytes of the unit as stored, from memory or from the file */
+static int
+fwpkg_stream_get(fwpkg_stream_t *st, char *buf, uint32 len)
+{
+	if (st->mem == NULL) {
+		return fwpkg_read(buf, len, st->fp);
+	}
+
+	len = MIN(len, st->mem_left);
+	memcpy(buf, st->mem, len);
+	st->mem += len;
+	st->mem_left -= len;
+
+	return len;
+}
+
+/*
+ * read up to 'len' bytes of unit data. a block that fits in what is left of 'buf'
+ * is inflated straight into it, otherwise it goes through the stream's block buffer.
+ */
+int
+fwpkg_stream_read(fwpkg_stream_t *st, char *buf, int len)
+{
+#ifdef DHD_FWPKG_COMP
+	uint32 blk, n;
+	char *dst;
+	int done = 0;
+	int ret;
+
+	if (st->unit == NULL) {
+		return fwpkg_stream_get(st, buf, len);
+	}
+
+	while (done < len) {
+		if (st->dbuf_off < st->dbuf_len) {
+			n = MIN(st->dbuf_len - st->dbuf_off, (uint32)(len - done));
+			memcpy(buf + done, st->dbuf + st->dbuf_off, n);
+			st->dbuf_off += n;
+			done += n;
+			continue;
+		}
+		if (st->out_left == 0) {
+			break;
+		}
+
+		blk = MIN(st->unit->blk_size, st->out_left);
+		if ((uint32)(len - done) >= blk) {
+			dst = buf + done;
+		} else {
+			if (st->dbuf == NULL) {
+				st->dbuf = fwpkg_alloc(st->unit->blk_size);
+				if (st->dbuf == NULL) {
+					FWPKG_ERR(("fwpkg_stream_read: can't allocate %d bytes\n",
+						st->unit->blk_size));
+					return BCME_NOMEM;
+				}
+			}
+			dst = st->dbuf;
+		}
+
+		ret = fwpkg_stream_inflate(st, dst, blk);
+		if (ret < 0) {
+			return ret;
+		}
+		if (dst == st->dbuf) {
+			st->dbuf_len = blk;
+			st->dbuf_off = 0;
+		} else {
+			done += blk;
+		}
+	}
+
+	return done;
+#else
+	return fwpkg_stream_get(st, buf, len);
+#endif /* DHD_FWPKG_COMP */
+}
+
+void
+fwpkg_stream_close(fwpkg_stream_t *st)
+{
+	if (st->cbuf) {
+		fwpkg_free(st->cbuf, st->cbuf_size);
+		st->cbuf = NULL;
+	}
+	if (st->dbuf) {
+		fwpkg_free(st->dbuf, st->unit->blk_size);
+		st->dbuf = NULL;
+	}
+}
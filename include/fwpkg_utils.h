@@ -41,12 +41,34 @@ typedef struct fwpkg_hdr {
 	uint32 magic_word1;	/* hardcoded value */
 } fwpkg_hdr_t;
 
+/* rTLV type field: unit tag in the low half, compression method in the high half */
+#define FWPKG_TYPE_TAG(type)	((type) & 0xFFFFu)
+#define FWPKG_TYPE_COMP(type)	((type) >> 16u)
+
+enum {
+	FWPKG_COMP_NONE	= 0,
+	FWPKG_COMP_LZ4	= 1,	/* independent LZ4 blocks */
+	FWPKG_COMP_LAST
+};
+
+/* header at the start of a compressed unit. It is followed by blocks of
+ * { uint32 comp_len; uint8 data[comp_len]; }, each of which inflates to
+ * blk_size bytes, except the last one which holds the remainder.
+ */
+typedef struct fwpkg_comp_hdr {
+	uint32 orig_size;	/* size of the unit once decompressed */
+	uint32 blk_size;	/* decompressed size of a block */
+} fwpkg_comp_hdr_t;
+
 /* internal firmware package unit header */
 typedef struct fwpkg_unit
 {
 	uint32	offset;		/* offset to the data in the file */
 	uint32	size;		/* the data size */
 	uint32  type;
+	uint32	comp;		/* FWPKG_COMP_xxx */
+	uint32	orig_size;	/* decompressed data size */
+	uint32	blk_size;	/* decompressed block size */
 } fwpkg_unit_t;
 
 #define FWPKG_SINGLE_FLG	1U
@@ -72,9 +94,33 @@ typedef struct fwpkg_info
 #endif /* BCMDRIVER */
 
 int fwpkg_init(fwpkg_info_t *fwpkg, char *fname);
+int fwpkg_init_mem(fwpkg_info_t *fwpkg, const char *data, uint32 len);
 int fwpkg_open_firmware_img(fwpkg_info_t *fwpkg, char *fname, FWPKG_FILE **fp);
 int fwpkg_open_signature_img(fwpkg_info_t *fwpkg, char *fname, FWPKG_FILE **fp);
 uint32 fwpkg_get_firmware_img_size(fwpkg_info_t *fwpkg);
 uint32 fwpkg_get_signature_img_size(fwpkg_info_t *fwpkg);
 
+/* reads a unit, inflating it on the fly if it is stored compressed */
+typedef struct fwpkg_stream
+{
+	FWPKG_FILE *fp;
+	const char *mem;	/* unit data in memory, read instead of fp if set */
+	uint32 mem_left;	/* bytes not read from mem yet */
+	fwpkg_unit_t *unit;	/* NULL when the data is read as is */
+	uint32 in_left;		/* compressed bytes not read from the file yet */
+	uint32 out_left;	/* decompressed bytes not produced yet */
+	char *cbuf;		/* one compressed block */
+	uint32 cbuf_size;
+	char *dbuf;		/* one decompressed block, for reads smaller than a block */
+	uint32 dbuf_len;
+	uint32 dbuf_off;
+} fwpkg_stream_t;
+
+int fwpkg_stream_open(fwpkg_stream_t *st, fwpkg_info_t *fwpkg, uint32 unit_type,
+	FWPKG_FILE *fp);
+int fwpkg_stream_open_mem(fwpkg_stream_t *st, fwpkg_info_t *fwpkg, uint32 unit_type,
+	const char *data);
+int fwpkg_stream_read(fwpkg_stream_t *st, char *buf, int len);
+void fwpkg_stream_close(fwpkg_stream_t *st);
+
 #endif /* _fwpkg_utils_h_ */
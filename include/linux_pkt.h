@@ -73,6 +73,8 @@
 #else
 #define	PKTFREE(osh, skb, send)		linux_pktfree((osh), (skb), (send))
 #endif /* BCM_OBJECT_TRACE */
+/* free an array of sent packets in one pass */
+#define	PKTFREE_BULK(osh, pkts, cnt)	linux_pktfree_bulk((osh), (pkts), (cnt))
 #ifdef CONFIG_DHD_USE_STATIC_BUF
 #define	PKTGET_STATIC(osh, len, send)		osl_pktget_static((osh), (len))
 #define	PKTFREE_STATIC(osh, skb, send)		osl_pktfree_static((osh), (skb), (send))
@@ -258,6 +260,7 @@ extern void linux_pktfree(osl_t *osh, void *skb, bool send, int line, const char
 #else
 extern void linux_pktfree(osl_t *osh, void *skb, bool send);
 #endif /* BCM_OBJECT_TRACE */
+extern void linux_pktfree_bulk(osl_t *osh, void **pkts, uint cnt);
 extern void *osl_pktget_static(osl_t *osh, uint len);
 extern void osl_pktfree_static(osl_t *osh, void *skb, bool send);
 extern void osl_pktclone(osl_t *osh, void **pkt);
@@ -437,6 +440,22 @@ extern void osl_pktlist_remove(osl_t *osh, void *p);
 #define PKTALLOCED(osh)		osl_pktalloced(osh)
 extern uint osl_pktalloced(osl_t *osh);
 
+#if defined(DHD_RX_PAGE_POOL) && (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0))
+/* RX packets backed by a page_pool page that keeps its DMA mapping */
+#define OSL_PAGE_POOL
+#define PKTISPAGEPOOL(osh, skb)		({BCM_REFERENCE(osh); \
+					((struct sk_buff *)(skb))->pp_recycle;})
+#define PKTGET_PAGE_POOL(osh, pool, len)	osl_page_pool_pktget((osh), (pool), (len))
+extern void *osl_page_pool_create(osl_t *osh, uint pool_size);
+extern void osl_page_pool_destroy(osl_t *osh, void *pool);
+extern void *osl_page_pool_pktget(osl_t *osh, void *pool, uint len);
+extern dmaaddr_t osl_page_pool_dma_addr(osl_t *osh, void *skb);
+extern void osl_page_pool_sync_for_cpu(osl_t *osh, dmaaddr_t pa, uint len);
+extern void osl_page_pool_sync_for_device(osl_t *osh, dmaaddr_t pa, uint len);
+#else
+#define PKTISPAGEPOOL(osh, skb)		({BCM_REFERENCE(osh); BCM_REFERENCE(skb); FALSE;})
+#endif /* DHD_RX_PAGE_POOL && LINUX_VERSION >= 5.15 */
+
 #define PKTPOOLHEAPCOUNT()            (0u)
 
 #if !defined(BCMDONGLEHOST) && !defined(DONGLEBUILD)
@@ -38,6 +38,13 @@
 #endif
 #include <linux/fs.h>
 #include "linux_osl_priv.h"
+#ifdef OSL_PAGE_POOL
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0))
+#include <net/page_pool/helpers.h>
+#else
+#include <net/page_pool.h>
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0) */
+#endif /* OSL_PAGE_POOL */
 
 #ifdef CONFIG_DHD_USE_STATIC_BUF
 
@@ -414,6 +421,46 @@ BCMFASTPATH(linux_pktfree)(osl_t *osh, void *p, bool send)
 	}
 }
 
+/*
+ * Free an array of sent packets. The skbs are consumed in one BH disabled pass
+ * through napi_consume_skb, which returns the skb heads to the per CPU NAPI cache
+ * in bulk instead of one kmem_cache_free each. With the packet debug/trace
+ * features the packets go through linux_pktfree one by one.
+ */
+void
+BCMFASTPATH(linux_pktfree_bulk)(osl_t *osh, void **pkts, uint cnt)
+{
+	uint i;
+#if defined(BCMDBG_CTRACE) || defined(BCMDBG_PKT) || defined(BCM_OBJECT_TRACE) || \
+	(defined(CONFIG_DHD_USE_STATIC_BUF) && defined(DHD_USE_STATIC_CTRLBUF)) || \
+	(LINUX_VERSION_CODE < KERNEL_VERSION(4, 5, 0))
+	for (i = 0; i < cnt; i++) {
+		PKTFREE(osh, pkts[i], TRUE);
+	}
+#else
+	struct sk_buff *skb, *nskb;
+
+	if (osh == NULL)
+		return;
+
+	local_bh_disable();
+	for (i = 0; i < cnt; i++) {
+		if (osh->pub.tx_fn) {
+			osh->pub.tx_fn(osh->pub.tx_ctx, pkts[i], 0);
+		}
+
+		/* multi-skb packets are chained through skb->next, as in linux_pktfree */
+		for (skb = (struct sk_buff *)pkts[i]; skb; skb = nskb) {
+			nskb = skb->next;
+			skb->next = NULL;
+			napi_consume_skb(skb, 1);
+			atomic_dec(&osh->cmn->pktalloced);
+		}
+	}
+	local_bh_enable();
+#endif /* pkt debug/trace || LINUX_VERSION_CODE < 4.5 */
+}
+
 #ifdef CONFIG_DHD_USE_STATIC_BUF
 void*
 osl_pktget_static(osl_t *osh, uint len)
@@ -910,3 +957,127 @@ osl_pkt_orphan_partial(struct sk_buff *skb)
 	atomic_sub(fraction, (atomic_t *)&skb->sk->sk_wmem_alloc);
 }
 #endif /* LINUX_VERSION >= 3.6.0 && TSQ_MULTIPLIER */
+
+#ifdef OSL_PAGE_POOL
+/* headroom left in front of the rx data, same as a dev_alloc_skb'd packet */
+#define OSL_PAGE_POOL_HEADROOM	NET_SKB_PAD
+/* largest buffer that still leaves room for skb_shared_info in the page */
+#define OSL_PAGE_POOL_BUF_MAX	\
+	(PAGE_SIZE - OSL_PAGE_POOL_HEADROOM - SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+/*
+ * Create a page_pool whose pages stay DMA mapped for the lifetime of the
+ * pool. Pages recycled by the stack are synced back to the device by the
+ * pool itself, so the rx path neither maps nor unmaps them.
+ */
+void *
+osl_page_pool_create(osl_t *osh, uint pool_size)
+{
+	struct page_pool_params pp_params;
+	struct page_pool *pool;
+
+	bzero(&pp_params, sizeof(pp_params));
+	pp_params.order = 0;
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+	pp_params.pool_size = pool_size;
+	pp_params.nid = NUMA_NO_NODE;
+	pp_params.dev = &((struct pci_dev *)osh->pdev)->dev;
+	/* For Rx buffers, keep direction as bidirectional to handle packet fetch cases */
+	pp_params.dma_dir = DMA_BIDIRECTIONAL;
+	pp_params.offset = OSL_PAGE_POOL_HEADROOM;
+	pp_params.max_len = OSL_PAGE_POOL_BUF_MAX;
+
+	pool = page_pool_create(&pp_params);
+	if (IS_ERR(pool)) {
+		OSL_PRINT(("%s: page_pool_create failed %ld\n", __FUNCTION__, PTR_ERR(pool)));
+		return NULL;
+	}
+
+	return (void *)pool;
+}
+
+void
+osl_page_pool_destroy(osl_t *osh, void *pool)
+{
+	/* pages still held by the stack are released as they come back */
+	if (pool) {
+		page_pool_destroy((struct page_pool *)pool);
+	}
+}
+
+/* Return a driver packet of len bytes built on a page from the pool */
+void *
+BCMFASTPATH(osl_page_pool_pktget)(osl_t *osh, void *pool, uint len)
+{
+	struct page *page;
+	struct sk_buff *skb;
+
+	if (len > OSL_PAGE_POOL_BUF_MAX) {
+		return NULL;
+	}
+
+	page = page_pool_dev_alloc_pages((struct page_pool *)pool);
+	if (!page) {
+		return NULL;
+	}
+
+	skb = build_skb(page_address(page), PAGE_SIZE);
+	if (!skb) {
+		page_pool_put_full_page((struct page_pool *)pool, page, FALSE);
+		return NULL;
+	}
+	skb_reserve(skb, OSL_PAGE_POOL_HEADROOM);
+	skb_put(skb, len);
+	/* freeing the skb returns the page to the pool instead of the allocator */
+	skb_mark_for_recycle(skb);
+
+	return PKTFRMNATIVE(osh, skb);
+}
+
+/* Bus address of the current data pointer of a page pool packet */
+dmaaddr_t
+BCMFASTPATH(osl_page_pool_dma_addr)(osl_t *osh, void *skb)
+{
+	struct sk_buff *nskb = (struct sk_buff *)skb;
+	struct page *page = virt_to_head_page(nskb->head);
+	dma_addr_t map_addr;
+	dmaaddr_t ret_addr;
+
+	map_addr = page_pool_get_dma_addr(page) +
+		(dma_addr_t)(nskb->data - (uchar *)page_address(page));
+	PHYSADDRLOSET(ret_addr, map_addr & 0xffffffff);
+	PHYSADDRHISET(ret_addr, (map_addr >> 32) & 0xffffffff);
+
+	return ret_addr;
+}
+
+/* Make the data written by the dongle visible to the CPU, mapping is kept */
+void
+BCMFASTPATH(osl_page_pool_sync_for_cpu)(osl_t *osh, dmaaddr_t pa, uint len)
+{
+	dma_addr_t paddr;
+
+#ifdef BCMDMA64OSL
+	PHYSADDRTOULONG(pa, paddr);
+#else
+	paddr = (dma_addr_t)pa;
+#endif /* BCMDMA64OSL */
+	dma_sync_single_for_cpu(&((struct pci_dev *)osh->pdev)->dev, paddr, len,
+		DMA_BIDIRECTIONAL);
+}
+
+/* Hand a recycled buffer back to the device, mapping is kept */
+void
+BCMFASTPATH(osl_page_pool_sync_for_device)(osl_t *osh, dmaaddr_t pa, uint len)
+{
+	dma_addr_t paddr;
+
+#ifdef BCMDMA64OSL
+	PHYSADDRTOULONG(pa, paddr);
+#else
+	paddr = (dma_addr_t)pa;
+#endif /* BCMDMA64OSL */
+	dma_sync_single_for_device(&((struct pci_dev *)osh->pdev)->dev, paddr, len,
+		DMA_BIDIRECTIONAL);
+}
+#endif /* OSL_PAGE_POOL */
@@ -679,6 +679,10 @@ static struct wl_event_q *wl_deq_event(struct bcm_cfg80211 *cfg);
 static s32 wl_enq_event(struct bcm_cfg80211 *cfg, struct net_device *ndev, u32 type,
 	const wl_event_msg_t *msg, void *data);
 static void wl_put_event(struct bcm_cfg80211 *cfg, struct wl_event_q *e);
+#ifdef WL_EVENT_SLOT_POOL
+static s32 wl_evt_pool_init(struct bcm_cfg80211 *cfg);
+static void wl_evt_pool_deinit(struct bcm_cfg80211 *cfg);
+#endif /* WL_EVENT_SLOT_POOL */
 static s32 wl_notify_connect_status(struct bcm_cfg80211 *cfg,
 	bcm_struct_cfgdev *cfgdev, const wl_event_msg_t *e, void *data);
 static s32 wl_notify_roaming_status(struct bcm_cfg80211 *cfg,
@@ -18092,6 +18096,19 @@ static s32 wl_init_priv_mem(struct bcm_cfg80211 *cfg)
 		goto init_priv_mem_out;
 	}
 #endif /* DEBUG_SETROAMMODE */
+#ifdef WL_ESCAN_BSS_HASH
+	cfg->escan_info.bss_idx = (void *)MALLOCZ(cfg->osh, sizeof(*cfg->escan_info.bss_idx));
+	if (unlikely(!cfg->escan_info.bss_idx)) {
+		WL_ERR(("escan bss index alloc failed\n"));
+		goto init_priv_mem_out;
+	}
+#endif /* WL_ESCAN_BSS_HASH */
+#ifdef WL_EVENT_SLOT_POOL
+	if (unlikely(wl_evt_pool_init(cfg))) {
+		WL_ERR(("event slot pool alloc failed\n"));
+		goto init_priv_mem_out;
+	}
+#endif /* WL_EVENT_SLOT_POOL */
 
 	return 0;
 
@@ -18125,6 +18142,12 @@ static void wl_deinit_priv_mem(struct bcm_cfg80211 *cfg)
 #ifdef DEBUG_SETROAMMODE
 	MFREE(cfg->osh, cfg->roamoff_info, sizeof(*cfg->roamoff_info));
 #endif /* DEBUG_SETROAMMODE */
+#ifdef WL_ESCAN_BSS_HASH
+	MFREE(cfg->osh, cfg->escan_info.bss_idx, sizeof(*cfg->escan_info.bss_idx));
+#endif /* WL_ESCAN_BSS_HASH */
+#ifdef WL_EVENT_SLOT_POOL
+	wl_evt_pool_deinit(cfg);
+#endif /* WL_EVENT_SLOT_POOL */
 
 }
 
@@ -19462,6 +19485,99 @@ static void wl_init_eq(struct bcm_cfg80211 *cfg)
 	INIT_LIST_HEAD(&cfg->eq_list);
 }
 
+#ifdef WL_EVENT_SLOT_POOL
+static s32 wl_evt_pool_init(struct bcm_cfg80211 *cfg)
+{
+	wl_evt_pool_t *pool = &cfg->evt_pool;
+	struct wl_event_q *e;
+	unsigned long flags;
+	u32 i;
+
+	pool->slots = (u8 *)VMALLOCZ(cfg->osh, WL_EVT_SLOT_NUM * WL_EVT_SLOT_SZ);
+	if (!pool->slots) {
+		return -ENOMEM;
+	}
+
+	flags = wl_lock_eq(cfg);
+	INIT_LIST_HEAD(&pool->free_list);
+	for (i = 0; i < WL_EVT_SLOT_NUM; i++) {
+		e = (struct wl_event_q *)(pool->slots + (i * WL_EVT_SLOT_SZ));
+		list_add_tail(&e->eq_list, &pool->free_list);
+	}
+	pool->inuse = pool->inuse_max = 0;
+	pool->oversize = pool->exhausted = pool->drops = 0;
+	wl_unlock_eq(cfg, flags);
+
+	return BCME_OK;
+}
+
+static void wl_evt_pool_deinit(struct bcm_cfg80211 *cfg)
+{
+	wl_evt_pool_t *pool = &cfg->evt_pool;
+	unsigned long flags;
+
+	if (!pool->slots) {
+		return;
+	}
+
+	WL_INFORM_MEM(("evt_pool inuse:%u max:%u oversize:%u exhausted:%u drops:%u\n",
+		pool->inuse, pool->inuse_max, pool->oversize, pool->exhausted, pool->drops));
+
+	flags = wl_lock_eq(cfg);
+	INIT_LIST_HEAD(&pool->free_list);
+	wl_unlock_eq(cfg, flags);
+
+	VMFREE(cfg->osh, pool->slots, WL_EVT_SLOT_NUM * WL_EVT_SLOT_SZ);
+	pool->slots = NULL;
+}
+
+static inline bool wl_evt_slot_owned(struct bcm_cfg80211 *cfg, struct wl_event_q *e)
+{
+	u8 *p = (u8 *)e;
+
+	return (cfg->evt_pool.slots && (p >= cfg->evt_pool.slots) &&
+		(p < cfg->evt_pool.slots + (WL_EVT_SLOT_NUM * WL_EVT_SLOT_SZ)));
+}
+
+/* Takes a free slot for an event of evtq_size bytes, NULL if the caller
+ * has to fall back to MALLOC
+ */
+static struct wl_event_q *wl_evt_slot_get(struct bcm_cfg80211 *cfg, u32 evtq_size)
+{
+	wl_evt_pool_t *pool = &cfg->evt_pool;
+	struct wl_event_q *e = NULL;
+	unsigned long flags;
+
+	if (unlikely(!pool->slots)) {
+		return NULL;
+	}
+
+	flags = wl_lock_eq(cfg);
+	if (unlikely(evtq_size > WL_EVT_SLOT_SZ)) {
+		pool->oversize++;
+	} else if (unlikely(list_empty(&pool->free_list))) {
+		pool->exhausted++;
+	} else {
+		BCM_SET_LIST_FIRST_ENTRY(e, &pool->free_list, struct wl_event_q, eq_list);
+		list_del(&e->eq_list);
+		pool->inuse++;
+		if (pool->inuse > pool->inuse_max) {
+			pool->inuse_max = pool->inuse;
+		}
+	}
+	wl_unlock_eq(cfg, flags);
+
+	return e;
+}
+
+/* called with eq_lock held */
+static inline void wl_evt_slot_put_locked(struct bcm_cfg80211 *cfg, struct wl_event_q *e)
+{
+	list_add(&e->eq_list, &cfg->evt_pool.free_list);
+	cfg->evt_pool.inuse--;
+}
+#endif /* WL_EVENT_SLOT_POOL */
+
 static void wl_flush_eq(struct bcm_cfg80211 *cfg)
 {
 	struct wl_event_q *e;
@@ -19471,6 +19587,12 @@ static void wl_flush_eq(struct bcm_cfg80211 *cfg)
 	while (!list_empty_careful(&cfg->eq_list)) {
 		BCM_SET_LIST_FIRST_ENTRY(e, &cfg->eq_list, struct wl_event_q, eq_list);
 		list_del(&e->eq_list);
+#ifdef WL_EVENT_SLOT_POOL
+		if (wl_evt_slot_owned(cfg, e)) {
+			wl_evt_slot_put_locked(cfg, e);
+			continue;
+		}
+#endif /* WL_EVENT_SLOT_POOL */
 		MFREE(cfg->osh, e, e->datalen + sizeof(struct wl_event_q));
 	}
 	wl_unlock_eq(cfg, flags);
@@ -19513,15 +19635,28 @@ wl_enq_event(struct bcm_cfg80211 *cfg, struct net_device *ndev, u32 event,
 	if (data)
 		data_len = ntoh32(msg->datalen);
 	evtq_size = (uint32)(sizeof(struct wl_event_q) + data_len);
-	e = (struct wl_event_q *)MALLOCZ(cfg->osh, evtq_size);
-	if (unlikely(!e)) {
-		WL_ERR(("event alloc failed\n"));
-		return -ENOMEM;
+#ifdef WL_EVENT_SLOT_POOL
+	e = wl_evt_slot_get(cfg, evtq_size);
+	if (unlikely(!e))
+#endif /* WL_EVENT_SLOT_POOL */
+	{
+		e = (struct wl_event_q *)MALLOCZ(cfg->osh, evtq_size);
+		if (unlikely(!e)) {
+#ifdef WL_EVENT_SLOT_POOL
+			flags = wl_lock_eq(cfg);
+			cfg->evt_pool.drops++;
+			wl_unlock_eq(cfg, flags);
+#endif /* WL_EVENT_SLOT_POOL */
+			WL_ERR(("event alloc failed\n"));
+			return -ENOMEM;
+		}
 	}
 	e->etype = event;
 	memcpy(&e->emsg, msg, sizeof(wl_event_msg_t));
 	if (data)
 		memcpy(e->edata, data, data_len);
+	/* handlers may treat edata as a string, a recycled slot is not zeroed */
+	e->edata[data_len] = 0;
 	e->datalen = data_len;
 	e->id = cfg->eidx.enqd++;
 	flags = wl_lock_eq(cfg);
@@ -19533,6 +19668,16 @@ wl_enq_event(struct bcm_cfg80211 *cfg, struct net_device *ndev, u32 event,
 
 static void wl_put_event(struct bcm_cfg80211 *cfg, struct wl_event_q *e)
 {
+#ifdef WL_EVENT_SLOT_POOL
+	if (wl_evt_slot_owned(cfg, e)) {
+		unsigned long flags;
+
+		flags = wl_lock_eq(cfg);
+		wl_evt_slot_put_locked(cfg, e);
+		wl_unlock_eq(cfg, flags);
+		return;
+	}
+#endif /* WL_EVENT_SLOT_POOL */
 	MFREE(cfg->osh, e, e->datalen + sizeof(struct wl_event_q));
 }
 
@@ -26878,6 +27023,12 @@ wl_cfg80211_debug_data_dump(struct net_device *dev, u8 *buf, u32 buf_len)
 
 	ret = snprintf(buf+len, buf_len-len, "eq_lock:%d\n", spin_is_locked(&cfg->eq_lock));
 	CHECK_AND_INCR_LEN(ret, len, buf_len);
+#ifdef WL_EVENT_SLOT_POOL
+	ret = snprintf(buf+len, buf_len-len, "evt_pool inuse:%u max:%u oversize:%u"
+		" exhausted:%u drops:%u\n", cfg->evt_pool.inuse, cfg->evt_pool.inuse_max,
+		cfg->evt_pool.oversize, cfg->evt_pool.exhausted, cfg->evt_pool.drops);
+	CHECK_AND_INCR_LEN(ret, len, buf_len);
+#endif /* WL_EVENT_SLOT_POOL */
 
 #ifdef WL_WPS_SYNC
 	ret = snprintf(buf+len, buf_len-len, "wps:%d\n", spin_is_locked(&cfg->wps_sync));
@@ -1575,6 +1575,24 @@ struct wl_pmk_list {
 #define MAC_RAND_BYTES	3
 #define ESCAN_BUF_SIZE (64 * 1024)
 
+#ifdef WL_ESCAN_BSS_HASH
+/* Hash index over the escan result buffer, keyed on BSSID and band, so that
+ * duplicate suppression of partial results does not walk the whole list.
+ */
+#define WL_ESCAN_BSS_HASH_SZ		256u	/* power of 2 */
+#define WL_ESCAN_BSS_IDX_MAX		512u	/* ESCAN_BUF_SIZE / min bss_info */
+#define WL_ESCAN_BSS_IDX_NULL		0xFFFFu
+
+typedef struct wl_escan_bss_idx {
+	void *list;		/* escan buffer the index was built for */
+	u32 count;		/* list->count when last synced */
+	u32 buflen;		/* list->buflen when last synced */
+	u16 head[WL_ESCAN_BSS_HASH_SZ];
+	u16 next[WL_ESCAN_BSS_IDX_MAX];
+	u32 offset[WL_ESCAN_BSS_IDX_MAX];	/* entry offset from list start */
+} wl_escan_bss_idx_t;
+#endif /* WL_ESCAN_BSS_HASH */
+
 struct escan_info {
 	u32 escan_state;
 #ifdef STATIC_WL_PRIV_STRUCT
@@ -1599,6 +1617,9 @@ struct escan_info {
 #endif /* DUAL_ESCAN_RESULT_BUFFER */
 	struct wiphy *wiphy;
 	struct net_device *ndev;
+#ifdef WL_ESCAN_BSS_HASH
+	wl_escan_bss_idx_t *bss_idx;
+#endif /* WL_ESCAN_BSS_HASH */
 #ifdef DHD_SEND_HANG_ESCAN_SYNCID_MISMATCH
 	bool prev_escan_aborted;
 #endif /* DHD_SEND_HANG_ESCAN_SYNCID_MISMATCH */
@@ -2029,6 +2050,29 @@ typedef struct wl_event_idx {
 	u32 min_connect_idx;
 } wl_event_idx_t;
 
+#ifdef WL_EVENT_SLOT_POOL
+/* Preallocated slots for wl_enq_event, oversized events and an empty
+ * pool fall back to MALLOC
+ */
+#ifndef WL_EVT_SLOT_NUM
+#define WL_EVT_SLOT_NUM		64u
+#endif /* WL_EVT_SLOT_NUM */
+#ifndef WL_EVT_SLOT_DATA_SZ
+#define WL_EVT_SLOT_DATA_SZ	1536u
+#endif /* WL_EVT_SLOT_DATA_SZ */
+#define WL_EVT_SLOT_SZ		(sizeof(struct wl_event_q) + WL_EVT_SLOT_DATA_SZ)
+
+typedef struct wl_evt_pool {
+	u8 *slots;			/* WL_EVT_SLOT_NUM slots of WL_EVT_SLOT_SZ */
+	struct list_head free_list;	/* free slots, protected by eq_lock */
+	u32 inuse;			/* slots currently queued or in handler */
+	u32 inuse_max;			/* high watermark of inuse */
+	u32 oversize;			/* events too big for a slot */
+	u32 exhausted;			/* events enqueued while no slot was free */
+	u32 drops;			/* events dropped on fallback alloc failure */
+} wl_evt_pool_t;
+#endif /* WL_EVENT_SLOT_POOL */
+
 typedef struct {
 	u32 band;
 	u32 bw_cap;
@@ -2360,6 +2404,9 @@ struct bcm_cfg80211 {
 	u32 join_iovar_ver;
 	struct delayed_work ap_work;     /* AP linkup timeout handler */
 	wl_event_idx_t eidx;	/* event state tracker */
+#ifdef WL_EVENT_SLOT_POOL
+	wl_evt_pool_t evt_pool;	/* preallocated event queue slots */
+#endif /* WL_EVENT_SLOT_POOL */
 	u32 halpid;
 #ifdef WL_THERMAL_MITIGATION
 	u32 thermal_mode;
@@ -813,6 +813,127 @@ wl_cfg80211_remove_lowRSSI_info(wl_scan_results_v109_t *list, removal_element_t
 #endif /* WL_DRV_AVOID_SCANCACHE */
 #endif /* ESCAN_BUF_OVERFLOW_MGMT */
 
+#if defined(WL_ESCAN_BSS_HASH) && !defined(WL_DRV_AVOID_SCANCACHE)
+static inline u32
+wl_escan_bss_hash(const wl_bss_info_v109_t *bi)
+{
+	const u8 *ea = bi->BSSID.octet;
+	u32 band = CHSPEC_BAND(wl_chspec_driver_to_host(bi->chanspec)) >>
+		WL_CHANSPEC_BAND_SHIFT;
+
+	return (ea[3] ^ ea[4] ^ ea[5] ^ (band << 6)) & (WL_ESCAN_BSS_HASH_SZ - 1);
+}
+
+static void
+wl_escan_bss_idx_invalidate(wl_escan_bss_idx_t *bss_idx)
+{
+	if (bss_idx) {
+		bss_idx->list = NULL;
+	}
+}
+
+/* Append the entry found at 'offset' of the escan buffer to the index */
+static void
+wl_escan_bss_idx_insert(wl_escan_bss_idx_t *bss_idx, const wl_bss_info_v109_t *bss,
+	u32 offset)
+{
+	u32 n = bss_idx->count;
+	u32 hash = wl_escan_bss_hash(bss);
+
+	bss_idx->offset[n] = offset;
+	bss_idx->next[n] = bss_idx->head[hash];
+	bss_idx->head[hash] = (u16)n;
+	bss_idx->count++;
+	bss_idx->buflen = offset + dtoh32(bss->length);
+}
+
+/*
+ * Returns TRUE if the index describes the current escan buffer. The index is
+ * rebuilt whenever the buffer was switched, reset or modified outside of the
+ * incremental updates done by the escan handler.
+ */
+static bool
+wl_escan_bss_idx_sync(wl_escan_bss_idx_t *bss_idx, wl_scan_results_v109_t *list)
+{
+	wl_bss_info_v109_t *bss;
+	u32 cur_len = WL_SCAN_RESULTS_V109_FIXED_SIZE;
+	u32 i;
+
+	if (!bss_idx) {
+		return FALSE;
+	}
+
+	if ((bss_idx->list == list) && (bss_idx->count == list->count) &&
+		(bss_idx->buflen == list->buflen)) {
+		return TRUE;
+	}
+
+	bss_idx->list = NULL;
+	if (list->count > WL_ESCAN_BSS_IDX_MAX) {
+		return FALSE;
+	}
+
+	(void)memset_s(bss_idx->head, sizeof(bss_idx->head), 0xFF, sizeof(bss_idx->head));
+	bss_idx->count = 0;
+	bss_idx->buflen = cur_len;
+	for (i = 0; i < list->count; i++) {
+		bss = (wl_bss_info_v109_t *)((uintptr)list + cur_len);
+		wl_escan_bss_idx_insert(bss_idx, bss, cur_len);
+		cur_len += dtoh32(bss->length);
+		if (cur_len > ESCAN_BUF_SIZE) {
+			return FALSE;
+		}
+	}
+
+	if (bss_idx->buflen != list->buflen) {
+		return FALSE;
+	}
+	bss_idx->list = list;
+
+	return TRUE;
+}
+
+/*
+ * Look up an entry with the same BSSID, band and SSID as 'bi'. Returns its
+ * position in the list and sets 'cur_len' to its offset, or returns
+ * list->count if there is no such entry.
+ */
+static u32
+wl_escan_bss_idx_find(wl_escan_bss_idx_t *bss_idx, wl_scan_results_v109_t *list,
+	const wl_bss_info_v109_t *bi, int *cur_len)
+{
+	wl_bss_info_v109_t *bss;
+	u16 n;
+
+	for (n = bss_idx->head[wl_escan_bss_hash(bi)]; n != WL_ESCAN_BSS_IDX_NULL;
+		n = bss_idx->next[n]) {
+		bss = (wl_bss_info_v109_t *)((uintptr)list + bss_idx->offset[n]);
+		if (!bcmp(&bi->BSSID, &bss->BSSID, ETHER_ADDR_LEN) &&
+			(CHSPEC_BAND(wl_chspec_driver_to_host(bi->chanspec))
+			== CHSPEC_BAND(wl_chspec_driver_to_host(bss->chanspec))) &&
+			bi->SSID_len == bss->SSID_len &&
+			!bcmp(bi->SSID, bss->SSID, bi->SSID_len)) {
+			*cur_len = bss_idx->offset[n];
+			return n;
+		}
+	}
+
+	return list->count;
+}
+
+/* Entry 'n' changed length in place, shift the entries behind it */
+static void
+wl_escan_bss_idx_resize(wl_escan_bss_idx_t *bss_idx, u32 n, u32 prev_len, u32 new_len)
+{
+	u32 i;
+
+	for (i = n + 1; i < bss_idx->count; i++) {
+		bss_idx->offset[i] = bss_idx->offset[i] - prev_len + new_len;
+	}
+	bss_idx->buflen = bss_idx->buflen - prev_len + new_len;
+}
+#endif /* WL_ESCAN_BSS_HASH && !WL_DRV_AVOID_SCANCACHE */
+
 s32
 wl_escan_handler(struct bcm_cfg80211 *cfg, bcm_struct_cfgdev *cfgdev,
 	const wl_event_msg_t *e, void *data)
@@ -945,6 +1066,10 @@ wl_escan_handler(struct bcm_cfg80211 *cfg, bcm_struct_cfgdev *cfgdev,
 
 		} else {
 			int cur_len = WL_SCAN_RESULTS_V109_FIXED_SIZE;
+#ifdef WL_ESCAN_BSS_HASH
+			wl_escan_bss_idx_t *bss_idx = cfg->escan_info.bss_idx;
+			bool bss_indexed = TRUE;
+#endif /* WL_ESCAN_BSS_HASH */
 #ifdef ESCAN_BUF_OVERFLOW_MGMT
 			removal_element_t candidate[BUF_OVERFLOW_MGMT_COUNT];
 			int remove_lower_rssi = FALSE;
@@ -990,9 +1115,27 @@ wl_escan_handler(struct bcm_cfg80211 *cfg, bcm_struct_cfgdev *cfgdev,
 				remove_lower_rssi = TRUE;
 #endif /* ESCAN_BUF_OVERFLOW_MGMT */
 
-			for (i = 0; i < list->count; i++) {
+			i = 0;
+#ifdef WL_ESCAN_BSS_HASH
+#ifdef ESCAN_BUF_OVERFLOW_MGMT
+			/* removal candidates are picked by walking the whole list */
+			bss_indexed = !remove_lower_rssi;
+#endif /* ESCAN_BUF_OVERFLOW_MGMT */
+			if (bss_indexed) {
+				bss_indexed = wl_escan_bss_idx_sync(bss_idx, list);
+			}
+			if (bss_indexed) {
+				/* start the walk at the matching entry, or skip it on a miss */
+				i = wl_escan_bss_idx_find(bss_idx, list, bi, &cur_len);
+			} else {
+				wl_escan_bss_idx_invalidate(bss_idx);
+			}
+#endif /* WL_ESCAN_BSS_HASH */
+
+			for (; i < list->count; i++) {
 				bss = bss ? (wl_bss_info_v109_t *)
-				((uintptr)bss + dtoh32(bss->length)): list->bss_info;
+				((uintptr)bss + dtoh32(bss->length)):
+				(wl_bss_info_v109_t *)((uintptr)list + cur_len);
 				if (!bss) {
 					WL_ERR(("bss is NULL\n"));
 					goto exit;
@@ -1075,6 +1218,12 @@ wl_escan_handler(struct bcm_cfg80211 *cfg, bcm_struct_cfgdev *cfgdev,
 						}
 						list->buflen -= prev_len;
 						list->buflen += bi_length;
+#ifdef WL_ESCAN_BSS_HASH
+						if (bss_indexed) {
+							wl_escan_bss_idx_resize(bss_idx, i,
+								prev_len, bi_length);
+						}
+#endif /* WL_ESCAN_BSS_HASH */
 					}
 					list->version = dtoh32(bi->version);
 					/* In the above code under check
@@ -1121,6 +1270,12 @@ wl_escan_handler(struct bcm_cfg80211 *cfg, bcm_struct_cfgdev *cfgdev,
 			list->version = dtoh32(bi->version);
 			list->buflen += bi_length;
 			list->count++;
+#ifdef WL_ESCAN_BSS_HASH
+			if (bss_indexed && (bss_idx->count < WL_ESCAN_BSS_IDX_MAX)) {
+				wl_escan_bss_idx_insert(bss_idx, bi,
+					list->buflen - bi_length);
+			}
+#endif /* WL_ESCAN_BSS_HASH */
 		}
 	}
 	else if (status == WLC_E_STATUS_SUCCESS) {